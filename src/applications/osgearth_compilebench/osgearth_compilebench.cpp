@@ -0,0 +1,182 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <OpenThreads/Atomic>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osgEarthFeatures/GeometryCompiler>
+#include <osgEarthFeatures/Feature>
+#include <osgEarthSymbology/Geometry>
+#include <osgEarthSymbology/Style>
+#include <osgEarthSymbology/ExtrusionSymbol>
+#include <osgEarthSymbology/PolygonSymbol>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+using namespace std;
+
+//
+// Compiles a synthetic block of extruded buildings over and over, and reports
+// how long each compile takes and how many heap allocations it makes, e.g.:
+//
+//   osgearth_compilebench --features 1000 --rounds 10
+//
+// Allocations are counted by replacing the global operator new for the whole
+// program and installing the count with GeometryCompiler::setAllocationCounter.
+//
+
+namespace
+{
+    OpenThreads::Atomic s_allocations;
+
+    unsigned long long countAllocations()
+    {
+        return (unsigned)s_allocations;
+    }
+
+    void* countedAlloc(std::size_t size)
+    {
+        ++s_allocations;
+        void* ptr = std::malloc(size > 0 ? size : 1);
+        if ( !ptr )
+            throw std::bad_alloc();
+        return ptr;
+    }
+}
+
+#if __cplusplus >= 201103L
+#  define THROWS_BAD_ALLOC
+#  define THROWS_NOTHING noexcept
+#else
+#  define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#  define THROWS_NOTHING throw()
+#endif
+
+void* operator new  (std::size_t size) THROWS_BAD_ALLOC { return countedAlloc(size); }
+void* operator new[](std::size_t size) THROWS_BAD_ALLOC { return countedAlloc(size); }
+void  operator delete  (void* ptr) THROWS_NOTHING { std::free(ptr); }
+void  operator delete[](void* ptr) THROWS_NOTHING { std::free(ptr); }
+
+namespace
+{
+    // A square footprint with a courtyard, in meters, centered on (x, y).
+    Polygon* makeFootprint(double x, double y, double size, unsigned pointsPerSide)
+    {
+        Polygon* poly = new Polygon();
+        Ring* hole = new Ring();
+        double h = 0.5*size, q = 0.25*size;
+        for(unsigned side=0; side<4; ++side)
+        {
+            for(unsigned i=0; i<pointsPerSide; ++i)
+            {
+                double t = -1.0 + 2.0*(double)i/(double)pointsPerSide;
+                double u = side == 0 ? t : side == 1 ? 1.0 : side == 2 ? -t : -1.0;
+                double v = side == 0 ? -1.0 : side == 1 ? t : side == 2 ? 1.0 : -t;
+                poly->push_back( osg::Vec3d(x + u*h, y + v*h, 0.0) );
+            }
+        }
+        hole->push_back( osg::Vec3d(x-q, y-q, 0.0) );
+        hole->push_back( osg::Vec3d(x-q, y+q, 0.0) );
+        hole->push_back( osg::Vec3d(x+q, y+q, 0.0) );
+        hole->push_back( osg::Vec3d(x+q, y-q, 0.0) );
+        poly->getHoles().push_back( hole );
+        return poly;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--features <n>", "Number of buildings per compile (default 1000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--points <n>", "Points along each side of a footprint (default 4)");
+    arguments.getApplicationUsage()->addCommandLineOption("--rounds <n>", "Number of compiles (default 10)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned numFeatures = 1000u, pointsPerSide = 4u, rounds = 10u;
+    arguments.read("--features", numFeatures);
+    arguments.read("--points", pointsPerSide);
+    arguments.read("--rounds", rounds);
+    numFeatures   = std::max(numFeatures, 1u);
+    pointsPerSide = std::max(pointsPerSide, 1u);
+    rounds        = std::max(rounds, 1u);
+
+    Style style;
+    style.getOrCreate<ExtrusionSymbol>()->height() = 30.0f;
+    style.getOrCreate<PolygonSymbol>()->fill()->color() = Color::White;
+
+    GeometryCompilerOptions options;
+    options.collectStats() = true;
+
+    GeometryCompiler::setAllocationCounter( countAllocations );
+
+    // buildings on a square grid, 50m apart:
+    unsigned columns = (unsigned)ceil(sqrt((double)numFeatures));
+
+    cout << setw(8) << "round" << setw(12) << "features" << setw(12) << "points"
+         << setw(14) << "allocations" << setw(14) << "allocs/feat" << setw(12) << "ms" << endl;
+
+    GeometryCompiler::Stats total;
+    for(unsigned r=0; r<rounds; ++r)
+    {
+        // the compiler munges its input, so every round gets a fresh copy.
+        FeatureList features;
+        for(unsigned i=0; i<numFeatures; ++i)
+        {
+            double x = 50.0 * (double)(i % columns), y = 50.0 * (double)(i / columns);
+            features.push_back( new Feature(makeFootprint(x, y, 20.0, pointsPerSide), 0L) );
+        }
+
+        GeometryCompiler compiler( options );
+        osg::ref_ptr<osg::Node> node = compiler.compile( features, style, FilterContext(0L) );
+
+        const GeometryCompiler::Stats& stats = compiler.getStats();
+        total += stats;
+
+        cout << setw(8) << r << setw(12) << stats._features << setw(12) << stats._points
+             << setw(14) << stats._allocations
+             << setw(14) << fixed << setprecision(1) << (double)stats._allocations/(double)std::max(stats._features, 1u)
+             << setw(12) << setprecision(2) << stats._seconds*1000.0 << endl;
+    }
+
+    cout << "mean: " << fixed << setprecision(1)
+         << (double)total._allocations/(double)rounds << " allocations, "
+         << setprecision(2) << total._seconds*1000.0/(double)rounds << " ms per compile; "
+         << (double)total._objects/(double)rounds << " objects in the output." << endl;
+
+    return 0;
+}
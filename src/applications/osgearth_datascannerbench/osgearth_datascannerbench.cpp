@@ -0,0 +1,194 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osgDB/FileNameUtils>
+#include <osgEarth/FileUtils>
+#include <osgEarthUtil/DataScanner>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace std;
+
+//
+// Measures DataScanner over a synthetic directory tree, e.g.:
+//
+//   osgearth_datascannerbench --files 20000 --dirs 200
+//
+// Writes a tree of small georeferenced ESRI ASCII grids (with .prj files)
+// and scans it: serially, in parallel, in parallel while writing a manifest,
+// again with the manifest in place, and after changing a few of the files.
+// The tree is left in place (see --path) so later runs can reuse its
+// manifest.
+//
+
+namespace
+{
+    const char* WGS84_PRJ =
+        "GEOGCS[\"GCS_WGS_1984\",DATUM[\"D_WGS_1984\",SPHEROID[\"WGS_1984\",6378137,298.257223563]],"
+        "PRIMEM[\"Greenwich\",0],UNIT[\"Degree\",0.0174532925199433]]";
+
+    bool writeGrid(const std::string& path, unsigned index, unsigned size, bool changed)
+    {
+        double cell = 0.001;
+        double west = -180.0 + (index % 3600u) * 0.1;
+        double south = -80.0 + ((index / 3600u) % 1600u) * 0.1;
+
+        std::ofstream out( path.c_str() );
+        if ( !out.is_open() )
+            return false;
+
+        out << "ncols " << size << "\nnrows " << size << "\n"
+            << setprecision(12) << "xllcorner " << west << "\nyllcorner " << south << "\n"
+            << "cellsize " << cell << "\nNODATA_value -9999\n";
+        for(unsigned r=0; r<size; ++r)
+        {
+            for(unsigned c=0; c<size; ++c)
+                out << ((r*size + c + index) % 100u) << ' ';
+            out << '\n';
+        }
+        if ( changed )
+            out << '\n';
+
+        std::ofstream prj( (osgDB::getNameLessExtension(path) + ".prj").c_str() );
+        prj << WGS84_PRJ;
+        return !out.fail();
+    }
+
+    void report(const std::string& name, const DataScanner& scanner)
+    {
+        const DataScanner::Stats& s = scanner.getStats();
+        cout << setw(20) << name
+             << fixed << setprecision(3) << setw(12) << s._seconds
+             << setprecision(0) << setw(14) << (s._seconds > 0.0 ? (double)s._files / s._seconds : 0.0)
+             << setw(10) << s._scanned
+             << setw(10) << s._reused << endl;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--files <n>", "Number of files in the tree (default 5000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--dirs <n>", "Number of directories to spread them over (default 50)");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <n>", "Width and height of each grid in cells (default 16)");
+    arguments.getApplicationUsage()->addCommandLineOption("--changed <percent>", "Percentage of files to change before the last scan (default 1)");
+    arguments.getApplicationUsage()->addCommandLineOption("--threads <n>", "Scanner threads for the parallel runs (default: one per processor)");
+    arguments.getApplicationUsage()->addCommandLineOption("--path <dir>", "Where to write the tree (default: a directory under the temp path)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned numFiles = 5000u, numDirs = 50u, size = 16u, numThreads = 0u;
+    double changed = 1.0;
+    std::string root = osgDB::concatPaths( getTempPath(), "osgearth_datascannerbench" );
+    arguments.read("--files", numFiles);
+    arguments.read("--dirs", numDirs);
+    arguments.read("--size", size);
+    arguments.read("--changed", changed);
+    arguments.read("--threads", numThreads);
+    arguments.read("--path", root);
+    numDirs = std::max(numDirs, 1u);
+    size = std::max(size, 2u);
+
+    // build the tree:
+    cout << "Writing " << numFiles << " files under " << root << "..." << endl;
+    std::vector<std::string> paths;
+    for(unsigned i=0; i<numFiles; ++i)
+    {
+        std::stringstream dir, file;
+        dir << "d" << (i % numDirs);
+        file << "grid" << i << ".asc";
+        std::string dirPath = osgDB::concatPaths( root, dir.str() );
+        std::string path = osgDB::concatPaths( dirPath, file.str() );
+        if ( i < numDirs && !makeDirectory(dirPath) )
+        {
+            cout << "Cannot create " << dirPath << endl;
+            return 1;
+        }
+        if ( !writeGrid(path, i, size, false) )
+        {
+            cout << "Cannot write " << path << endl;
+            return 1;
+        }
+        paths.push_back( path );
+    }
+
+    std::vector<std::string> extensions;
+    extensions.push_back( "asc" );
+    std::string manifest = osgDB::concatPaths( root, "manifest.txt" );
+    ::remove( manifest.c_str() );
+
+    std::vector<DataScanner::Record> records;
+
+    cout << setw(20) << "run" << setw(12) << "seconds" << setw(14) << "files/s"
+         << setw(10) << "opened" << setw(10) << "reused" << endl;
+
+    DataScanner serial;
+    serial.setNumThreads( 1u );
+    serial.scan( root, extensions, records );
+    report( "serial", serial );
+
+    DataScanner parallel;
+    if ( numThreads > 0u )
+        parallel.setNumThreads( numThreads );
+    parallel.scan( root, extensions, records );
+    report( "parallel", parallel );
+
+    parallel.setManifest( manifest );
+    parallel.scan( root, extensions, records );
+    report( "parallel+manifest", parallel );
+
+    parallel.scan( root, extensions, records );
+    report( "unchanged", parallel );
+
+    unsigned numChanged = std::min( numFiles, (unsigned)(numFiles * changed / 100.0) );
+    for(unsigned i=0; i<numChanged; ++i)
+        writeGrid( paths[(i * 7919u) % numFiles], (i * 7919u) % numFiles, size, true );
+
+    parallel.scan( root, extensions, records );
+    report( "changed", parallel );
+
+    unsigned georeferenced = 0u;
+    for(unsigned i=0; i<records.size(); ++i)
+        if ( !records[i]._srs.empty() )
+            ++georeferenced;
+
+    cout << "(" << records.size() << " files found, " << georeferenced << " georeferenced, "
+         << numChanged << " changed, " << parallel.getNumThreads() << " threads)" << endl;
+
+    return 0;
+}
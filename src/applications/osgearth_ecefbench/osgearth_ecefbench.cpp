@@ -0,0 +1,255 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/CoordinateSystemNode>
+#include <osg/Timer>
+#include <osgEarth/ECEF>
+#include <osgEarth/SpatialReference>
+
+using namespace osgEarth;
+using namespace std;
+
+//
+// Compares the bulk geodetic/ECEF kernels in osgEarth::ECEF against the
+// per-point osg::EllipsoidModel conversions, e.g.:
+//
+//   osgearth_ecefbench --points 1000000
+//
+// Reports the worst difference between the two paths (in meters) and the
+// throughput of each, for both directions, plus SpatialReference::transform
+// from WGS84 to ECEF and back, one point at a time vs. the whole array.
+// The "scalar" column runs the bulk formulas one point at a time with the
+// C library's trig, to show what the SSE2 kernels gain over plain loops.
+//
+
+namespace
+{
+    double randomIn(double lo, double hi)
+    {
+        return lo + (hi-lo) * ((double)::rand() / (double)RAND_MAX);
+    }
+
+    double mpointsPerSec(unsigned count, osg::Timer_t start, osg::Timer_t end)
+    {
+        double s = osg::Timer::instance()->delta_s(start, end);
+        return s > 0.0 ? (double)count / s / 1.0e6 : 0.0;
+    }
+
+    // Same formulas as ECEF::geodeticToECEF, with no vector path.
+    void scalarGeodeticToECEF(const osg::EllipsoidModel* em, unsigned count,
+                              const double* lon, const double* lat, const double* height,
+                              double* x, double* y, double* z)
+    {
+        const double a  = em->getRadiusEquator();
+        const double b  = em->getRadiusPolar();
+        const double e2 = (a*a - b*b) / (a*a);
+
+        for(unsigned i=0; i<count; ++i)
+        {
+            double phi    = osg::DegreesToRadians(lat[i]);
+            double lambda = osg::DegreesToRadians(lon[i]);
+            double sinPhi = sin(phi);
+            double N      = a / sqrt(1.0 - e2*sinPhi*sinPhi);
+            double r      = (N + height[i]) * cos(phi);
+            x[i] = r * cos(lambda);
+            y[i] = r * sin(lambda);
+            z[i] = (N*(1.0 - e2) + height[i]) * sinPhi;
+        }
+    }
+
+    // Same formulas as ECEF::ECEFToGeodetic (Vermeille), with no vector path.
+    void scalarECEFToGeodetic(const osg::EllipsoidModel* em, unsigned count,
+                              const double* x, const double* y, const double* z,
+                              double* lon, double* lat, double* height)
+    {
+        const double a  = em->getRadiusEquator();
+        const double b  = em->getRadiusPolar();
+        const double e2 = (a*a - b*b) / (a*a);
+        const double e4 = e2*e2;
+
+        for(unsigned i=0; i<count; ++i)
+        {
+            double rho2 = x[i]*x[i] + y[i]*y[i];
+            double p    = rho2 / (a*a);
+            double q    = (1.0 - e2) * z[i]*z[i] / (a*a);
+            double r    = osg::maximum((p + q - e4) / 6.0, 1e-300);
+            double s    = e4 * p * q / (4.0 * r*r*r);
+            double t    = pow(1.0 + s + sqrt(s*(2.0 + s)), 1.0/3.0);
+            double u    = r * (1.0 + t + 1.0/t);
+            double v    = sqrt(u*u + e4*q);
+            double w    = e2 * (u + v - q) / (2.0*v);
+            double k    = sqrt(u + v + w*w) - w;
+            double D    = k * sqrt(rho2) / (k + e2);
+            double Dz   = sqrt(D*D + z[i]*z[i]);
+
+            lon[i]    = osg::RadiansToDegrees(atan2(y[i], x[i]));
+            lat[i]    = osg::RadiansToDegrees(2.0 * atan2(z[i], D + Dz));
+            height[i] = (k + e2 - 1.0) / k * Dz;
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--points <n>", "Number of random points to convert (default 1000000)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned count = 1000000u;
+    arguments.read("--points", count);
+    count = std::max(count, 1u);
+
+    osg::ref_ptr<osg::EllipsoidModel> em = new osg::EllipsoidModel();
+
+    // random points from below sea level to beyond geostationary orbit:
+    std::vector<double> lon(count), lat(count), hae(count);
+    ::srand(1234);
+    for(unsigned i=0; i<count; ++i)
+    {
+        lon[i] = randomIn(-180.0, 180.0);
+        lat[i] = randomIn(-90.0, 90.0);
+        hae[i] = (i % 2u) == 0u ? randomIn(-500.0, 9000.0) : randomIn(-500.0, 5.0e7);
+    }
+
+    std::vector<double> x(count), y(count), z(count);
+    std::vector<double> x0(count), y0(count), z0(count);
+    std::vector<double> lon1(count), lat1(count), hae1(count);
+    std::vector<double> lon0(count), lat0(count), hae0(count);
+    std::vector<double> xs(count), ys(count), zs(count);
+
+    // geodetic => ECEF
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<count; ++i)
+        em->convertLatLongHeightToXYZ(osg::DegreesToRadians(lat[i]), osg::DegreesToRadians(lon[i]), hae[i], x0[i], y0[i], z0[i]);
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    ECEF::geodeticToECEF(em.get(), count, &lon[0], &lat[0], &hae[0], &x[0], &y[0], &z[0]);
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+    scalarGeodeticToECEF(em.get(), count, &lon[0], &lat[0], &hae[0], &xs[0], &ys[0], &zs[0]);
+    osg::Timer_t t3 = osg::Timer::instance()->tick();
+
+    double maxForwardError = 0.0;
+    for(unsigned i=0; i<count; ++i)
+        maxForwardError = std::max(maxForwardError, (osg::Vec3d(x[i],y[i],z[i]) - osg::Vec3d(x0[i],y0[i],z0[i])).length());
+
+    double fwdOld = mpointsPerSec(count, t0, t1), fwdNew = mpointsPerSec(count, t1, t2), fwdScalar = mpointsPerSec(count, t2, t3);
+
+    // ECEF => geodetic
+    t0 = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<count; ++i)
+    {
+        em->convertXYZToLatLongHeight(x0[i], y0[i], z0[i], lat0[i], lon0[i], hae0[i]);
+        lat0[i] = osg::RadiansToDegrees(lat0[i]);
+        lon0[i] = osg::RadiansToDegrees(lon0[i]);
+    }
+    t1 = osg::Timer::instance()->tick();
+    ECEF::ECEFToGeodetic(em.get(), count, &x0[0], &y0[0], &z0[0], &lon1[0], &lat1[0], &hae1[0]);
+    t2 = osg::Timer::instance()->tick();
+    scalarECEFToGeodetic(em.get(), count, &x0[0], &y0[0], &z0[0], &xs[0], &ys[0], &zs[0]);
+    t3 = osg::Timer::instance()->tick();
+
+    // compare each path to the original geodetic points, in meters on the ground:
+    double maxInverseErrorOld = 0.0, maxInverseErrorNew = 0.0;
+    const double metersPerDegree = em->getRadiusEquator() * osg::PI / 180.0;
+    for(unsigned i=0; i<count; ++i)
+    {
+        double c = cos(osg::DegreesToRadians(lat[i]));
+        double dLonOld = lon0[i]-lon[i]; if (dLonOld > 180.0) dLonOld -= 360.0; else if (dLonOld < -180.0) dLonOld += 360.0;
+        double dLonNew = lon1[i]-lon[i]; if (dLonNew > 180.0) dLonNew -= 360.0; else if (dLonNew < -180.0) dLonNew += 360.0;
+        osg::Vec3d eOld(dLonOld*c*metersPerDegree, (lat0[i]-lat[i])*metersPerDegree, hae0[i]-hae[i]);
+        osg::Vec3d eNew(dLonNew*c*metersPerDegree, (lat1[i]-lat[i])*metersPerDegree, hae1[i]-hae[i]);
+        maxInverseErrorOld = std::max(maxInverseErrorOld, eOld.length());
+        maxInverseErrorNew = std::max(maxInverseErrorNew, eNew.length());
+    }
+
+    double invOld = mpointsPerSec(count, t0, t1), invNew = mpointsPerSec(count, t1, t2), invScalar = mpointsPerSec(count, t2, t3);
+
+    // SpatialReference, one point at a time vs. the whole array:
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::get("wgs84");
+    const SpatialReference* ecef = wgs84->getECEF();
+
+    std::vector<osg::Vec3d> points(count), single(count);
+    for(unsigned i=0; i<count; ++i)
+        points[i].set(lon[i], lat[i], hae[i]);
+
+    // each direction is timed separately, on the same points, for both paths.
+    t0 = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<count; ++i)
+        wgs84->transform(points[i], ecef, single[i]);
+    t1 = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<count; ++i)
+    {
+        osg::Vec3d temp = single[i];
+        ecef->transform(temp, wgs84.get(), single[i]);
+    }
+    t2 = osg::Timer::instance()->tick();
+
+    t3 = osg::Timer::instance()->tick();
+    wgs84->transform(points, ecef);
+    osg::Timer_t t4 = osg::Timer::instance()->tick();
+    ecef->transform(points, wgs84.get());
+    osg::Timer_t t5 = osg::Timer::instance()->tick();
+
+    double maxRoundTripErrorOld = 0.0, maxRoundTripErrorNew = 0.0;
+    for(unsigned i=0; i<count; ++i)
+    {
+        double c = cos(osg::DegreesToRadians(lat[i]));
+        osg::Vec3d eOld((single[i].x()-lon[i])*c*metersPerDegree, (single[i].y()-lat[i])*metersPerDegree, single[i].z()-hae[i]);
+        osg::Vec3d eNew((points[i].x()-lon[i])*c*metersPerDegree, (points[i].y()-lat[i])*metersPerDegree, points[i].z()-hae[i]);
+        maxRoundTripErrorOld = std::max(maxRoundTripErrorOld, eOld.length());
+        maxRoundTripErrorNew = std::max(maxRoundTripErrorNew, eNew.length());
+    }
+
+    double srsFwdOld = mpointsPerSec(count, t0, t1), srsFwdNew = mpointsPerSec(count, t3, t4);
+    double srsInvOld = mpointsPerSec(count, t1, t2), srsInvNew = mpointsPerSec(count, t4, t5);
+
+    cout << setw(24) << "" << setw(14) << "per-point" << setw(14) << "scalar" << setw(14) << "bulk" << setw(16) << "max error (m)" << endl;
+    cout << scientific << setprecision(3);
+    cout << setw(24) << "geodetic to ECEF Mpt/s" << setw(14) << fwdOld << setw(14) << fwdScalar << setw(14) << fwdNew << setw(16) << maxForwardError << endl;
+    cout << setw(24) << "ECEF to geodetic Mpt/s" << setw(14) << invOld << setw(14) << invScalar << setw(14) << invNew << setw(16) << maxInverseErrorNew
+         << "  (per-point: " << maxInverseErrorOld << ")" << endl;
+    cout << setw(24) << "SRS to ECEF Mpt/s" << setw(14) << srsFwdOld << setw(14) << "" << setw(14) << srsFwdNew << endl;
+    cout << setw(24) << "SRS from ECEF Mpt/s" << setw(14) << srsInvOld << setw(14) << "" << setw(14) << srsInvNew << setw(16) << maxRoundTripErrorNew
+         << "  (round trip; per-point: " << maxRoundTripErrorOld << ")" << endl;
+    cout << fixed << setprecision(2)
+         << "bulk vs. scalar: " << fwdNew/std::max(fwdScalar, 1e-9) << "x to ECEF, "
+         << invNew/std::max(invScalar, 1e-9) << "x from ECEF" << endl;
+    cout << "(" << count << " points)" << endl;
+
+    return 0;
+}
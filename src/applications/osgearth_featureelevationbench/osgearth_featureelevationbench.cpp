@@ -0,0 +1,280 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osgEarth/GeoData>
+#include <osgEarth/SpatialReference>
+#include <osgEarthSymbology/Geometry>
+#include <osgEarthDrivers/feature_elevation/PolygonRasterizer>
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Drivers;
+using namespace std;
+
+//
+// Compares the two ways the feature_elevation driver can fill a heightfield
+// tile from flattening polygons, e.g.:
+//
+//   osgearth_featureelevationbench --features 100 --vertices 32 --size 129
+//
+// The per-sample path tests every sample against every polygon with
+// Polygon::contains2D (transforming the sample into the feature SRS when
+// --transform is given); the scanline path transforms each polygon into the
+// tile's pixel space once and fills it with PolygonRasterizer. Both give each
+// sample the height of the first polygon covering it. Reports the average
+// time per tile and the number of samples on which the two paths disagree
+// (with --transform, polygon edges are straight in different projections, so
+// a few boundary samples may differ).
+//
+
+namespace
+{
+    double randomIn(double lo, double hi)
+    {
+        return lo + (hi-lo) * ((double)::rand() / (double)RAND_MAX);
+    }
+
+    // star-shaped ring of roughly the given radius around (cx, cy)
+    void makeRing(Ring* ring, double cx, double cy, double radius, unsigned vertices)
+    {
+        for(unsigned i=0; i<vertices; ++i)
+        {
+            double a = 2.0*osg::PI*((double)i + randomIn(0.0, 0.5))/(double)vertices;
+            double r = radius * randomIn(0.3, 1.0);
+            ring->push_back( osg::Vec3d(cx + r*cos(a), cy + r*sin(a), 0.0) );
+        }
+    }
+
+    struct Tile
+    {
+        const SpatialReference* _srs;
+        double                  _xmin, _ymin, _xmax, _ymax;
+        unsigned                _size;
+    };
+
+    void perSample(const Tile& tile, const SpatialReference* featureSRS,
+                   const std::vector< osg::ref_ptr<Polygon> >& polygons, const std::vector<float>& heights,
+                   std::vector<float>& output)
+    {
+        bool transformRequired = !tile._srs->isHorizEquivalentTo(featureSRS);
+        double dx = (tile._xmax - tile._xmin) / (tile._size-1);
+        double dy = (tile._ymax - tile._ymin) / (tile._size-1);
+
+        for(unsigned c=0; c<tile._size; ++c)
+        {
+            double geoX = tile._xmin + (dx * (double)c);
+            for(unsigned r=0; r<tile._size; ++r)
+            {
+                double geoY = tile._ymin + (dy * (double)r);
+                float h = NO_DATA_VALUE;
+                for(unsigned p=0; p<polygons.size(); ++p)
+                {
+                    GeoPoint geo(tile._srs, geoX, geoY, 0.0, ALTMODE_ABSOLUTE);
+                    if ( transformRequired )
+                        geo = geo.transform(featureSRS);
+
+                    if ( polygons[p]->contains2D(geo.x(), geo.y()) )
+                    {
+                        h = heights[p];
+                        break;
+                    }
+                }
+                output[r*tile._size + c] = h;
+            }
+        }
+    }
+
+    bool toPixels(const Tile& tile, const Ring* ring, const SpatialReference* featureSRS, bool transformRequired,
+                  double dx, double dy, std::vector<osg::Vec3d>& output)
+    {
+        output.assign( ring->begin(), ring->end() );
+        if ( transformRequired && !featureSRS->transform(output, tile._srs) )
+            return false;
+
+        for(unsigned i=0; i<output.size(); ++i)
+        {
+            output[i].x() = (output[i].x() - tile._xmin) / dx;
+            output[i].y() = (output[i].y() - tile._ymin) / dy;
+        }
+        return true;
+    }
+
+    void scanline(const Tile& tile, const SpatialReference* featureSRS,
+                  const std::vector< osg::ref_ptr<Polygon> >& polygons, const std::vector<float>& heights,
+                  std::vector<float>& output)
+    {
+        bool transformRequired = !tile._srs->isHorizEquivalentTo(featureSRS);
+        double dx = (tile._xmax - tile._xmin) / (tile._size-1);
+        double dy = (tile._ymax - tile._ymin) / (tile._size-1);
+
+        std::fill( output.begin(), output.end(), NO_DATA_VALUE );
+
+        PolygonRasterizer rasterizer(tile._size, tile._size);
+        std::vector<PolygonRasterizer::Span> spans;
+        std::vector<osg::Vec3d> ring;
+
+        for(unsigned p=0; p<polygons.size(); ++p)
+        {
+            bool ok = toPixels(tile, polygons[p].get(), featureSRS, transformRequired, dx, dy, ring);
+            if ( ok )
+                rasterizer.addRing( &ring[0], ring.size() );
+
+            const RingCollection& holes = polygons[p]->getHoles();
+            for(unsigned i=0; ok && i<holes.size(); ++i)
+            {
+                ok = toPixels(tile, holes[i].get(), featureSRS, transformRequired, dx, dy, ring);
+                if ( ok )
+                    rasterizer.addRing( &ring[0], ring.size() );
+            }
+
+            if ( !ok )
+            {
+                rasterizer.discard();
+                continue;
+            }
+
+            spans.clear();
+            rasterizer.fill( spans );
+            for(unsigned i=0; i<spans.size(); ++i)
+            {
+                const PolygonRasterizer::Span& span = spans[i];
+                for(unsigned c=span._colStart; c<span._colEnd; ++c)
+                    output[span._row*tile._size + c] = heights[p];
+            }
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--features <n>", "Number of polygons per tile (default 100)");
+    arguments.getApplicationUsage()->addCommandLineOption("--vertices <n>", "Number of vertices in each outer ring (default 32)");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <n>", "Heightfield tile size (default 129)");
+    arguments.getApplicationUsage()->addCommandLineOption("--tiles <n>", "Number of tiles to fill with each path (default 4)");
+    arguments.getApplicationUsage()->addCommandLineOption("--transform", "Store the polygons in WGS84 instead of the tile's Mercator SRS");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned numFeatures = 100u, numVertices = 32u, size = 129u, numTiles = 4u;
+    arguments.read("--features", numFeatures);
+    arguments.read("--vertices", numVertices);
+    arguments.read("--size", size);
+    arguments.read("--tiles", numTiles);
+    bool transform = arguments.read("--transform");
+    numVertices = std::max(numVertices, 3u);
+    size = std::max(size, 2u);
+    numTiles = std::max(numTiles, 1u);
+
+    osg::ref_ptr<const SpatialReference> mercator = SpatialReference::get("spherical-mercator");
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::get("wgs84");
+    const SpatialReference* featureSRS = transform ? wgs84.get() : mercator.get();
+
+    // a 10km tile; polygons of up to 2km radius scattered over and around it,
+    // a third of them with a hole.
+    Tile tile;
+    tile._srs  = mercator.get();
+    tile._xmin = 1.0e6;
+    tile._ymin = 5.0e6;
+    tile._xmax = tile._xmin + 1.0e4;
+    tile._ymax = tile._ymin + 1.0e4;
+    tile._size = size;
+
+    ::srand(1234);
+    std::vector< osg::ref_ptr<Polygon> > polygons;
+    std::vector<float> heights;
+    for(unsigned i=0; i<numFeatures; ++i)
+    {
+        double cx = randomIn(tile._xmin - 1.0e3, tile._xmax + 1.0e3);
+        double cy = randomIn(tile._ymin - 1.0e3, tile._ymax + 1.0e3);
+        double radius = randomIn(200.0, 2000.0);
+
+        osg::ref_ptr<Polygon> polygon = new Polygon();
+        makeRing(polygon.get(), cx, cy, radius, numVertices);
+        if ( i % 3u == 0u )
+        {
+            Ring* hole = new Ring();
+            makeRing(hole, cx, cy, radius*0.25, std::max(numVertices/4u, 3u));
+            polygon->getHoles().push_back(hole);
+        }
+
+        if ( transform )
+        {
+            mercator->transform(polygon->asVector(), wgs84.get());
+            for(unsigned h=0; h<polygon->getHoles().size(); ++h)
+                mercator->transform(polygon->getHoles()[h]->asVector(), wgs84.get());
+        }
+
+        polygons.push_back(polygon.get());
+        heights.push_back((float)randomIn(0.0, 1000.0));
+    }
+
+    std::vector<float> expected(size*size), actual(size*size);
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<numTiles; ++i)
+        perSample(tile, featureSRS, polygons, heights, expected);
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<numTiles; ++i)
+        scanline(tile, featureSRS, polygons, heights, actual);
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+    unsigned covered = 0u, mismatches = 0u;
+    for(unsigned i=0; i<expected.size(); ++i)
+    {
+        if ( expected[i] != NO_DATA_VALUE )
+            ++covered;
+        if ( expected[i] != actual[i] )
+            ++mismatches;
+    }
+
+    double oldMs = osg::Timer::instance()->delta_m(t0, t1) / (double)numTiles;
+    double newMs = osg::Timer::instance()->delta_m(t1, t2) / (double)numTiles;
+
+    cout << setw(14) << "path" << setw(14) << "ms/tile" << setw(14) << "speedup" << endl;
+    cout << fixed << setprecision(3);
+    cout << setw(14) << "per-sample" << setw(14) << oldMs << setw(14) << 1.0 << endl;
+    cout << setw(14) << "scanline" << setw(14) << newMs << setw(14) << (newMs > 0.0 ? oldMs/newMs : 0.0) << endl;
+    cout << "(" << numTiles << " tiles of " << size << "x" << size << ", " << numFeatures << " polygons of "
+         << numVertices << " vertices, " << covered << " samples covered, " << mismatches << " mismatches"
+         << (transform ? ", WGS84 polygons" : "") << ")" << endl;
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <osgEarth/GeoidGrid>
+#include <osgEarth/Geoid>
+#include <osgEarth/VerticalDatum>
+
+using namespace osgEarth;
+using namespace std;
+
+//
+// Writes a memory-mapped geoid grid and compares it to the heightfield geoid, e.g.:
+//
+//   osgearth_geoidgrid --vdatum egm96 --out egm96.geoid
+//   osgearth_geoidgrid --in egm2008_1min.tif --out egm2008.geoid
+//
+// The vertical datum drivers pick up "<name>.geoid" from the data file path.
+// After writing, the tool samples random tiles with the batched grid path and
+// with per-point heightfield queries, and reports the throughput of each and
+// the largest difference between them: separately for tiles sampled at the
+// full resolution, which should match, and for tiles spaced widely enough to
+// read a coarser (smoothed) level.
+//
+
+namespace
+{
+    double randomIn(double lo, double hi)
+    {
+        return lo + (hi-lo) * ((double)::rand() / (double)RAND_MAX);
+    }
+
+    double mpointsPerSec(unsigned count, double seconds)
+    {
+        return seconds > 0.0 ? (double)count / seconds / 1.0e6 : 0.0;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--vdatum <name>", "Vertical datum whose geoid to write (e.g. egm96)");
+    arguments.getApplicationUsage()->addCommandLineOption("--in <file>", "Heightfield to write instead, referenced in degrees with heights in meters");
+    arguments.getApplicationUsage()->addCommandLineOption("--out <file>", "Grid file to write");
+    arguments.getApplicationUsage()->addCommandLineOption("--tile-size <n>", "Tile size in samples, a power of two (default 256)");
+    arguments.getApplicationUsage()->addCommandLineOption("--tiles <n>", "Number of random 257x257 tiles to sample in the comparison (default 200)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    std::string vdatumName, inFile, outFile;
+    unsigned tileSize = 256u, numTiles = 200u;
+    arguments.read("--vdatum", vdatumName);
+    arguments.read("--in", inFile);
+    arguments.read("--out", outFile);
+    arguments.read("--tile-size", tileSize);
+    arguments.read("--tiles", numTiles);
+
+    if ( outFile.empty() || (vdatumName.empty() == inFile.empty()) )
+    {
+        cout << "Specify --out and one of --vdatum or --in (--help for details)" << endl;
+        return 1;
+    }
+
+    osg::ref_ptr<osg::HeightField> hf;
+    if ( !inFile.empty() )
+    {
+        hf = osgDB::readHeightFieldFile( inFile );
+    }
+    else
+    {
+        const VerticalDatum* vdatum = VerticalDatum::get( vdatumName );
+        if ( vdatum && vdatum->getGeoid() )
+            hf = const_cast<osg::HeightField*>( vdatum->getGeoid()->getHeightField() );
+    }
+
+    if ( !hf.valid() )
+    {
+        cout << "No heightfield to write (a datum already backed by a grid file has none)" << endl;
+        return 1;
+    }
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    if ( !GeoidGrid::write(outFile, hf.get(), tileSize) )
+        return 1;
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+    osg::ref_ptr<GeoidGrid> grid = GeoidGrid::open( outFile );
+    if ( !grid.valid() )
+        return 1;
+
+    cout << "Wrote " << outFile << " in " << fixed << setprecision(2) << osg::Timer::instance()->delta_s(t0, t1)
+         << " s (" << grid->getNumLevels() << " levels)" << endl;
+
+    // the reference: the same heightfield, one point at a time
+    osg::ref_ptr<Geoid> reference = new Geoid();
+    reference->setHeightField( hf.get() );
+
+    const Bounds& b = grid->getBounds();
+    const unsigned size = 257u;
+    std::vector<float> batched(size*size), single(size*size);
+    double batchedSeconds = 0.0, singleSeconds = 0.0, maxError = 0.0, maxCoarseError = 0.0;
+    unsigned coarseTiles = 0u;
+
+    ::srand(1234);
+    for(unsigned t=0; t<numTiles; ++t)
+    {
+        // spacing from well under to a few times the grid's
+        double dx    = randomIn(0.1, 4.0) * hf->getXInterval();
+        double dy    = randomIn(0.1, 4.0) * hf->getYInterval();
+        double west  = randomIn(b.xMin(), std::max(b.xMin(), b.xMax() - dx*double(size-1)));
+        double south = randomIn(b.yMin(), std::max(b.yMin(), b.yMax() - dy*double(size-1)));
+
+        t0 = osg::Timer::instance()->tick();
+        grid->getHeights(south, west, dy, dx, size, size, &batched[0]);
+        t1 = osg::Timer::instance()->tick();
+        for(unsigned r=0; r<size; ++r)
+            for(unsigned c=0; c<size; ++c)
+                single[r*size+c] = reference->getHeight(south + dy*double(r), west + dx*double(c));
+        osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+        batchedSeconds += osg::Timer::instance()->delta_s(t0, t1);
+        singleSeconds  += osg::Timer::instance()->delta_s(t1, t2);
+
+        bool coarse = grid->getLevel(dy, dx) > 0u;
+        if ( coarse )
+            ++coarseTiles;
+
+        double& error = coarse ? maxCoarseError : maxError;
+        for(unsigned i=0; i<batched.size(); ++i)
+            error = std::max(error, (double)fabs(batched[i] - single[i]));
+    }
+
+    unsigned count = numTiles * size * size;
+    cout << setw(24) << "" << setw(14) << "per-point" << setw(14) << "batched" << setw(16) << "max diff (m)" << endl;
+    cout << scientific << setprecision(3);
+    cout << setw(24) << "geoid height Mpt/s"
+         << setw(14) << mpointsPerSec(count, singleSeconds)
+         << setw(14) << mpointsPerSec(count, batchedSeconds)
+         << setw(16) << maxError << endl;
+    cout << setw(24) << "max diff, coarse levels" << setw(28) << "" << setw(16) << maxCoarseError << endl;
+    cout << "(" << numTiles << " tiles of " << size << "x" << size << " samples, "
+         << coarseTiles << " from coarse levels)" << endl;
+
+    return 0;
+}
@@ -0,0 +1,466 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Image>
+#include <osg/Timer>
+#include <osgDB/Registry>
+#include <osgDB/ReaderWriter>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Atomic>
+#include <osgEarth/Registry>
+#include <osgEarth/HTTPClient>
+#include <osgEarth/URI>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+   typedef SOCKET socket_t;
+#  define OE_BAD_SOCKET   INVALID_SOCKET
+#  define OE_SHUT_RDWR    SD_BOTH
+#  define closeSocket     ::closesocket
+   typedef int socklen_t;
+#else
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#  include <unistd.h>
+   typedef int socket_t;
+#  define OE_BAD_SOCKET   (-1)
+#  define OE_SHUT_RDWR    SHUT_RDWR
+#  define closeSocket     ::close
+#endif
+
+using namespace osgEarth;
+using namespace std;
+
+//
+// Measures HTTP throughput against a local server that adds a fixed delay
+// to every response, so the cost of waiting on the network shows up even
+// on a loopback connection, e.g.:
+//
+//   osgearth_httpbench --requests 400 --latency 50 --threads 8
+//
+// Runs the same batch of requests three ways: blocking HTTPClient::get on
+// a pool of threads, HTTPClient::getAsync from one thread, and
+// URI::readImageAsync (when a PNG plugin is available to decode the body).
+// Latency is the mean time from issuing a request to its completion, so for
+// the asynchronous runs it includes time spent queued behind the per-host
+// limit.
+//
+
+namespace
+{
+    // Minimal HTTP/1.1 server: answers every GET with the same body after
+    // sleeping for the configured latency. Connections are kept alive.
+    class LatencyServer : public OpenThreads::Thread
+    {
+    public:
+        LatencyServer(unsigned latencyMs, const std::string& body, const std::string& mimeType) :
+            _latencyMs( latencyMs ),
+            _listen   ( OE_BAD_SOCKET ),
+            _port     ( 0 ),
+            _done     ( 0u )
+        {
+            std::stringstream buf;
+            buf << "HTTP/1.1 200 OK\r\n"
+                << "Content-Type: " << mimeType << "\r\n"
+                << "Content-Length: " << body.size() << "\r\n"
+                << "Connection: keep-alive\r\n\r\n"
+                << body;
+            _response = buf.str();
+        }
+
+        // binds to an ephemeral loopback port.
+        bool listen()
+        {
+            _listen = ::socket(AF_INET, SOCK_STREAM, 0);
+            if ( _listen == OE_BAD_SOCKET )
+                return false;
+
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+            addr.sin_family      = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port        = 0;
+            if ( ::bind(_listen, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(_listen, 64) != 0 )
+                return false;
+
+            socklen_t len = sizeof(addr);
+            if ( ::getsockname(_listen, (sockaddr*)&addr, &len) != 0 )
+                return false;
+            _port = ntohs(addr.sin_port);
+            return true;
+        }
+
+        unsigned short getPort() const { return _port; }
+
+        void run()
+        {
+            while( _done == 0u )
+            {
+                socket_t s = ::accept(_listen, 0L, 0L);
+                if ( s == OE_BAD_SOCKET )
+                    break;
+                if ( _done != 0u )
+                {
+                    closeSocket(s);
+                    break;
+                }
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                _connections.push_back( new Connection(this, s) );
+                _connections.back()->start();
+            }
+        }
+
+        void stop()
+        {
+            _done.exchange(1u);
+
+            // wake up accept() with a throwaway connection.
+            socket_t s = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+            addr.sin_family      = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port        = htons(_port);
+            ::connect(s, (sockaddr*)&addr, sizeof(addr));
+            closeSocket(s);
+            join();
+            closeSocket(_listen);
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            for(unsigned i=0; i<_connections.size(); ++i)
+            {
+                ::shutdown(_connections[i]->_socket, OE_SHUT_RDWR);
+                _connections[i]->join();
+                closeSocket(_connections[i]->_socket);
+                delete _connections[i];
+            }
+            _connections.clear();
+        }
+
+    private:
+        struct Connection : public OpenThreads::Thread
+        {
+            Connection(LatencyServer* server, socket_t s) : _server(server), _socket(s) { }
+
+            void run()
+            {
+                std::string in;
+                char buf[4096];
+                for(;;)
+                {
+                    int n = ::recv(_socket, buf, sizeof(buf), 0);
+                    if ( n <= 0 )
+                        return;
+                    in.append(buf, n);
+
+                    // one response per complete request header (GETs have no body)
+                    std::string::size_type end;
+                    while( (end = in.find("\r\n\r\n")) != std::string::npos )
+                    {
+                        in.erase(0, end+4);
+                        OpenThreads::Thread::microSleep( _server->_latencyMs * 1000u );
+                        if ( !sendAll(_server->_response) )
+                            return;
+                    }
+                }
+            }
+
+            bool sendAll(const std::string& data)
+            {
+                const char* ptr = data.c_str();
+                int left = (int)data.size();
+                while( left > 0 )
+                {
+                    int n = ::send(_socket, ptr, left, 0);
+                    if ( n <= 0 )
+                        return false;
+                    ptr  += n;
+                    left -= n;
+                }
+                return true;
+            }
+
+            LatencyServer* _server;
+            socket_t       _socket;
+        };
+
+        unsigned                 _latencyMs;
+        std::string              _response;
+        socket_t                 _listen;
+        unsigned short           _port;
+        OpenThreads::Atomic      _done;
+        OpenThreads::Mutex       _mutex;
+        std::vector<Connection*> _connections;
+    };
+
+    // Splits a batch of URLs across a fixed number of blocking threads.
+    struct BlockingWorker : public OpenThreads::Thread
+    {
+        BlockingWorker(const std::vector<std::string>& urls, OpenThreads::Atomic& next) :
+            _urls(urls), _next(next), _failed(0u), _latency_s(0.0) { }
+
+        void run()
+        {
+            for(;;)
+            {
+                unsigned i = ++_next - 1u;
+                if ( i >= _urls.size() )
+                    break;
+                osg::Timer_t start = osg::Timer::instance()->tick();
+                HTTPResponse r = HTTPClient::get( _urls[i] );
+                _latency_s += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+                if ( !r.isOK() )
+                    ++_failed;
+            }
+        }
+
+        const std::vector<std::string>& _urls;
+        OpenThreads::Atomic&            _next;
+        unsigned                        _failed;
+        double                          _latency_s;
+    };
+
+    // Records how long an asynchronous read took from the time it was issued.
+    struct TimedRead : public URIResultCallback
+    {
+        TimedRead() : _start(osg::Timer::instance()->tick()), _latency_s(0.0) { }
+
+        void onResult(const URI& uri, const ReadResult& result)
+        {
+            _latency_s = osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+        }
+
+        osg::Timer_t _start;
+        double       _latency_s;
+    };
+
+    // unique URLs, so that nothing along the way can cache a response.
+    void makeURLs(const std::string& base, unsigned& serial, std::vector<std::string>& urls)
+    {
+        for(unsigned i=0; i<urls.size(); ++i)
+        {
+            std::stringstream buf;
+            buf << base << serial++;
+            urls[i] = buf.str();
+        }
+    }
+
+    void report(const std::string& name, unsigned threads, unsigned count, unsigned failed, double wall_s, double latency_s)
+    {
+        cout << setw(22) << left << name << right
+             << setw(9)  << threads
+             << setw(12) << fixed << setprecision(1) << (wall_s > 0.0 ? (double)count / wall_s : 0.0)
+             << setw(14) << setprecision(2) << (count > 0 ? 1000.0 * latency_s / (double)count : 0.0)
+             << setw(9)  << failed
+             << endl;
+    }
+
+    std::string encodePNG(unsigned size)
+    {
+        osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("png");
+        if ( !rw )
+            return std::string();
+
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGB, GL_UNSIGNED_BYTE);
+        for(unsigned t=0; t<size; ++t)
+        {
+            for(unsigned s=0; s<size; ++s)
+            {
+                unsigned char* p = image->data(s, t);
+                p[0] = (unsigned char)s; p[1] = (unsigned char)t; p[2] = (unsigned char)(s^t);
+            }
+        }
+
+        std::stringstream buf;
+        osgDB::ReaderWriter::WriteResult wr = rw->writeImage(*image.get(), buf);
+        return wr.success() ? buf.str() : std::string();
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--requests <n>", "Number of requests per run (default 400)");
+    arguments.getApplicationUsage()->addCommandLineOption("--latency <ms>", "Delay the server adds to each response (default 50)");
+    arguments.getApplicationUsage()->addCommandLineOption("--threads <n>", "Threads for the blocking run (default 8)");
+    arguments.getApplicationUsage()->addCommandLineOption("--per-host <n>", "Async requests in flight per host (default 8)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned count = 400u, latencyMs = 50u, threads = 8u, perHost = 8u;
+    arguments.read("--requests", count);
+    arguments.read("--latency", latencyMs);
+    arguments.read("--threads", threads);
+    arguments.read("--per-host", perHost);
+    threads = std::max(threads, 1u);
+
+#ifdef _WIN32
+    WSADATA wsa;
+    ::WSAStartup(MAKEWORD(2,2), &wsa);
+#endif
+
+    // initializes curl, among other things.
+    osgEarth::Registry::instance();
+
+    std::string body = encodePNG(256u);
+    bool haveImage = !body.empty();
+    if ( !haveImage )
+    {
+        cout << "No PNG plugin; serving raw bytes and skipping URI::readImageAsync" << endl;
+        body.assign(64u*1024u, 'x');
+    }
+
+    LatencyServer server( latencyMs, body, haveImage ? "image/png" : "application/octet-stream" );
+    if ( !server.listen() )
+    {
+        cout << "Failed to start the local server" << endl;
+        return 1;
+    }
+    server.start();
+
+    std::stringstream base;
+    base << "http://127.0.0.1:" << server.getPort() << "/tile.png?n=";
+
+    unsigned serial = 0u;
+    std::vector<std::string> urls(count);
+
+    HTTPClient::setMaxRequestsPerHost( perHost );
+
+    cout << count << " requests, " << latencyMs << " ms server latency, "
+         << body.size() << " byte responses" << endl << endl
+         << setw(22) << left << "Method" << right
+         << setw(9)  << "Threads"
+         << setw(12) << "Req/s"
+         << setw(14) << "Latency (ms)"
+         << setw(9)  << "Failed"
+         << endl;
+
+    // blocking requests on a thread pool:
+    {
+        makeURLs(base.str(), serial, urls);
+
+        HTTPClient::setAsyncEnabled( false );
+        OpenThreads::Atomic next(0u);
+        std::vector<BlockingWorker*> workers;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<threads; ++i)
+        {
+            workers.push_back( new BlockingWorker(urls, next) );
+            workers.back()->start();
+        }
+        unsigned failed = 0u;
+        double latency_s = 0.0;
+        for(unsigned i=0; i<workers.size(); ++i)
+        {
+            workers[i]->join();
+            failed    += workers[i]->_failed;
+            latency_s += workers[i]->_latency_s;
+            delete workers[i];
+        }
+        double wall_s = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+        report("HTTPClient::get", threads, count, failed, wall_s, latency_s);
+    }
+
+    // asynchronous requests, all issued from this thread:
+    {
+        makeURLs(base.str(), serial, urls);
+
+        std::vector< osg::ref_ptr<HTTPFuture> > futures;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<count; ++i)
+            futures.push_back( HTTPClient::getAsync(HTTPRequest(urls[i])) );
+
+        unsigned failed = 0u;
+        double latency_s = 0.0;
+        for(unsigned i=0; i<futures.size(); ++i)
+        {
+            const HTTPResponse& r = futures[i]->get();
+            latency_s += r.getDuration();
+            if ( !r.isOK() )
+                ++failed;
+        }
+        double wall_s = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+        report("HTTPClient::getAsync", 1, count, failed, wall_s, latency_s);
+    }
+
+    // asynchronous image reads (fetch and decode):
+    if ( haveImage )
+    {
+        makeURLs(base.str(), serial, urls);
+
+        std::vector< osg::ref_ptr<URIFuture> > futures;
+        std::vector< osg::ref_ptr<TimedRead> > timers;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<count; ++i)
+        {
+            timers.push_back( new TimedRead() );
+            futures.push_back( URI(urls[i]).readImageAsync(0L, 0L, timers.back().get()) );
+        }
+
+        unsigned failed = 0u;
+        double latency_s = 0.0;
+        for(unsigned i=0; i<futures.size(); ++i)
+        {
+            if ( !futures[i]->get().succeeded() )
+                ++failed;
+            latency_s += timers[i]->_latency_s;
+        }
+        double wall_s = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        // requests go out on the async engine's one I/O thread; the decode
+        // pool (one thread per core) never waits on the network.
+        report("URI::readImageAsync", 1, count, failed, wall_s, latency_s);
+    }
+
+    URI::shutdownAsync();
+    HTTPClient::shutdownAsync();
+    server.stop();
+
+#ifdef _WIN32
+    ::WSACleanup();
+#endif
+    return 0;
+}
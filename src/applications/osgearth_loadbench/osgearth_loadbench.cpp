@@ -0,0 +1,200 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <osgEarth/Config>
+#include <osgEarth/XmlUtils>
+#include <osgEarth/JsonUtils>
+#include <osgEarth/URI>
+
+using namespace osgEarth;
+using namespace std;
+
+//
+// Measures how long it takes to load earth files, e.g.:
+//
+//   osgearth_loadbench tests/*.earth
+//
+// For each file, times parsing into a Config through the legacy XmlDocument
+// path and through the direct XmlDocument::loadConfig path. Then writes the
+// result as JSON and times reading it back: into a jsoncpp DOM (the first half
+// of the old Config::fromJSON) and straight into a Config. With --full, also times a complete osgDB::readNodeFile
+// (which opens the map's layers, and so depends on data and network access).
+//
+
+namespace
+{
+    double timeXmlDocument(const std::string& xml, const URIContext& context, unsigned n)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<n; ++i)
+        {
+            std::stringstream in(xml);
+            osg::ref_ptr<XmlDocument> doc = XmlDocument::load(in, context);
+            if ( doc.valid() )
+                Config conf = doc->getConfig();
+        }
+        return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / (double)n;
+    }
+
+    double timeLoadConfig(const std::string& xml, const URIContext& context, unsigned n, Config& output)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<n; ++i)
+        {
+            std::stringstream in(xml);
+            Config conf;
+            XmlDocument::loadConfig(in, context, conf);
+            if ( i+1 == n )
+                output.swap(conf);
+        }
+        return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / (double)n;
+    }
+
+    double timeJSON(const Config& conf, unsigned n)
+    {
+        std::string json = conf.toJSON(false);
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<n; ++i)
+        {
+            Config temp;
+            temp.fromJSON(json);
+        }
+        return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / (double)n;
+    }
+
+    double timeJSONDOM(const Config& conf, unsigned n)
+    {
+        std::string json = conf.toJSON(false);
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<n; ++i)
+        {
+            Json::Reader reader;
+            Json::Value root;
+            reader.parse(json, root);
+        }
+        return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / (double)n;
+    }
+
+    double timeReadNode(const std::string& filename)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(filename);
+        return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options] file.earth ...");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--iterations <n>", "Number of times to parse each file (default 20)");
+    arguments.getApplicationUsage()->addCommandLineOption("--full", "Also time a full read of each file, including opening its layers");
+
+    if (arguments.read("-h") || arguments.read("--help") || arguments.argc() < 2)
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned iterations = 20u;
+    arguments.read("--iterations", iterations);
+    iterations = std::max(iterations, 1u);
+
+    bool full = arguments.read("--full");
+
+    cout << setw(10) << "KB"
+         << setw(12) << "xmldoc ms"
+         << setw(12) << "direct ms"
+         << setw(12) << "jsondom ms"
+         << setw(12) << "json ms";
+    if ( full )
+        cout << setw(12) << "read ms";
+    cout << "  file" << endl;
+
+    double totals[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned count = 0;
+
+    for(int pos = 1; pos < arguments.argc(); ++pos)
+    {
+        if ( arguments.isOption(pos) )
+            continue;
+
+        std::string filename = arguments[pos];
+
+        ReadResult r = URI(filename).readString();
+        if ( r.failed() )
+        {
+            cout << "Failed to read " << filename << endl;
+            continue;
+        }
+
+        const std::string& xml = r.getString();
+        URIContext context(filename);
+
+        Config conf;
+        double t[5];
+        t[0] = timeXmlDocument(xml, context, iterations);
+        t[1] = timeLoadConfig(xml, context, iterations, conf);
+        t[2] = timeJSONDOM(conf, iterations);
+        t[3] = timeJSON(conf, iterations);
+        t[4] = full ? timeReadNode(filename) : 0.0;
+
+        cout << fixed << setprecision(3)
+             << setw(10) << (double)xml.size()/1024.0
+             << setw(12) << t[0]
+             << setw(12) << t[1]
+             << setw(12) << t[2]
+             << setw(12) << t[3];
+        if ( full )
+            cout << setw(12) << t[4];
+        cout << "  " << filename << endl;
+
+        for(unsigned i=0; i<5; ++i)
+            totals[i] += t[i];
+        ++count;
+    }
+
+    if ( count > 0 )
+    {
+        cout << setw(10) << "total"
+             << setw(12) << totals[0]
+             << setw(12) << totals[1]
+             << setw(12) << totals[2]
+             << setw(12) << totals[3];
+        if ( full )
+            cout << setw(12) << totals[4];
+        cout << "  (" << count << " files, " << iterations << " iterations each)" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+#include <osgEarth/ObjectIndex>
+
+using namespace osgEarth;
+using namespace std;
+
+//
+// Measures ObjectIndex churn under a paging-like workload, e.g.:
+//
+//   osgearth_objectindexbench --features 5000 --readers 4
+//
+// Tiles of features are tagged into the index and, once more than --tiles
+// are resident, the oldest tile is untagged. Meanwhile reader threads look up
+// IDs as a picker would. The run is done once tagging one object at a time
+// and once with the batched insert/remove calls; each row reports the average
+// cost of tagging and untagging a tile and the lookup rate achieved by the
+// readers during that run.
+//
+
+namespace
+{
+    struct Reader : public OpenThreads::Thread
+    {
+        Reader(ObjectIndex* index, const std::vector<ObjectID>& probes, OpenThreads::Atomic& done) :
+            _index(index), _probes(probes), _done(done), _reads(0u) { }
+
+        void run()
+        {
+            unsigned n = 0u;
+            while( _done == 0u )
+            {
+                for(unsigned i=0; i<1024u; ++i, ++n)
+                {
+                    osg::ref_ptr<osg::Referenced> object = _index->get<osg::Referenced>( _probes[n % _probes.size()] );
+                }
+                _reads += 1024u;
+            }
+        }
+
+        ObjectIndex*                 _index;
+        const std::vector<ObjectID>& _probes;
+        OpenThreads::Atomic&         _done;
+        unsigned long                _reads;
+    };
+
+    struct Result
+    {
+        double _tagMs;
+        double _untagMs;
+        double _readsPerSec;
+    };
+
+    void tagTile(ObjectIndex* index, const std::vector<osg::Referenced*>& features, bool batched, std::vector<ObjectID>& ids)
+    {
+        if ( batched )
+        {
+            index->insert( features, ids );
+        }
+        else
+        {
+            for(unsigned i=0; i<features.size(); ++i)
+                ids.push_back( index->insert(features[i]) );
+        }
+    }
+
+    void untagTile(ObjectIndex* index, const std::vector<ObjectID>& ids, bool batched)
+    {
+        if ( batched )
+        {
+            index->remove( ids );
+        }
+        else
+        {
+            for(unsigned i=0; i<ids.size(); ++i)
+                index->remove( ids[i] );
+        }
+    }
+
+    Result run(bool batched, unsigned maxTiles, unsigned numFeatures, unsigned rounds, unsigned numReaders)
+    {
+        osg::ref_ptr<ObjectIndex> index = new ObjectIndex();
+
+        std::vector< osg::ref_ptr<osg::Referenced> > storage;
+        std::vector<osg::Referenced*> features;
+        for(unsigned i=0; i<numFeatures; ++i)
+        {
+            storage.push_back( new osg::Referenced() );
+            features.push_back( storage.back().get() );
+        }
+
+        // a resident tile for the readers to probe
+        std::vector<ObjectID> probes;
+        tagTile( index.get(), features, true, probes );
+
+        OpenThreads::Atomic done(0u);
+        std::vector<Reader*> readers;
+        for(unsigned i=0; i<numReaders; ++i)
+        {
+            readers.push_back( new Reader(index.get(), probes, done) );
+            readers.back()->start();
+        }
+
+        std::deque< std::vector<ObjectID> > tiles;
+        double tagMs = 0.0, untagMs = 0.0;
+        unsigned untagged = 0u;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned r=0; r<rounds; ++r)
+        {
+            tiles.push_back( std::vector<ObjectID>() );
+
+            osg::Timer_t t0 = osg::Timer::instance()->tick();
+            tagTile( index.get(), features, batched, tiles.back() );
+            osg::Timer_t t1 = osg::Timer::instance()->tick();
+            tagMs += osg::Timer::instance()->delta_m(t0, t1);
+
+            if ( tiles.size() > maxTiles )
+            {
+                untagTile( index.get(), tiles.front(), batched );
+                untagMs += osg::Timer::instance()->delta_m(t1, osg::Timer::instance()->tick());
+                tiles.pop_front();
+                ++untagged;
+            }
+        }
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        ++done;
+        unsigned long reads = 0u;
+        for(unsigned i=0; i<readers.size(); ++i)
+        {
+            readers[i]->join();
+            reads += readers[i]->_reads;
+            delete readers[i];
+        }
+
+        Result result;
+        result._tagMs       = rounds > 0u ? tagMs / (double)rounds : 0.0;
+        result._untagMs     = untagged > 0u ? untagMs / (double)untagged : 0.0;
+        result._readsPerSec = seconds > 0.0 ? (double)reads / seconds : 0.0;
+        return result;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--tiles <n>", "Number of resident tiles before the oldest is untagged (default 64)");
+    arguments.getApplicationUsage()->addCommandLineOption("--features <n>", "Number of features tagged per tile (default 2000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--rounds <n>", "Number of tiles to tag (default 1000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--readers <n>", "Number of threads looking up IDs during the run (default 2)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned maxTiles = 64u, numFeatures = 2000u, rounds = 1000u, numReaders = 2u;
+    arguments.read("--tiles", maxTiles);
+    arguments.read("--features", numFeatures);
+    arguments.read("--rounds", rounds);
+    arguments.read("--readers", numReaders);
+    numFeatures = std::max(numFeatures, 1u);
+
+    cout << setw(10) << "mode"
+         << setw(12) << "tag ms"
+         << setw(12) << "untag ms"
+         << setw(14) << "reads/s" << endl;
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        bool batched = pass == 1;
+        Result r = run(batched, maxTiles, numFeatures, rounds, numReaders);
+
+        cout << fixed << setprecision(3)
+             << setw(10) << (batched ? "batched" : "single")
+             << setw(12) << r._tagMs
+             << setw(12) << r._untagMs
+             << setw(14) << setprecision(0) << r._readsPerSec << endl;
+    }
+
+    cout << "(" << rounds << " tiles of " << numFeatures << " features, "
+         << maxTiles << " resident, " << numReaders << " readers)" << endl;
+
+    return 0;
+}
@@ -0,0 +1,330 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cfloat>
+#include <limits>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osgUtil/IntersectionVisitor>
+#include <osgEarth/DPLineSegmentIntersector>
+#include "HeightPyramid"
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace std;
+
+//
+// Measures the CPU cost of intersecting line segments with a terrain tile,
+// e.g.:
+//
+//   osgearth_raybench --size 65 --rays 5000 --seed 7
+//
+// Generates an fBm heightfield at each tile size, draped over a patch of a
+// sphere the size of the earth, and casts the same seeded random segments
+// at it four ways: against every triangle of the tile (no spatial index) and
+// through its HeightPyramid, each collecting all hits and only the nearest.
+// Reports rays per second and how far the nearest hit of each method is from
+// the brute-force one. Needs no earth file and no window.
+//
+
+namespace
+{
+    const double EARTH_RADIUS = 6378137.0;
+
+    double randomIn(double lo, double hi)
+    {
+        return lo + (hi-lo) * ((double)::rand() / (double)RAND_MAX);
+    }
+
+    // lattice value in [-1..1] for a seeded integer grid point
+    double lattice(int x, int y, unsigned seed)
+    {
+        unsigned h = (unsigned)x * 374761393u + (unsigned)y * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        h ^= h >> 16;
+        return (double)(h & 0xffffu) / 32767.5 - 1.0;
+    }
+
+    // smoothly interpolated value noise
+    double noise(double x, double y, unsigned seed)
+    {
+        int    ix = (int)floor(x), iy = (int)floor(y);
+        double fx = x - (double)ix, fy = y - (double)iy;
+        double sx = fx*fx*(3.0-2.0*fx), sy = fy*fy*(3.0-2.0*fy);
+
+        double a = lattice(ix,   iy,   seed), b = lattice(ix+1, iy,   seed);
+        double c = lattice(ix,   iy+1, seed), d = lattice(ix+1, iy+1, seed);
+        return (a + (b-a)*sx) + ((c + (d-c)*sx) - (a + (b-a)*sx))*sy;
+    }
+
+    // fractal Brownian motion: octaves of noise, each twice the frequency and
+    // half the amplitude of the last.
+    double fbm(double x, double y, unsigned seed)
+    {
+        double sum = 0.0, amp = 1.0;
+        for(unsigned i=0; i<8; ++i)
+        {
+            sum += amp * noise(x, y, seed+i);
+            x   *= 2.0;
+            y   *= 2.0;
+            amp *= 0.5;
+        }
+        return sum;
+    }
+
+    // One tile: the undisplaced grid the pyramid reads, and a drawable of the
+    // displaced triangles (same triangulation as the rex TileDrawable) that
+    // carries the pyramid as its Shape.
+    struct Tile
+    {
+        osg::ref_ptr<osg::Geometry>  _grid;
+        std::vector<float>           _heights;
+        osg::ref_ptr<HeightPyramid>  _pyramid;
+        osg::ref_ptr<osg::Geode>     _geode;
+        float                        _minHeight, _maxHeight;
+    };
+
+    void makeTile(unsigned tileSize, double extent, double amplitude, unsigned seed, Tile& tile)
+    {
+        osg::Vec3Array* verts   = new osg::Vec3Array( tileSize*tileSize );
+        osg::Vec3Array* normals = new osg::Vec3Array( tileSize*tileSize );
+        tile._heights.resize( tileSize*tileSize );
+        tile._minHeight =  FLT_MAX;
+        tile._maxHeight = -FLT_MAX;
+
+        // a patch of the sphere, in a frame tangent at its center, so the
+        // normals vary across the tile as they do on the globe.
+        const osg::Vec3d center(0.0, 0.0, -EARTH_RADIUS);
+        for(unsigned t=0; t<tileSize; ++t)
+        {
+            double v = (double)t/(double)(tileSize-1);
+            for(unsigned s=0; s<tileSize; ++s)
+            {
+                double u = (double)s/(double)(tileSize-1);
+                unsigned i = t*tileSize + s;
+
+                osg::Vec3d n = osg::Vec3d((u-0.5)*extent, (v-0.5)*extent, 0.0) - center;
+                n.normalize();
+                (*normals)[i] = n;
+                (*verts)[i]   = center + n*EARTH_RADIUS;
+
+                float h = (float)(amplitude * fbm(4.0*u, 4.0*v, seed));
+                tile._heights[i] = h;
+                tile._minHeight = osg::minimum(tile._minHeight, h);
+                tile._maxHeight = osg::maximum(tile._maxHeight, h);
+            }
+        }
+
+        tile._grid = new osg::Geometry();
+        tile._grid->setVertexArray( verts );
+        tile._grid->setNormalArray( normals );
+        tile._grid->setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
+
+        osg::Vec3Array* points = new osg::Vec3Array( tileSize*tileSize );
+        for(unsigned i=0; i<tileSize*tileSize; ++i)
+            (*points)[i] = (*verts)[i] + (*normals)[i] * tile._heights[i];
+
+        osg::DrawElementsUInt* tris = new osg::DrawElementsUInt( GL_TRIANGLES );
+        tris->reserve( 6*(tileSize-1)*(tileSize-1) );
+        for(unsigned t=0; t<tileSize-1; ++t)
+        {
+            for(unsigned s=0; s<tileSize-1; ++s)
+            {
+                unsigned i00 = t*tileSize + s;
+                unsigned i10 = i00 + 1;
+                unsigned i01 = i00 + tileSize;
+                unsigned i11 = i01 + 1;
+                tris->push_back(i00); tris->push_back(i01); tris->push_back(i10);
+                tris->push_back(i10); tris->push_back(i01); tris->push_back(i11);
+            }
+        }
+
+        osg::Geometry* surface = new osg::Geometry();
+        surface->setUseDisplayList( false );
+        surface->setVertexArray( points );
+        surface->addPrimitiveSet( tris );
+
+        tile._pyramid = new HeightPyramid( tile._grid.get(), &tile._heights.front(), tileSize );
+        surface->setShape( tile._pyramid.get() );
+
+        tile._geode = new osg::Geode();
+        tile._geode->addDrawable( surface );
+    }
+
+    struct Run
+    {
+        const char*                             _name;
+        bool                                    _useIndex;
+        osgUtil::Intersector::IntersectionLimit _limit;
+        double                                  _seconds;
+        unsigned                                _hits;
+        double                                  _maxError;
+    };
+
+    // casts every ray; fills in the nearest hit of each (or a NaN if none)
+    void castRays(osg::Node* node, const std::vector<osg::Vec3d>& starts, const std::vector<osg::Vec3d>& ends,
+                  Run& run, std::vector<osg::Vec3d>& nearest)
+    {
+        nearest.resize( starts.size() );
+        run._hits = 0u;
+        const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<starts.size(); ++i)
+        {
+            osg::ref_ptr<DPLineSegmentIntersector> lsi = new DPLineSegmentIntersector( starts[i], ends[i] );
+            lsi->setIntersectionLimit( run._limit );
+
+            osgUtil::IntersectionVisitor iv( lsi.get() );
+            iv.setUseKdTreeWhenAvailable( run._useIndex );
+            node->accept( iv );
+
+            if ( lsi->containsIntersections() )
+            {
+                nearest[i] = lsi->getFirstIntersection().getWorldIntersectPoint();
+                run._hits += lsi->getIntersections().size();
+            }
+            else
+            {
+                nearest[i].set( NaN, NaN, NaN );
+            }
+        }
+        run._seconds = osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <n>", "Test only tiles of n x n vertices (default 17, 33, 65, 129 and 257)");
+    arguments.getApplicationUsage()->addCommandLineOption("--extent <m>", "Width of a tile (default 10000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--amplitude <m>", "Height scale of the terrain (default 1000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--rays <n>", "Number of rays to cast per tile (default 2000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--seed <n>", "Seed for the terrain and the rays (default 1)");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        cout << arguments.getApplicationUsage()->getCommandLineUsage() << endl;
+        arguments.getApplicationUsage()->write(cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    std::vector<unsigned> sizes;
+    unsigned size;
+    while( arguments.read("--size", size) )
+    {
+        if ( size >= 2u )
+            sizes.push_back( size );
+    }
+    if ( sizes.empty() )
+    {
+        sizes.push_back(17u);
+        sizes.push_back(33u);
+        sizes.push_back(65u);
+        sizes.push_back(129u);
+        sizes.push_back(257u);
+    }
+
+    double extent = 10000.0, amplitude = 1000.0;
+    unsigned numRays = 2000u, seed = 1u;
+    arguments.read("--extent", extent);
+    arguments.read("--amplitude", amplitude);
+    arguments.read("--rays", numRays);
+    arguments.read("--seed", seed);
+
+    cout << setw(8) << "Size" << "  "
+         << setw(24) << left << "Method" << right
+         << setw(12) << "Rays/s"
+         << setw(10) << "Hits"
+         << setw(16) << "Max error (m)"
+         << endl;
+
+    for(unsigned z=0; z<sizes.size(); ++z)
+    {
+        Tile tile;
+        makeTile( sizes[z], extent, amplitude, seed, tile );
+
+        // segments from random points above the tile to random points below
+        // it, so each one crosses the whole height range at a slant.
+        ::srand( seed + z );
+        double top    = (double)tile._maxHeight + 0.5*amplitude;
+        double bottom = (double)tile._minHeight - 0.5*amplitude;
+        double half   = 0.5*extent;
+
+        std::vector<osg::Vec3d> starts, ends;
+        for(unsigned i=0; i<numRays; ++i)
+        {
+            starts.push_back( osg::Vec3d(randomIn(-half, half), randomIn(-half, half), top) );
+            ends.push_back  ( osg::Vec3d(randomIn(-half, half), randomIn(-half, half), bottom) );
+        }
+
+        Run runs[4] = {
+            { "triangles, all hits",   false, osgUtil::Intersector::NO_LIMIT,      0.0, 0u, 0.0 },
+            { "triangles, nearest",    false, osgUtil::Intersector::LIMIT_NEAREST, 0.0, 0u, 0.0 },
+            { "pyramid, all hits",     true,  osgUtil::Intersector::NO_LIMIT,      0.0, 0u, 0.0 },
+            { "pyramid, nearest",      true,  osgUtil::Intersector::LIMIT_NEAREST, 0.0, 0u, 0.0 }
+        };
+
+        // build the pyramid before timing anything.
+        float minHeight, maxHeight;
+        tile._pyramid->getHeightRange( minHeight, maxHeight );
+
+        std::vector<osg::Vec3d> reference, nearest;
+        castRays( tile._geode.get(), starts, ends, runs[0], reference );
+
+        for(unsigned r=1; r<4; ++r)
+        {
+            castRays( tile._geode.get(), starts, ends, runs[r], nearest );
+            for(unsigned i=0; i<nearest.size(); ++i)
+            {
+                bool a = osg::isNaN(reference[i].x()), b = osg::isNaN(nearest[i].x());
+                double error = a != b ? DBL_MAX : a ? 0.0 : (nearest[i] - reference[i]).length();
+                runs[r]._maxError = std::max( runs[r]._maxError, error );
+            }
+        }
+
+        for(unsigned r=0; r<4; ++r)
+        {
+            cout << setw(8) << sizes[z] << "  "
+                 << setw(24) << left << runs[r]._name << right
+                 << setw(12) << fixed << setprecision(0) << (runs[r]._seconds > 0.0 ? (double)numRays / runs[r]._seconds : 0.0)
+                 << setw(10) << runs[r]._hits
+                 << setw(16) << setprecision(4) << runs[r]._maxError
+                 << endl;
+        }
+    }
+
+    return 0;
+}
@@ -18,6 +18,7 @@
  */
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
+#include <osgEarth/TaskService>
 #include <osgEarth/ThreadingUtils>
 
 #include <osg/UserDataContainer>
@@ -192,3 +193,77 @@ CacheDriver::~CacheDriver()
 }
 
 //------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[CacheRefreshService] "
+
+// maximum number of refreshes that may be queued at once
+#define MAX_PENDING_REFRESHES 1024u
+
+struct CacheRefreshService::Task : public TaskRequest
+{
+    Task(CacheRefreshService* service, const std::string& recordID, TaskRequest* task) :
+        _service ( service ),
+        _recordID( recordID ),
+        _task    ( task ) { }
+
+    void operator()(ProgressCallback* progress)
+    {
+        (*_task)(progress);
+        _service->done(_recordID);
+    }
+
+    osg::ref_ptr<CacheRefreshService> _service;
+    std::string                       _recordID;
+    osg::ref_ptr<TaskRequest>         _task;
+};
+
+CacheRefreshService*
+CacheRefreshService::instance()
+{
+    static osg::ref_ptr<CacheRefreshService> s_instance = new CacheRefreshService();
+    return s_instance.get();
+}
+
+CacheRefreshService::CacheRefreshService()
+{
+    _service = new TaskService("Cache refresh", 2);
+}
+
+CacheRefreshService::~CacheRefreshService()
+{
+    //nop
+}
+
+bool
+CacheRefreshService::schedule(const std::string& recordID, TaskRequest* task)
+{
+    // take ownership so a rejected task is released.
+    osg::ref_ptr<TaskRequest> taskRef = task;
+    if ( !taskRef.valid() )
+        return false;
+
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if ( _pending.size() >= MAX_PENDING_REFRESHES || !_pending.insert(recordID).second )
+            return false;
+    }
+
+    OE_DEBUG << LC << "Refreshing " << recordID << " in the background" << std::endl;
+    _service->add( new Task(this, recordID, taskRef.get()) );
+    return true;
+}
+
+void
+CacheRefreshService::done(const std::string& recordID)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _pending.erase(recordID);
+}
+
+unsigned
+CacheRefreshService::getNumPending() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _pending.size();
+}
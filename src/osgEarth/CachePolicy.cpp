@@ -32,33 +32,37 @@ CachePolicy CachePolicy::CACHE_ONLY( CachePolicy::USAGE_CACHE_ONLY );
 //------------------------------------------------------------------------
 
 CachePolicy::CachePolicy() :
-_usage  ( USAGE_READ_WRITE ),
-_maxAge ( INT_MAX ),
-_minTime( 0 )
+_usage               ( USAGE_READ_WRITE ),
+_maxAge              ( INT_MAX ),
+_minTime             ( 0 ),
+_staleWhileRevalidate( false )
 {
     //nop
 }
 
 CachePolicy::CachePolicy( const Usage& usage ) :
-_usage  ( usage ),
-_maxAge ( INT_MAX ),
-_minTime( 0 )
+_usage               ( usage ),
+_maxAge              ( INT_MAX ),
+_minTime             ( 0 ),
+_staleWhileRevalidate( false )
 {
     _usage = usage; // explicity set the optional<>
 }
 
 CachePolicy::CachePolicy( const Config& conf ) :
-_usage  ( USAGE_READ_WRITE ),
-_maxAge ( INT_MAX ),
-_minTime( 0 )
+_usage               ( USAGE_READ_WRITE ),
+_maxAge              ( INT_MAX ),
+_minTime             ( 0 ),
+_staleWhileRevalidate( false )
 {
     fromConfig( conf );
 }
 
 CachePolicy::CachePolicy(const CachePolicy& rhs) :
-_usage  ( rhs._usage ),
-_maxAge ( rhs._maxAge ),
-_minTime( rhs._minTime )
+_usage               ( rhs._usage ),
+_maxAge              ( rhs._maxAge ),
+_minTime             ( rhs._minTime ),
+_staleWhileRevalidate( rhs._staleWhileRevalidate )
 {
     //nop
 }
@@ -99,6 +103,9 @@ CachePolicy::mergeAndOverride(const CachePolicy& rhs)
 
     if ( rhs.maxAge().isSet() )
         maxAge() = rhs.maxAge().get();
+
+    if ( rhs.staleWhileRevalidate().isSet() )
+        staleWhileRevalidate() = rhs.staleWhileRevalidate().get();
 }
 
 void
@@ -131,7 +138,8 @@ CachePolicy::operator == (const CachePolicy& rhs) const
     return 
         (_usage.get() == rhs._usage.get()) &&
         (_maxAge.get() == rhs._maxAge.get()) &&
-        (_minTime.get() == rhs._minTime.get());
+        (_minTime.get() == rhs._minTime.get()) &&
+        (_staleWhileRevalidate.get() == rhs._staleWhileRevalidate.get());
 }
 
 CachePolicy&
@@ -140,6 +148,7 @@ CachePolicy::operator = ( const CachePolicy& rhs )
     _usage  = optional<Usage>(rhs._usage);
     _maxAge = optional<TimeSpan>(rhs._maxAge);
     _minTime = optional<TimeStamp>(rhs._minTime);
+    _staleWhileRevalidate = optional<bool>(rhs._staleWhileRevalidate);
 
     return *this;
 }
@@ -157,7 +166,7 @@ CachePolicy::usageString() const
 bool
 CachePolicy::empty() const
 {
-    bool isSet = _usage.isSet() || _maxAge.isSet() || _minTime.isSet();
+    bool isSet = _usage.isSet() || _maxAge.isSet() || _minTime.isSet() || _staleWhileRevalidate.isSet();
     return !isSet;
 }
 
@@ -171,6 +180,7 @@ CachePolicy::fromConfig( const Config& conf )
     conf.getIfSet( "usage", "none",         _usage, USAGE_NO_CACHE );
     conf.getIfSet( "max_age", _maxAge );
     conf.getIfSet( "min_time", _minTime );
+    conf.getIfSet( "stale_while_revalidate", _staleWhileRevalidate );
 }
 
 Config
@@ -183,5 +193,6 @@ CachePolicy::getConfig() const
     conf.addIfSet( "usage", "no_cache",     _usage, USAGE_NO_CACHE );
     conf.addIfSet( "max_age", _maxAge );
     conf.addIfSet( "min_time", _minTime );
+    conf.addIfSet( "stale_while_revalidate", _staleWhileRevalidate );
     return conf;
 }
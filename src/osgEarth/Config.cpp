@@ -29,6 +29,10 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <cstring>
 
 using namespace osgEarth;
 
@@ -59,6 +63,15 @@ Config::setReferrer( const std::string& referrer )
         absReferrer = referrer;
     }
 
+    inheritReferrer( absReferrer );
+}
+
+void
+Config::inheritReferrer( const std::string& absReferrer )
+{
+    if ( absReferrer.empty() )
+        return;
+
     // Don't overwrite an existing referrer:
     if ( _referrer.empty() )
     {
@@ -67,17 +80,30 @@ Config::setReferrer( const std::string& referrer )
 
     for( ConfigSet::iterator i = _children.begin(); i != _children.end(); i++ )
     { 
-        i->setReferrer( absReferrer );
+        i->inheritReferrer( absReferrer );
     }
 }
 
+void
+Config::swap( Config& rhs )
+{
+    _key.swap( rhs._key );
+    _defaultValue.swap( rhs._defaultValue );
+    _children.swap( rhs._children );
+    _referrer.swap( rhs._referrer );
+    std::swap( _isLocation, rhs._isLocation );
+    _externalRef.swap( rhs._externalRef );
+    _refMap.swap( rhs._refMap );
+}
+
 bool
 Config::fromXML( std::istream& in )
 {
-    osg::ref_ptr<XmlDocument> xml = XmlDocument::load( in );
-    if ( xml.valid() )
-        *this = xml->getConfig();
-    return xml.valid();
+    Config conf;
+    if ( !XmlDocument::loadConfig(in, URIContext(), conf) )
+        return false;
+    swap( conf );
+    return true;
 }
 
 Config
@@ -277,92 +303,469 @@ namespace
         return value;
     }
 
-    void json2conf(const Json::Value& json, Config& conf, int depth)
+    // Children are populated in place (addChild) rather than built and
+    // copied in, since copying a subtree is linear in its size.
+    // Parses JSON text straight into a Config, without building a Json::Value
+    // tree first. The result is the same as the old jsoncpp path: object
+    // members are emitted in sorted key order (the last of any duplicates
+    // wins), "$key" and "$value" set the key and value, "xxx__array__" (or
+    // the older "xxx_$set") arrays become repeated "xxx" children, and a
+    // top-level object with a single object member becomes the Config itself.
+    // Numbers and booleans are formatted the way Json::Value::asString does.
+    struct JSONReader
     {
-        if ( json.type() == Json::objectValue )
+        enum MemberType
         {
-            Json::Value::Members members = json.getMemberNames();
+            MEMBER_CHILD,    // a child node
+            MEMBER_EXPANDED, // a holder node whose children get spliced in
+            MEMBER_KEY,      // "$key"
+            MEMBER_VALUE     // "$value"
+        };
 
-            for( Json::Value::Members::const_iterator i = members.begin(); i != members.end(); ++i )
+        struct Member
+        {
+            MemberType          _type;
+            ConfigSet::iterator _node;
+            std::string         _text;
+            bool                _isObject;
+        };
+
+        const char*       _begin;
+        const char*       _ptr;
+        const char*       _end;
+        std::string       _error;
+        const char*       _errorAt;
+        std::stringstream _buf;
+
+        JSONReader(const char* begin, const char* end) :
+            _begin(begin), _ptr(begin), _end(end), _errorAt(begin) { }
+
+        bool fail(const char* message)
+        {
+            if ( _error.empty() )
             {
-                const Json::Value& value = json[*i];
+                _error = message;
+                _errorAt = _ptr;
+            }
+            return false;
+        }
 
-                if ( value.isObject() )
+        std::string errorMessage() const
+        {
+            int line = 1, column = 1;
+            for(const char* p = _begin; p < _errorAt; ++p)
+            {
+                if ( *p == '\n' ) { ++line; column = 1; }
+                else ++column;
+            }
+            return Stringify() << "Line " << line << ", Column " << column << ": " << _error;
+        }
+
+        // skips white space and comments; false on an unterminated comment.
+        bool skip()
+        {
+            while( _ptr != _end )
+            {
+                char c = *_ptr;
+                if ( c == ' ' || c == '\t' || c == '\r' || c == '\n' )
                 {
-                    if (depth == 0 && members.size() == 1)
-                    {
-                        conf.key() = *i;
-                        json2conf(value, conf, depth+1);
-                    }
-                    else
-                    {
-                        Config element( *i );
-                        json2conf( value, element, depth+1 );
-                        conf.add( element );
-                    }
+                    ++_ptr;
                 }
-                else if ( value.isArray() )
+                else if ( c == '/' && _end - _ptr >= 2 && _ptr[1] == '*' )
                 {
-                    if ( endsWith(*i, "__array__") )
+                    const char* p = _ptr + 2;
+                    while( p+1 < _end && !(p[0] == '*' && p[1] == '/') )
+                        ++p;
+                    if ( p+1 >= _end )
+                        return fail("Unterminated comment");
+                    _ptr = p + 2;
+                }
+                else if ( c == '/' && _end - _ptr >= 2 && _ptr[1] == '/' )
+                {
+                    while( _ptr != _end && *_ptr != '\r' && *_ptr != '\n' )
+                        ++_ptr;
+                }
+                else break;
+            }
+            return true;
+        }
+
+        bool peek(char c)
+        {
+            return skip() && _ptr != _end && *_ptr == c;
+        }
+
+        static void appendUTF8(unsigned code, std::string& out)
+        {
+            if ( code < 0x80 ) {
+                out += (char)code;
+            }
+            else if ( code < 0x800 ) {
+                out += (char)(0xC0 | (code >> 6));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else if ( code < 0x10000 ) {
+                out += (char)(0xE0 | (code >> 12));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else {
+                out += (char)(0xF0 | (code >> 18));
+                out += (char)(0x80 | ((code >> 12) & 0x3F));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool hex4(unsigned& code)
+        {
+            if ( _end - _ptr < 4 )
+                return fail("Bad unicode escape sequence in string: four digits expected.");
+            code = 0;
+            for(int i = 0; i < 4; ++i)
+            {
+                char c = *_ptr++;
+                code *= 16;
+                if      ( c >= '0' && c <= '9' ) code += c - '0';
+                else if ( c >= 'a' && c <= 'f' ) code += c - 'a' + 10;
+                else if ( c >= 'A' && c <= 'F' ) code += c - 'A' + 10;
+                else return fail("Bad unicode escape sequence in string: hexadecimal digit expected.");
+            }
+            return true;
+        }
+
+        // reads a quoted string; _ptr is on the opening quote.
+        bool string(std::string& out)
+        {
+            ++_ptr;
+            const char* run = _ptr;
+            while( _ptr != _end )
+            {
+                char c = *_ptr;
+                if ( c == '"' )
+                {
+                    out.append( run, _ptr );
+                    ++_ptr;
+                    return true;
+                }
+                if ( c != '\\' )
+                {
+                    ++_ptr;
+                    continue;
+                }
+
+                out.append( run, _ptr );
+                if ( ++_ptr == _end )
+                    break;
+
+                switch( *_ptr++ )
+                {
+                case '"':  out += '"';  break;
+                case '/':  out += '/';  break;
+                case '\\': out += '\\'; break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u':
                     {
-                        std::string key = i->substr(0, i->length()-9);
-                        for( Json::Value::const_iterator j = value.begin(); j != value.end(); ++j )
+                        unsigned code;
+                        if ( !hex4(code) )
+                            return false;
+                        // combine a surrogate pair.
+                        if ( code >= 0xD800 && code <= 0xDBFF && _end - _ptr >= 6 && _ptr[0] == '\\' && _ptr[1] == 'u' )
                         {
-                            Config child;
-                            json2conf( *j, child, depth+1 );
-                            conf.add( key, child );
+                            const char* save = _ptr;
+                            _ptr += 2;
+                            unsigned low;
+                            if ( hex4(low) && low >= 0xDC00 && low <= 0xDFFF )
+                                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            else
+                                _ptr = save;
                         }
+                        appendUTF8( code, out );
                     }
-                    else if ( endsWith(*i, "_$set") ) // backwards compatibility
+                    break;
+                default:
+                    return fail("Bad escape sequence in string");
+                }
+                run = _ptr;
+            }
+            return fail("Missing '\"' at the end of a string");
+        }
+
+        bool literal(const char* word, unsigned length)
+        {
+            if ( (unsigned)(_end - _ptr) < length || ::strncmp(_ptr, word, length) != 0 )
+                return fail("Syntax error: value, object or array expected.");
+            _ptr += length;
+            return true;
+        }
+
+        // numbers are formatted the way Json::Value::asString() formats the
+        // int, uint or double that jsoncpp would have decoded.
+        bool number(std::string& out)
+        {
+            const char* start = _ptr;
+            bool isDouble = false;
+            while( _ptr != _end )
+            {
+                char c = *_ptr;
+                if ( c == '.' || c == 'e' || c == 'E' || c == '+' || (c == '-' && _ptr != start) )
+                    isDouble = true;
+                else if ( !(c >= '0' && c <= '9') && c != '-' )
+                    break;
+                ++_ptr;
+            }
+
+            _buf.str( std::string() );
+            _buf.clear();
+
+            if ( !isDouble )
+            {
+                const char* p = start;
+                bool negative = *p == '-';
+                if ( negative )
+                    ++p;
+                unsigned threshold = (negative ? 2147483648u : 4294967295u) / 10u;
+                unsigned value = 0;
+                while( p < _ptr && value < threshold )
+                    value = value*10u + (unsigned)(*p++ - '0');
+
+                if ( p == _ptr )
+                {
+                    if ( negative )
+                        _buf << (int)(-(long long)value);
+                    else if ( value <= 2147483647u )
+                        _buf << (int)value;
+                    else
+                        _buf << value;
+                    out = _buf.str();
+                    return true;
+                }
+                // too big for an int; fall through to a double.
+            }
+
+            double value = 0.0;
+            std::string token( start, _ptr );
+            if ( ::sscanf(token.c_str(), "%lf", &value) != 1 )
+                return fail("Not a number.");
+            _buf << value;
+            out = _buf.str();
+            return true;
+        }
+
+        // reads a string, number, boolean or null as the text that
+        // json2conf assigned.
+        bool scalar(std::string& out, bool& isNull)
+        {
+            isNull = false;
+            if ( !skip() || _ptr == _end )
+                return fail("Syntax error: value, object or array expected.");
+
+            char c = *_ptr;
+            if ( c == '"' )
+                return string(out);
+            if ( c == '-' || (c >= '0' && c <= '9') )
+                return number(out);
+            if ( c == 't' ) { out = "true";  return literal("true", 4); }
+            if ( c == 'f' ) { out = "false"; return literal("false", 5); }
+            if ( c == 'n' ) { isNull = true; return literal("null", 4); }
+
+            return fail("Syntax error: value, object or array expected.");
+        }
+
+        bool value(Config& conf, bool top)
+        {
+            if ( peek('{') )
+                return object(conf, top);
+            if ( peek('[') )
+                return array(conf, true);
+
+            std::string text;
+            bool isNull;
+            if ( !scalar(text, isNull) )
+                return false;
+            if ( !isNull )
+                conf.value().swap( text );
+            return true;
+        }
+
+        // each element becomes an (initially unnamed) child. Empty ones are
+        // dropped unless the caller is going to name them.
+        bool array(Config& conf, bool dropEmpty)
+        {
+            ++_ptr;
+            if ( peek(']') )
+            {
+                ++_ptr;
+                return true;
+            }
+
+            for(;;)
+            {
+                Config& element = conf.addChild( std::string() );
+                if ( !value(element, false) )
+                    return false;
+                if ( dropEmpty && element.empty() )
+                    conf.children().pop_back();
+
+                if ( peek(',') )
+                    ++_ptr;
+                else if ( peek(']') ) {
+                    ++_ptr;
+                    return true;
+                }
+                else
+                    return fail("Missing ',' or ']' in array declaration");
+            }
+        }
+
+        // members are parsed straight into children of conf, then put in
+        // key order once the object is closed.
+        bool object(Config& conf, bool top)
+        {
+            ++_ptr;
+            if ( peek('}') )
+            {
+                ++_ptr;
+                return true;
+            }
+
+            ConfigSet& children = conf.children();
+            std::map<std::string, Member> members;
+
+            for(;;)
+            {
+                std::string name;
+                if ( !peek('"') )
+                    return fail("Missing '}' or object member name");
+                if ( !string(name) )
+                    return false;
+
+                if ( !peek(':') )
+                    return fail("Missing ':' after object member name");
+                ++_ptr;
+
+                Member m;
+                m._isObject = false;
+
+                if ( peek('{') )
+                {
+                    Config& child = conf.addChild( name );
+                    m._type = MEMBER_CHILD;
+                    m._node = --children.end();
+                    m._isObject = true;
+                    if ( !object(child, false) )
+                        return false;
+                }
+                else if ( peek('[') )
+                {
+                    std::string::size_type suffix =
+                        endsWith(name, "__array__") ? 9 :
+                        endsWith(name, "_$set")     ? 5 : // backwards compatibility
+                        0;
+
+                    if ( suffix > 0 )
                     {
-                        std::string key = i->substr(0, i->length()-5);
-                        for( Json::Value::const_iterator j = value.begin(); j != value.end(); ++j )
-                        {
-                            Config child;
-                            json2conf( *j, child, depth+1 );
-                            conf.add( key, child );
-                        }
+                        std::string key = name.substr(0, name.length()-suffix);
+                        Config& holder = conf.addChild( std::string() );
+                        m._type = MEMBER_EXPANDED;
+                        m._node = --children.end();
+                        if ( !array(holder, false) )
+                            return false;
+                        for(ConfigSet::iterator i = holder.children().begin(); i != holder.children().end(); ++i)
+                            i->key() = key;
                     }
                     else
                     {
-                        Config element( *i );
-                        json2conf( value, element, depth+1 );
-                        conf.add( element );
+                        Config& child = conf.addChild( name );
+                        m._type = MEMBER_CHILD;
+                        m._node = --children.end();
+                        if ( !array(child, true) )
+                            return false;
                     }
                 }
-                else if ( (*i) == "$key" )
-                {
-                    conf.key() = value.asString();
-                }
-                else if ( (*i) == "$value" )
+                else
                 {
-                    conf.value() = value.asString();
+                    bool isNull;
+                    if ( !scalar(m._text, isNull) )
+                        return false;
+
+                    if ( isNull )
+                    {
+                        // jsoncpp treats a null member as an empty object.
+                        conf.addChild( name );
+                        m._type = MEMBER_CHILD;
+                        m._node = --children.end();
+                        m._isObject = true;
+                    }
+                    else if ( name == "$key" )
+                        m._type = MEMBER_KEY;
+                    else if ( name == "$value" )
+                        m._type = MEMBER_VALUE;
+                    else
+                    {
+                        Config& child = conf.addChild( name );
+                        child.value().swap( m._text );
+                        m._type = MEMBER_CHILD;
+                        m._node = --children.end();
+                    }
                 }
-                else if ( (*i) == "$children" && value.isArray() )
+
+                // a repeated name replaces the earlier member.
+                std::map<std::string, Member>::iterator existing = members.find( name );
+                if ( existing != members.end() )
                 {
-                    json2conf( value, conf, depth+1 );
+                    if ( existing->second._type == MEMBER_CHILD || existing->second._type == MEMBER_EXPANDED )
+                        children.erase( existing->second._node );
+                    existing->second = m;
                 }
                 else
                 {
-                    conf.add( *i, value.asString() );
+                    members.insert( std::make_pair(name, m) );
+                }
+
+                if ( peek(',') )
+                    ++_ptr;
+                else if ( peek('}') ) {
+                    ++_ptr;
+                    break;
                 }
+                else
+                    return fail("Missing ',' or '}' in object declaration");
             }
-        }
-        else if ( json.type() == Json::arrayValue )
-        {          
-            for( Json::Value::const_iterator j = json.begin(); j != json.end(); ++j )
+
+            // a lone object at the top level is the Config itself.
+            if ( top && members.size() == 1 && members.begin()->second._isObject )
             {
-                Config child;
-                json2conf( *j, child, depth+1 );
-                if ( !child.empty() )
-                    conf.add( child );
+                ConfigSet::iterator node = members.begin()->second._node;
+                conf.key() = node->key();
+                if ( !node->value().empty() )
+                    conf.value() = node->value();
+                children.splice( children.end(), node->children() );
+                children.erase( node );
+                return true;
             }
+
+            for(std::map<std::string, Member>::iterator i = members.begin(); i != members.end(); ++i)
+            {
+                Member& m = i->second;
+                switch( m._type )
+                {
+                case MEMBER_KEY:   conf.key().swap( m._text ); break;
+                case MEMBER_VALUE: conf.value().swap( m._text ); break;
+                case MEMBER_CHILD: children.splice( children.end(), children, m._node ); break;
+                case MEMBER_EXPANDED:
+                    children.splice( children.end(), m._node->children() );
+                    children.erase( m._node );
+                    break;
+                }
+            }
+            return true;
         }
-        else if ( json.type() != Json::nullValue )
-        {
-            conf.value() = json.asString();
-        }
-    }
+    };
 }
 
 std::string
@@ -378,21 +781,24 @@ Config::toJSON( bool pretty ) const
 bool
 Config::fromJSON( const std::string& input )
 {
-    Json::Reader reader;
-    Json::Value root( Json::objectValue );
-    if ( reader.parse( input, root ) )
-    {
-        json2conf( root, *this, 0 );
-        return true;
-    }
-    else
+    // parse into a scratch Config so that a failure leaves this one alone.
+    Config result( _key, _defaultValue );
+    result._referrer = _referrer;
+
+    JSONReader reader( input.data(), input.data() + input.size() );
+    if ( !reader.value(result, true) )
     {
         OE_WARN 
             << "JSON decoding error: "
-            << reader.getFormatedErrorMessages() 
+            << reader.errorMessage()
             << std::endl;
+        return false;
     }
-    return false;
+
+    _key.swap( result._key );
+    _defaultValue.swap( result._defaultValue );
+    _children.splice( _children.end(), result._children );
+    return true;
 }
 
 Config
@@ -591,12 +591,14 @@ double OcclusionCullingCallback::_maxFrameTime = 10.0;
 //    //nop
 //}
 //
-OcclusionCullingCallback::OcclusionCullingCallback(GeoTransform* xform) :
+OcclusionCullingCallback::OcclusionCullingCallback(GeoTransform* xform, const Map* map) :
 _xform      ( xform ),
 _visible    ( true ),
 _maxAltitude( 200000 )
 {
-    //nop
+    _service = OcclusionCullingService::get( map );
+    if ( _service.valid() )
+        _entry = new OcclusionCullingService::Entry();
 }
 
 double OcclusionCullingCallback::getMaxFrameTime()
@@ -619,9 +621,69 @@ void OcclusionCullingCallback::setMaxAltitude( double maxAltitude )
     _maxAltitude = maxAltitude;    
 }
 
+namespace
+{
+    // asks the view for another frame, so results still to come get drawn.
+    void requestRedraw(osgUtil::CullVisitor* cv)
+    {
+        if ( cv->getCurrentCamera() && cv->getCurrentCamera()->getView() )
+        {
+            osgGA::GUIActionAdapter* aa = dynamic_cast<osgGA::GUIActionAdapter*>(cv->getCurrentCamera()->getView());
+            if ( aa )
+            {
+                aa->requestRedraw();
+            }
+        }
+    }
+}
+
 void OcclusionCullingCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
 {
-    if (nv->getVisitorType() == osg::NodeVisitor::CULL_VISITOR)
+    if (nv->getVisitorType() == osg::NodeVisitor::CULL_VISITOR && _service.valid())
+    {
+        osgUtil::CullVisitor* cv = Culling::asCullVisitor(nv);
+
+        // start testing whatever was submitted last frame:
+        _service->dispatch( nv->getFrameStamp()->getFrameNumber() );
+
+        osg::ref_ptr<GeoTransform> geo;
+        if ( _xform.lock(geo) )
+        {
+            osg::Vec3d eye = cv->getViewPoint();
+            double alt = eye.z();
+
+            osg::ref_ptr<Terrain> terrain = geo->getTerrain();
+            if ( terrain.valid() && !terrain->getSRS()->isProjected() )
+            {
+                osgEarth::GeoPoint mapPoint;
+                mapPoint.fromWorld( terrain->getSRS(), eye );
+                alt = mapPoint.z();
+            }
+
+            if ( alt <= _maxAltitude )
+            {
+                osg::Vec3d target = osg::Vec3d(0,0,0) * geo->getMatrix();
+                _service->submit( _entry.get(), eye, target );
+                _visible = _entry->isVisible();
+
+                if ( _entry->isPending() )
+                {
+                    requestRedraw( cv );
+                }
+            }
+            else
+            {
+                _visible = true;
+            }
+        }
+
+        if (_visible)
+        {
+            traverse(node, nv );
+        }
+    }
+
+    else if (nv->getVisitorType() == osg::NodeVisitor::CULL_VISITOR)
     {        
         osgUtil::CullVisitor* cv = Culling::asCullVisitor(nv);
 
@@ -702,14 +764,7 @@ void OcclusionCullingCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
             {
                 numSkipped++;
                 // if we skipped some we need to request a redraw so the remianing ones get processed on the next frame.
-                if ( cv->getCurrentCamera() && cv->getCurrentCamera()->getView() )
-                {
-                    osgGA::GUIActionAdapter* aa = dynamic_cast<osgGA::GUIActionAdapter*>(cv->getCurrentCamera()->getView());
-                    if ( aa )
-                    {
-                        aa->requestRedraw();
-                    }
-                }
+                requestRedraw( cv );
             }
         }
 
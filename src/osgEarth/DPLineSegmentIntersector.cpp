@@ -325,7 +325,24 @@ void intersectWithQuadTree(osgUtil::IntersectionVisitor& iv, osg::Drawable* draw
 {
     QuadTree::LineSegmentIntersections intersections;
     intersections.reserve(4);
-    if (quadTree->intersect(s,e,intersections))
+
+    // when only one hit per drawable counts, let the tree stop at the nearest.
+    bool found = false;
+    if (intersector.getIntersectionLimit() == osgUtil::Intersector::LIMIT_ONE_PER_DRAWABLE ||
+        intersector.getIntersectionLimit() == osgUtil::Intersector::LIMIT_ONE ||
+        intersector.getIntersectionLimit() == osgUtil::Intersector::LIMIT_NEAREST)
+    {
+        QuadTree::LineSegmentIntersection nearest;
+        found = quadTree->intersectNearest(s, e, nearest);
+        if (found)
+            intersections.push_back(nearest);
+    }
+    else
+    {
+        found = quadTree->intersect(s, e, intersections);
+    }
+
+    if (found)
     {
         // OSG_NOTICE<<"Got QuadTree intersections"<<std::endl;
         for(QuadTree::LineSegmentIntersections::iterator itr = intersections.begin();
@@ -0,0 +1,656 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/DataExtentIndex>
+#include <osgEarth/TileKey>
+#include <osgEarth/Notify>
+#include <sstream>
+
+#define LC "[DataExtentIndex] "
+
+using namespace osgEarth;
+
+// Highest LOD representable in a mask; the last bit also covers everything above it.
+#define MAX_MASK_LOD 63u
+
+namespace
+{
+    bool intersects(double xmin, double ymin, double xmax, double ymax, const Bounds& b)
+    {
+        // exclusive, to match GeoExtent::intersects
+        return !(xmin >= b.xMax() || xmax <= b.xMin() || ymin >= b.yMax() || ymax <= b.yMin());
+    }
+
+    bool contains(const Bounds& b, double xmin, double ymin, double xmax, double ymax)
+    {
+        return b.xMin() <= xmin && xmax <= b.xMax() && b.yMin() <= ymin && ymax <= b.yMax();
+    }
+
+    // FNV-1a, used to fingerprint the extents an index was built from.
+    void hash(unsigned long long& h, const void* data, unsigned len)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for(unsigned i=0; i<len; ++i)
+        {
+            h ^= bytes[i];
+            h *= 1099511628211ULL;
+        }
+    }
+
+    // Bounds of an extent, split in two if it crosses the antimeridian.
+    void getBoundsList(const GeoExtent& extent, std::vector<Bounds>& output)
+    {
+        if ( extent.crossesAntimeridian() )
+        {
+            GeoExtent west, east;
+            if ( extent.splitAcrossAntimeridian(west, east) )
+            {
+                output.push_back( west.bounds() );
+                output.push_back( east.bounds() );
+                return;
+            }
+        }
+        output.push_back( extent.bounds() );
+    }
+}
+
+//------------------------------------------------------------------------
+
+DataExtentIndex::Node::Node() :
+_fullLODs    ( 0ULL ),
+_partialLODs ( 0ULL ),
+_fullMaxLevel( -1 )
+{
+    _children[0] = _children[1] = _children[2] = _children[3] = -1;
+}
+
+//------------------------------------------------------------------------
+
+DataExtentIndex::DataExtentIndex(const Profile* profile, unsigned maxDepth) :
+_profile  ( profile ),
+_maxDepth ( osg::minimum(maxDepth, 24u) ),
+_tilesWide( 0u ),
+_tilesHigh( 0u ),
+_checksum ( 0ULL ),
+_valid    ( false )
+{
+    init();
+}
+
+void
+DataExtentIndex::init()
+{
+    if ( _profile.valid() )
+    {
+        _profile->getNumTiles(0, _tilesWide, _tilesHigh);
+        _xmin   = _profile->getExtent().xMin();
+        _ymax   = _profile->getExtent().yMax();
+        _width  = _profile->getExtent().width();
+        _height = _profile->getExtent().height();
+
+        // tile sizes per LOD, computed exactly like Profile::getTileDimensions
+        _tileWidths.resize(32);
+        _tileHeights.resize(32);
+        for(unsigned lod=0; lod<32; ++lod)
+            _profile->getTileDimensions(lod, _tileWidths[lod], _tileHeights[lod]);
+    }
+}
+
+DataExtentIndex::LODMask
+DataExtentIndex::bit(unsigned lod)
+{
+    return 1ULL << osg::minimum(lod, MAX_MASK_LOD);
+}
+
+DataExtentIndex::LODMask
+DataExtentIndex::makeMask(const optional<unsigned>& minLevel, const optional<unsigned>& maxLevel)
+{
+    unsigned lo = minLevel.isSet() ? osg::minimum(minLevel.get(), MAX_MASK_LOD) : 0u;
+    unsigned hi = maxLevel.isSet() ? osg::minimum(maxLevel.get(), MAX_MASK_LOD) : MAX_MASK_LOD;
+    if ( lo > hi )
+        return 0ULL;
+
+    LODMask upper = hi == MAX_MASK_LOD ? ~0ULL : ((1ULL << (hi+1)) - 1ULL);
+    LODMask lower = (1ULL << lo) - 1ULL;
+    return upper & ~lower;
+}
+
+void
+DataExtentIndex::tileBounds(unsigned lod, unsigned x, unsigned y,
+                            double& xmin, double& ymin, double& xmax, double& ymax) const
+{
+    // same math as Profile::calculateExtent, so edges line up exactly with TileKey extents.
+    double w = _tileWidths[lod], h = _tileHeights[lod];
+    xmin = _xmin + w * (double)x;
+    ymax = _ymax - h * (double)y;
+    xmax = xmin + w;
+    ymin = ymax - h;
+}
+
+void
+DataExtentIndex::createEntries(const DataExtentList& dataExtents)
+{
+    _extents.clear();
+    _nodes.clear();
+    _roots.assign(_tilesWide * _tilesHigh, -1);
+    _checksum = 14695981039346656037ULL;
+
+    const SpatialReference* srs = _profile->getSRS();
+
+    for(unsigned i=0; i<dataExtents.size(); ++i)
+    {
+        const DataExtent& de = dataExtents[i];
+
+        double bounds[4] = { de.xMin(), de.yMin(), de.xMax(), de.yMax() };
+        int    levels[2] = { de.minLevel().isSet() ? (int)de.minLevel().get() : -1,
+                             de.maxLevel().isSet() ? (int)de.maxLevel().get() : -1 };
+        hash(_checksum, bounds, sizeof(bounds));
+        hash(_checksum, levels, sizeof(levels));
+        if ( de.getSRS() )
+        {
+            const std::string& init = de.getSRS()->getHorizInitString();
+            hash(_checksum, init.c_str(), init.length());
+        }
+
+        // Transform each extent into the index profile once, up front,
+        // instead of on every query.
+        Entry entry;
+        entry._extent     = srs->isHorizEquivalentTo(de.getSRS()) ? GeoExtent(de) : de.transform(srs);
+        entry._lods       = makeMask(de.minLevel(), de.maxLevel());
+        entry._maxLevel   = de.maxLevel().isSet() ? (int)de.maxLevel().get() : -1;
+        entry._dataExtent = i;
+
+        // an extent that cannot be expressed in the profile cannot intersect any key.
+        if ( entry._extent.isValid() )
+            _extents.push_back( entry );
+    }
+}
+
+void
+DataExtentIndex::build(const DataExtentList& dataExtents)
+{
+    _valid = false;
+
+    if ( !_profile.valid() )
+        return;
+
+    createEntries( dataExtents );
+
+    for(unsigned e=0; e<_extents.size(); ++e)
+    {
+        std::vector<Bounds> boundsList;
+        getBoundsList( _extents[e]._extent, boundsList );
+
+        for(std::vector<Bounds>::const_iterator b = boundsList.begin(); b != boundsList.end(); ++b)
+        {
+            for(unsigned ty=0; ty<_tilesHigh; ++ty)
+            {
+                for(unsigned tx=0; tx<_tilesWide; ++tx)
+                {
+                    double xmin, ymin, xmax, ymax;
+                    tileBounds(0, tx, ty, xmin, ymin, xmax, ymax);
+                    if ( intersects(xmin, ymin, xmax, ymax, *b) )
+                    {
+                        if ( _roots[ty*_tilesWide + tx] < 0 )
+                        {
+                            _roots[ty*_tilesWide + tx] = _nodes.size();
+                            _nodes.push_back( Node() );
+                        }
+                        insert( _roots[ty*_tilesWide + tx], 0, tx, ty, e, *b );
+                    }
+                }
+            }
+        }
+    }
+
+    _valid = true;
+
+    OE_DEBUG << LC << "Indexed " << _extents.size() << " extents in "
+        << _nodes.size() << " nodes" << std::endl;
+}
+
+void
+DataExtentIndex::insert(int n, unsigned lod, unsigned x, unsigned y, unsigned e, const Bounds& b)
+{
+    const Entry& entry = _extents[e];
+
+    double xmin, ymin, xmax, ymax;
+    tileBounds(lod, x, y, xmin, ymin, xmax, ymax);
+
+    _nodes[n]._partialLODs |= entry._lods;
+
+    // extent covers the entire tile; all descendants inherit it.
+    if ( contains(b, xmin, ymin, xmax, ymax) )
+    {
+        _nodes[n]._fullLODs |= entry._lods;
+        _nodes[n]._fullMaxLevel = osg::maximum(_nodes[n]._fullMaxLevel, entry._maxLevel);
+        return;
+    }
+
+    // no point in descending past the extent's max level, or the index's max depth.
+    // Keep the extent here for exact testing.
+    if ( lod >= _maxDepth || (entry._maxLevel >= 0 && lod >= (unsigned)entry._maxLevel) )
+    {
+        _nodes[n]._extents.push_back( e );
+        return;
+    }
+
+    for(unsigned i=0; i<4; ++i)
+    {
+        unsigned cx = x*2 + (i & 1);
+        unsigned cy = y*2 + (i >> 1);
+        tileBounds(lod+1, cx, cy, xmin, ymin, xmax, ymax);
+        if ( intersects(xmin, ymin, xmax, ymax, b) )
+        {
+            int c = _nodes[n]._children[i];
+            if ( c < 0 )
+            {
+                c = _nodes.size();
+                _nodes.push_back( Node() ); // invalidates references into _nodes
+                _nodes[n]._children[i] = c;
+            }
+            insert( c, lod+1, cx, cy, e, b );
+        }
+    }
+}
+
+bool
+DataExtentIndex::query(unsigned lod, unsigned x, unsigned y, LODMask mask, const GeoExtent* keyExtent) const
+{
+    if ( !_valid || mask == 0ULL || lod > 31u )
+        return false;
+
+    unsigned rx = x >> lod, ry = y >> lod;
+    if ( rx >= _tilesWide || ry >= _tilesHigh )
+        return false;
+
+    GeoExtent tileExtent;
+    LODMask   full = 0ULL;
+    int       n    = _roots[ry*_tilesWide + rx];
+
+    for(unsigned level = 0; n >= 0; ++level)
+    {
+        const Node& node = _nodes[n];
+
+        // nothing under this node has data at the requested LOD(s).
+        if ( (node._partialLODs & mask) == 0ULL )
+            return (full & mask) != 0ULL;
+
+        full |= node._fullLODs;
+        if ( (full & mask) != 0ULL )
+            return true;
+
+        // reached the queried tile:
+        if ( level == lod )
+            return true;
+
+        // extents that stopped descending at this node get an exact test:
+        if ( !node._extents.empty() )
+        {
+            if ( !keyExtent )
+            {
+                double xmin, ymin, xmax, ymax;
+                tileBounds(lod, x, y, xmin, ymin, xmax, ymax);
+                tileExtent = GeoExtent(_profile->getSRS(), xmin, ymin, xmax, ymax);
+                keyExtent = &tileExtent;
+            }
+
+            for(std::vector<unsigned>::const_iterator e = node._extents.begin(); e != node._extents.end(); ++e)
+            {
+                const Entry& entry = _extents[*e];
+                if ( (entry._lods & mask) != 0ULL && entry._extent.intersects(*keyExtent, false) )
+                    return true;
+            }
+        }
+
+        unsigned shift = lod - level - 1;
+        unsigned child = (((y >> shift) & 1u) << 1) | ((x >> shift) & 1u);
+        n = node._children[child];
+    }
+
+    return (full & mask) != 0ULL;
+}
+
+bool
+DataExtentIndex::hasData(unsigned lod, unsigned x, unsigned y) const
+{
+    return query(lod, x, y, bit(lod), 0L);
+}
+
+bool
+DataExtentIndex::hasData(const TileKey& key) const
+{
+    if ( !key.valid() )
+        return false;
+
+    return query(key.getLOD(), key.getTileX(), key.getTileY(), bit(key.getLOD()), &key.getExtent());
+}
+
+bool
+DataExtentIndex::hasDataForFallback(const TileKey& key) const
+{
+    if ( !key.valid() )
+        return false;
+
+    // any extent whose minLevel is <= the key LOD:
+    unsigned lod = key.getLOD();
+    LODMask mask = lod >= MAX_MASK_LOD ? ~0ULL : ((1ULL << (lod+1)) - 1ULL);
+
+    return query(lod, key.getTileX(), key.getTileY(), mask, &key.getExtent());
+}
+
+bool
+DataExtentIndex::hasDataInExtent(const GeoExtent& input) const
+{
+    if ( !_valid || !input.isValid() )
+        return false;
+
+    const SpatialReference* srs = _profile->getSRS();
+    GeoExtent extent = srs->isHorizEquivalentTo(input.getSRS()) ? input : input.transform(srs);
+    if ( !extent.isValid() )
+        return false;
+
+    std::vector<Bounds> boundsList;
+    getBoundsList( extent, boundsList );
+
+    for(std::vector<Bounds>::const_iterator b = boundsList.begin(); b != boundsList.end(); ++b)
+    {
+        for(unsigned ty=0; ty<_tilesHigh; ++ty)
+        {
+            for(unsigned tx=0; tx<_tilesWide; ++tx)
+            {
+                int root = _roots[ty*_tilesWide + tx];
+                if ( root >= 0 )
+                {
+                    double xmin, ymin, xmax, ymax;
+                    tileBounds(0, tx, ty, xmin, ymin, xmax, ymax);
+                    if ( intersects(xmin, ymin, xmax, ymax, *b) && queryExtent(root, 0, tx, ty, *b, extent) )
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool
+DataExtentIndex::queryExtent(int n, unsigned lod, unsigned x, unsigned y, const Bounds& b, const GeoExtent& extent) const
+{
+    const Node& node = _nodes[n];
+
+    // an extent covers this whole tile, which intersects the query.
+    if ( node._fullLODs != 0ULL )
+        return true;
+
+    double xmin, ymin, xmax, ymax;
+    tileBounds(lod, x, y, xmin, ymin, xmax, ymax);
+
+    // the query covers this whole tile, which some extent intersects.
+    if ( node._partialLODs != 0ULL && contains(b, xmin, ymin, xmax, ymax) )
+        return true;
+
+    for(std::vector<unsigned>::const_iterator e = node._extents.begin(); e != node._extents.end(); ++e)
+    {
+        if ( _extents[*e]._extent.intersects(extent, false) )
+            return true;
+    }
+
+    for(unsigned i=0; i<4; ++i)
+    {
+        int c = node._children[i];
+        if ( c >= 0 )
+        {
+            unsigned cx = x*2 + (i & 1);
+            unsigned cy = y*2 + (i >> 1);
+            tileBounds(lod+1, cx, cy, xmin, ymin, xmax, ymax);
+            if ( intersects(xmin, ymin, xmax, ymax, b) && queryExtent(c, lod+1, cx, cy, b, extent) )
+                return true;
+        }
+    }
+
+    return false;
+}
+
+int
+DataExtentIndex::getMaxLevel(double x, double y) const
+{
+    int result = -1;
+
+    unsigned tx, ty;
+    int n = findNode(x, y, _maxDepth, tx, ty);
+
+    for(unsigned level = 0; n >= 0; ++level)
+    {
+        const Node& node = _nodes[n];
+
+        result = osg::maximum(result, node._fullMaxLevel);
+
+        for(std::vector<unsigned>::const_iterator e = node._extents.begin(); e != node._extents.end(); ++e)
+        {
+            const Entry& entry = _extents[*e];
+            if ( entry._maxLevel > result && entry._extent.contains(x, y) )
+                result = entry._maxLevel;
+        }
+
+        if ( level == _maxDepth )
+            break;
+
+        unsigned shift = _maxDepth - level - 1;
+        unsigned child = (((ty >> shift) & 1u) << 1) | ((tx >> shift) & 1u);
+        n = node._children[child];
+    }
+
+    return result;
+}
+
+bool
+DataExtentIndex::hasDataAt(double x, double y) const
+{
+    unsigned tx, ty;
+    int n = findNode(x, y, _maxDepth, tx, ty);
+
+    for(unsigned level = 0; n >= 0; ++level)
+    {
+        const Node& node = _nodes[n];
+
+        if ( node._fullLODs != 0ULL )
+            return true;
+
+        for(std::vector<unsigned>::const_iterator e = node._extents.begin(); e != node._extents.end(); ++e)
+        {
+            if ( _extents[*e]._extent.contains(x, y) )
+                return true;
+        }
+
+        if ( level == _maxDepth )
+            break;
+
+        unsigned shift = _maxDepth - level - 1;
+        unsigned child = (((ty >> shift) & 1u) << 1) | ((tx >> shift) & 1u);
+        n = node._children[child];
+    }
+
+    return false;
+}
+
+int
+DataExtentIndex::findNode(double x, double y, unsigned lod, unsigned& tx, unsigned& ty) const
+{
+    // Locates the tile containing (x,y) at the given LOD, and returns
+    // the root node on its path (or -1 if there is none).
+    if ( !_valid || _width <= 0.0 || _height <= 0.0 )
+        return -1;
+
+    if ( _profile->getSRS()->isGeographic() )
+        x = _profile->getExtent().normalizeLongitude(x);
+
+    double rx = (x - _xmin) / _width;
+    double ry = (_ymax - y) / _height;
+    if ( rx < 0.0 || rx > 1.0 || ry < 0.0 || ry > 1.0 )
+        return -1;
+
+    unsigned tilesX = _tilesWide << lod;
+    unsigned tilesY = _tilesHigh << lod;
+    tx = osg::minimum( (unsigned)(rx * (double)tilesX), tilesX-1 );
+    ty = osg::minimum( (unsigned)(ry * (double)tilesY), tilesY-1 );
+
+    return _roots[(ty >> lod)*_tilesWide + (tx >> lod)];
+}
+
+//------------------------------------------------------------------------
+
+Config
+DataExtentIndex::getConfig() const
+{
+    Config conf("data_extent_index");
+    if ( !_valid )
+        return conf;
+
+    conf.set("max_depth", _maxDepth);
+    conf.set("num_extents", _extents.size());
+    conf.set("checksum", _checksum);
+    conf.addObj("profile", _profile->toProfileOptions());
+
+    std::stringstream buf;
+    for(std::vector<int>::const_iterator root = _roots.begin(); root != _roots.end(); ++root)
+    {
+        if ( *root < 0 )
+            buf << "- ";
+        else
+            writeNode(*root, buf);
+    }
+    conf.set("nodes", buf.str());
+
+    return conf;
+}
+
+void
+DataExtentIndex::writeNode(int n, std::ostream& out) const
+{
+    const Node& node = _nodes[n];
+
+    unsigned childMask = 0u;
+    for(unsigned i=0; i<4; ++i)
+        if ( node._children[i] >= 0 )
+            childMask |= (1u << i);
+
+    out << childMask << ' '
+        << node._fullLODs << ' '
+        << node._partialLODs << ' '
+        << node._fullMaxLevel << ' '
+        << node._extents.size() << ' ';
+
+    for(std::vector<unsigned>::const_iterator e = node._extents.begin(); e != node._extents.end(); ++e)
+        out << *e << ' ';
+
+    for(unsigned i=0; i<4; ++i)
+        if ( node._children[i] >= 0 )
+            writeNode(node._children[i], out);
+}
+
+int
+DataExtentIndex::readNode(std::istream& in, unsigned depth)
+{
+    if ( depth > _maxDepth )
+        return -1;
+
+    unsigned childMask, numExtents;
+    Node node;
+    in >> childMask >> node._fullLODs >> node._partialLODs >> node._fullMaxLevel >> numExtents;
+    if ( in.fail() || numExtents > _extents.size() )
+        return -1;
+
+    node._extents.resize(numExtents);
+    for(unsigned i=0; i<numExtents; ++i)
+    {
+        in >> node._extents[i];
+        if ( in.fail() || node._extents[i] >= _extents.size() )
+            return -1;
+    }
+
+    int n = _nodes.size();
+    _nodes.push_back( node );
+
+    for(unsigned i=0; i<4; ++i)
+    {
+        if ( childMask & (1u << i) )
+        {
+            int c = readNode(in, depth+1);
+            if ( c < 0 )
+                return -1;
+            _nodes[n]._children[i] = c;
+        }
+    }
+    return n;
+}
+
+bool
+DataExtentIndex::fromConfig(const Config& conf, const DataExtentList& dataExtents)
+{
+    _valid = false;
+
+    if ( !_profile.valid() || !conf.hasValue("nodes") )
+        return false;
+
+    // the index must have been built in the same tiling scheme:
+    optional<ProfileOptions> profileOptions;
+    conf.getObjIfSet("profile", profileOptions);
+    if ( !profileOptions.isSet() )
+        return false;
+
+    osg::ref_ptr<const Profile> profile = Profile::create( profileOptions.get() );
+    if ( !profile.valid() || !profile->isHorizEquivalentTo(_profile.get()) )
+        return false;
+
+    _maxDepth = osg::minimum(conf.value("max_depth", _maxDepth), 24u);
+
+    // Recreate the entries (which is cheap) and read the tree.
+    createEntries( dataExtents );
+
+    if ( conf.value("num_extents", 0u) != _extents.size() ||
+         conf.value("checksum", 0ULL) != _checksum )
+    {
+        _extents.clear();
+        return false;
+    }
+
+    std::istringstream in( conf.value("nodes") );
+    for(unsigned i=0; i<_roots.size(); ++i)
+    {
+        std::string token;
+        in >> std::ws;
+        if ( in.peek() == '-' )
+        {
+            in >> token;
+        }
+        else
+        {
+            _roots[i] = readNode(in, 0u);
+            if ( _roots[i] < 0 )
+            {
+                OE_WARN << LC << "Serialized index is corrupt" << std::endl;
+                _extents.clear();
+                _nodes.clear();
+                return false;
+            }
+        }
+    }
+
+    _valid = true;
+    return true;
+}
@@ -20,10 +20,19 @@
 #include <osgEarth/ECEF>
 #include <osgEarth/Notify>
 
+// the bulk kernels work two points at a time where SSE2 is available.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define OE_ECEF_SSE2 1
+#  include <emmintrin.h>
+#endif
+
 using namespace osgEarth;
 
 #define LC "[ECEF] "
 
+// number of points the vector versions convert at a time
+#define BLOCK_SIZE 256u
+
 // --------------------------------------------------------------------------
 
 osg::Matrixd
@@ -90,12 +99,13 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
     const SpatialReference* ecefSRS = outputSRS->getECEF();
     output->reserve( output->size() + input.size() );
 
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
+    // transform all the points in one call:
+    std::vector<osg::Vec3d> ecef( input );
+    inputSRS->transform( ecef, ecefSRS );
+
+    for( std::vector<osg::Vec3d>::const_iterator i = ecef.begin(); i != ecef.end(); ++i )
     {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        //inputSRS->transformToECEF( *i, ecef );
-        output->push_back( ecef * world2local );
+        output->push_back( (*i) * world2local );
     }
 }
 
@@ -110,12 +120,14 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
 {
     const SpatialReference* ecefSRS = outputSRS->getECEF();
     out_verts->reserve( out_verts->size() + input.size() );
-    
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
+
+    // transform all the points in one call:
+    std::vector<osg::Vec3d> ecef( input );
+    inputSRS->transform( ecef, ecefSRS );
+
+    for( std::vector<osg::Vec3d>::const_iterator i = ecef.begin(); i != ecef.end(); ++i )
     {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        out_verts->push_back( ecef * world2local );
+        out_verts->push_back( (*i) * world2local );
     }
 
     if ( out_normals )
@@ -178,3 +190,338 @@ ECEF::transformAndGetRotationMatrix(const osg::Vec3d&       input,
     // then convert that to ECEF.
     geoSRS->transform(geoPoint, ecefSRS, out_point);
 }
+
+//------------------------------------------------------------------------
+
+#ifdef OE_ECEF_SSE2
+
+namespace
+{
+    // Two-lane double helpers for the bulk kernels. The polynomials are the
+    // Cephes ones (S. Moshier), good to about one ulp over their ranges, so the
+    // vector path agrees with the scalar one to well under a millimeter.
+
+    inline __m128d blend(__m128d mask, __m128d a, __m128d b)
+    {
+        return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    }
+
+    // Sine and cosine of angles in degrees. Reducing by multiples of 90 degrees
+    // is exact, which keeps the full precision for large longitudes.
+    inline void sinCosDegrees(__m128d deg, __m128d& out_sin, __m128d& out_cos)
+    {
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+
+        __m128i k  = _mm_cvtpd_epi32(_mm_mul_pd(deg, _mm_set1_pd(1.0/90.0)));
+        __m128d r  = _mm_mul_pd(
+            _mm_sub_pd(deg, _mm_mul_pd(_mm_cvtepi32_pd(k), _mm_set1_pd(90.0))),
+            _mm_set1_pd(osg::PI/180.0));
+        __m128d z  = _mm_mul_pd(r, r);
+
+        __m128d sp = _mm_set1_pd(1.58962301576546568060E-10);
+        sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(-2.50507477628578072866E-8));
+        sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd( 2.75573136213857245213E-6));
+        sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(-1.98412698295895385996E-4));
+        sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd( 8.33333333332211858878E-3));
+        sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(-1.66666666666666307295E-1));
+        __m128d s  = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), sp));
+
+        __m128d cp = _mm_set1_pd(-1.13585365213876817300E-11);
+        cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd( 2.08757008419747316778E-9));
+        cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(-2.75573141792967388112E-7));
+        cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd( 2.48015872888517045348E-5));
+        cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(-1.38888888888730564116E-3));
+        cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd( 4.16666666666665929218E-2));
+        __m128d c  = _mm_add_pd(
+            _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), z)),
+            _mm_mul_pd(_mm_mul_pd(z, z), cp));
+
+        // quadrant k (mod 4): odd quadrants swap sin and cos, and bit 1 of k
+        // (of k+1 for the cosine) flips the sign.
+        __m128i k64     = _mm_shuffle_epi32(k, _MM_SHUFFLE(1,1,0,0));
+        __m128d swap    = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(k64, one), one));
+        __m128d sinSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(k64, two), 62));
+        __m128d cosSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(_mm_add_epi32(k64, one), two), 62));
+
+        out_sin = _mm_xor_pd(blend(swap, c, s), sinSign);
+        out_cos = _mm_xor_pd(blend(swap, s, c), cosSign);
+    }
+
+    // Cube root of a >= 1: a quadratic guess on the mantissa, scaled by the
+    // exponent, then two Halley steps.
+    inline __m128d cbrtAtLeastOne(__m128d a)
+    {
+        const __m128i bits = _mm_castpd_si128(a);
+
+        __m128d m = _mm_castsi128_pd(_mm_or_si128(
+            _mm_and_si128(bits, _mm_set_epi32(0x000FFFFF, 0xFFFFFFFF, 0x000FFFFF, 0xFFFFFFFF)),
+            _mm_set_epi32(0x3FF00000, 0, 0x3FF00000, 0)));
+
+        __m128i be = _mm_shuffle_epi32(_mm_srli_epi64(bits, 52), _MM_SHUFFLE(3,3,2,0));
+        __m128d e  = _mm_sub_pd(_mm_cvtepi32_pd(be), _mm_set1_pd(1023.0));
+        __m128i k  = _mm_cvttpd_epi32(_mm_div_pd(e, _mm_set1_pd(3.0)));
+        __m128d rem = _mm_sub_pd(e, _mm_mul_pd(_mm_cvtepi32_pd(k), _mm_set1_pd(3.0)));
+
+        __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(
+            _mm_unpacklo_epi32(_mm_add_epi32(k, _mm_set1_epi32(1023)), _mm_setzero_si128()), 52));
+
+        __m128d remFactor = _mm_add_pd(_mm_set1_pd(1.0), _mm_add_pd(
+            _mm_and_pd(_mm_cmpge_pd(rem, _mm_set1_pd(1.0)), _mm_set1_pd(1.25992104989487316477 - 1.0)),
+            _mm_and_pd(_mm_cmpge_pd(rem, _mm_set1_pd(2.0)), _mm_set1_pd(1.58740105196819947475 - 1.25992104989487316477))));
+
+        __m128d y = _mm_set1_pd(-0.05836172077613502);
+        y = _mm_add_pd(_mm_mul_pd(y, m), _mm_set1_pd(0.43356059182366014));
+        y = _mm_add_pd(_mm_mul_pd(y, m), _mm_set1_pd(0.6256872265641454));
+        y = _mm_mul_pd(_mm_mul_pd(y, remFactor), scale);
+
+        for(int i=0; i<2; ++i)
+        {
+            __m128d y3 = _mm_mul_pd(_mm_mul_pd(y, y), y);
+            y = _mm_mul_pd(y, _mm_div_pd(
+                _mm_add_pd(y3, _mm_add_pd(a, a)),
+                _mm_add_pd(_mm_add_pd(y3, y3), a)));
+        }
+        return y;
+    }
+
+    // atan2(y, x) in radians, reduced to atan over [0, 1] by octant.
+    inline __m128d atan2Radians(__m128d y, __m128d x)
+    {
+        const __m128d signBit = _mm_set1_pd(-0.0);
+        const __m128d zero    = _mm_setzero_pd();
+
+        __m128d ax = _mm_andnot_pd(signBit, x);
+        __m128d ay = _mm_andnot_pd(signBit, y);
+        __m128d hi = _mm_max_pd(ax, ay);
+        __m128d lo = _mm_min_pd(ax, ay);
+        __m128d t  = _mm_and_pd(_mm_cmpneq_pd(hi, zero), _mm_div_pd(lo, hi));
+
+        // above 0.66, use atan(t) = pi/4 + atan((t-1)/(t+1))
+        __m128d big  = _mm_cmpgt_pd(t, _mm_set1_pd(0.66));
+        __m128d base = _mm_and_pd(big, _mm_set1_pd(osg::PI_4));
+        __m128d more = _mm_and_pd(big, _mm_set1_pd(0.5 * 6.123233995736765886130E-17));
+        t = blend(big,
+            _mm_div_pd(_mm_sub_pd(t, _mm_set1_pd(1.0)), _mm_add_pd(t, _mm_set1_pd(1.0))),
+            t);
+
+        __m128d z = _mm_mul_pd(t, t);
+        __m128d p = _mm_set1_pd(-8.750608600031904122785E-1);
+        p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(-1.615753718733365076637E1));
+        p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(-7.500855792314704667340E1));
+        p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(-1.228866684490136173410E2));
+        p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(-6.485021904942025371773E1));
+        __m128d q = _mm_add_pd(z, _mm_set1_pd(2.485846490142306297962E1));
+        q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(1.650270098316988542046E2));
+        q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(4.328810604912902668951E2));
+        q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(4.853903996359136964868E2));
+        q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(1.945506571482613964425E2));
+
+        __m128d r = _mm_add_pd(t, _mm_mul_pd(_mm_mul_pd(t, z), _mm_div_pd(p, q)));
+        r = _mm_add_pd(base, _mm_add_pd(r, more));
+
+        // back out to the full circle:
+        r = blend(_mm_cmpgt_pd(ay, ax), _mm_sub_pd(_mm_set1_pd(osg::PI_2), r), r);
+        r = blend(_mm_cmplt_pd(x, zero), _mm_sub_pd(_mm_set1_pd(osg::PI), r), r);
+        return _mm_or_pd(r, _mm_and_pd(signBit, y));
+    }
+}
+
+#endif // OE_ECEF_SSE2
+
+void
+ECEF::geodeticToECEF(const osg::EllipsoidModel* em,
+                     unsigned                   count,
+                     const double* lon, const double* lat, const double* height,
+                     double* x, double* y, double* z)
+{
+    const double a  = em->getRadiusEquator();
+    const double b  = em->getRadiusPolar();
+    const double e2 = (a*a - b*b) / (a*a);
+    const double deg2rad = osg::PI / 180.0;
+
+    unsigned i = 0;
+
+#ifdef OE_ECEF_SSE2
+    const __m128d va  = _mm_set1_pd(a);
+    const __m128d ve2 = _mm_set1_pd(e2);
+    const __m128d one = _mm_set1_pd(1.0);
+
+    for(; i+2 <= count; i += 2)
+    {
+        __m128d sinPhi, cosPhi, sinLambda, cosLambda;
+        sinCosDegrees(_mm_loadu_pd(lat+i), sinPhi, cosPhi);
+        sinCosDegrees(_mm_loadu_pd(lon+i), sinLambda, cosLambda);
+
+        __m128d h = _mm_loadu_pd(height+i);
+        __m128d N = _mm_div_pd(va, _mm_sqrt_pd(_mm_sub_pd(one, _mm_mul_pd(ve2, _mm_mul_pd(sinPhi, sinPhi)))));
+        __m128d r = _mm_mul_pd(_mm_add_pd(N, h), cosPhi);
+        _mm_storeu_pd(x+i, _mm_mul_pd(r, cosLambda));
+        _mm_storeu_pd(y+i, _mm_mul_pd(r, sinLambda));
+        _mm_storeu_pd(z+i, _mm_mul_pd(_mm_add_pd(_mm_mul_pd(N, _mm_sub_pd(one, ve2)), h), sinPhi));
+    }
+#endif
+
+    // scalar path, for the odd point out or when there is no SSE2:
+    for(; i<count; ++i)
+    {
+        double phi    = lat[i] * deg2rad;
+        double lambda = lon[i] * deg2rad;
+        double sinPhi = sin(phi);
+        double cosPhi = cos(phi);
+        double N      = a / sqrt(1.0 - e2*sinPhi*sinPhi);
+        double r      = (N + height[i]) * cosPhi;
+        x[i] = r * cos(lambda);
+        y[i] = r * sin(lambda);
+        z[i] = (N*(1.0 - e2) + height[i]) * sinPhi;
+    }
+}
+
+void
+ECEF::ECEFToGeodetic(const osg::EllipsoidModel* em,
+                     unsigned                   count,
+                     const double* x, const double* y, const double* z,
+                     double* lon, double* lat, double* height)
+{
+    const double a  = em->getRadiusEquator();
+    const double b  = em->getRadiusPolar();
+    const double e2 = (a*a - b*b) / (a*a);
+    const double e4 = e2*e2;
+    const double invA2 = 1.0 / (a*a);
+    const double rad2deg = 180.0 / osg::PI;
+
+    // Vermeille, H. "Direct transformation from geocentric coordinates to
+    // geodetic coordinates." Journal of Geodesy 76 (2002).
+    // Inside the evolute (r <= 0) the results are garbage; the second loop
+    // below replaces them.
+    unsigned i = 0;
+
+#ifdef OE_ECEF_SSE2
+    const __m128d one    = _mm_set1_pd(1.0);
+    const __m128d two    = _mm_set1_pd(2.0);
+    const __m128d ve2    = _mm_set1_pd(e2);
+    const __m128d ve4    = _mm_set1_pd(e4);
+    const __m128d vinvA2 = _mm_set1_pd(invA2);
+    const __m128d toDeg  = _mm_set1_pd(rad2deg);
+
+    for(; i+2 <= count; i += 2)
+    {
+        __m128d xi = _mm_loadu_pd(x+i), yi = _mm_loadu_pd(y+i), zi = _mm_loadu_pd(z+i);
+
+        __m128d rho2 = _mm_add_pd(_mm_mul_pd(xi, xi), _mm_mul_pd(yi, yi));
+        __m128d p    = _mm_mul_pd(rho2, vinvA2);
+        __m128d q    = _mm_mul_pd(_mm_mul_pd(_mm_sub_pd(one, ve2), _mm_mul_pd(zi, zi)), vinvA2);
+        __m128d r    = _mm_max_pd(_mm_div_pd(_mm_sub_pd(_mm_add_pd(p, q), ve4), _mm_set1_pd(6.0)), _mm_set1_pd(1e-300));
+        __m128d s    = _mm_div_pd(_mm_mul_pd(_mm_mul_pd(ve4, p), q), _mm_mul_pd(_mm_set1_pd(4.0), _mm_mul_pd(_mm_mul_pd(r, r), r)));
+        __m128d t    = cbrtAtLeastOne(_mm_add_pd(_mm_add_pd(one, s), _mm_sqrt_pd(_mm_mul_pd(s, _mm_add_pd(two, s)))));
+        __m128d u    = _mm_mul_pd(r, _mm_add_pd(_mm_add_pd(one, t), _mm_div_pd(one, t)));
+        __m128d v    = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(u, u), _mm_mul_pd(ve4, q)));
+        __m128d w    = _mm_div_pd(_mm_mul_pd(ve2, _mm_sub_pd(_mm_add_pd(u, v), q)), _mm_mul_pd(two, v));
+        __m128d k    = _mm_sub_pd(_mm_sqrt_pd(_mm_add_pd(_mm_add_pd(u, v), _mm_mul_pd(w, w))), w);
+        __m128d D    = _mm_div_pd(_mm_mul_pd(k, _mm_sqrt_pd(rho2)), _mm_add_pd(k, ve2));
+        __m128d Dz   = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(D, D), _mm_mul_pd(zi, zi)));
+
+        _mm_storeu_pd(lon+i,    _mm_mul_pd(atan2Radians(yi, xi), toDeg));
+        _mm_storeu_pd(lat+i,    _mm_mul_pd(atan2Radians(zi, _mm_add_pd(D, Dz)), _mm_add_pd(toDeg, toDeg)));
+        _mm_storeu_pd(height+i, _mm_mul_pd(_mm_div_pd(_mm_sub_pd(_mm_add_pd(k, ve2), one), k), Dz));
+    }
+#endif
+
+    // scalar path, for the odd point out or when there is no SSE2:
+    for(; i<count; ++i)
+    {
+        double rho2 = x[i]*x[i] + y[i]*y[i];
+        double p    = rho2 * invA2;
+        double q    = (1.0 - e2) * z[i]*z[i] * invA2;
+        double r    = osg::maximum((p + q - e4) / 6.0, 1e-300);
+        double s    = e4 * p * q / (4.0 * r*r*r);
+        double t    = pow(1.0 + s + sqrt(s*(2.0 + s)), 1.0/3.0);
+        double u    = r * (1.0 + t + 1.0/t);
+        double v    = sqrt(u*u + e4*q);
+        double w    = e2 * (u + v - q) / (2.0*v);
+        double k    = sqrt(u + v + w*w) - w;
+        double D    = k * sqrt(rho2) / (k + e2);
+        double Dz   = sqrt(D*D + z[i]*z[i]);
+
+        lon[i]    = atan2(y[i], x[i]) * rad2deg;
+        lat[i]    = 2.0 * atan2(z[i], D + Dz) * rad2deg;
+        height[i] = (k + e2 - 1.0) / k * Dz;
+    }
+
+    for(i=0; i<count; ++i)
+    {
+        double p = (x[i]*x[i] + y[i]*y[i]) * invA2;
+        double q = (1.0 - e2) * z[i]*z[i] * invA2;
+        if ( p + q <= e4 )
+        {
+            em->convertXYZToLatLongHeight(x[i], y[i], z[i], lat[i], lon[i], height[i]);
+            lat[i] *= rad2deg;
+            lon[i] *= rad2deg;
+        }
+    }
+}
+
+void
+ECEF::transform(const osg::Matrixd& m,
+                unsigned            count,
+                double* x, double* y, double* z)
+{
+    const double
+        m00 = m(0,0), m01 = m(0,1), m02 = m(0,2),
+        m10 = m(1,0), m11 = m(1,1), m12 = m(1,2),
+        m20 = m(2,0), m21 = m(2,1), m22 = m(2,2),
+        m30 = m(3,0), m31 = m(3,1), m32 = m(3,2);
+
+    // row-vector convention, same as osg::Vec3d * osg::Matrixd
+    for(unsigned i=0; i<count; ++i)
+    {
+        double xi = x[i], yi = y[i], zi = z[i];
+        x[i] = xi*m00 + yi*m10 + zi*m20 + m30;
+        y[i] = xi*m01 + yi*m11 + zi*m21 + m31;
+        z[i] = xi*m02 + yi*m12 + zi*m22 + m32;
+    }
+}
+
+void
+ECEF::geodeticToECEF(std::vector<osg::Vec3d>&   points,
+                     const osg::EllipsoidModel* em)
+{
+    double in[3][BLOCK_SIZE], out[3][BLOCK_SIZE];
+
+    for(unsigned base=0; base<points.size(); base += BLOCK_SIZE)
+    {
+        unsigned n = osg::minimum(BLOCK_SIZE, (unsigned)points.size()-base);
+        for(unsigned i=0; i<n; ++i)
+        {
+            const osg::Vec3d& p = points[base+i];
+            in[0][i] = p.x(); in[1][i] = p.y(); in[2][i] = p.z();
+        }
+
+        geodeticToECEF(em, n, in[0], in[1], in[2], out[0], out[1], out[2]);
+
+        for(unsigned i=0; i<n; ++i)
+            points[base+i].set(out[0][i], out[1][i], out[2][i]);
+    }
+}
+
+void
+ECEF::ECEFToGeodetic(std::vector<osg::Vec3d>&   points,
+                     const osg::EllipsoidModel* em)
+{
+    double in[3][BLOCK_SIZE], out[3][BLOCK_SIZE];
+
+    for(unsigned base=0; base<points.size(); base += BLOCK_SIZE)
+    {
+        unsigned n = osg::minimum(BLOCK_SIZE, (unsigned)points.size()-base);
+        for(unsigned i=0; i<n; ++i)
+        {
+            const osg::Vec3d& p = points[base+i];
+            in[0][i] = p.x(); in[1][i] = p.y(); in[2][i] = p.z();
+        }
+
+        ECEFToGeodetic(em, n, in[0], in[1], in[2], out[0], out[1], out[2]);
+
+        for(unsigned i=0; i<n; ++i)
+            points[base+i].set(out[0][i], out[1][i], out[2][i]);
+    }
+}
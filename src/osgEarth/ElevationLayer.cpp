@@ -21,6 +21,8 @@
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Progress>
 #include <osgEarth/MemCache>
+#include <osgEarth/TaskService>
+#include <osgEarth/URI>
 #include <osg/Version>
 #include <iterator>
 
@@ -29,6 +31,8 @@ using namespace OpenThreads;
 
 #define LC "[ElevationLayer] \"" << getName() << "\" : "
 
+#define ELEVATION_RANGES_KEY "_elevation_ranges"
+
 //------------------------------------------------------------------------
 
 ElevationLayerOptions::ElevationLayerOptions( const ConfigOptions& options ) :
@@ -158,6 +162,18 @@ void
 ElevationLayer::init()
 {
     TerrainLayer::init();
+
+    _ranges = new ElevationRanges();
+    _rangesLoaded = false;
+    _rangesDirtied = false;
+    _rangesSavedRevision = 0u;
+    sync( _rangesLayerRevision );
+}
+
+ElevationLayer::~ElevationLayer()
+{
+    // save whatever was recorded since the last periodic save.
+    saveElevationRanges( 1u );
 }
 
 void
@@ -366,6 +382,59 @@ ElevationLayer::assembleHeightFieldFromTileSource(const TileKey&    key,
 }
 
 
+namespace
+{
+    // background refresh of an expired cached heightfield (stale-while-revalidate)
+    struct RefreshHeightFieldTask : public TaskRequest
+    {
+        RefreshHeightFieldTask(ElevationLayer* layer, const TileKey& key, const Config& cacheMetadata) :
+            _layer(layer), _key(key), _cacheMetadata(cacheMetadata) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            osg::ref_ptr<ElevationLayer> layer;
+            if ( _layer.lock(layer) )
+                layer->refreshCachedHeightField( _key, _cacheMetadata, progress );
+        }
+
+        osg::observer_ptr<ElevationLayer> _layer;
+        TileKey                           _key;
+        Config                            _cacheMetadata;
+    };
+}
+
+void
+ElevationLayer::refreshCachedHeightField(const TileKey& key, const Config& cacheMetadata, ProgressCallback* progress)
+{
+    CacheBin* cacheBin = getCacheBin( key.getProfile() );
+    if ( !cacheBin || !getCacheSettings()->cachePolicy()->isCacheWriteable() || !getTileSource() )
+        return;
+
+    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
+
+    // send the record's validators, so an unchanged remote tile costs only a 304.
+    osg::ref_ptr<RevalidationProgress> revalidation = new RevalidationProgress( progress, cacheMetadata );
+    osg::ref_ptr<osg::HeightField> hf = createHeightFieldFromTileSource( key, revalidation.get() );
+    revalidation->finish();
+
+    if ( revalidation->notModified() )
+    {
+        cacheBin->touch( cacheKey );
+        OE_DEBUG << LC << "Revalidated cached heightfield for " << key.str() << std::endl;
+    }
+    else if ( hf.valid() && validateHeightField(hf.get()) )
+    {
+        cacheBin->write(cacheKey, hf.get(), revalidation->getCacheMetadata(), 0L);
+
+        // the L2 copy is post-processed, so drop it and let the next request rebuild it.
+        if ( _memCacheBin.valid() )
+            _memCacheBin->remove(cacheKey);
+
+        OE_DEBUG << LC << "Refreshed cached heightfield for " << key.str() << std::endl;
+    }
+}
+
+
 GeoHeightField
 ElevationLayer::createHeightField(const TileKey&    key,
                                   ProgressCallback* progress )
@@ -386,9 +455,9 @@ ElevationLayer::createHeightField(const TileKey&    key,
     std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
 
-    if ( _memCache.valid() )
+    if ( _memCacheBin.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        CacheBin* bin = _memCacheBin.get();
         ReadResult cacheResult = bin->readObject(cacheKey, 0L);
         if ( cacheResult.succeeded() )
         {
@@ -426,6 +495,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
         bool fromCache = false;
 
         osg::ref_ptr< osg::HeightField > cachedHF;
+        Config cachedMetadata;
 
         if ( cacheBin && policy.isCacheReadable() )
         {
@@ -434,6 +504,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
             {            
                 bool expired = policy.isExpired(r.lastModifiedTime());
                 cachedHF = r.get<osg::HeightField>();
+                cachedMetadata = r.metadata();
                 if ( cachedHF && validateHeightField(cachedHF) )
                 {
                     if (!expired)
@@ -441,6 +512,16 @@ ElevationLayer::createHeightField(const TileKey&    key,
                         hf = cachedHF;
                         fromCache = true;
                     }
+                    else if ( policy.staleWhileRevalidate() == true && !policy.isCacheOnly() && policy.isCacheWriteable() )
+                    {
+                        // use the expired heightfield for now, and replace it in the background.
+                        CacheRefreshService::instance()->schedule(
+                            cacheBin->getID() + "/" + cacheKey,
+                            new RefreshHeightFieldTask(this, key, cachedMetadata) );
+
+                        hf = cachedHF;
+                        fromCache = true;
+                    }
                 }
             }
         }
@@ -460,8 +541,24 @@ ElevationLayer::createHeightField(const TileKey&    key,
             if ( !isKeyInRange(key) )
                 return GeoHeightField::INVALID;
 
-            // build a HF from the TileSource.
-            hf = createHeightFieldFromTileSource( key, progress );
+            // build a HF from the TileSource. The revalidation callback collects the
+            // HTTP validators to store with the cache record, and sends those of the
+            // expired record (if any) so an unchanged remote tile costs only a 304.
+            osg::ref_ptr<RevalidationProgress> revalidation = new RevalidationProgress( progress, cachedMetadata );
+            hf = createHeightFieldFromTileSource( key, revalidation.get() );
+            revalidation->finish();
+
+            if ( cachedHF.valid() && revalidation->notModified() )
+            {
+                OE_DEBUG << LC << "Expired heightfield for " << key.str() << " not modified" << std::endl;
+
+                // the record is still good; just renew its timestamp.
+                if ( cacheBin && policy.isCacheWriteable() )
+                    cacheBin->touch( cacheKey );
+
+                hf = cachedHF;
+                fromCache = true;
+            }
 
             // validate it to make sure it's legal.
             if ( hf.valid() && !validateHeightField(hf.get()) )
@@ -476,7 +573,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
                  !fromCache    &&
                  policy.isCacheWriteable() )
             {
-                cacheBin->write(cacheKey, hf, 0L);
+                cacheBin->write(cacheKey, hf, revalidation->getCacheMetadata(), 0L);
             }
 
             // We have an expired heightfield from the cache and no new data from the TileSource.  So just return the cached data.
@@ -509,9 +606,9 @@ ElevationLayer::createHeightField(const TileKey&    key,
     }
 
     // write to mem cache if needed:
-    if ( result.valid() && !fromMemCache && _memCache.valid() )
+    if ( result.valid() && !fromMemCache && _memCacheBin.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        CacheBin* bin = _memCacheBin.get();
         bin->write(cacheKey, result.getHeightField(), 0L);
     }
 
@@ -540,11 +637,119 @@ ElevationLayer::createHeightField(const TileKey&    key,
                 NO_DATA_VALUE,
                 geoid );
         }
+
+        // record the min/max of the tile for bounding purposes; a tile from the
+        // mem cache has already been recorded.
+        if ( !fromMemCache )
+        {
+            updateElevationRanges( key, result.getHeightField() );
+        }
     }
 
     return result;
 }
 
+const ElevationRanges*
+ElevationLayer::getElevationRanges() const
+{
+    bool cleared;
+    {
+        Threading::ScopedMutexLock lock(_rangesMutex);
+        cleared = syncElevationRanges();
+    }
+
+    if ( cleared )
+        saveElevationRanges( 1u );
+
+    return _ranges.get();
+}
+
+void
+ElevationLayer::updateElevationRanges(const TileKey& key, const osg::HeightField* hf)
+{
+    CacheBin* cacheBin = getCacheBin( key.getProfile() );
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
+
+    bool cleared;
+    {
+        Threading::ScopedMutexLock lock(_rangesMutex);
+
+        cleared = syncElevationRanges();
+
+        // restore the ranges recorded by earlier sessions the first time through,
+        // unless the layer's data has changed since then.
+        if ( !_rangesLoaded )
+        {
+            if ( cacheBin && policy.isCacheReadable() && !_rangesDirtied )
+            {
+                ReadResult rr = cacheBin->readString(ELEVATION_RANGES_KEY, 0L);
+                if ( rr.succeeded() && !policy.isExpired(rr.lastModifiedTime()) )
+                {
+                    if ( _ranges->read(rr.getString(), key.getProfile()) )
+                    {
+                        OE_INFO << LC << "Restored elevation ranges for " << _ranges->size() << " tiles" << std::endl;
+                    }
+                }
+            }
+
+            if ( cacheBin && policy.isCacheWriteable() )
+                _rangesBin = cacheBin;
+
+            _rangesSavedRevision = _ranges->getRevision();
+            _rangesLoaded = true;
+
+            // a copy saved before the layer was dirtied is stale; overwrite it now.
+            cleared = cleared || _rangesDirtied;
+        }
+
+        _ranges->add( key, hf );
+    }
+
+    // write the ranges back every so often; they are small, and rewriting
+    // the whole record keeps the cache bin format simple.
+    saveElevationRanges( cleared ? 1u : 256u );
+}
+
+// Clears the ranges if the layer has been dirtied since they were recorded.
+// Returns true if it did. Call with _rangesMutex held.
+bool
+ElevationLayer::syncElevationRanges() const
+{
+    if ( inSyncWith(_rangesLayerRevision) )
+        return false;
+
+    sync( _rangesLayerRevision );
+    _ranges->clear();
+    _rangesDirtied = true;
+
+    OE_INFO << LC << "Layer changed; cleared its elevation ranges" << std::endl;
+    return true;
+}
+
+// Writes the ranges to the cache bin if they changed at least "minChanges"
+// times since the last save. An empty pyramid removes the saved copy.
+void
+ElevationLayer::saveElevationRanges(unsigned minChanges) const
+{
+    osg::ref_ptr<CacheBin> bin;
+    std::string data;
+    bool empty;
+    {
+        Threading::ScopedMutexLock lock(_rangesMutex);
+        if ( !_rangesBin.valid() || _ranges->getRevision() - _rangesSavedRevision < minChanges )
+            return;
+
+        bin = _rangesBin.get();
+        empty = !_ranges->write(data);
+        _rangesSavedRevision = _ranges->getRevision();
+    }
+
+    if ( empty )
+        bin->remove( ELEVATION_RANGES_KEY );
+    else
+        bin->write( ELEVATION_RANGES_KEY, new StringObject(data), 0L );
+}
+
 
 //------------------------------------------------------------------------
 
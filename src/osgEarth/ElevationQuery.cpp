@@ -214,13 +214,23 @@ ElevationQuery::getMaxLevel( double x, double y, const SpatialReference* srs, co
                 else
                     tsSRS = srs;
 
-                for (osgEarth::DataExtentList::iterator j = ts->getDataExtents().begin(); j != ts->getDataExtents().end(); j++)
+                osg::ref_ptr<const DataExtentIndex> index = ts->getDataExtentIndex();
+                if ( index.valid() && (!tsSRS || tsSRS->isHorizEquivalentTo(index->getProfile()->getSRS())) )
                 {
-                    if (j->maxLevel().isSet() &&
-                        (!layerMaxLevel.isSet() || j->maxLevel() > layerMaxLevel.get() )
-                        && j->contains( tsCoord.x(), tsCoord.y(), tsSRS ))
+                    int indexMaxLevel = index->getMaxLevel( tsCoord.x(), tsCoord.y() );
+                    if ( indexMaxLevel >= 0 )
+                        layerMaxLevel = indexMaxLevel;
+                }
+                else
+                {
+                    for (osgEarth::DataExtentList::iterator j = ts->getDataExtents().begin(); j != ts->getDataExtents().end(); j++)
                     {
-                        layerMaxLevel = j->maxLevel().value();
+                        if (j->maxLevel().isSet() &&
+                            (!layerMaxLevel.isSet() || j->maxLevel() > layerMaxLevel.get() )
+                            && j->contains( tsCoord.x(), tsCoord.y(), tsSRS ))
+                        {
+                            layerMaxLevel = j->maxLevel().value();
+                        }
                     }
                 }
             }
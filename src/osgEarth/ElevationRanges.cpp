@@ -0,0 +1,338 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ElevationRanges>
+#include <osgEarth/GeoCommon>
+#include <osgEarth/Notify>
+#include <osgEarth/TileKey>
+#include <osg/Math>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cfloat>
+
+#define LC "[ElevationRanges] "
+
+using namespace osgEarth;
+
+namespace
+{
+    const char* s_header = "#osgEarth elevation ranges 1";
+
+    // Deepest LOD we can pack into a 64-bit code (6 bits of LOD, 29 bits each of X and Y)
+    const unsigned s_maxLOD = 28u;
+}
+
+ElevationRanges::ElevationRanges(unsigned maxEntries) :
+_maxEntries( maxEntries ),
+_revision  ( 0u )
+{
+    //nop
+}
+
+bool
+ElevationRanges::encode(unsigned lod, unsigned x, unsigned y, unsigned long long& out_code)
+{
+    if ( lod > s_maxLOD || x >= (1u<<29) || y >= (1u<<29) )
+        return false;
+
+    out_code = ((unsigned long long)lod << 58) | ((unsigned long long)x << 29) | (unsigned long long)y;
+    return true;
+}
+
+bool
+ElevationRanges::acceptProfile(const Profile* profile)
+{
+    if ( !profile )
+        return false;
+
+    if ( !_profile.valid() )
+    {
+        _profile = profile;
+        return true;
+    }
+
+    return profile == _profile.get() || profile->isHorizEquivalentTo(_profile.get());
+}
+
+void
+ElevationRanges::add(const TileKey& key, const osg::HeightField* hf)
+{
+    if ( !hf || !hf->getFloatArray() || !key.valid() )
+        return;
+
+    unsigned long long code;
+    if ( !encode(key.getLOD(), key.getTileX(), key.getTileY(), code) )
+        return;
+
+    // scan the heights outside the lock:
+    Range range;
+    range._min    = FLT_MAX;
+    range._max    = -FLT_MAX;
+    range._noData = false;
+
+    const osg::FloatArray* heights = hf->getFloatArray();
+    for(unsigned i=0; i<heights->size(); ++i)
+    {
+        float h = (*heights)[i];
+        if ( h == NO_DATA_VALUE )
+        {
+            range._noData = true;
+        }
+        else
+        {
+            range._min = std::min(range._min, h);
+            range._max = std::max(range._max, h);
+        }
+    }
+
+    if ( range._min > range._max )
+    {
+        range._min = range._max = 0.0f;
+    }
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    if ( !acceptProfile(key.getProfile()) )
+        return;
+
+    // Ranges only ever widen, so that a tile's range contains the ranges
+    // of all its recorded descendants.
+    RangeMap::iterator i = _ranges.find(code);
+    if ( i != _ranges.end() )
+    {
+        Range& r = i->second;
+        if ( range._min >= r._min && range._max <= r._max && (!range._noData || r._noData) )
+            return;
+
+        r._min    = std::min(r._min, range._min);
+        r._max    = std::max(r._max, range._max);
+        r._noData = r._noData || range._noData;
+        range = r;
+    }
+    else
+    {
+        if ( _ranges.size() >= _maxEntries )
+            return;
+
+        // absorb any children that were recorded first:
+        unsigned lod = key.getLOD() + 1u;
+        for(unsigned q=0; q<4u; ++q)
+        {
+            unsigned long long childCode;
+            if ( encode(lod, key.getTileX()*2u + (q&1u), key.getTileY()*2u + (q>>1), childCode) )
+            {
+                RangeMap::const_iterator child = _ranges.find(childCode);
+                if ( child != _ranges.end() )
+                {
+                    range._min    = std::min(range._min, child->second._min);
+                    range._max    = std::max(range._max, child->second._max);
+                    range._noData = range._noData || child->second._noData;
+                }
+            }
+        }
+
+        _ranges[code] = range;
+    }
+
+    // widen the recorded ancestors:
+    unsigned lod = key.getLOD(), x = key.getTileX(), y = key.getTileY();
+    while( lod > 0u )
+    {
+        --lod, x >>= 1, y >>= 1;
+        encode(lod, x, y, code);
+
+        RangeMap::iterator parent = _ranges.find(code);
+        if ( parent != _ranges.end() )
+        {
+            Range& r = parent->second;
+            r._min    = std::min(r._min, range._min);
+            r._max    = std::max(r._max, range._max);
+            r._noData = r._noData || range._noData;
+        }
+    }
+
+    ++_revision;
+}
+
+bool
+ElevationRanges::get(const TileKey& key, float& out_min, float& out_max) const
+{
+    if ( !key.valid() )
+        return false;
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    if ( _ranges.empty() )
+        return false;
+
+    if ( key.getProfile() != _profile.get() && !key.getProfile()->isHorizEquivalentTo(_profile.get()) )
+        return false;
+
+    unsigned lod = key.getLOD(), x = key.getTileX(), y = key.getTileY();
+    while( lod > s_maxLOD )
+    {
+        --lod, x >>= 1, y >>= 1;
+    }
+
+    for(;;)
+    {
+        unsigned long long code;
+        if ( encode(lod, x, y, code) )
+        {
+            RangeMap::const_iterator i = _ranges.find(code);
+            if ( i != _ranges.end() )
+            {
+                out_min = i->second._min;
+                out_max = i->second._max;
+                if ( i->second._noData )
+                {
+                    out_min = std::min(out_min, 0.0f);
+                    out_max = std::max(out_max, 0.0f);
+                }
+                return true;
+            }
+        }
+
+        if ( lod == 0u )
+            return false;
+
+        --lod, x >>= 1, y >>= 1;
+    }
+}
+
+unsigned
+ElevationRanges::size() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _ranges.size();
+}
+
+unsigned
+ElevationRanges::getRevision() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _revision;
+}
+
+void
+ElevationRanges::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _ranges.clear();
+    ++_revision;
+}
+
+bool
+ElevationRanges::write(std::string& out) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    if ( _ranges.empty() || !_profile.valid() )
+        return false;
+
+    // 9 significant digits round-trip a float exactly, so ranges never shrink.
+    std::stringstream buf;
+    buf << s_header << ' ' << _profile->getHorizSignature() << '\n'
+        << std::setprecision(9);
+
+    for(RangeMap::const_iterator i = _ranges.begin(); i != _ranges.end(); ++i)
+    {
+        unsigned lod = (unsigned)(i->first >> 58);
+        unsigned x   = (unsigned)((i->first >> 29) & 0x1FFFFFFFull);
+        unsigned y   = (unsigned)(i->first & 0x1FFFFFFFull);
+
+        buf << lod << ' ' << x << ' ' << y << ' '
+            << i->second._min << ' ' << i->second._max << ' '
+            << (i->second._noData ? 1 : 0) << '\n';
+    }
+
+    out = buf.str();
+    return true;
+}
+
+bool
+ElevationRanges::read(const std::string& in, const Profile* profile)
+{
+    if ( !profile )
+        return false;
+
+    std::istringstream buf(in);
+
+    std::string line;
+    if ( !std::getline(buf, line) || line != std::string(s_header) + ' ' + profile->getHorizSignature() )
+        return false;
+
+    RangeMap ranges;
+    unsigned lod, x, y;
+    int noData;
+    Range range;
+    while( buf >> lod >> x >> y >> range._min >> range._max >> noData )
+    {
+        unsigned long long code;
+        if ( !encode(lod, x, y, code) || range._min > range._max )
+            return false;
+
+        range._noData = noData != 0;
+        ranges[code] = range;
+    }
+
+    if ( !buf.eof() )
+    {
+        OE_WARN << LC << "Malformed elevation ranges; ignoring them" << std::endl;
+        return false;
+    }
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    if ( !acceptProfile(profile) )
+        return false;
+
+    for(RangeMap::const_iterator i = ranges.begin(); i != ranges.end() && _ranges.size() < _maxEntries; ++i)
+    {
+        _ranges.insert( *i );
+    }
+
+    // Restore the ancestor invariant over the merged set. Codes sort by LOD
+    // first, so visiting them in reverse order widens each parent after all
+    // of its children have been widened.
+    for(RangeMap::reverse_iterator i = _ranges.rbegin(); i != _ranges.rend(); ++i)
+    {
+        unsigned lod = (unsigned)(i->first >> 58);
+        if ( lod == 0u )
+            break;
+
+        unsigned x = (unsigned)((i->first >> 29) & 0x1FFFFFFFull);
+        unsigned y = (unsigned)(i->first & 0x1FFFFFFFull);
+
+        unsigned long long parentCode;
+        encode(lod-1u, x>>1, y>>1, parentCode);
+
+        RangeMap::iterator parent = _ranges.find(parentCode);
+        if ( parent != _ranges.end() )
+        {
+            Range& r = parent->second;
+            r._min    = std::min(r._min, i->second._min);
+            r._max    = std::max(r._max, i->second._max);
+            r._noData = r._noData || i->second._noData;
+        }
+    }
+
+    ++_revision;
+    return true;
+}
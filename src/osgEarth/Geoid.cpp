@@ -51,6 +51,15 @@ Geoid::setHeightField( osg::HeightField* hf )
     validate();
 }
 
+void
+Geoid::setGrid( GeoidGrid* grid )
+{
+    _grid = grid;
+    if ( _grid.valid() )
+        _bounds = _grid->getBounds();
+    validate();
+}
+
 void
 Geoid::setUnits( const Units& units ) 
 {
@@ -62,7 +71,7 @@ void
 Geoid::validate()
 {
     _valid = false;
-    if ( !_hf.valid() )
+    if ( !_hf.valid() && !_grid.valid() )
     {
         //OE_WARN << LC << "ILLEGAL GEOID: no heightfield" << std::endl;
     }
@@ -81,7 +90,11 @@ Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& i
 {
     float result = 0.0f;
 
-    if ( _valid && _bounds.contains(lon_deg, lat_deg) )
+    if ( _valid && _grid.valid() )
+    {
+        result = _grid->getHeight( lat_deg, lon_deg );
+    }
+    else if ( _valid && _bounds.contains(lon_deg, lat_deg) )
     {
         double nlon = (lon_deg-_bounds.xMin())/_bounds.width();
         double nlat = (lat_deg-_bounds.yMin())/_bounds.height();
@@ -91,13 +104,41 @@ Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& i
     return result;
 }
 
+void
+Geoid::getHeights(double   lat_deg,
+                  double   lon_deg,
+                  double   latInterval_deg,
+                  double   lonInterval_deg,
+                  unsigned numCols,
+                  unsigned numRows,
+                  float*   out) const
+{
+    if ( _valid && _grid.valid() )
+    {
+        _grid->getHeights( lat_deg, lon_deg, latInterval_deg, lonInterval_deg, numCols, numRows, out );
+    }
+    else
+    {
+        for( unsigned r=0; r<numRows; ++r )
+        {
+            double lat = lat_deg + latInterval_deg*(double)r;
+            for( unsigned c=0; c<numCols; ++c )
+            {
+                double lon = lon_deg + lonInterval_deg*(double)c;
+                out[r*numCols + c] = getHeight( lat, lon );
+            }
+        }
+    }
+}
+
 bool
 Geoid::isEquivalentTo( const Geoid& rhs ) const
 {
     // weak..
     return
-        _valid                      &&
-        _name == rhs._name          &&
-        _hf.get() == rhs._hf.get()  &&
+        _valid                          &&
+        _name == rhs._name              &&
+        _hf.get() == rhs._hf.get()      &&
+        _grid.get() == rhs._grid.get()  &&
         _units == rhs._units;
 }
@@ -0,0 +1,428 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/GeoidGrid>
+#include <osgEarth/Notify>
+#include <osg/Math>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#define LC "[GeoidGrid] "
+
+using namespace osgEarth;
+
+namespace
+{
+    const char     GRID_MAGIC[8]  = { 'O', 'E', 'G', 'E', 'O', 'I', 'D', 'G' };
+    const unsigned GRID_VERSION   = 2u;
+    const unsigned GRID_BYTEORDER = 0x01020304u;
+    const unsigned GRID_ALIGNMENT = 4096u; // tile data starts on a page boundary
+
+    // File layout: FileHeader, one FileLevel per level, padding, then for each
+    // level its tiles in row-major order. A tile is tileSize x tileSize floats
+    // in row-major order (south to north); tiles on the east and north edges are
+    // padded by repeating the last column and row.
+    struct FileHeader
+    {
+        char     _magic[8];
+        unsigned _version;
+        unsigned _byteOrder;
+        unsigned _numLevels;
+        unsigned _tileSize;
+        double   _west, _south;          // location of sample (0,0), degrees
+        double   _xInterval, _yInterval; // full-resolution sample spacing, degrees
+    };
+
+    struct FileLevel
+    {
+        unsigned           _cols, _rows;
+        unsigned           _tilesX, _tilesY;
+        unsigned long long _offset;      // of the first tile, from the start of the file
+    };
+
+    // one level of the pyramid, while writing
+    struct Raster
+    {
+        unsigned           _cols, _rows;
+        std::vector<float> _heights;
+
+        float at(int c, int r) const
+        {
+            c = osg::clampBetween(c, 0, (int)_cols-1);
+            r = osg::clampBetween(r, 0, (int)_rows-1);
+            return _heights[r*_cols + c];
+        }
+    };
+
+    // Halves a raster with a [1 2 1] filter, keeping every other sample so the
+    // levels stay aligned with the full-resolution grid. When the input has an
+    // odd number of intervals, the output gets one more sample past the edge
+    // (padded by repeating the last column or row) so it still covers the
+    // whole grid.
+    void downsample(const Raster& in, Raster& out)
+    {
+        static const float w[3] = { 0.25f, 0.5f, 0.25f };
+
+        out._cols = in._cols/2 + 1;
+        out._rows = in._rows/2 + 1;
+        out._heights.resize( out._cols * out._rows );
+
+        for(unsigned r=0; r<out._rows; ++r)
+        {
+            for(unsigned c=0; c<out._cols; ++c)
+            {
+                float sum = 0.0f;
+                for(int dr=-1; dr<=1; ++dr)
+                    for(int dc=-1; dc<=1; ++dc)
+                        sum += w[dr+1] * w[dc+1] * in.at( 2*(int)c + dc, 2*(int)r + dr );
+                out._heights[r*out._cols + c] = sum;
+            }
+        }
+    }
+
+    unsigned numTiles(unsigned samples, unsigned tileSize)
+    {
+        return (samples + tileSize - 1) / tileSize;
+    }
+}
+
+//------------------------------------------------------------------------
+
+GeoidGrid::GeoidGrid() :
+_tileShift( 0u ),
+_tileMask ( 0u ),
+_west     ( 0.0 ),
+_south    ( 0.0 )
+{
+    //nop
+}
+
+bool
+GeoidGrid::write(const std::string&      filename,
+                 const osg::HeightField* hf,
+                 unsigned                tileSize)
+{
+    if ( !hf || hf->getNumColumns() < 2 || hf->getNumRows() < 2 )
+    {
+        OE_WARN << LC << "Cannot write " << filename << ": the geoid needs at least 2x2 samples" << std::endl;
+        return false;
+    }
+
+    if ( tileSize < 2 || (tileSize & (tileSize-1)) != 0 )
+    {
+        OE_WARN << LC << "Cannot write " << filename << ": tile size must be a power of two" << std::endl;
+        return false;
+    }
+
+    // build the pyramid, halving until a level fits in one tile.
+    std::vector<Raster> levels( 1 );
+    levels[0]._cols = hf->getNumColumns();
+    levels[0]._rows = hf->getNumRows();
+    levels[0]._heights.assign( hf->getFloatArray()->begin(), hf->getFloatArray()->end() );
+
+    while(
+        (levels.back()._cols > tileSize || levels.back()._rows > tileSize) &&
+        levels.back()._cols >= 3 && levels.back()._rows >= 3 )
+    {
+        levels.resize( levels.size()+1 );
+        downsample( levels[levels.size()-2], levels.back() );
+    }
+
+    FileHeader header;
+    ::memset( &header, 0, sizeof(header) );
+    ::memcpy( header._magic, GRID_MAGIC, sizeof(GRID_MAGIC) );
+    header._version   = GRID_VERSION;
+    header._byteOrder = GRID_BYTEORDER;
+    header._numLevels = levels.size();
+    header._tileSize  = tileSize;
+    header._west      = hf->getOrigin().x();
+    header._south     = hf->getOrigin().y();
+    header._xInterval = hf->getXInterval();
+    header._yInterval = hf->getYInterval();
+
+    const unsigned long long tileBytes = (unsigned long long)tileSize * tileSize * sizeof(float);
+
+    std::vector<FileLevel> table( levels.size() );
+    unsigned long long offset = sizeof(FileHeader) + sizeof(FileLevel) * table.size();
+    offset = ((offset + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT) * GRID_ALIGNMENT;
+    for(unsigned i=0; i<levels.size(); ++i)
+    {
+        ::memset( &table[i], 0, sizeof(FileLevel) );
+        table[i]._cols   = levels[i]._cols;
+        table[i]._rows   = levels[i]._rows;
+        table[i]._tilesX = numTiles( levels[i]._cols, tileSize );
+        table[i]._tilesY = numTiles( levels[i]._rows, tileSize );
+        table[i]._offset = offset;
+        offset += tileBytes * table[i]._tilesX * table[i]._tilesY;
+    }
+
+    // write to a temporary file and swap it in, so that processes mapping the
+    // old file never see a partial one.
+    std::string tempname = filename + ".tmp";
+    std::ofstream out( tempname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !out.is_open() )
+    {
+        OE_WARN << LC << "Cannot open " << tempname << " for writing" << std::endl;
+        return false;
+    }
+
+    out.write( (const char*)&header, sizeof(header) );
+    out.write( (const char*)&table[0], sizeof(FileLevel) * table.size() );
+
+    std::vector<char> padding( (size_t)(table[0]._offset - sizeof(FileHeader) - sizeof(FileLevel) * table.size()), 0 );
+    if ( !padding.empty() )
+        out.write( &padding[0], padding.size() );
+
+    std::vector<float> tile( tileSize * tileSize );
+    for(unsigned i=0; i<levels.size(); ++i)
+    {
+        const Raster& level = levels[i];
+        for(unsigned ty=0; ty<table[i]._tilesY; ++ty)
+        {
+            for(unsigned tx=0; tx<table[i]._tilesX; ++tx)
+            {
+                for(unsigned r=0; r<tileSize; ++r)
+                    for(unsigned c=0; c<tileSize; ++c)
+                        tile[r*tileSize + c] = level.at( tx*tileSize + c, ty*tileSize + r );
+
+                out.write( (const char*)&tile[0], tile.size() * sizeof(float) );
+            }
+        }
+    }
+
+    out.close();
+    if ( out.fail() )
+    {
+        OE_WARN << LC << "Failed to write " << tempname << std::endl;
+        ::remove( tempname.c_str() );
+        return false;
+    }
+
+    ::remove( filename.c_str() );
+    if ( ::rename( tempname.c_str(), filename.c_str() ) != 0 )
+    {
+        OE_WARN << LC << "Failed to rename " << tempname << " to " << filename << std::endl;
+        return false;
+    }
+
+    OE_INFO << LC << "Wrote " << filename << " (" << levels.size() << " levels, "
+        << levels[0]._cols << " x " << levels[0]._rows << " samples)" << std::endl;
+
+    return true;
+}
+
+GeoidGrid*
+GeoidGrid::open(const std::string& filename)
+{
+    osg::ref_ptr<MappedFile> file = MappedFile::open( filename );
+    if ( !file.valid() )
+        return 0L;
+
+    FileHeader header;
+    if ( file->size() < sizeof(header) )
+    {
+        OE_WARN << LC << filename << " is not a geoid grid" << std::endl;
+        return 0L;
+    }
+    ::memcpy( &header, file->data(), sizeof(header) );
+
+    if ( ::memcmp(header._magic, GRID_MAGIC, sizeof(GRID_MAGIC)) != 0 || header._version != GRID_VERSION )
+    {
+        OE_WARN << LC << filename << " is not a geoid grid (or is an unsupported version)" << std::endl;
+        return 0L;
+    }
+
+    if ( header._byteOrder != GRID_BYTEORDER )
+    {
+        OE_WARN << LC << filename << " was written on a machine with a different byte order" << std::endl;
+        return 0L;
+    }
+
+    unsigned tileSize = header._tileSize;
+    if ( tileSize < 2 || (tileSize & (tileSize-1)) != 0 || header._numLevels == 0 ||
+         file->size() < sizeof(FileHeader) + sizeof(FileLevel) * header._numLevels )
+    {
+        OE_WARN << LC << filename << " is corrupt" << std::endl;
+        return 0L;
+    }
+
+    osg::ref_ptr<GeoidGrid> grid = new GeoidGrid();
+    grid->_file = file.get();
+    while( (1u << grid->_tileShift) < tileSize )
+        ++grid->_tileShift;
+    grid->_tileMask = tileSize - 1;
+    grid->_west     = header._west;
+    grid->_south    = header._south;
+
+    const unsigned long long tileBytes = (unsigned long long)tileSize * tileSize * sizeof(float);
+
+    for(unsigned i=0; i<header._numLevels; ++i)
+    {
+        FileLevel entry;
+        ::memcpy( &entry, file->data() + sizeof(FileHeader) + sizeof(FileLevel) * i, sizeof(entry) );
+
+        unsigned long long end = entry._offset + tileBytes * entry._tilesX * entry._tilesY;
+
+        if ( entry._cols < 2 || entry._rows < 2 ||
+             entry._tilesX != numTiles(entry._cols, tileSize) ||
+             entry._tilesY != numTiles(entry._rows, tileSize) ||
+             entry._offset % sizeof(float) != 0 ||
+             end > (unsigned long long)file->size() )
+        {
+            OE_WARN << LC << filename << " is corrupt (level " << i << ")" << std::endl;
+            return 0L;
+        }
+
+        Level level;
+        level._cols      = entry._cols;
+        level._rows      = entry._rows;
+        level._tilesX    = entry._tilesX;
+        level._xInterval = header._xInterval * double(1u << i);
+        level._yInterval = header._yInterval * double(1u << i);
+        level._data      = (const float*)(file->data() + entry._offset);
+        grid->_levels.push_back( level );
+    }
+
+    const Level& full = grid->_levels[0];
+    grid->_bounds = Bounds(
+        header._west,
+        header._south,
+        header._west  + header._xInterval * double(full._cols-1),
+        header._south + header._yInterval * double(full._rows-1) );
+
+    OE_INFO << LC << "Mapped " << filename << " (" << grid->_levels.size() << " levels, "
+        << full._cols << " x " << full._rows << " samples)" << std::endl;
+
+    return grid.release();
+}
+
+float
+GeoidGrid::getHeight(double lat_deg, double lon_deg) const
+{
+    if ( _levels.empty() || !_bounds.contains(lon_deg, lat_deg) )
+        return 0.0f;
+
+    const Level& level = _levels[0];
+
+    double x = osg::clampBetween( (lon_deg - _west)  / level._xInterval, 0.0, double(level._cols-1) );
+    double y = osg::clampBetween( (lat_deg - _south) / level._yInterval, 0.0, double(level._rows-1) );
+
+    unsigned c = osg::minimum( (unsigned)x, level._cols-2 );
+    unsigned r = osg::minimum( (unsigned)y, level._rows-2 );
+    float fx = float(x - double(c));
+    float fy = float(y - double(r));
+
+    size_t tileArea = (size_t)1 << (2*_tileShift);
+    size_t c0 = ((size_t)(c     >> _tileShift) * tileArea) + (c     & _tileMask);
+    size_t c1 = ((size_t)((c+1) >> _tileShift) * tileArea) + ((c+1) & _tileMask);
+    const float* row0 = level._data + ((size_t)(r     >> _tileShift) * level._tilesX * tileArea) + (((r)   & _tileMask) << _tileShift);
+    const float* row1 = level._data + ((size_t)((r+1) >> _tileShift) * level._tilesX * tileArea) + (((r+1) & _tileMask) << _tileShift);
+
+    float south = row0[c0] + fx*(row0[c1] - row0[c0]);
+    float north = row1[c0] + fx*(row1[c1] - row1[c0]);
+    return south + fy*(north - south);
+}
+
+void
+GeoidGrid::getHeights(double   lat_deg,
+                      double   lon_deg,
+                      double   latInterval_deg,
+                      double   lonInterval_deg,
+                      unsigned numCols,
+                      unsigned numRows,
+                      float*   out) const
+{
+    if ( numCols == 0 || numRows == 0 )
+        return;
+
+    if ( _levels.empty() )
+    {
+        std::fill( out, out + numCols*numRows, 0.0f );
+        return;
+    }
+
+    const Level& level = _levels[ getLevel(latInterval_deg, lonInterval_deg) ];
+    sample( level, lat_deg, lon_deg, latInterval_deg, lonInterval_deg, numCols, numRows, out );
+}
+
+unsigned
+GeoidGrid::getLevel(double latInterval_deg, double lonInterval_deg) const
+{
+    // levels are aligned with the full-resolution grid, so any of them can
+    // serve a query; the coarsest one no wider than the spacing filters out
+    // the detail the samples can't represent.
+    double dx = fabs(lonInterval_deg), dy = fabs(latInterval_deg);
+    unsigned i = 0u;
+    while( i+1 < _levels.size() && _levels[i+1]._xInterval <= dx && _levels[i+1]._yInterval <= dy )
+        ++i;
+    return i;
+}
+
+void
+GeoidGrid::sample(const Level& level,
+                  double       lat_deg,
+                  double       lon_deg,
+                  double       latInterval_deg,
+                  double       lonInterval_deg,
+                  unsigned     numCols,
+                  unsigned     numRows,
+                  float*       out) const
+{
+    // Bilinear sampling is separable on a regular grid: work out the sample
+    // offsets, weights and in-bounds masks once per column and once per row,
+    // so the inner loop is just loads and arithmetic with no branches.
+    size_t tileArea = (size_t)1 << (2*_tileShift);
+
+    std::vector<size_t> col0( numCols ), col1( numCols );
+    std::vector<float>  wx( numCols ), mx( numCols );
+    for(unsigned i=0; i<numCols; ++i)
+    {
+        double lon = lon_deg + lonInterval_deg*double(i);
+        double x = osg::clampBetween( (lon - _west) / level._xInterval, 0.0, double(level._cols-1) );
+        unsigned c = osg::minimum( (unsigned)x, level._cols-2 );
+        col0[i] = ((size_t)(c     >> _tileShift) * tileArea) + (c     & _tileMask);
+        col1[i] = ((size_t)((c+1) >> _tileShift) * tileArea) + ((c+1) & _tileMask);
+        wx[i]   = float(x - double(c));
+        mx[i]   = lon >= _bounds.xMin() && lon <= _bounds.xMax() ? 1.0f : 0.0f;
+    }
+
+    size_t rowArea = (size_t)level._tilesX * tileArea;
+
+    for(unsigned j=0; j<numRows; ++j)
+    {
+        double lat = lat_deg + latInterval_deg*double(j);
+        double y = osg::clampBetween( (lat - _south) / level._yInterval, 0.0, double(level._rows-1) );
+        unsigned r = osg::minimum( (unsigned)y, level._rows-2 );
+        float wy = float(y - double(r));
+        float my = lat >= _bounds.yMin() && lat <= _bounds.yMax() ? 1.0f : 0.0f;
+
+        const float* row0 = level._data + ((size_t)(r     >> _tileShift) * rowArea) + ((r     & _tileMask) << _tileShift);
+        const float* row1 = level._data + ((size_t)((r+1) >> _tileShift) * rowArea) + (((r+1) & _tileMask) << _tileShift);
+        float* output = out + (size_t)j*numCols;
+
+        for(unsigned i=0; i<numCols; ++i)
+        {
+            float south = row0[col0[i]] + wx[i]*(row0[col1[i]] - row0[col0[i]]);
+            float north = row1[col0[i]] + wx[i]*(row1[col1[i]] - row1[col0[i]]);
+            output[i] = my * mx[i] * (south + wy*(north - south));
+        }
+    }
+}
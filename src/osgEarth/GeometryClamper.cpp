@@ -23,12 +23,152 @@
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/UserDataContainer>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 #define LC "[GeometryClamper] "
 
 using namespace osgEarth;
 
 #define ZOFFSETS_NAME "GeometryClamper::zOffsets"
+#define GRID_NAME     "GeometryClamper::grid"
+
+// target number of vertices per grid cell, and the maximum cells per side
+#define VERTS_PER_CELL 16u
+#define MAX_GRID_SIZE  256u
+
+namespace
+{
+    /**
+     * Buckets the vertices of one geometry by their horizontal position in
+     * terrain coordinates (degrees in a geocentric map), so the vertices under
+     * a tile can be found without visiting all of them. Clamping moves a vertex
+     * along the up vector, which doesn't change its horizontal position, so the
+     * grid stays valid until the vertex count or the geometry's transform does.
+     */
+    class ClampingGrid : public osg::Object
+    {
+    public:
+        META_Object(osgEarth, ClampingGrid);
+
+        ClampingGrid() : _xmin(0.0), _ymin(0.0), _cellWidth(1.0), _cellHeight(1.0), _cols(0u), _rows(0u) { }
+
+        ClampingGrid(const ClampingGrid& rhs, const osg::CopyOp& op) :
+            osg::Object(rhs, op),
+            _local2world(rhs._local2world),
+            _xmin(rhs._xmin), _ymin(rhs._ymin),
+            _cellWidth(rhs._cellWidth), _cellHeight(rhs._cellHeight),
+            _cols(rhs._cols), _rows(rhs._rows),
+            _coords(rhs._coords), _cellStart(rhs._cellStart), _indices(rhs._indices) { }
+
+        bool isValidFor(const osg::Vec3Array* verts, const osg::Matrixd& local2world) const
+        {
+            return _coords.size() == verts->size() && _local2world == local2world;
+        }
+
+        void build(const osg::Vec3Array* verts, const osg::Matrixd& local2world, const SpatialReference* srs)
+        {
+            _local2world = local2world;
+
+            const osg::EllipsoidModel* em = srs->getEllipsoid();
+            bool isGeocentric = srs->isGeographic();
+
+            _coords.resize( verts->size() );
+            double xmax = -DBL_MAX, ymax = -DBL_MAX;
+            _xmin = DBL_MAX, _ymin = DBL_MAX;
+
+            for(unsigned k=0; k<verts->size(); ++k)
+            {
+                osg::Vec3d vw = osg::Vec3d((*verts)[k]) * local2world;
+                osg::Vec2d& c = _coords[k];
+                if ( isGeocentric )
+                {
+                    double lat, lon, hae;
+                    em->convertXYZToLatLongHeight(vw.x(), vw.y(), vw.z(), lat, lon, hae);
+                    c.set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat) );
+                }
+                else
+                {
+                    c.set( vw.x(), vw.y() );
+                }
+                _xmin = std::min(_xmin, c.x()); xmax = std::max(xmax, c.x());
+                _ymin = std::min(_ymin, c.y()); ymax = std::max(ymax, c.y());
+            }
+
+            unsigned size = (unsigned)ceil(sqrt((double)verts->size() / (double)VERTS_PER_CELL));
+            _cols = _rows = osg::clampBetween(size, 1u, MAX_GRID_SIZE);
+            _cellWidth  = osg::maximum((xmax - _xmin) / (double)_cols, 1e-9);
+            _cellHeight = osg::maximum((ymax - _ymin) / (double)_rows, 1e-9);
+
+            // counting sort of the vertex indices by cell:
+            std::vector<unsigned> cells( _coords.size() );
+            _cellStart.assign( _cols*_rows + 1u, 0u );
+            for(unsigned k=0; k<_coords.size(); ++k)
+            {
+                cells[k] = cellOf(_coords[k].x(), _coords[k].y());
+                ++_cellStart[cells[k] + 1u];
+            }
+            for(unsigned c=1; c<_cellStart.size(); ++c)
+                _cellStart[c] += _cellStart[c-1];
+
+            std::vector<unsigned> next( _cellStart.begin(), _cellStart.end()-1 );
+            _indices.resize( _coords.size() );
+            for(unsigned k=0; k<_coords.size(); ++k)
+                _indices[next[cells[k]]++] = k;
+        }
+
+        /** Indices of the vertices inside an extent (in the grid's SRS). */
+        void query(const GeoExtent& extent, std::vector<unsigned>& output) const
+        {
+            if ( _coords.empty() )
+                return;
+
+            unsigned c0 = column(extent.xMin()), c1 = column(extent.xMax());
+            unsigned r0 = row(extent.yMin()),    r1 = row(extent.yMax());
+
+            for(unsigned r=r0; r<=r1; ++r)
+            {
+                for(unsigned c=c0; c<=c1; ++c)
+                {
+                    unsigned cell = r*_cols + c;
+                    for(unsigned i=_cellStart[cell]; i<_cellStart[cell+1]; ++i)
+                    {
+                        const osg::Vec2d& p = _coords[_indices[i]];
+                        if ( p.x() >= extent.xMin() && p.x() <= extent.xMax() &&
+                             p.y() >= extent.yMin() && p.y() <= extent.yMax() )
+                        {
+                            output.push_back( _indices[i] );
+                        }
+                    }
+                }
+            }
+        }
+
+    protected:
+        virtual ~ClampingGrid() { }
+
+        unsigned column(double x) const {
+            double c = floor((x - _xmin) / _cellWidth);
+            return c < 0.0 ? 0u : std::min((unsigned)c, _cols-1u);
+        }
+
+        unsigned row(double y) const {
+            double r = floor((y - _ymin) / _cellHeight);
+            return r < 0.0 ? 0u : std::min((unsigned)r, _rows-1u);
+        }
+
+        unsigned cellOf(double x, double y) const { return row(y)*_cols + column(x); }
+
+        osg::Matrixd             _local2world;
+        double                   _xmin, _ymin;
+        double                   _cellWidth, _cellHeight;
+        unsigned                 _cols, _rows;
+        std::vector<osg::Vec2d>  _coords;      // horizontal terrain coordinates, per vertex
+        std::vector<unsigned>    _cellStart;   // offset of each cell's run in _indices
+        std::vector<unsigned>    _indices;     // vertex indices, grouped by cell
+    };
+}
 
 //-----------------------------------------------------------------------
 
@@ -74,6 +214,21 @@ GeometryClamper::apply(osg::Geode& geode)
 
     unsigned count = 0;
 
+    // when the patch extent is known, only the vertices inside it can change.
+    GeoExtent patchExtent;
+    if ( _terrainPatchExtent.isValid() )
+    {
+        patchExtent = _terrainPatchExtent.getSRS()->isHorizEquivalentTo(_terrainSRS.get()) ?
+            _terrainPatchExtent :
+            _terrainPatchExtent.transform(_terrainSRS.get());
+
+        // the grid doesn't wrap, so fall back on visiting everything.
+        if ( patchExtent.isValid() && patchExtent.crossesAntimeridian() )
+            patchExtent = GeoExtent::INVALID;
+    }
+
+    std::vector<unsigned> candidates;
+
     for( unsigned i=0; i<geode.getNumDrawables(); ++i )
     {
         bool geomDirty = false;
@@ -105,8 +260,38 @@ GeometryClamper::apply(osg::Geode& geode)
                 }
             }
 
-            for( unsigned k=0; k<verts->size(); ++k )
+            // the z-offsets array is built in vertex order, so the first pass
+            // must visit every vertex.
+            bool useGrid = patchExtent.isValid() && !buildZOffsets;
+            if ( useGrid )
+            {
+                osg::UserDataContainer* udc = geom->getOrCreateUserDataContainer();
+                ClampingGrid* grid = 0L;
+                unsigned n = udc->getUserObjectIndex( GRID_NAME );
+                if ( n < udc->getNumUserObjects() )
+                {
+                    grid = dynamic_cast<ClampingGrid*>(udc->getUserObject(n));
+                }
+                if ( !grid )
+                {
+                    grid = new ClampingGrid();
+                    grid->setName( GRID_NAME );
+                    udc->addUserObject( grid );
+                }
+                if ( !grid->isValidFor(verts, local2world) )
+                {
+                    grid->build( verts, local2world, _terrainSRS.get() );
+                }
+
+                candidates.clear();
+                grid->query( patchExtent, candidates );
+            }
+
+            unsigned numToClamp = useGrid ? candidates.size() : verts->size();
+
+            for( unsigned c=0; c<numToClamp; ++c )
             {
+                unsigned k = useGrid ? candidates[c] : c;
                 osg::Vec3d vw = (*verts)[k];
                 vw = vw * local2world;
 
@@ -194,5 +379,6 @@ GeometryClamperCallback::onTileAdded(const TileKey&          key,
                                      osg::Node*              tile, 
                                      TerrainCallbackContext& context)
 {
+    _clamper.setTerrainPatchExtent( key.getExtent() );
     tile->accept( _clamper );
 }
@@ -32,6 +32,7 @@
 #include <iterator>
 #include <iostream>
 #include <algorithm>
+#include <list>
 #include <curl/curl.h>
 
 // Whether to use WinInet instead of cURL - CMAKE option
@@ -124,12 +125,16 @@ namespace osgEarth
 
         void writeHeader(const char* ptr, size_t realsize)
         {            
-            std::string header(ptr);            
-            StringTokenizer tok(":");
-            StringVector tized;
-            tok.tokenize(header, tized);            
-            if ( tized.size() >= 2 )
-                _headers[tized[0]] = tized[1];                
+            // split on the first colon only; values like Last-Modified contain colons.
+            std::string header(ptr, realsize);
+            std::string::size_type colon = header.find(':');
+            if ( colon != std::string::npos && colon > 0 )
+            {
+                std::string name  = trim(header.substr(0, colon));
+                std::string value = trim(header.substr(colon+1));
+                if ( !name.empty() )
+                    _headers[name] = value;
+            }
         }
 
         std::ostream* _stream;
@@ -244,6 +249,11 @@ void HTTPRequest::setLastModified( const DateTime &lastModified)
     addHeader("If-Modified-Since", lastModified.asRFC1123());
 }
 
+void HTTPRequest::setETag( const std::string& etag )
+{
+    addHeader("If-None-Match", etag);
+}
+
 
 std::string
 HTTPRequest::getURL() const
@@ -283,8 +293,8 @@ _response_code( rhs._response_code ),
 _parts( rhs._parts ),
 _mimeType( rhs._mimeType ),
 _cancelled( rhs._cancelled ),
-_duration_s(0.0),
-_lastModified(0u)
+_duration_s( rhs._duration_s ),
+_lastModified( rhs._lastModified )
 {
     //nop
 }
@@ -380,6 +390,44 @@ namespace
     static osg::ref_ptr< URLRewriter > s_rewriter;
 
     static osg::ref_ptr< CurlConfigHandler > s_curlConfigHandler;
+
+    // asynchronous engine settings
+    static bool                        s_asyncEnabled = ::getenv("OSGEARTH_HTTP_ASYNC") != 0L;
+    static unsigned                    s_maxRequestsPerHost = 0u; // 0 = not yet initialized
+
+    // DNS and SSL session caches shared by all curl handles
+    static CURLSH*                     s_curlShare = 0L;
+    static Threading::Mutex            s_curlShareMutex[CURL_LOCK_DATA_LAST];
+
+    void curlShareLock(CURL*, curl_lock_data data, curl_lock_access, void*)
+    {
+        s_curlShareMutex[data].lock();
+    }
+
+    void curlShareUnlock(CURL*, curl_lock_data data, void*)
+    {
+        s_curlShareMutex[data].unlock();
+    }
+
+    // Whether a request made through a proxy failed to get through it. That
+    // says nothing about the resource itself, so callers report it as a
+    // cancellation, which layers retry instead of blacklisting the tile.
+    bool proxyConnectFailed(CURL* handle, CURLcode result)
+    {
+        long connect_code = 0L;
+        CURLcode r = curl_easy_getinfo( handle, CURLINFO_HTTP_CONNECTCODE, &connect_code );
+        if ( r != CURLE_OK )
+        {
+            OE_WARN << LC << "Proxy connect error: " << curl_easy_strerror(r) << std::endl;
+            return true;
+        }
+        if ( result == CURLE_COULDNT_RESOLVE_PROXY )
+        {
+            OE_WARN << LC << "Proxy connect error: " << curl_easy_strerror(result) << std::endl;
+            return true;
+        }
+        return false;
+    }
 }
 
 HTTPClient&
@@ -458,6 +506,12 @@ HTTPClient::initializeImpl()
     // Note that you must have curl built against zlib to support gzip or deflate encoding.
     curl_easy_setopt( _curl_handle, CURLOPT_ENCODING, "");
 
+    // Share DNS lookups and SSL sessions with the other threads' handles.
+    if ( s_curlShare )
+    {
+        curl_easy_setopt( _curl_handle, CURLOPT_SHARE, s_curlShare );
+    }
+
     osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
     if (curlConfigHandler.valid()) {
         curlConfigHandler->onInitialize(_curl_handle);
@@ -548,6 +602,56 @@ void
 HTTPClient::globalInit()
 {
     curl_global_init(CURL_GLOBAL_ALL);
+
+    if ( !s_curlShare )
+    {
+        s_curlShare = curl_share_init();
+        curl_share_setopt( s_curlShare, CURLSHOPT_LOCKFUNC, curlShareLock );
+        curl_share_setopt( s_curlShare, CURLSHOPT_UNLOCKFUNC, curlShareUnlock );
+        curl_share_setopt( s_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+#if LIBCURL_VERSION_NUM >= 0x071700
+        curl_share_setopt( s_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+#endif
+    }
+}
+
+void
+HTTPClient::setAsyncEnabled(bool value)
+{
+    s_asyncEnabled = value;
+}
+
+bool
+HTTPClient::isAsyncEnabled()
+{
+    return s_asyncEnabled;
+}
+
+void
+HTTPClient::setMaxRequestsPerHost(unsigned value)
+{
+    s_maxRequestsPerHost = osg::maximum(value, 1u);
+}
+
+unsigned
+HTTPClient::getMaxRequestsPerHost()
+{
+    if ( s_maxRequestsPerHost == 0u )
+    {
+        const char* maxEnv = ::getenv("OSGEARTH_HTTP_MAX_PER_HOST");
+        s_maxRequestsPerHost = osg::maximum(maxEnv ? as<unsigned>(std::string(maxEnv), 8u) : 8u, 1u);
+    }
+    return s_maxRequestsPerHost;
+}
+
+const HTTPResponse&
+HTTPFuture::get()
+{
+    while( !_ready.isSet() )
+    {
+        _ready.wait();
+    }
+    return _response;
 }
 
 void
@@ -573,6 +677,68 @@ HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host,
     }
 }
 
+void
+HTTPClient::resolveProxy(const osgDB::Options* options, std::string& proxy_addr, std::string& proxy_auth) const
+{
+    std::string proxy_host;
+    std::string proxy_port = "8080";
+
+    //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when 
+    // the proxy information changes.
+
+    //Try to get the proxy settings from the global settings
+    if (s_proxySettings.isSet())
+    {
+        proxy_host = s_proxySettings.get().hostName();
+        std::stringstream buf;
+        buf << s_proxySettings.get().port();
+        proxy_port = buf.str();
+
+        std::string proxy_username = s_proxySettings.get().userName();
+        std::string proxy_password = s_proxySettings.get().password();
+        if (!proxy_username.empty() && !proxy_password.empty())
+        {
+            proxy_auth = proxy_username + std::string(":") + proxy_password;
+        }
+    }
+
+    //Try to get the proxy settings from the local options that are passed in.
+    readOptions( options, proxy_host, proxy_port );
+
+    optional< ProxySettings > proxySettings;
+    ProxySettings::fromOptions( options, proxySettings );
+    if (proxySettings.isSet())
+    {       
+        proxy_host = proxySettings.get().hostName();
+        proxy_port = toString<int>(proxySettings.get().port());
+        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
+    }
+
+    //Try to get the proxy settings from the environment variable
+    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
+    if (proxyEnvAddress) //Env Proxy Settings
+    {
+        proxy_host = std::string(proxyEnvAddress);
+
+        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
+        if (proxyEnvPort)
+        {
+            proxy_port = std::string( proxyEnvPort );
+        }
+    }
+
+    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
+    if (proxyEnvAuth)
+    {
+        proxy_auth = std::string(proxyEnvAuth);
+    }
+
+    if ( !proxy_host.empty() )
+    {
+        proxy_addr = proxy_host + ":" + proxy_port;
+    }
+}
+
 bool
 HTTPClient::decodeMultipartStream(const std::string&   boundary,
                                   HTTPResponse::Part*  input,
@@ -955,6 +1121,28 @@ HTTPClient::doGet(const HTTPRequest&    request,
     return response;
 }
 
+
+osg::ref_ptr<HTTPFuture>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress,
+                     HTTPResponseCallback* callback)
+{
+    // No multi-request engine for WinInet; run the request synchronously.
+    osg::ref_ptr<HTTPFuture> future = new HTTPFuture();
+    HTTPResponse response = getClient().doGet( request, options, progress );
+    if ( callback )
+        callback->onResponse( request, response );
+    resolveAsync( future.get(), response );
+    return future;
+}
+
+void
+HTTPClient::shutdownAsync()
+{
+    //nop
+}
+
 #else // OSGEARTH_USE_WININET_FOR_HTTP
 
 HTTPResponse
@@ -962,6 +1150,21 @@ HTTPClient::doGet(const HTTPRequest&    request,
                   const osgDB::Options* options, 
                   ProgressCallback*     progress) const
 {    
+    if ( isAsyncEnabled() )
+    {
+        // run on the shared engine and wait; this lets blocking callers
+        // share connections and HTTP/2 sessions with everyone else.
+        HTTPResponse response = getAsync( request, options, progress )->get();
+        if ( progress )
+        {
+            progress->stats()["http_get_time"] += response.getDuration();
+            progress->stats()["http_get_count"] += 1;
+            if ( response.isCancelled() )
+                progress->stats()["http_cancel_count"] += 1;
+        }
+        return response;
+    }
+
     initialize();
 
     OE_START_TIMER(http_get);
@@ -972,71 +1175,13 @@ HTTPClient::doGet(const HTTPRequest&    request,
             options->getAuthenticationMap() :
             osgDB::Registry::instance()->getAuthenticationMap();
 
-    std::string proxy_host;
-    std::string proxy_port = "8080";
-
+    std::string proxy_addr;
     std::string proxy_auth;
-
-    //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when 
-    // the proxy information changes.
-
-    //Try to get the proxy settings from the global settings
-    if (s_proxySettings.isSet())
-    {
-        proxy_host = s_proxySettings.get().hostName();
-        std::stringstream buf;
-        buf << s_proxySettings.get().port();
-        proxy_port = buf.str();
-
-        std::string proxy_username = s_proxySettings.get().userName();
-        std::string proxy_password = s_proxySettings.get().password();
-        if (!proxy_username.empty() && !proxy_password.empty())
-        {
-            proxy_auth = proxy_username + std::string(":") + proxy_password;
-        }
-    }
-
-    //Try to get the proxy settings from the local options that are passed in.
-    readOptions( options, proxy_host, proxy_port );
-
-    optional< ProxySettings > proxySettings;
-    ProxySettings::fromOptions( options, proxySettings );
-    if (proxySettings.isSet())
-    {       
-        proxy_host = proxySettings.get().hostName();
-        proxy_port = toString<int>(proxySettings.get().port());
-        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
-    }
-
-    //Try to get the proxy settings from the environment variable
-    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
-    if (proxyEnvAddress) //Env Proxy Settings
-    {
-        proxy_host = std::string(proxyEnvAddress);
-
-        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
-        if (proxyEnvPort)
-        {
-            proxy_port = std::string( proxyEnvPort );
-        }
-    }
-
-    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
-    if (proxyEnvAuth)
-    {
-        proxy_auth = std::string(proxyEnvAuth);
-    }
+    resolveProxy( options, proxy_addr, proxy_auth );
 
     // Set up proxy server:
-    std::string proxy_addr;
-    if ( !proxy_host.empty() )
+    if ( !proxy_addr.empty() )
     {
-        std::stringstream buf;
-        buf << proxy_host << ":" << proxy_port;
-        std::string bufStr;
-        bufStr = buf.str();
-        proxy_addr = bufStr;
-    
         if ( s_HTTP_DEBUG )
         {
             OE_NOTICE << LC << "Using proxy: " << proxy_addr << std::endl;
@@ -1164,15 +1309,13 @@ HTTPClient::doGet(const HTTPRequest&    request,
         curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)0 );
         curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSDATA, (void*)0);
 
-        if (!proxy_addr.empty())
+        if ( !proxy_addr.empty() && proxyConnectFailed(_curl_handle, res) )
         {
-            long connect_code = 0L;
-            CURLcode r = curl_easy_getinfo(_curl_handle, CURLINFO_HTTP_CONNECTCODE, &connect_code);
-            if ( r != CURLE_OK )
-            {
-                OE_WARN << LC << "Proxy connect error: " << curl_easy_strerror(r) << std::endl;
-                return HTTPResponse(0);
-            }
+            if ( headers )
+                curl_slist_free_all( headers );
+            HTTPResponse response(0);
+            response._cancelled = true;
+            return response;
         }
 
         curl_easy_getinfo( _curl_handle, CURLINFO_RESPONSE_CODE, &response_code );        
@@ -1301,6 +1444,467 @@ HTTPClient::doGet(const HTTPRequest&    request,
     return response;
 }
 
+
+//----------------------------------------------------------------------------
+// Asynchronous engine: one curl_multi handle serviced by one I/O thread.
+
+class HTTPClient::AsyncEngine : public OpenThreads::Thread
+{
+public:
+    struct Job : public osg::Referenced
+    {
+        Job(const HTTPRequest& request) :
+            _request( request ),
+            _handle ( 0L ),
+            _headers( 0L ),
+            _sp     ( 0L ),
+            _viaProxy( false ),
+            _start  ( osg::Timer::instance()->tick() ) { }
+
+        virtual ~Job()
+        {
+            if ( _handle ) curl_easy_cleanup( _handle );
+            if ( _headers ) curl_slist_free_all( _headers );
+            delete _sp;
+        }
+
+        HTTPRequest                        _request;
+        std::string                        _url;
+        std::string                        _host;
+        CURL*                              _handle;
+        struct curl_slist*                 _headers;
+        StreamObject*                      _sp;
+        bool                               _viaProxy;
+        HTTPResponse                       _response;
+        osg::ref_ptr<HTTPFuture>           _future;
+        osg::ref_ptr<HTTPResponseCallback> _callback;
+        osg::ref_ptr<ProgressCallback>     _progress;
+        osg::Timer_t                       _start;
+    };
+
+    AsyncEngine() :
+        _done           ( 0u ),
+        _simResponseCode( -1L )
+    {
+        _multi = curl_multi_init();
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        // multiplex requests to the same host over one HTTP/2 connection
+        curl_multi_setopt( _multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+#endif
+
+        const char* simCode = ::getenv("OSGEARTH_SIMULATE_HTTP_RESPONSE_CODE");
+        if ( simCode )
+            _simResponseCode = osgEarth::as<long>(std::string(simCode), 404L);
+
+        if ( ::getenv("OSGEARTH_HTTP_DISABLE") )
+            _simResponseCode = 503L;
+
+        if ( ::getenv("OSGEARTH_HTTP_DEBUG") )
+            s_HTTP_DEBUG = true;
+
+        start();
+    }
+
+    virtual ~AsyncEngine()
+    {
+        _done.exchange( 1u );
+        wakeup();
+        join();
+
+        // fail anything still outstanding so no one waits forever.
+        for(ActiveJobs::iterator i = _active.begin(); i != _active.end(); ++i)
+        {
+            curl_multi_remove_handle( _multi, i->second->_handle );
+            complete( i->second.get(), CURLE_ABORTED_BY_CALLBACK );
+        }
+        for(Jobs::iterator i = _pending.begin(); i != _pending.end(); ++i)
+        {
+            complete( i->get(), CURLE_ABORTED_BY_CALLBACK );
+        }
+
+        curl_multi_cleanup( _multi );
+    }
+
+    long getSimResponseCode() const { return _simResponseCode; }
+
+    void submit(Job* job)
+    {
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _pending.push_back( job );
+        }
+        wakeup();
+    }
+
+    void run()
+    {
+        while( _done == 0u )
+        {
+            startPending();
+
+            int running = 0;
+            curl_multi_perform( _multi, &running );
+
+            CURLMsg* msg;
+            int remaining;
+            while( (msg = curl_multi_info_read(_multi, &remaining)) != 0L )
+            {
+                if ( msg->msg == CURLMSG_DONE )
+                {
+                    ActiveJobs::iterator i = _active.find( msg->easy_handle );
+                    if ( i != _active.end() )
+                    {
+                        osg::ref_ptr<Job> job = i->second.get();
+                        _active.erase( i );
+                        curl_multi_remove_handle( _multi, job->_handle );
+                        if ( --_perHost[job->_host] == 0u )
+                            _perHost.erase( job->_host );
+                        complete( job.get(), msg->data.result );
+                    }
+                }
+            }
+
+            int numfds = 0;
+#if LIBCURL_VERSION_NUM >= 0x074400
+            curl_multi_poll( _multi, 0L, 0, 100, &numfds );
+#else
+            // without curl_multi_wakeup, poll often enough to pick up new requests.
+            if ( _active.empty() )
+                OpenThreads::Thread::microSleep( 5000 );
+            else
+                curl_multi_wait( _multi, 0L, 0, 5, &numfds );
+#endif
+        }
+    }
+
+    static int progressCallback(void* clientp, double, double, double, double)
+    {
+        Job* job = (Job*)clientp;
+        return
+            job->_future->isCancelRequested() ||
+            (job->_progress.valid() && job->_progress->isCanceled()) ? 1 : 0;
+    }
+
+private:
+    typedef std::list< osg::ref_ptr<Job> >          Jobs;
+    typedef std::map< CURL*, osg::ref_ptr<Job> >    ActiveJobs;
+    typedef std::map< std::string, unsigned >       HostCounts;
+
+    CURLM*              _multi;
+    OpenThreads::Atomic _done;
+    long                _simResponseCode;
+    Threading::Mutex    _mutex;
+    Jobs                _pending;   // protected by _mutex
+    ActiveJobs          _active;    // I/O thread only
+    HostCounts          _perHost;   // I/O thread only
+
+    void wakeup()
+    {
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_wakeup( _multi );
+#endif
+    }
+
+    // moves pending jobs into the multi handle, respecting the per-host limit.
+    void startPending()
+    {
+        unsigned maxPerHost = HTTPClient::getMaxRequestsPerHost();
+        Jobs cancelled;
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            for(Jobs::iterator i = _pending.begin(); i != _pending.end(); )
+            {
+                Job* job = i->get();
+
+                if ( progressCallback(job, 0, 0, 0, 0) )
+                {
+                    cancelled.push_back( job );
+                    i = _pending.erase( i );
+                }
+                else if ( _perHost[job->_host] < maxPerHost )
+                {
+                    _perHost[job->_host]++;
+                    job->_start = osg::Timer::instance()->tick();
+                    _active[job->_handle] = job;
+                    curl_multi_add_handle( _multi, job->_handle );
+                    i = _pending.erase( i );
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+        }
+
+        for(Jobs::iterator i = cancelled.begin(); i != cancelled.end(); ++i)
+        {
+            complete( i->get(), CURLE_ABORTED_BY_CALLBACK );
+        }
+    }
+
+    void complete(Job* job, CURLcode result)
+    {
+        double duration_s = osg::Timer::instance()->delta_s( job->_start, osg::Timer::instance()->tick() );
+        HTTPClient::finishAsync( job->_handle, result, job->_viaProxy, duration_s, job->_sp->_headers, job->_response );
+
+        if ( s_HTTP_DEBUG )
+        {
+            OE_NOTICE << LC
+                << "GET(" << job->_response.getCode() << ", " << job->_response.getMimeType() << ") : \""
+                << job->_url << "\" t="
+                << std::setprecision(4) << job->_response.getDuration() << "s (async)" << std::endl;
+        }
+
+        if ( job->_callback.valid() )
+            job->_callback->onResponse( job->_request, job->_response );
+
+        HTTPClient::resolveAsync( job->_future.get(), job->_response );
+    }
+};
+
+namespace
+{
+    // The engine is stopped by HTTPClient::shutdownAsync(), not here: a
+    // running thread must not be torn down during static destruction.
+    struct AsyncEngineHolder
+    {
+        AsyncEngineHolder() : _engine(0L) { }
+        OpenThreads::Thread* _engine;
+        Threading::Mutex     _mutex;
+    };
+    static AsyncEngineHolder s_asyncEngine;
+
+    // scheme://host:port portion of a URL, for per-host accounting.
+    std::string getHostKey(const std::string& url)
+    {
+        std::string::size_type start = url.find("://");
+        start = start == std::string::npos ? 0 : start + 3;
+        std::string::size_type end = url.find_first_of("/?#", start);
+        return url.substr(0, end);
+    }
+}
+
+void
+HTTPClient::shutdownAsync()
+{
+    OpenThreads::Thread* engine = 0L;
+    {
+        Threading::ScopedMutexLock lock( s_asyncEngine._mutex );
+        engine = s_asyncEngine._engine;
+        s_asyncEngine._engine = 0L;
+    }
+
+    // stops and joins the I/O thread, failing anything still outstanding.
+    delete engine;
+}
+
+void
+HTTPClient::finishAsync(void* curl_handle, int curl_result, bool viaProxy, double duration_s, const Headers& headers, HTTPResponse& response)
+{
+    response._duration_s = duration_s;
+
+    if ( viaProxy && proxyConnectFailed((CURL*)curl_handle, (CURLcode)curl_result) )
+    {
+        response._response_code = 0L;
+        response._parts.clear();
+        response._cancelled = true;
+        return;
+    }
+
+    curl_easy_getinfo( curl_handle, CURLINFO_RESPONSE_CODE, &response._response_code );
+
+    char* content_type_cp = 0L;
+    curl_easy_getinfo( curl_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
+    if ( content_type_cp != NULL )
+    {
+        response._mimeType = content_type_cp;
+    }
+
+    response._lastModified = getCurlFileTime( curl_handle );
+
+    if ( curl_result != CURLE_ABORTED_BY_CALLBACK && curl_result != CURLE_OPERATION_TIMEDOUT )
+    {
+        osg::ref_ptr<HTTPResponse::Part> part = response._parts[0].get();
+
+        if (response._mimeType.length() > 9 && 
+            ::strstr( response._mimeType.c_str(), "multipart" ) == response._mimeType.c_str() )
+        {
+            response._parts.clear();
+            getClient().decodeMultipartStream( "wcs", part.get(), response._parts );
+        }
+        else
+        {
+            for (Headers::const_iterator itr = headers.begin(); itr != headers.end(); ++itr)
+            {
+                part->_headers[itr->first] = itr->second;
+            }
+        }
+    }
+    else
+    {
+        response._parts.clear();
+        response._cancelled = true;
+    }
+}
+
+void
+HTTPClient::resolveAsync(HTTPFuture* future, const HTTPResponse& response)
+{
+    future->_response = response;
+    future->_ready.set();
+}
+
+osg::ref_ptr<HTTPFuture>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress,
+                     HTTPResponseCallback* callback)
+{
+    AsyncEngine* engine;
+    {
+        Threading::ScopedMutexLock lock( s_asyncEngine._mutex );
+        if ( !s_asyncEngine._engine )
+            s_asyncEngine._engine = new AsyncEngine();
+        engine = static_cast<AsyncEngine*>( s_asyncEngine._engine );
+    }
+
+    osg::ref_ptr<AsyncEngine::Job> job = new AsyncEngine::Job( request );
+    job->_future   = new HTTPFuture();
+    job->_callback = callback;
+    job->_progress = progress;
+
+    // the body streams directly into the first response part:
+    job->_response._parts.push_back( new HTTPResponse::Part() );
+    job->_sp = new StreamObject( &job->_response._parts[0]->_stream );
+
+    if ( engine->getSimResponseCode() >= 0L )
+    {
+        // simulate failure with a custom response code; like the blocking
+        // path, a simulated 408 is reported as a timeout.
+        job->_response._response_code = engine->getSimResponseCode();
+        if ( job->_response._response_code == 408L )
+        {
+            job->_response._parts.clear();
+            job->_response._cancelled = true;
+        }
+        if ( callback )
+            callback->onResponse( request, job->_response );
+        resolveAsync( job->_future.get(), job->_response );
+        return job->_future.get();
+    }
+
+    job->_url = request.getURL();
+    osg::ref_ptr< URLRewriter > rewriter = getURLRewriter();
+    if ( rewriter.valid() )
+    {
+        job->_url = rewriter->rewrite( job->_url );
+    }
+    job->_host = getHostKey( job->_url );
+
+    std::string userAgent = s_userAgent;
+    const char* userAgentEnv = getenv("OSGEARTH_USERAGENT");
+    if (userAgentEnv)
+    {
+        userAgent = std::string(userAgentEnv);
+    }
+
+    long timeout = s_timeout;
+    const char* timeoutEnv = getenv("OSGEARTH_HTTP_TIMEOUT");
+    if (timeoutEnv)
+    {
+        timeout = osgEarth::as<long>(std::string(timeoutEnv), 0);
+    }
+
+    long connectTimeout = s_connectTimeout;
+    const char* connectTimeoutEnv = getenv("OSGEARTH_HTTP_CONNECTTIMEOUT");
+    if (connectTimeoutEnv)
+    {
+        connectTimeout = osgEarth::as<long>(std::string(connectTimeoutEnv), 0);
+    }
+
+    CURL* h = curl_easy_init();
+    job->_handle = h;
+
+    curl_easy_setopt( h, CURLOPT_URL, job->_url.c_str() );
+    curl_easy_setopt( h, CURLOPT_USERAGENT, userAgent.c_str() );
+    curl_easy_setopt( h, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
+    curl_easy_setopt( h, CURLOPT_HEADERFUNCTION, osgEarth::StreamObjectHeaderCallback );
+    curl_easy_setopt( h, CURLOPT_WRITEDATA, (void*)job->_sp );
+    curl_easy_setopt( h, CURLOPT_HEADERDATA, (void*)job->_sp );
+    curl_easy_setopt( h, CURLOPT_FOLLOWLOCATION, (void*)1 );
+    curl_easy_setopt( h, CURLOPT_MAXREDIRS, (void*)5 );
+    curl_easy_setopt( h, CURLOPT_PROGRESSFUNCTION, &AsyncEngine::progressCallback );
+    curl_easy_setopt( h, CURLOPT_PROGRESSDATA, (void*)job.get() );
+    curl_easy_setopt( h, CURLOPT_NOPROGRESS, (void*)0 );
+    curl_easy_setopt( h, CURLOPT_FILETIME, true );
+    curl_easy_setopt( h, CURLOPT_ENCODING, "" );
+    curl_easy_setopt( h, CURLOPT_TIMEOUT, timeout );
+    curl_easy_setopt( h, CURLOPT_CONNECTTIMEOUT, connectTimeout );
+    curl_easy_setopt( h, CURLOPT_SSL_VERIFYPEER, (void*)0 );
+    curl_easy_setopt( h, CURLOPT_PRIVATE, (void*)job.get() );
+
+    if ( s_curlShare )
+    {
+        curl_easy_setopt( h, CURLOPT_SHARE, s_curlShare );
+    }
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    // negotiate HTTP/2 over TLS when the server supports it
+    curl_easy_setopt( h, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+    // prefer waiting for a connection we can multiplex over opening a new one
+    curl_easy_setopt( h, CURLOPT_PIPEWAIT, 1L );
+#endif
+
+    std::string proxy_addr, proxy_auth;
+    getClient().resolveProxy( options, proxy_addr, proxy_auth );
+    if ( !proxy_addr.empty() )
+    {
+        job->_viaProxy = true;
+        curl_easy_setopt( h, CURLOPT_PROXY, proxy_addr.c_str() );
+        if ( !proxy_auth.empty() )
+            curl_easy_setopt( h, CURLOPT_PROXYUSERPWD, proxy_auth.c_str() );
+    }
+
+    const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ? 
+        options->getAuthenticationMap() :
+        osgDB::Registry::instance()->getAuthenticationMap();
+
+    const osgDB::AuthenticationDetails* details = authenticationMap ?
+        authenticationMap->getAuthenticationDetails( job->_url ) :
+        0;
+
+    if ( details )
+    {
+        std::string password(details->username + ":" + details->password);
+        curl_easy_setopt( h, CURLOPT_USERPWD, password.c_str() );
+#if LIBCURL_VERSION_NUM >= 0x070a07
+        curl_easy_setopt( h, CURLOPT_HTTPAUTH, details->httpAuthentication );
+#endif
+    }
+
+    for (Headers::const_iterator itr = request.getHeaders().begin(); itr != request.getHeaders().end(); ++itr)
+    {
+        std::string header = itr->first + ": " + itr->second;
+        job->_headers = curl_slist_append( job->_headers, header.c_str() );
+    }
+    job->_headers = curl_slist_append( job->_headers, "Pragma: " );
+    curl_easy_setopt( h, CURLOPT_HTTPHEADER, job->_headers );
+
+    osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
+    if ( curlConfigHandler.valid() )
+    {
+        curlConfigHandler->onInitialize( h );
+        curlConfigHandler->onGet( h );
+    }
+
+    osg::ref_ptr<HTTPFuture> future = job->_future.get();
+    engine->submit( job.get() );
+    return future;
+}
+
 #endif // USE_WININET
 
 bool
@@ -1385,10 +1989,19 @@ HTTPClient::doReadImage(const HTTPRequest&    request,
 {
     initialize();
 
-    ReadResult result;
-
     HTTPResponse response = this->doGet(request, options, callback);
 
+    return decodeImage(request, response, options, callback);
+}
+
+ReadResult
+HTTPClient::decodeImage(const HTTPRequest&    request,
+                        const HTTPResponse&   response,
+                        const osgDB::Options* options,
+                        ProgressCallback*     callback)
+{
+    ReadResult result;
+
     if (response.isOK())
     {
         osgDB::ReaderWriter* reader = getReader(request.getURL(), response);
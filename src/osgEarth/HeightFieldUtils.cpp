@@ -23,6 +23,7 @@
 #include <osgEarth/CullingUtils>
 #include <osgEarth/ImageUtils>
 #include <osg/Notify>
+#include <algorithm>
 
 using namespace osgEarth;
 
@@ -481,16 +482,17 @@ HeightFieldUtils::resolveInvalidHeights(osg::HeightField* grid,
         double lonInterval = geodeticExtent.width() / (double)(numCols-1);
         double latInterval = geodeticExtent.height() / (double)(numRows-1);
 
-        for( unsigned r=0; r<numRows; ++r )
+        osg::HeightField::HeightList& heights = grid->getHeightList();
+        if ( std::find(heights.begin(), heights.end(), invalidValue) != heights.end() )
         {
-            double lat = latMin + latInterval*(double)r;
-            for( unsigned c=0; c<numCols; ++c )
+            // sample the geoid for the whole grid in one pass:
+            std::vector<float> offsets( numCols*numRows );
+            geoid->getHeights( latMin, lonMin, latInterval, lonInterval, numCols, numRows, &offsets[0] );
+
+            for(unsigned i=0; i<heights.size(); ++i)
             {
-                double lon = lonMin + lonInterval*(double)c;
-                if ( grid->getHeight(c, r) == invalidValue )
-                {
-                    grid->setHeight( c, r, geoid->getHeight(lat, lon) );
-                }
+                if ( heights[i] == invalidValue )
+                    heights[i] = offsets[i];
             }
         }
     }
@@ -0,0 +1,204 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ImageCache>
+#include <osgEarth/Registry>
+
+#define LC "[ImageCache] "
+
+using namespace osgEarth;
+
+//------------------------------------------------------------------------
+
+ImageCache::ImageCache(unsigned long long maxBytes) :
+_maxBytes( maxBytes ),
+_numBytes( 0u ),
+_hits    ( 0u ),
+_misses  ( 0u )
+{
+    //nop
+}
+
+void
+ImageCache::setMaxBytes(unsigned long long value)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _maxBytes = value;
+    evict();
+}
+
+unsigned long long
+ImageCache::getMaxBytes() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _maxBytes;
+}
+
+unsigned long long
+ImageCache::getNumBytes() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _numBytes;
+}
+
+unsigned
+ImageCache::getNumHits() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _hits;
+}
+
+unsigned
+ImageCache::getNumMisses() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _misses;
+}
+
+void
+ImageCache::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _entries.clear();
+    _lru.clear();
+    _numBytes = 0u;
+}
+
+std::string
+ImageCache::makeKey(const URI& uri, const osgDB::Options* dbOptions)
+{
+    // The option string can change how a plugin decodes the image.
+    std::string key = uri.full();
+    if ( uri.optionString().isSet() )
+        key += "|" + uri.optionString().get();
+    if ( dbOptions && !dbOptions->getOptionString().empty() )
+        key += "|" + dbOptions->getOptionString();
+    return key;
+}
+
+ReadResult
+ImageCache::readImage(const URI&            uri,
+                      const osgDB::Options* dbOptions,
+                      ProgressCallback*     progress)
+{
+    // An alias map or a post-read callback makes the result depend on more
+    // than the URI, so don't share it.
+    if ( uri.empty() || URIAliasMap::from(dbOptions) || URIPostReadCallback::from(dbOptions) )
+    {
+        return uri.readImage( dbOptions, progress );
+    }
+
+    std::string key = makeKey(uri, dbOptions);
+    osg::ref_ptr<Pending> pending;
+    bool reader = false;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        EntryMap::iterator i = _entries.find(key);
+        if ( i != _entries.end() )
+        {
+            _lru.splice( _lru.begin(), _lru, i->second._lru );
+            ++_hits;
+            return i->second._result;
+        }
+
+        PendingMap::iterator p = _pending.find(key);
+        if ( p != _pending.end() )
+        {
+            pending = p->second.get();
+            ++_hits;
+        }
+        else
+        {
+            pending = new Pending();
+            _pending[key] = pending.get();
+            reader = true;
+            ++_misses;
+        }
+    }
+
+    if ( !reader )
+    {
+        while( !pending->_done.isSet() )
+            pending->_done.wait();
+
+        // the reader was canceled; that doesn't mean we are.
+        if ( pending->_result.code() == ReadResult::RESULT_CANCELED )
+            return readImage( uri, dbOptions, progress );
+
+        return pending->_result;
+    }
+
+    ReadResult result = uri.readImage( dbOptions, progress );
+
+    osg::Image* image = result.getImage();
+    if ( image )
+    {
+        image->setDataVariance( osg::Object::STATIC );
+    }
+
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        if ( image && result.succeeded() )
+        {
+            unsigned bytes = sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+            if ( bytes <= _maxBytes )
+            {
+                Entry& entry = _entries[key];
+                entry._result = result;
+                entry._bytes  = bytes;
+                _lru.push_front( key );
+                entry._lru    = _lru.begin();
+                _numBytes    += bytes;
+                evict();
+            }
+        }
+
+        _pending.erase( key );
+    }
+
+    pending->_result = result;
+    pending->_done.set();
+
+    return result;
+}
+
+void
+ImageCache::evict()
+{
+    // assumes the mutex is locked.
+    while( _numBytes > _maxBytes && !_lru.empty() )
+    {
+        EntryMap::iterator i = _entries.find( _lru.back() );
+        _numBytes -= i->second._bytes;
+        _entries.erase( i );
+        _lru.pop_back();
+    }
+}
+
+ReadResult
+ImageCache::readSharedImage(const URI&            uri,
+                            const osgDB::Options* dbOptions,
+                            ProgressCallback*     progress)
+{
+    ImageCache* cache = Registry::instance()->getImageCache();
+    return cache ?
+        cache->readImage( uri, dbOptions, progress ) :
+        uri.readImage( dbOptions, progress );
+}
@@ -28,6 +28,7 @@
 #include <osgEarth/MemCache>
 #include <osgEarth/Registry>
 #include <osgEarth/Capabilities>
+#include <osgEarth/TaskService>
 #include <osg/Version>
 #include <osgDB/WriteFile>
 #include <memory.h>
@@ -514,6 +515,60 @@ ImageLayer::createImageInNativeProfile(const TileKey&    key,
 }
 
 
+namespace
+{
+    // background refresh of an expired cached image (stale-while-revalidate)
+    struct RefreshImageTask : public TaskRequest
+    {
+        RefreshImageTask(ImageLayer* layer, const TileKey& key, const Config& cacheMetadata) :
+            _layer(layer), _key(key), _cacheMetadata(cacheMetadata) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            osg::ref_ptr<ImageLayer> layer;
+            if ( _layer.lock(layer) )
+                layer->refreshCachedImage( _key, _cacheMetadata, progress );
+        }
+
+        osg::observer_ptr<ImageLayer> _layer;
+        TileKey                       _key;
+        Config                        _cacheMetadata;
+    };
+}
+
+void
+ImageLayer::refreshCachedImage(const TileKey& key, const Config& cacheMetadata, ProgressCallback* progress)
+{
+    CacheBin* cacheBin = getCacheBin( key.getProfile() );
+    if ( !cacheBin || !getCacheSettings()->cachePolicy()->isCacheWriteable() )
+        return;
+
+    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature();
+
+    // send the record's validators, so an unchanged remote tile costs only a 304.
+    osg::ref_ptr<RevalidationProgress> revalidation = new RevalidationProgress( progress, cacheMetadata );
+    GeoImage result = createImageFromTileSource( key, revalidation.get() );
+    revalidation->finish();
+
+    if ( revalidation->notModified() )
+    {
+        cacheBin->touch( cacheKey );
+        OE_DEBUG << LC << "Revalidated cached image for " << key.str() << std::endl;
+    }
+    else if ( result.valid() )
+    {
+        ImageUtils::fixInternalFormat( result.getImage() );
+
+        cacheBin->write(cacheKey, result.getImage(), revalidation->getCacheMetadata(), 0L);
+
+        if ( _memCacheBin.valid() )
+            _memCacheBin->write(cacheKey, result.getImage(), 0L);
+
+        OE_DEBUG << LC << "Refreshed cached image for " << key.str() << std::endl;
+    }
+}
+
+
 GeoImage
 ImageLayer::createImageInKeyProfile(const TileKey&    key, 
                                     ProgressCallback* progress)
@@ -540,9 +595,9 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
     
     // Check the layer L2 cache first
-    if ( _memCache.valid() )
+    if ( _memCacheBin.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        CacheBin* bin = _memCacheBin.get();
         ReadResult result = bin->readObject(cacheKey, 0L);
         if ( result.succeeded() )
             return GeoImage(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
@@ -573,6 +628,7 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     }
 
     osg::ref_ptr< osg::Image > cachedImage;
+    Config cachedMetadata;
 
     // First, attempt to read from the cache. Since the cached data is stored in the
     // map profile, we can try this first.
@@ -581,6 +637,7 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         ReadResult r = cacheBin->readImage(cacheKey, 0L);
         if ( r.succeeded() )
         {
+            cachedMetadata = r.metadata();
             cachedImage = r.releaseImage();
             ImageUtils::fixInternalFormat( cachedImage.get() );            
             bool expired = policy.isExpired(r.lastModifiedTime());
@@ -589,6 +646,19 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
                 OE_DEBUG << "Got cached image for " << key.str() << std::endl;                
                 return GeoImage( cachedImage.get(), key.getExtent() );                        
             }
+            else if ( policy.staleWhileRevalidate() == true && !policy.isCacheOnly() && policy.isCacheWriteable() )
+            {
+                // use the expired image for now, and replace it in the background.
+                CacheRefreshService::instance()->schedule(
+                    cacheBin->getID() + "/" + cacheKey,
+                    new RefreshImageTask(this, key, cachedMetadata) );
+
+                // keep it in memory so it isn't read from disk again for every request.
+                if ( _memCacheBin.valid() )
+                    _memCacheBin->write(cacheKey, cachedImage.get(), 0L);
+
+                return GeoImage( cachedImage.get(), key.getExtent() );
+            }
             else
             {
                 OE_DEBUG << "Expired image for " << key.str() << std::endl;                
@@ -602,6 +672,9 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         // If it's cache only and we have an expired but cached image, just return it.
         if (cachedImage.valid())
         {
+            if ( _memCacheBin.valid() )
+                _memCacheBin->write(cacheKey, cachedImage.get(), 0L);
+
             return GeoImage( cachedImage.get(), key.getExtent() );            
         }
         else
@@ -610,25 +683,57 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         }
     }
 
-    // Get an image from the underlying TileSource.
-    result = createImageFromTileSource( key, progress );
+    // Get an image from the underlying TileSource. The revalidation callback collects
+    // the HTTP validators to store with the cache record, and sends those of the
+    // expired record (if any) so an unchanged remote tile costs only a 304.
+    osg::ref_ptr<RevalidationProgress> revalidation = new RevalidationProgress( progress, cachedMetadata );
+    result = createImageFromTileSource( key, revalidation.get() );
+    revalidation->finish();
+
+    bool fromCache = false;
+
+    if ( cachedImage.valid() && revalidation->notModified() )
+    {
+        OE_DEBUG << LC << "Expired image for " << key.str() << " not modified" << std::endl;
+
+        // the record is still good; just renew its timestamp.
+        if ( cacheBin && policy.isCacheWriteable() )
+            cacheBin->touch( cacheKey );
+
+        result = GeoImage( cachedImage.get(), key.getExtent() );
+        fromCache = true;
+    }
 
     // Normalize the image if necessary
-    if ( result.valid() )
+    else if ( result.valid() )
     {
+        OE_DEBUG << LC << key.str() << " result OK" << std::endl;
         ImageUtils::fixInternalFormat( result.getImage() );
     }
 
+    else
+    {
+        OE_DEBUG << LC << key.str() << "result INVALID" << std::endl;        
+        // We couldn't get an image from the source.  So see if we have an expired cached image
+        if (cachedImage.valid())
+        {
+            OE_DEBUG << LC << "Using cached but expired image for " << key.str() << std::endl;
+            result = GeoImage( cachedImage.get(), key.getExtent());
+            fromCache = true;
+        }
+    }
+
     // memory cache first:
-    if ( result.valid() && _memCache.valid() )
+    if ( result.valid() && _memCacheBin.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        CacheBin* bin = _memCacheBin.get();
         bin->write(cacheKey, result.getImage(), 0L);
     }
 
     // If we got a result, the cache is valid and we are caching in the map profile,
     // write to the map cache.
     if (result.valid()  &&
+        !fromCache      &&
         cacheBin        && 
         policy.isCacheWriteable())
     {
@@ -637,22 +742,7 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
             OE_INFO << LC << "WARNING! mismatched extents." << std::endl;
         }
 
-        cacheBin->write(cacheKey, result.getImage(), 0L);
-    }
-
-    if ( result.valid() )
-    {
-        OE_DEBUG << LC << key.str() << " result OK" << std::endl;
-    }
-    else
-    {
-        OE_DEBUG << LC << key.str() << "result INVALID" << std::endl;        
-        // We couldn't get an image from the source.  So see if we have an expired cached image
-        if (cachedImage.valid())
-        {
-            OE_DEBUG << LC << "Using cached but expired image for " << key.str() << std::endl;
-            result = GeoImage( cachedImage.get(), key.getExtent());
-        }
+        cacheBin->write(cacheKey, result.getImage(), revalidation->getCacheMetadata(), 0L);
     }
 
     return result;
@@ -23,6 +23,11 @@
 #include <osgEarth/TileSource>
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/URI>
+#include <osgEarth/TaskService>
+#include <OpenThreads/Thread>
+#include <osg/Timer>
+#include <algorithm>
+#include <iomanip>
 #include <iterator>
 
 using namespace osgEarth;
@@ -381,23 +386,127 @@ Map::endUpdate()
     }
 }
 
+struct Map::OpenLayerTask
+{
+    OpenLayerTask() : _seconds(0.0) { }
+
+    void execute()
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        _map->openLayer( _layer.get() );
+        _seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+    }
+
+    std::string getName() const
+    {
+        if ( TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(_layer.get()) )
+            return terrainLayer->getName();
+        if ( ModelLayer* modelLayer = dynamic_cast<ModelLayer*>(_layer.get()) )
+            return modelLayer->getName();
+        return "";
+    }
+
+    Map*                 _map;
+    osg::ref_ptr<Layer>  _layer;
+    double               _seconds;
+};
+
 void
-Map::addImageLayer( ImageLayer* layer )
+Map::openLayer(Layer* layer)
 {
-    osgEarth::Registry::instance()->clearBlacklist();
-    unsigned int index = -1;
-    if ( layer )
+    if ( TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer) )
     {
         // Set the DB options for the map from the layer, including the cache policy.
-        layer->setReadOptions( _readOptions.get() );
+        terrainLayer->setReadOptions( _readOptions.get() );
 
         // Tell the layer the map profile, if possible:
         if ( _profile.valid() )
         {
-            layer->setTargetProfileHint( _profile.get() );
+            terrainLayer->setTargetProfileHint( _profile.get() );
         }
 
-        layer->open();
+        terrainLayer->open();
+    }
+
+    else if ( ModelLayer* modelLayer = dynamic_cast<ModelLayer*>(layer) )
+    {
+        modelLayer->setReadOptions( _readOptions.get() );
+        modelLayer->open();
+    }
+}
+
+bool
+Map::wasOpened(Layer* layer)
+{
+    Threading::ScopedMutexLock lock( _openedLayersMutex );
+    return _openedLayers.erase( layer ) > 0;
+}
+
+void
+Map::openLayers(const std::vector< osg::ref_ptr<Layer> >& layers)
+{
+    if ( layers.empty() )
+        return;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    // Opening is mostly I/O, so use more threads than cores on small machines.
+    unsigned numThreads = osg::minimum(
+        (unsigned)layers.size(),
+        (unsigned)osg::maximum(OpenThreads::GetNumberOfProcessors(), 4) );
+
+    osg::ref_ptr<TaskService> service = new TaskService( "Map layer open", numThreads );
+    Threading::MultiEvent semaphore;
+    semaphore.reset( layers.size() );
+
+    std::vector< osg::ref_ptr< ParallelTask<OpenLayerTask> > > jobs;
+    for(unsigned i=0; i<layers.size(); ++i)
+    {
+        ParallelTask<OpenLayerTask>* job = new ParallelTask<OpenLayerTask>( &semaphore );
+        job->_map   = this;
+        job->_layer = layers[i].get();
+        jobs.push_back( job );
+        service->add( job );
+    }
+
+    semaphore.wait();
+
+    {
+        Threading::ScopedMutexLock lock( _openedLayersMutex );
+        _openedLayers.insert( layers.begin(), layers.end() );
+    }
+
+    // Startup report, slowest layers first.
+    double elapsed = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+    double total = 0.0;
+    std::vector< std::pair<double, std::string> > report;
+    for(unsigned i=0; i<jobs.size(); ++i)
+    {
+        total += jobs[i]->_seconds;
+        report.push_back( std::make_pair(jobs[i]->_seconds, jobs[i]->getName()) );
+    }
+
+    std::sort( report.begin(), report.end() );
+
+    OE_INFO << LC << "Opened " << jobs.size() << " layers in " << (int)(elapsed*1000.0)
+        << "ms (" << (int)(total*1000.0) << "ms total) using " << numThreads << " threads:\n";
+    for(std::vector< std::pair<double, std::string> >::reverse_iterator r = report.rbegin(); r != report.rend(); ++r)
+    {
+        OE_INFO << LC << "  " << std::setw(8) << (int)(r->first*1000.0) << "ms  " << r->second << "\n";
+    }
+}
+
+void
+Map::addImageLayer( ImageLayer* layer )
+{
+    osgEarth::Registry::instance()->clearBlacklist();
+    unsigned int index = -1;
+    if ( layer )
+    {
+        if ( !wasOpened(layer) )
+        {
+            openLayer( layer );
+        }
 
         int newRevision;
 
@@ -467,14 +576,10 @@ Map::addElevationLayer( ElevationLayer* layer )
     unsigned int index = -1;
     if ( layer )
     {
-        //Set options for the map from the layer
-        layer->setReadOptions( _readOptions.get() );
-
-        // Tell the layer the map profile, if possible:
-        if ( _profile.valid() )
-            layer->setTargetProfileHint( _profile.get() );
-
-        layer->open();
+        if ( !wasOpened(layer) )
+        {
+            openLayer( layer );
+        }
 
         int newRevision;
 
@@ -682,8 +787,10 @@ Map::addModelLayer( ModelLayer* layer )
         }
 
         // initialize the model layer
-        layer->setReadOptions(_readOptions.get());
-        layer->open();
+        if ( !wasOpened(layer) )
+        {
+            openLayer( layer );
+        }
 
         // a seprate block b/c we don't need the mutex
         for( MapCallbackList::iterator i = _mapCallbacks.begin(); i != _mapCallbacks.end(); i++ )
@@ -0,0 +1,121 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/MappedFile>
+#include <osgEarth/Notify>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#define LC "[MappedFile] "
+
+using namespace osgEarth;
+
+MappedFile::MappedFile() :
+_data   ( 0L ),
+_size   ( 0 )
+#ifdef _WIN32
+,_file   ( INVALID_HANDLE_VALUE ),
+_mapping( 0L )
+#else
+,_fd     ( -1 )
+#endif
+{
+    //nop
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if ( _data )
+        ::UnmapViewOfFile( _data );
+    if ( _mapping )
+        ::CloseHandle( (HANDLE)_mapping );
+    if ( _file != INVALID_HANDLE_VALUE )
+        ::CloseHandle( (HANDLE)_file );
+#else
+    if ( _data )
+        ::munmap( (void*)_data, _size );
+    if ( _fd >= 0 )
+        ::close( _fd );
+#endif
+}
+
+MappedFile*
+MappedFile::open(const std::string& filename)
+{
+    osg::ref_ptr<MappedFile> file = new MappedFile();
+    file->_filename = filename;
+
+#ifdef _WIN32
+
+    file->_file = ::CreateFileA(
+        filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0L,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0L );
+
+    if ( file->_file == INVALID_HANDLE_VALUE )
+        return 0L;
+
+    LARGE_INTEGER size;
+    if ( !::GetFileSizeEx( (HANDLE)file->_file, &size ) || size.QuadPart == 0 )
+        return 0L;
+
+    file->_mapping = ::CreateFileMappingA( (HANDLE)file->_file, 0L, PAGE_READONLY, 0, 0, 0L );
+    if ( !file->_mapping )
+    {
+        OE_WARN << LC << "Failed to map " << filename << std::endl;
+        return 0L;
+    }
+
+    file->_data = (const char*)::MapViewOfFile( (HANDLE)file->_mapping, FILE_MAP_READ, 0, 0, 0 );
+    file->_size = (size_t)size.QuadPart;
+
+#else
+
+    file->_fd = ::open( filename.c_str(), O_RDONLY );
+    if ( file->_fd < 0 )
+        return 0L;
+
+    struct stat info;
+    if ( ::fstat( file->_fd, &info ) != 0 || info.st_size == 0 )
+        return 0L;
+
+    void* data = ::mmap( 0L, (size_t)info.st_size, PROT_READ, MAP_SHARED, file->_fd, 0 );
+    if ( data != MAP_FAILED )
+    {
+        file->_data = (const char*)data;
+        file->_size = (size_t)info.st_size;
+    }
+
+#endif
+
+    if ( !file->_data )
+    {
+        OE_WARN << LC << "Failed to map " << filename << std::endl;
+        return 0L;
+    }
+
+    return file.release();
+}
@@ -34,8 +34,15 @@ using namespace osgEarth;
 //#undef OE_DEBUG
 //#define OE_DEBUG OE_NOTICE
 
-// Object IDs under this reserved
-#define STARTING_OBJECT_ID 10
+// An ObjectID is [generation:8][slot:24]. The generation is never zero, so
+// every ID lands well above the reserved low values (EMPTY, TERRAIN, etc.)
+// A slot is retired once its generation reaches the maximum, so IDs never
+// repeat; that allows about 4 billion insertions over the index's lifetime.
+#define SLOT_BITS       24
+#define SLOT_MASK       ((1u << SLOT_BITS) - 1u)
+#define GENERATION_MASK 0xFFu
+#define SLAB_SIZE       4096u
+#define MAX_SLABS       ((SLOT_MASK + 1u) / SLAB_SIZE)
 
 namespace
 {
@@ -59,10 +66,18 @@ namespace
         "    else \n"
         "        oe_index_objectid = 0u; \n"
         "} \n";
+
+    inline ObjectID makeObjectID(unsigned slot, unsigned generation)
+    {
+        return (ObjectID)((generation << SLOT_BITS) | slot);
+    }
+
 }
 
 ObjectIndex::ObjectIndex() :
-_idGen( STARTING_OBJECT_ID )
+_slabs   ( new OpenThreads::AtomicPtr[MAX_SLABS] ),
+_numSlots( 0u ),
+_size    ( 0u )
 {
     _attribName     = "oe_index_objectid_attr";
     _attribLocation = osg::Drawable::SECONDARY_COLORS;
@@ -72,6 +87,20 @@ _idGen( STARTING_OBJECT_ID )
     _shaders.add( "ObjectIndex.vert.glsl", indexVertexInit );
 }
 
+ObjectIndex::~ObjectIndex()
+{
+    for(unsigned i=0; i<MAX_SLABS; ++i)
+        delete static_cast<Slab*>( _slabs[i].get() );
+    delete [] _slabs;
+}
+
+ObjectIndex::Slab*
+ObjectIndex::getSlab(unsigned slot) const
+{
+    // slabs are published with a barrier, so readers need no lock here.
+    return static_cast<Slab*>( _slabs[slot / SLAB_SIZE].get() );
+}
+
 bool
 ObjectIndex::loadShaders(VirtualProgram* vp) const
 {
@@ -86,7 +115,7 @@ ObjectIndex::loadShaders(VirtualProgram* vp) const
 void
 ObjectIndex::setObjectIDAtrribLocation(int value)
 {
-    if ( _index.size() == 0 )
+    if ( _size == 0u )
     {
         _attribLocation = value;
     } 
@@ -99,48 +128,170 @@ ObjectIndex::setObjectIDAtrribLocation(int value)
 ObjectID
 ObjectIndex::insert(osg::Referenced* object)
 {
-    Threading::ScopedMutexLock excl( _mutex );
     return insertImpl( object );
 }
 
+void
+ObjectIndex::insert(const std::vector<osg::Referenced*>& objects, std::vector<ObjectID>& output)
+{
+    std::vector<unsigned> slots;
+    allocateSlots( objects.size(), slots );
+
+    output.reserve( output.size() + objects.size() );
+
+    for(unsigned i=0; i<objects.size(); ++i)
+    {
+        if ( i < slots.size() )
+        {
+            Slab* slab = getSlab( slots[i] );
+            Threading::ScopedMutexLock lock( slab->_mutex );
+            Slot& slot = slab->_slots[slots[i] % SLAB_SIZE];
+            slot._object = objects[i];
+            output.push_back( makeObjectID(slots[i], slot._generation) );
+            ++_size;
+        }
+        else
+        {
+            output.push_back( OSGEARTH_OBJECTID_EMPTY );
+        }
+    }
+}
+
 ObjectID
 ObjectIndex::insertImpl(osg::Referenced* object)
 {
-    // internal: assume mutex is locked
-    ObjectID id = ++_idGen;
-    _index[id] = object;
-    OE_DEBUG << LC << "Insert " << id << "; size = " << _index.size() << "\n";
+    std::vector<unsigned> slots;
+    allocateSlots( 1u, slots );
+    if ( slots.empty() )
+        return OSGEARTH_OBJECTID_EMPTY;
+
+    Slab* slab = getSlab( slots[0] );
+    Threading::ScopedMutexLock lock( slab->_mutex );
+    Slot& slot = slab->_slots[slots[0] % SLAB_SIZE];
+    slot._object = object;
+    ++_size;
+
+    ObjectID id = makeObjectID(slots[0], slot._generation);
+    OE_DEBUG << LC << "Insert " << id << "; size = " << (unsigned)_size << "\n";
     return id;
 }
 
-osg::Referenced*
+void
+ObjectIndex::allocateSlots(unsigned count, std::vector<unsigned>& slots)
+{
+    slots.reserve( count );
+
+    Threading::ScopedMutexLock lock( _allocMutex );
+
+    while( slots.size() < count && !_freeSlots.empty() )
+    {
+        slots.push_back( _freeSlots.front() );
+        _freeSlots.pop_front();
+    }
+
+    while( slots.size() < count )
+    {
+        if ( _numSlots > SLOT_MASK )
+        {
+            OE_WARN << LC << "Index has run out of object IDs (" << (unsigned)_size << " objects); cannot insert\n";
+            break;
+        }
+
+        unsigned s = _numSlots++;
+
+        // publish a new slab before any ID that refers to it:
+        if ( s % SLAB_SIZE == 0u )
+        {
+            Slab* slab = new Slab();
+            slab->_slots.resize( SLAB_SIZE );
+            _slabs[s / SLAB_SIZE].assign( slab, 0L );
+        }
+
+        slots.push_back( s );
+    }
+}
+
+osg::ref_ptr<osg::Referenced>
 ObjectIndex::getImpl(ObjectID id) const
 {
-    // assume the mutex is locked
-    IndexMap::const_iterator i = _index.find(id);
-    return i != _index.end() ? i->second.get() : 0L;
+    unsigned s = id & SLOT_MASK;
+    Slab* slab = getSlab( s );
+    if ( !slab )
+        return 0L;
+
+    Threading::ScopedMutexLock lock( slab->_mutex );
+    const Slot& slot = slab->_slots[s % SLAB_SIZE];
+    return slot._generation == (id >> SLOT_BITS) ? slot._object.get() : 0L;
 }
 
 void
 ObjectIndex::remove(ObjectID id)
 {
-    Threading::ScopedMutexLock excl(_mutex);
-    removeImpl(id);
+    std::vector<unsigned> freed;
+    std::vector< osg::ref_ptr<osg::Referenced> > released;
+
+    removeImpl( id, freed, released );
+
+    if ( !freed.empty() )
+    {
+        Threading::ScopedMutexLock lock( _allocMutex );
+        _freeSlots.push_back( freed[0] );
+    }
+
+    // released objects are dereferenced here, outside of any lock, in case
+    // their destructors call back into the index.
 }
 
 void
-ObjectIndex::removeImpl(ObjectID id)
+ObjectIndex::remove(const std::vector<ObjectID>& ids)
 {
-    // internal - assume mutex is locked
-    _index.erase( id );
-    OE_DEBUG << "Remove " << id << "; size = " << _index.size() << "\n";
+    std::vector<unsigned> freed;
+    std::vector< osg::ref_ptr<osg::Referenced> > released;
+    freed.reserve( ids.size() );
+    released.reserve( ids.size() );
 
+    for(std::vector<ObjectID>::const_iterator i = ids.begin(); i != ids.end(); ++i)
+        removeImpl( *i, freed, released );
+
+    if ( !freed.empty() )
+    {
+        Threading::ScopedMutexLock lock( _allocMutex );
+        _freeSlots.insert( _freeSlots.end(), freed.begin(), freed.end() );
+    }
+}
+
+void
+ObjectIndex::removeImpl(ObjectID id, std::vector<unsigned>& freed, std::vector< osg::ref_ptr<osg::Referenced> >& released)
+{
+    unsigned s = id & SLOT_MASK;
+    Slab* slab = getSlab( s );
+    if ( !slab )
+        return;
+
+    Threading::ScopedMutexLock lock( slab->_mutex );
+    Slot& slot = slab->_slots[s % SLAB_SIZE];
+    if ( slot._generation != (id >> SLOT_BITS) || !slot._object.valid() )
+        return;
+
+    released.push_back( slot._object.get() );
+    slot._object = 0L;
+    --_size;
+
+    // advancing the generation invalidates any copies of the old ID. A slot
+    // on its last generation is retired instead of wrapping around to an ID
+    // that was already handed out.
+    if ( slot._generation < GENERATION_MASK )
+    {
+        ++slot._generation;
+        freed.push_back( s );
+    }
+
+    OE_DEBUG << LC << "Remove " << id << "; size = " << (unsigned)_size << "\n";
 }
 
 ObjectID
 ObjectIndex::tagDrawable(osg::Drawable* drawable, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
     ObjectID oid = insertImpl(object);
     tagDrawable(drawable, oid);
     return oid;
@@ -198,7 +349,6 @@ namespace
 ObjectID
 ObjectIndex::tagAllDrawables(osg::Node* node, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
     ObjectID oid = insertImpl(object);
     tagAllDrawables(node, oid);
     return oid;
@@ -217,7 +367,6 @@ ObjectIndex::tagAllDrawables(osg::Node* node, ObjectID id) const
 ObjectID
 ObjectIndex::tagNode(osg::Node* node, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
     ObjectID oid = insertImpl(object);
     tagNode(node, oid);
     return oid;
@@ -280,19 +429,38 @@ ObjectIndex::updateObjectIDs(osg::Drawable* drawable,
     ObjectIDArray* oids = dynamic_cast<ObjectIDArray*>(geometry->getVertexAttribArray(_attribLocation));
     if ( !oids ) return false;
     if (oids->empty()) return false;
-    
-    for (ObjectIDArray::iterator i = oids->begin(); i != oids->end(); ++i)
+
+    // Vertices come in long runs of the same ID, so only look up each run
+    // once, and register all the unmapped IDs in a single batch.
+    std::vector<ObjectID> unmapped;
+    ObjectID last = OSGEARTH_OBJECTID_EMPTY;
+    for (ObjectIDArray::const_iterator i = oids->begin(); i != oids->end(); ++i)
     {
-        ObjectID newoid;
-        std::map<ObjectID, ObjectID>::iterator k = oldNewMap.find(*i);
-        if (k != oldNewMap.end()) {
-            newoid = k->second;
-        }
-        else {
-            newoid = insert(object);
-            oldNewMap[*i] = newoid;
+        if ( i == oids->begin() || *i != last )
+        {
+            last = *i;
+            if ( oldNewMap.find(last) == oldNewMap.end() )
+                unmapped.push_back( last );
         }
-        *i = newoid;
+    }
+
+    if ( !unmapped.empty() )
+    {
+        std::sort( unmapped.begin(), unmapped.end() );
+        unmapped.erase( std::unique(unmapped.begin(), unmapped.end()), unmapped.end() );
+
+        std::vector<ObjectID> newoids;
+        insert( std::vector<osg::Referenced*>(unmapped.size(), object), newoids );
+        for (unsigned k = 0; k < unmapped.size(); ++k)
+            oldNewMap[unmapped[k]] = newoids[k];
+    }
+
+    std::map<ObjectID, ObjectID>::const_iterator k = oldNewMap.end();
+    for (ObjectIDArray::iterator i = oids->begin(); i != oids->end(); ++i)
+    {
+        if ( k == oldNewMap.end() || k->first != *i )
+            k = oldNewMap.find(*i);
+        *i = k->second;
     }
 
     oids->dirty();
@@ -0,0 +1,286 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/OcclusionCullingService>
+#include <osgEarth/ElevationQuery>
+#include <osgEarth/GeoCommon>
+#include <osgEarth/Map>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/TaskService>
+#include <osgEarth/Units>
+#include <osg/Math>
+#include <OpenThreads/Thread>
+#include <map>
+
+using namespace osgEarth;
+
+#define LC "[OcclusionCullingService] "
+
+// bounds on the number of terrain samples along one segment
+#define MIN_SAMPLES 16u
+#define MAX_SAMPLES 256u
+
+// preferred distance between terrain samples, in meters
+#define SAMPLE_SPACING 50.0
+
+// a target that moves less than this many meters is not re-tested
+#define TARGET_MOVE_THRESHOLD 1.0
+
+namespace
+{
+    // one service per map, kept for as long as the map exists.
+    typedef std::map<UID, osg::ref_ptr<OcclusionCullingService> > ServiceMap;
+    ServiceMap       s_services;
+    Threading::Mutex s_servicesMutex;
+}
+
+//------------------------------------------------------------------------
+
+OcclusionCullingService::Entry::Entry() :
+_visible  ( 1u ),
+_pending  ( 0u ),
+_submitted( false ),
+_queued   ( false )
+{
+    //nop
+}
+
+//------------------------------------------------------------------------
+
+struct OcclusionCullingService::Batch : public osg::Referenced
+{
+    std::vector<Request> _requests;
+};
+
+struct OcclusionCullingService::Job : public TaskRequest
+{
+    OcclusionCullingService* _service;
+    osg::ref_ptr<Batch>      _batch;
+    unsigned                 _begin, _end;
+    ElevationQuery*          _query;
+
+    void operator()(ProgressCallback*)
+    {
+        _service->run( *_batch.get(), _begin, _end, *_query );
+        --_service->_jobsInFlight;
+    }
+};
+
+//------------------------------------------------------------------------
+
+OcclusionCullingService*
+OcclusionCullingService::get(const Map* map)
+{
+    if ( !map )
+        return 0L;
+
+    Threading::ScopedMutexLock lock( s_servicesMutex );
+
+    // retire services whose maps are gone.
+    for(ServiceMap::iterator i = s_services.begin(); i != s_services.end(); )
+    {
+        osg::ref_ptr<const Map> m;
+        if ( !i->second->_map.lock(m) && i->second->_jobsInFlight == 0u )
+            s_services.erase( i++ );
+        else
+            ++i;
+    }
+
+    osg::ref_ptr<OcclusionCullingService>& service = s_services[map->getUID()];
+    if ( !service.valid() )
+    {
+        unsigned numThreads = osg::clampBetween( OpenThreads::GetNumberOfProcessors()/2, 1, 4 );
+        service = new OcclusionCullingService( map, numThreads );
+    }
+    return service.get();
+}
+
+OcclusionCullingService::OcclusionCullingService(const Map* map, unsigned numThreads) :
+_map             ( map ),
+_srs             ( map->getSRS() ),
+_frameNumber     ( 0u ),
+_jobsInFlight    ( 0u ),
+_eyeMoveThreshold( 0.01 )
+{
+    _workers = new TaskService( "Occlusion culling", numThreads );
+
+    for(unsigned i=0; i<numThreads; ++i)
+    {
+        _queries.push_back( new ElevationQuery(map) );
+    }
+
+    OE_DEBUG << LC << "Started with " << numThreads << " threads\n";
+}
+
+OcclusionCullingService::~OcclusionCullingService()
+{
+    // stop the workers before releasing their queries.
+    _workers = 0L;
+
+    for(unsigned i=0; i<_queries.size(); ++i)
+        delete _queries[i];
+}
+
+void
+OcclusionCullingService::submit(Entry* entry, const osg::Vec3d& eye, const osg::Vec3d& target)
+{
+    if ( !entry )
+        return;
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    // temporal coherence: skip the test if neither end moved enough to matter.
+    if ( entry->_submitted )
+    {
+        double threshold = _eyeMoveThreshold * (entry->_target - entry->_eye).length();
+        if ( (eye - entry->_eye).length2() <= threshold*threshold &&
+             (target - entry->_target).length2() <= TARGET_MOVE_THRESHOLD*TARGET_MOVE_THRESHOLD )
+        {
+            return;
+        }
+    }
+
+    entry->_submitted = true;
+    entry->_eye       = eye;
+    entry->_target    = target;
+
+    if ( !entry->_queued )
+    {
+        entry->_queued = true;
+        entry->_pending.exchange( 1u );
+        _queue.push_back( entry );
+    }
+}
+
+void
+OcclusionCullingService::dispatch(unsigned frameNumber)
+{
+    if ( _frameNumber == frameNumber )
+        return;
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    if ( _frameNumber == frameNumber )
+        return;
+
+    _frameNumber.exchange( frameNumber );
+
+    if ( _jobsInFlight > 0u || _queue.empty() )
+        return;
+
+    osg::ref_ptr<Batch> batch = new Batch();
+    batch->_requests.resize( _queue.size() );
+    for(unsigned i=0; i<_queue.size(); ++i)
+    {
+        Entry* entry = _queue[i].get();
+        Request& request = batch->_requests[i];
+        request._entry  = entry;
+        request._eye    = entry->_eye;
+        request._target = entry->_target;
+        entry->_queued = false;
+    }
+    _queue.clear();
+
+    unsigned numJobs = osg::minimum( (unsigned)_queries.size(), (unsigned)batch->_requests.size() );
+    unsigned perJob  = (batch->_requests.size() + numJobs - 1u) / numJobs;
+
+    _jobsInFlight.exchange( numJobs );
+
+    for(unsigned j=0; j<numJobs; ++j)
+    {
+        Job* job = new Job();
+        job->_service = this;
+        job->_batch   = batch.get();
+        job->_begin   = j * perJob;
+        job->_end     = osg::minimum( job->_begin + perJob, (unsigned)batch->_requests.size() );
+        job->_query   = _queries[j];
+        _workers->add( job );
+    }
+}
+
+void
+OcclusionCullingService::run(const Batch& batch, unsigned begin, unsigned end, ElevationQuery& query)
+{
+    std::vector<osg::Vec3d> points;
+    std::vector<double>     heights;
+
+    for(unsigned i=begin; i<end; ++i)
+    {
+        const Request& request = batch._requests[i];
+        bool visible = test( request, query, points, heights );
+        request._entry->_visible.exchange( visible ? 1u : 0u );
+    }
+
+    // entries submitted again while we ran are still pending.
+    Threading::ScopedMutexLock lock( _mutex );
+    for(unsigned i=begin; i<end; ++i)
+    {
+        Entry* entry = batch._requests[i]._entry.get();
+        if ( !entry->_queued )
+            entry->_pending.exchange( 0u );
+    }
+}
+
+bool
+OcclusionCullingService::test(const Request&           request,
+                              ElevationQuery&          query,
+                              std::vector<osg::Vec3d>& points,
+                              std::vector<double>&     heights) const
+{
+    osg::Vec3d vec = request._target - request._eye;
+    double len = vec.length();
+
+    // stop 1m short of the target to prevent flickering.
+    double usable = len - 1.0;
+    if ( usable <= 0.0 )
+        return true;
+
+    unsigned numSamples = osg::clampBetween( (unsigned)(usable / SAMPLE_SPACING), MIN_SAMPLES, MAX_SAMPLES );
+
+    points.clear();
+    heights.clear();
+
+    for(unsigned i=1; i<=numSamples; ++i)
+    {
+        osg::Vec3d world = request._eye + vec * ((usable/len) * (double)i / (double)numSamples);
+        osg::Vec3d p;
+        if ( _srs->transformFromWorld(world, p) )
+        {
+            heights.push_back( p.z() );
+            points.push_back( osg::Vec3d(p.x(), p.y(), NO_DATA_VALUE) );
+        }
+    }
+
+    if ( points.empty() )
+        return true;
+
+    double resolution = SpatialReference::transformUnits(
+        Distance(usable / (double)numSamples, Units::METERS),
+        _srs.get(),
+        _srs->isGeographic() ? points.back().y() : 0.0 );
+
+    query.getElevations( points, _srs.get(), true, resolution );
+
+    for(unsigned i=0; i<points.size(); ++i)
+    {
+        if ( points[i].z() != NO_DATA_VALUE && heights[i] < points[i].z() )
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,497 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/PackedHilbertRTree>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <OpenThreads/Thread>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+#define LC "[PackedHilbertRTree] "
+
+using namespace osgEarth;
+
+// inputs smaller than this are sorted on the calling thread.
+#define MIN_ITEMS_PER_JOB 65536u
+
+#define RECORD_MAGIC   "OEHR"
+#define RECORD_VERSION 1u
+
+namespace
+{
+    // distance along a Hilbert curve filling a 65536x65536 grid.
+    unsigned hilbert(unsigned x, unsigned y)
+    {
+        const unsigned n = 1u << 16;
+        unsigned d = 0u;
+        for(unsigned s = n/2; s > 0; s /= 2)
+        {
+            unsigned rx = (x & s) > 0 ? 1u : 0u;
+            unsigned ry = (y & s) > 0 ? 1u : 0u;
+            d += s * s * ((3u * rx) ^ ry);
+            if ( ry == 0u )
+            {
+                if ( rx == 1u )
+                {
+                    x = n-1 - x;
+                    y = n-1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    // single-precision bounds that contain the double-precision ones.
+    // (stepping by a relative epsilon moves at least one float ulp.)
+    float floatBelow(double v)
+    {
+        float f = (float)v;
+        return (double)f > v ? (float)(v - osg::absolute(v)*FLT_EPSILON) : f;
+    }
+
+    float floatAbove(double v)
+    {
+        float f = (float)v;
+        return (double)f < v ? (float)(v + osg::absolute(v)*FLT_EPSILON) : f;
+    }
+
+    struct Keyed
+    {
+        unsigned _key;
+        unsigned _item;
+        bool operator < (const Keyed& rhs) const { return _key < rhs._key; }
+    };
+
+    // one unit of the parallel build: computes Hilbert keys for a range,
+    // sorts a range, or merges two sorted adjacent ranges.
+    struct BuildJob
+    {
+        enum Mode { KEYS, SORT, MERGE };
+
+        BuildJob() : _mode(KEYS), _items(0L), _keys(0L), _begin(0u), _middle(0u), _end(0u) { }
+
+        void execute()
+        {
+            if ( _mode == KEYS )
+            {
+                for(unsigned i=_begin; i<_end; ++i)
+                {
+                    const PackedHilbertRTree::Item& item = (*_items)[i];
+                    double cx = 0.5*(item._xmin + item._xmax);
+                    double cy = 0.5*(item._ymin + item._ymax);
+                    unsigned x = (unsigned)osg::clampBetween((cx - _xmin) * _sx, 0.0, 65535.0);
+                    unsigned y = (unsigned)osg::clampBetween((cy - _ymin) * _sy, 0.0, 65535.0);
+                    (*_keys)[i]._key  = hilbert(x, y);
+                    (*_keys)[i]._item = i;
+                }
+            }
+            else if ( _mode == SORT )
+            {
+                std::sort( _keys->begin() + _begin, _keys->begin() + _end );
+            }
+            else
+            {
+                std::inplace_merge( _keys->begin() + _begin, _keys->begin() + _middle, _keys->begin() + _end );
+            }
+        }
+
+        Mode                                          _mode;
+        const std::vector<PackedHilbertRTree::Item>*  _items;
+        std::vector<Keyed>*                           _keys;
+        unsigned                                      _begin, _middle, _end;
+        double                                        _xmin, _ymin, _sx, _sy;
+    };
+
+    typedef std::vector< osg::ref_ptr< ParallelTask<BuildJob> > > BuildJobs;
+
+    TaskService* getBuildService()
+    {
+        static Threading::Mutex s_mutex;
+        static osg::ref_ptr<TaskService> s_service;
+
+        Threading::ScopedMutexLock lock( s_mutex );
+        if ( !s_service.valid() )
+            s_service = new TaskService( "Spatial index", OpenThreads::GetNumberOfProcessors() );
+        return s_service.get();
+    }
+
+    // runs the first job on this thread and the rest in the pool; returns when all are done.
+    void run(BuildJobs& jobs)
+    {
+        if ( jobs.empty() )
+            return;
+
+        Threading::MultiEvent semaphore;
+        if ( jobs.size() > 1 )
+        {
+            semaphore.reset( jobs.size()-1 );
+            TaskService* service = getBuildService();
+            for(unsigned j=1; j<jobs.size(); ++j)
+            {
+                jobs[j]->_mev = &semaphore;
+                service->add( jobs[j].get() );
+            }
+        }
+
+        jobs[0]->execute();
+
+        if ( jobs.size() > 1 )
+            semaphore.wait();
+    }
+}
+
+//------------------------------------------------------------------------
+
+PackedHilbertRTree::PackedHilbertRTree() :
+_nodeSize ( 16u ),
+_numItems ( 0u ),
+_numLevels( 0u ),
+_levelEnds( 0L ),
+_numBoxes ( 0u ),
+_boxes    ( 0L ),
+_indices  ( 0L )
+{
+    //nop
+}
+
+void
+PackedHilbertRTree::clear()
+{
+    _numItems = 0u;
+    _boxStore.clear();
+    _indexStore.clear();
+    _levelEndStore.clear();
+    useStore();
+}
+
+void
+PackedHilbertRTree::useStore()
+{
+    _numLevels = _levelEndStore.size();
+    _levelEnds = _levelEndStore.empty() ? 0L : &_levelEndStore[0];
+    _numBoxes  = _boxStore.size();
+    _boxes     = _boxStore.empty() ? 0L : &_boxStore[0];
+    _indices   = _indexStore.empty() ? 0L : &_indexStore[0];
+}
+
+bool
+PackedHilbertRTree::validate() const
+{
+    if ( _nodeSize < 2u || (_numLevels > 0u) != (_numBoxes > 0u) )
+        return false;
+
+    if ( _numLevels == 0u )
+        return _numItems == 0u;
+
+    if ( _levelEnds[0] != _numItems || _levelEnds[_numLevels-1] != _numBoxes )
+        return false;
+
+    // each node's first child must lie in the level below; the rest follow.
+    for(unsigned level=0, begin=0; level<_numLevels; ++level)
+    {
+        unsigned end = _levelEnds[level];
+        if ( end <= begin )
+            return false;
+
+        if ( level > 0u )
+        {
+            unsigned childBegin = level > 1u ? _levelEnds[level-2] : 0u;
+            for(unsigned i=begin; i<end; ++i)
+            {
+                if ( _indices[i] < childBegin || _indices[i] >= _levelEnds[level-1] )
+                    return false;
+            }
+        }
+        begin = end;
+    }
+
+    return true;
+}
+
+void
+PackedHilbertRTree::build(std::vector<Item>& items, unsigned nodeSize)
+{
+    clear();
+    _nodeSize = osg::maximum(nodeSize, 2u);
+    _numItems = items.size();
+
+    if ( items.empty() )
+        return;
+
+    // full extent, for normalizing the curve:
+    double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX;
+    for(std::vector<Item>::const_iterator i = items.begin(); i != items.end(); ++i)
+    {
+        xmin = osg::minimum(xmin, i->_xmin);
+        ymin = osg::minimum(ymin, i->_ymin);
+        xmax = osg::maximum(xmax, i->_xmax);
+        ymax = osg::maximum(ymax, i->_ymax);
+    }
+
+    unsigned numJobs = osg::clampBetween(
+        _numItems / MIN_ITEMS_PER_JOB,
+        1u,
+        (unsigned)osg::maximum(OpenThreads::GetNumberOfProcessors(), 1) );
+
+    std::vector<Keyed> keys( _numItems );
+    std::vector<unsigned> bounds;
+    for(unsigned j=0; j<=numJobs; ++j)
+        bounds.push_back( (unsigned)(((unsigned long long)_numItems * j) / numJobs) );
+
+    // compute the keys and sort each range in parallel...
+    BuildJob::Mode modes[2] = { BuildJob::KEYS, BuildJob::SORT };
+    for(unsigned m=0; m<2; ++m)
+    {
+        BuildJobs jobs;
+        for(unsigned j=0; j<numJobs; ++j)
+        {
+            ParallelTask<BuildJob>* job = new ParallelTask<BuildJob>();
+            job->_mode  = modes[m];
+            job->_items = &items;
+            job->_keys  = &keys;
+            job->_begin = bounds[j];
+            job->_end   = bounds[j+1];
+            job->_xmin  = xmin;
+            job->_ymin  = ymin;
+            job->_sx    = xmax > xmin ? 65535.0/(xmax-xmin) : 0.0;
+            job->_sy    = ymax > ymin ? 65535.0/(ymax-ymin) : 0.0;
+            jobs.push_back( job );
+        }
+        run( jobs );
+    }
+
+    // ...then merge the sorted ranges pairwise, each round in parallel.
+    while( bounds.size() > 2 )
+    {
+        BuildJobs jobs;
+        std::vector<unsigned> merged;
+        for(unsigned j=0; j+1 < bounds.size(); j += 2)
+        {
+            merged.push_back( bounds[j] );
+            if ( j+2 < bounds.size() )
+            {
+                ParallelTask<BuildJob>* job = new ParallelTask<BuildJob>();
+                job->_mode   = BuildJob::MERGE;
+                job->_keys   = &keys;
+                job->_begin  = bounds[j];
+                job->_middle = bounds[j+1];
+                job->_end    = bounds[j+2];
+                jobs.push_back( job );
+            }
+        }
+        merged.push_back( bounds.back() );
+        run( jobs );
+        bounds.swap( merged );
+    }
+
+    // count the nodes so the arrays are allocated once:
+    unsigned numBoxes = _numItems;
+    for(unsigned n = _numItems; n > 1; )
+    {
+        n = (n + _nodeSize - 1) / _nodeSize;
+        numBoxes += n;
+    }
+    _boxStore.reserve( numBoxes );
+    _indexStore.reserve( numBoxes );
+
+    // leaves, in curve order:
+    for(std::vector<Keyed>::const_iterator k = keys.begin(); k != keys.end(); ++k)
+    {
+        const Item& item = items[k->_item];
+        Box box;
+        box._xmin = floatBelow(item._xmin);
+        box._ymin = floatBelow(item._ymin);
+        box._xmax = floatAbove(item._xmax);
+        box._ymax = floatAbove(item._ymax);
+        _boxStore.push_back( box );
+        _indexStore.push_back( item._id );
+    }
+    _levelEndStore.push_back( _boxStore.size() );
+
+    std::vector<Item>().swap( items );
+    std::vector<Keyed>().swap( keys );
+
+    // pack each level into the one above it until there's a single root.
+    unsigned levelBegin = 0u;
+    while( _boxStore.size() - levelBegin > 1u )
+    {
+        unsigned levelEnd = _boxStore.size();
+        for(unsigned i = levelBegin; i < levelEnd; i += _nodeSize)
+        {
+            Box box = _boxStore[i];
+            for(unsigned c = i+1; c < osg::minimum(i+_nodeSize, levelEnd); ++c)
+            {
+                box._xmin = osg::minimum(box._xmin, _boxStore[c]._xmin);
+                box._ymin = osg::minimum(box._ymin, _boxStore[c]._ymin);
+                box._xmax = osg::maximum(box._xmax, _boxStore[c]._xmax);
+                box._ymax = osg::maximum(box._ymax, _boxStore[c]._ymax);
+            }
+            _boxStore.push_back( box );
+            _indexStore.push_back( i );
+        }
+        levelBegin = levelEnd;
+        _levelEndStore.push_back( _boxStore.size() );
+    }
+
+    useStore();
+}
+
+bool
+PackedHilbertRTree::setView(unsigned             nodeSize,
+                            unsigned             numItems,
+                            unsigned             numLevels,
+                            const unsigned*      levelEnds,
+                            unsigned             numBoxes,
+                            const Box*           boxes,
+                            const unsigned long* indices)
+{
+    clear();
+    _nodeSize  = nodeSize;
+    _numItems  = numItems;
+    _numLevels = numLevels;
+    _levelEnds = levelEnds;
+    _numBoxes  = numBoxes;
+    _boxes     = boxes;
+    _indices   = indices;
+
+    if ( !validate() )
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+void
+PackedHilbertRTree::query(double xmin, double ymin, double xmax, double ymax, std::vector<unsigned long>& output) const
+{
+    if ( _numBoxes == 0u )
+        return;
+
+    unsigned first = output.size();
+
+    // stack of (node index, level) of boxes known to intersect the query.
+    std::vector< std::pair<unsigned, unsigned> > stack;
+
+    const Box& root = _boxes[_numBoxes-1];
+    if ( !(root._xmax < xmin || root._xmin > xmax || root._ymax < ymin || root._ymin > ymax) )
+        stack.push_back( std::make_pair(_numBoxes-1, _numLevels-1) );
+
+    while( !stack.empty() )
+    {
+        unsigned node  = stack.back().first;
+        unsigned level = stack.back().second;
+        stack.pop_back();
+
+        if ( level == 0u )
+        {
+            output.push_back( _indices[node] );
+            continue;
+        }
+
+        // children of a node are contiguous in the level below.
+        unsigned begin = _indices[node];
+        unsigned end   = osg::minimum(begin + _nodeSize, _levelEnds[level-1]);
+
+        for(unsigned i = begin; i < end; ++i)
+        {
+            const Box& box = _boxes[i];
+            if ( !(box._xmax < xmin || box._xmin > xmax || box._ymax < ymin || box._ymin > ymax) )
+                stack.push_back( std::make_pair(i, level-1) );
+        }
+    }
+
+    // ascending IDs let the caller read runs of neighboring records.
+    std::sort( output.begin() + first, output.end() );
+}
+
+void
+PackedHilbertRTree::write(std::string& buffer) const
+{
+    unsigned header[6] = {
+        RECORD_VERSION,
+        (unsigned)sizeof(unsigned long),
+        _nodeSize,
+        _numItems,
+        _numBoxes,
+        _numLevels };
+
+    buffer.append( RECORD_MAGIC, 4 );
+    buffer.append( reinterpret_cast<const char*>(header), sizeof(header) );
+    if ( _numLevels > 0u )
+        buffer.append( reinterpret_cast<const char*>(_levelEnds), _numLevels*sizeof(unsigned) );
+    if ( _numBoxes > 0u )
+    {
+        buffer.append( reinterpret_cast<const char*>(_boxes),   _numBoxes*sizeof(Box) );
+        buffer.append( reinterpret_cast<const char*>(_indices), _numBoxes*sizeof(unsigned long) );
+    }
+}
+
+bool
+PackedHilbertRTree::read(const std::string& buffer)
+{
+    clear();
+
+    unsigned header[6];
+    if ( buffer.size() < 4 + sizeof(header) || buffer.compare(0, 4, RECORD_MAGIC) != 0 )
+        return false;
+
+    ::memcpy( header, buffer.data() + 4, sizeof(header) );
+    if ( header[0] != RECORD_VERSION || header[1] != sizeof(unsigned long) )
+        return false;
+
+    unsigned numBoxes  = header[4];
+    unsigned numLevels = header[5];
+    unsigned long long size =
+        4 + sizeof(header) +
+        (unsigned long long)numLevels*sizeof(unsigned) +
+        (unsigned long long)numBoxes*(sizeof(Box) + sizeof(unsigned long));
+
+    if ( buffer.size() != size )
+        return false;
+
+    const char* ptr = buffer.data() + 4 + sizeof(header);
+
+    _nodeSize = header[2];
+    _numItems = header[3];
+    _levelEndStore.resize( numLevels );
+    _boxStore.resize( numBoxes );
+    _indexStore.resize( numBoxes );
+
+    if ( numLevels > 0u )
+        ::memcpy( &_levelEndStore[0], ptr, numLevels*sizeof(unsigned) );
+    ptr += numLevels*sizeof(unsigned);
+
+    if ( numBoxes > 0u )
+    {
+        ::memcpy( &_boxStore[0], ptr, numBoxes*sizeof(Box) );
+        ptr += numBoxes*sizeof(Box);
+        ::memcpy( &_indexStore[0], ptr, numBoxes*sizeof(unsigned long) );
+    }
+
+    useStore();
+    if ( !validate() )
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
@@ -18,6 +18,7 @@
 */
 #undef NDEBUG
 #include <cassert>
+#include <algorithm>
 #include "QuadTree"
 #include <osg/Geode>
 #include <osg/TriangleIndexFunctor>
@@ -783,6 +784,16 @@ bool QuadTree::intersect(const osg::Vec3d& start, const osg::Vec3d& end, LineSeg
     return numIntersectionsBefore != intersections.size();
 }
 
+bool QuadTree::intersectNearest(const osg::Vec3d& start, const osg::Vec3d& end, LineSegmentIntersection& nearest) const
+{
+    LineSegmentIntersections intersections;
+    if (!intersect(start, end, intersections))
+        return false;
+
+    nearest = *std::min_element(intersections.begin(), intersections.end());
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // QuadTreeBuilder
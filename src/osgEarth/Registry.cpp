@@ -27,9 +27,12 @@
 #include <osgEarth/ColorFilter>
 #include <osgEarth/StateSetCache>
 #include <osgEarth/HTTPClient>
+#include <osgEarth/URI>
 #include <osgEarth/StringUtils>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/ObjectIndex>
+#include <osgEarth/SharedMemCache>
+#include <osgEarth/ImageCache>
 
 #include <osgEarth/Units>
 #include <osg/Notify>
@@ -64,7 +67,9 @@ _caps               ( 0L ),
 _defaultFont        ( 0L ),
 _terrainEngineDriver( "mp" ),
 _cacheDriver        ( "filesystem" ),
-_overrideCachePolicyInitialized( false )
+_overrideCachePolicyInitialized( false ),
+_sharedMemCacheInitialized( false ),
+_imageCacheInitialized( false )
 {
     // set up GDAL and OGR.
     OGRRegisterAll();
@@ -150,7 +155,8 @@ _overrideCachePolicyInitialized( false )
 
 Registry::~Registry()
 {
-    //nop
+    URI::shutdownAsync();
+    HTTPClient::shutdownAsync();
 }
 
 Registry* 
@@ -170,7 +176,8 @@ Registry::instance(bool erase)
 void 
 Registry::destruct()
 {
-    //nop
+    URI::shutdownAsync();
+    HTTPClient::shutdownAsync();
 }
 
 
@@ -400,6 +407,78 @@ Registry::setDefaultCache(Cache* cache)
     _defaultCache = cache;
 }
 
+SharedMemCache*
+Registry::getSharedMemCache() const
+{
+    if ( !_sharedMemCacheInitialized )
+    {
+        Threading::ScopedMutexLock lock(_regMutex);
+        if ( !_sharedMemCacheInitialized )
+        {
+            const char* megabytes = ::getenv(OSGEARTH_ENV_L2_CACHE_MB);
+            if ( megabytes )
+            {
+                unsigned mb = as<unsigned>(std::string(megabytes), 0u);
+                if ( mb > 0u )
+                {
+                    _sharedMemCache = new SharedMemCache( (unsigned long long)mb*1024ull*1024ull );
+                    OE_INFO << LC << "Shared L2 cache size set from environment = " << mb << " MB\n";
+                }
+            }
+            _sharedMemCacheInitialized = true;
+        }
+    }
+    return _sharedMemCache.get();
+}
+
+void
+Registry::setSharedMemCache(SharedMemCache* cache)
+{
+    Threading::ScopedMutexLock lock(_regMutex);
+    _sharedMemCache = cache;
+    _sharedMemCacheInitialized = true;
+}
+
+ImageCache*
+Registry::getImageCache() const
+{
+    if ( !_imageCacheInitialized )
+    {
+        Threading::ScopedMutexLock lock(_regMutex);
+        if ( !_imageCacheInitialized )
+        {
+            const char* megabytes = ::getenv(OSGEARTH_ENV_IMAGE_CACHE_MB);
+            if ( megabytes )
+            {
+                unsigned mb = as<unsigned>(std::string(megabytes), 0u);
+                if ( mb > 0u )
+                {
+                    _imageCache = new ImageCache( (unsigned long long)mb*1024ull*1024ull );
+                    OE_INFO << LC << "Image cache size set from environment = " << mb << " MB\n";
+                }
+                else
+                {
+                    OE_INFO << LC << "Image cache disabled from environment\n";
+                }
+            }
+            else
+            {
+                _imageCache = new ImageCache();
+            }
+            _imageCacheInitialized = true;
+        }
+    }
+    return _imageCache.get();
+}
+
+void
+Registry::setImageCache(ImageCache* cache)
+{
+    Threading::ScopedMutexLock lock(_regMutex);
+    _imageCache = cache;
+    _imageCacheInitialized = true;
+}
+
 bool
 Registry::isBlacklisted(const std::string& filename)
 {
@@ -0,0 +1,394 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/SharedMemCache>
+#include <osgEarth/StringUtils>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osg/Timer>
+#include <algorithm>
+
+using namespace osgEarth;
+
+#define LC "[SharedMemCache] "
+
+// bound on the number of outstanding misses a bin remembers for costing.
+#define MAX_PENDING_MISSES 4096u
+
+namespace
+{
+    // approximate memory footprint of a cached object.
+    unsigned getSizeInBytes(const osg::Object* object)
+    {
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        if ( image )
+            return sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+
+        const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+        if ( hf )
+            return sizeof(osg::HeightField) + (hf->getFloatArray() ? hf->getFloatArray()->getTotalDataSize() : 0u);
+
+        const StringObject* str = dynamic_cast<const StringObject*>(object);
+        if ( str )
+            return sizeof(StringObject) + str->getString().size();
+
+        return 1024u;
+    }
+}
+
+//------------------------------------------------------------------------
+
+class SharedMemCache::Bin : public CacheBin
+{
+public:
+    struct Record
+    {
+        osg::ref_ptr<const osg::Object> _object;
+        Config                          _meta;
+        unsigned                        _bytes;
+        double                          _cost;
+        PriorityQueue::iterator         _queued;
+    };
+    typedef std::map<std::string, Record> Records;
+
+    Bin(const std::string& id, SharedMemCache* cache) :
+        CacheBin( id ),
+        _cache  ( cache ),
+        _weight ( 1.0f ),
+        _bytes  ( 0u ),
+        _reads  ( 0u ),
+        _hits   ( 0u ),
+        _removed( false )
+    {
+        //nop
+    }
+
+    ReadResult readObject(const std::string& key, const osgDB::Options*)
+    {
+        osg::ref_ptr<const osg::Object> object;
+        Config meta;
+        {
+            Threading::ScopedMutexLock lock( _cache->_mutex );
+            ++_reads;
+
+            Records::iterator i = _records.find(key);
+            if ( i != _records.end() )
+            {
+                ++_hits;
+                object = i->second._object.get();
+                meta   = i->second._meta;
+                requeue( i );
+            }
+            else if ( !_removed )
+            {
+                // remember when we missed so the write that follows
+                // tells us how expensive this record is to re-create.
+                if ( _misses.size() >= MAX_PENDING_MISSES )
+                    _misses.clear();
+                _misses[key] = osg::Timer::instance()->tick();
+            }
+        }
+
+        // clone required since the cache is in memory
+        if ( object.valid() )
+            return ReadResult( osg::clone(object.get(), osg::CopyOp::DEEP_COPY_ALL), meta );
+        else
+            return ReadResult();
+    }
+
+    ReadResult readImage(const std::string& key, const osgDB::Options* readOptions)
+    {
+        return readObject(key, readOptions);
+    }
+
+    ReadResult readString(const std::string& key, const osgDB::Options* readOptions)
+    {
+        return readObject(key, readOptions);
+    }
+
+    bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options*)
+    {
+        if ( !object )
+            return false;
+
+        unsigned bytes = getSizeInBytes(object);
+
+        Threading::ScopedMutexLock lock( _cache->_mutex );
+
+        if ( _removed || bytes > _cache->_maxBytes )
+            return false;
+
+        // cost = milliseconds since the miss that led to this write;
+        // a write without a preceding miss gets a nominal cost.
+        double cost = 1.0;
+        std::map<std::string, osg::Timer_t>::iterator m = _misses.find(key);
+        if ( m != _misses.end() )
+        {
+            cost = osg::maximum( osg::Timer::instance()->delta_m(m->second, osg::Timer::instance()->tick()), 0.01 );
+            _misses.erase( m );
+        }
+
+        Records::iterator i = _records.find(key);
+        if ( i != _records.end() )
+        {
+            unrecord( i );
+        }
+
+        Record& rec = _records[key];
+        rec._object = object;
+        rec._meta   = meta;
+        rec._bytes  = bytes;
+        rec._cost   = cost;
+        rec._queued = _cache->_queue.insert( std::make_pair(priority(rec), std::make_pair(this, key)) );
+
+        _bytes           += bytes;
+        _cache->_numBytes += bytes;
+
+        _cache->evict();
+        return true;
+    }
+
+    bool remove(const std::string& key)
+    {
+        Threading::ScopedMutexLock lock( _cache->_mutex );
+        Records::iterator i = _records.find(key);
+        if ( i != _records.end() )
+            unrecord( i );
+        return true;
+    }
+
+    bool touch(const std::string& key)
+    {
+        Threading::ScopedMutexLock lock( _cache->_mutex );
+        Records::iterator i = _records.find(key);
+        if ( i == _records.end() )
+            return false;
+        requeue( i );
+        return true;
+    }
+
+    RecordStatus getRecordStatus(const std::string& key)
+    {
+        // no expiration in a memory cache
+        Threading::ScopedMutexLock lock( _cache->_mutex );
+        return _records.find(key) != _records.end() ? STATUS_OK : STATUS_NOT_FOUND;
+    }
+
+    bool clear()
+    {
+        Threading::ScopedMutexLock lock( _cache->_mutex );
+        clearUnlocked();
+        return true;
+    }
+
+    std::string getHashedKey(const std::string& key) const
+    {
+        return key;
+    }
+
+public: // all the following must be called with the cache mutex held.
+
+    double priority(const Record& rec) const
+    {
+        double kb = osg::maximum( (double)rec._bytes / 1024.0, 1.0 );
+        return _cache->_clock + (double)_weight * rec._cost / kb;
+    }
+
+    void requeue(Records::iterator i)
+    {
+        _cache->_queue.erase( i->second._queued );
+        i->second._queued = _cache->_queue.insert( std::make_pair(priority(i->second), std::make_pair(this, i->first)) );
+    }
+
+    void unrecord(Records::iterator i)
+    {
+        _cache->_queue.erase( i->second._queued );
+        _bytes            -= i->second._bytes;
+        _cache->_numBytes -= i->second._bytes;
+        _records.erase( i );
+    }
+
+    void clearUnlocked()
+    {
+        while( !_records.empty() )
+            unrecord( _records.begin() );
+        _misses.clear();
+    }
+
+    SharedMemCache*                      _cache;
+    float                                _weight;
+    unsigned long long                   _bytes;
+    unsigned                             _reads;
+    unsigned                             _hits;
+    bool                                 _removed;
+    Records                              _records;
+    std::map<std::string, osg::Timer_t>  _misses;
+};
+
+//------------------------------------------------------------------------
+
+SharedMemCache::SharedMemCache( unsigned long long maxBytes ) :
+_maxBytes( maxBytes ),
+_numBytes( 0u ),
+_clock   ( 0.0 )
+{
+    //nop
+}
+
+void
+SharedMemCache::setMaxBytes(unsigned long long value)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _maxBytes = value;
+    evict();
+}
+
+unsigned long long
+SharedMemCache::getMaxBytes() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _maxBytes;
+}
+
+unsigned long long
+SharedMemCache::getNumBytes() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _numBytes;
+}
+
+void
+SharedMemCache::evict()
+{
+    while( _numBytes > _maxBytes && !_queue.empty() )
+    {
+        PriorityQueue::iterator lowest = _queue.begin();
+
+        // inflate the clock so that records that are not accessed
+        // eventually lose out to newer ones.
+        _clock = lowest->first;
+
+        Bin* bin = lowest->second.first;
+        Bin::Records::iterator i = bin->_records.find( lowest->second.second );
+        if ( i != bin->_records.end() )
+            bin->unrecord( i );
+        else
+            _queue.erase( lowest );
+    }
+}
+
+CacheBin*
+SharedMemCache::addBin(const std::string& binID)
+{
+    Bin* bin = static_cast<Bin*>( _bins.getOrCreate(binID, new Bin(binID, this)) );
+
+    Threading::ScopedMutexLock lock( _mutex );
+    if ( std::find(_binList.begin(), _binList.end(), bin) == _binList.end() )
+        _binList.push_back( bin );
+
+    return bin;
+}
+
+CacheBin*
+SharedMemCache::getOrCreateDefaultBin()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    if ( !_defaultBin.valid() )
+    {
+        Bin* bin = new Bin("__default", this);
+        _defaultBin = bin;
+        _binList.push_back( bin );
+    }
+    return _defaultBin.get();
+}
+
+void
+SharedMemCache::removeBin(CacheBin* cacheBin)
+{
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        std::vector<Bin*>::iterator i = std::find(_binList.begin(), _binList.end(), cacheBin);
+        if ( i == _binList.end() )
+            return;
+
+        // release the bin's memory now, and ignore any late writes
+        // from a layer that is still shutting down.
+        (*i)->clearUnlocked();
+        (*i)->_removed = true;
+        _binList.erase( i );
+    }
+
+    Cache::removeBin( cacheBin );
+}
+
+bool
+SharedMemCache::clear()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    for(std::vector<Bin*>::iterator i = _binList.begin(); i != _binList.end(); ++i)
+        (*i)->clearUnlocked();
+    _clock = 0.0;
+    return true;
+}
+
+void
+SharedMemCache::setBinWeight(CacheBin* cacheBin, float weight)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    std::vector<Bin*>::iterator i = std::find(_binList.begin(), _binList.end(), cacheBin);
+    if ( i != _binList.end() )
+    {
+        // takes effect as records are next accessed or written.
+        (*i)->_weight = osg::maximum(weight, 0.0f);
+    }
+}
+
+bool
+SharedMemCache::getStats(const CacheBin* cacheBin, BinStats& out) const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    std::vector<Bin*>::const_iterator i = std::find(_binList.begin(), _binList.end(), cacheBin);
+    if ( i == _binList.end() )
+        return false;
+
+    out._binID   = (*i)->getID();
+    out._weight  = (*i)->_weight;
+    out._entries = (*i)->_records.size();
+    out._bytes   = (*i)->_bytes;
+    out._reads   = (*i)->_reads;
+    out._hits    = (*i)->_hits;
+    return true;
+}
+
+void
+SharedMemCache::getStats(std::vector<BinStats>& out) const
+{
+    out.clear();
+    std::vector<Bin*> bins;
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        bins = _binList;
+    }
+
+    for(std::vector<Bin*>::const_iterator i = bins.begin(); i != bins.end(); ++i)
+    {
+        BinStats stats;
+        if ( getStats(*i, stats) )
+            out.push_back( stats );
+    }
+}
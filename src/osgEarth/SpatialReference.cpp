@@ -88,30 +88,6 @@ namespace
         }
         return true;
     }
-
-    void geodeticToECEF(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
-    {
-        for( unsigned i=0; i<points.size(); ++i )
-        {
-            double x, y, z;
-            em->convertLatLongHeightToXYZ(
-                osg::DegreesToRadians( points[i].y() ), osg::DegreesToRadians( points[i].x() ), points[i].z(),
-                x, y, z );
-            points[i].set( x, y, z );
-        }
-    }
-
-    void ECEFtoGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
-    {
-        for( unsigned i=0; i<points.size(); ++i )
-        {
-            double lat, lon, alt;
-            em->convertXYZToLatLongHeight(
-                points[i].x(), points[i].y(), points[i].z(),
-                lat, lon, alt );
-            points[i].set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt );
-        }
-    }
 }
 
 //------------------------------------------------------------------------
@@ -1062,7 +1038,7 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
     else if ( inputSRS->isECEF() && !outputSRS->isECEF() )
     {
         const SpatialReference* outputGeoSRS = outputSRS->getGeodeticSRS();
-        ECEFtoGeodetic(points, outputGeoSRS->getEllipsoid());
+        ECEF::ECEFToGeodetic(points, outputGeoSRS->getEllipsoid());
         return outputGeoSRS->transform(points, outputSRS);
     }
 
@@ -1070,7 +1046,7 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
     {
         const SpatialReference* outputGeoSRS = outputSRS->getGeodeticSRS();
         success = inputSRS->transform(points, outputGeoSRS);
-        geodeticToECEF(points, outputGeoSRS->getEllipsoid());
+        ECEF::geodeticToECEF(points, outputGeoSRS->getEllipsoid());
         return success;
     }
 
@@ -28,12 +28,15 @@
 #include <osg/Version>
 #include <OpenThreads/ScopedLock>
 #include <memory.h>
+#include <sstream>
 
 using namespace osgEarth;
 using namespace OpenThreads;
 
 #define LC "[TerrainLayer] Layer (" << getName() << ") "
 
+#define BLACKLIST_KEY "_blacklist"
+
 //------------------------------------------------------------------------
 
 TerrainLayerOptions::TerrainLayerOptions( const ConfigOptions& options ) :
@@ -42,6 +45,7 @@ _minLevel           ( 0 ),
 _maxLevel           ( 23 ),
 _cachePolicy        ( CachePolicy::DEFAULT ),
 _loadingWeight      ( 1.0f ),
+_l2CacheWeight      ( 1.0f ),
 _exactCropping      ( false ),
 _enabled            ( true ),
 _visible            ( true ),
@@ -70,6 +74,7 @@ TerrainLayerOptions::setDefaults()
     _reprojectedTileSize.init( 256 );
     _cachePolicy.init( CachePolicy() );
     _loadingWeight.init( 1.0f );
+    _l2CacheWeight.init( 1.0f );
     _minLevel.init( 0 );
     _maxLevel.init( 23 );
     _maxDataLevel.init( 99 );
@@ -86,6 +91,7 @@ TerrainLayerOptions::getConfig( bool isolate ) const
     conf.updateIfSet( "min_resolution", _minResolution );
     conf.updateIfSet( "max_resolution", _maxResolution );
     conf.updateIfSet( "loading_weight", _loadingWeight );
+    conf.updateIfSet( "l2_cache_weight", _l2CacheWeight );
     conf.updateIfSet( "enabled", _enabled );
     conf.updateIfSet( "visible", _visible );
     conf.updateIfSet( "edge_buffer_ratio", _edgeBufferRatio);
@@ -116,6 +122,7 @@ TerrainLayerOptions::fromConfig( const Config& conf )
     conf.getIfSet( "min_resolution", _minResolution );
     conf.getIfSet( "max_resolution", _maxResolution );
     conf.getIfSet( "loading_weight", _loadingWeight );
+    conf.getIfSet( "l2_cache_weight", _l2CacheWeight );
     conf.getIfSet( "enabled", _enabled );
     conf.getIfSet( "visible", _visible );
     conf.getIfSet( "edge_buffer_ratio", _edgeBufferRatio);    
@@ -162,7 +169,9 @@ _sourceDriver   ( rhs._sourceDriver ),
 _sourceTileSize ( rhs._sourceTileSize ),
 _sourceProfile  ( rhs._sourceProfile ),
 _cacheProfile   ( rhs._cacheProfile ),   
-_cacheCreateTime( rhs._cacheCreateTime )
+_cacheCreateTime( rhs._cacheCreateTime ),
+_dataExtents    ( rhs._dataExtents ),
+_dataExtentIndex( rhs._dataExtentIndex )
 {
     //nop
 }
@@ -209,6 +218,12 @@ TerrainLayer::CacheBinMetadata::CacheBinMetadata(const Config& conf)
         }
     }
 
+    const Config* indexConf = conf.child_ptr("data_extent_index");
+    if ( indexConf )
+    {
+        _dataExtentIndex = *indexConf;
+    }
+
     // check for validity. This will reject older caches that don't have
     // sufficient attribution.
     if (_valid)
@@ -252,6 +267,11 @@ TerrainLayer::CacheBinMetadata::getConfig() const
         conf.add("extents", extents);
     }
 
+    if (_dataExtentIndex.isSet())
+    {
+        conf.add("data_extent_index", _dataExtentIndex.get());
+    }
+
     return conf;
 }
 
@@ -262,7 +282,9 @@ TerrainLayer::TerrainLayer(const TerrainLayerOptions& initOptions,
 _initOptions   ( initOptions ),
 _runtimeOptions( runtimeOptions ),
 _openCalled( false ),
-_tileSize( 256 )
+_tileSize( 256 ),
+_blacklistRestored( false ),
+_blacklistSavedRevision( 0u )
 {
     // nop
 }
@@ -274,14 +296,42 @@ _initOptions   ( initOptions ),
 _runtimeOptions( runtimeOptions ),
 _tileSource    ( tileSource ),
 _openCalled( false ),
-_tileSize( 256 )
+_tileSize( 256 ),
+_blacklistRestored( false ),
+_blacklistSavedRevision( 0u )
 {
     // nop
 }
 
 TerrainLayer::~TerrainLayer()
 {
-    //nop
+    // release our share of a shared L2 cache.
+    SharedMemCache* shared = dynamic_cast<SharedMemCache*>( _memCache.get() );
+    if ( shared && _memCacheBin.valid() )
+    {
+        shared->removeBin( _memCacheBin.get() );
+    }
+
+    // save the blacklist next to the cached tiles if it changed.
+    TileBlacklist* blacklist = _tileSource.valid() ? _tileSource->getBlacklist() : 0L;
+    if ( blacklist &&
+         _blacklistRestored &&
+         blacklist->getRevision() != _blacklistSavedRevision &&
+         _cacheSettings.valid() &&
+         _cacheSettings->getCacheBin() &&
+         _cacheSettings->cachePolicy()->isCacheWriteable() )
+    {
+        std::stringstream buf;
+        blacklist->write( buf );
+        _cacheSettings->getCacheBin()->write(BLACKLIST_KEY, new StringObject(buf.str()), _readOptions.get());
+    }
+}
+
+bool
+TerrainLayer::getL2CacheStats(SharedMemCache::BinStats& out) const
+{
+    SharedMemCache* shared = dynamic_cast<SharedMemCache*>( _memCache.get() );
+    return shared && _memCacheBin.valid() && shared->getStats( _memCacheBin.get(), out );
 }
 
 void
@@ -309,10 +359,22 @@ TerrainLayer::init()
         l2CacheSize = 0;
     }
 
-    // Initialize the l2 cache if it's size is > 0
+    // Initialize the l2 cache if it's size is > 0. If the application installed
+    // a shared L2 cache, take a bin in that instead of creating our own.
     if ( l2CacheSize > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        SharedMemCache* shared = Registry::instance()->getSharedMemCache();
+        if ( shared )
+        {
+            _memCache = shared;
+            _memCacheBin = shared->addBin( Stringify() << getName() << "_" << getUID() );
+            shared->setBinWeight( _memCacheBin.get(), _runtimeOptions->l2CacheWeight().get() );
+        }
+        else
+        {
+            _memCache = new MemCache( l2CacheSize );
+            _memCacheBin = _memCache->getOrCreateDefaultBin();
+        }
     }
 
     // create the unique cache ID for the cache bin.
@@ -591,6 +653,17 @@ TerrainLayer::getCacheBin(const Profile* profile)
                     _tileSize = meta->_sourceTileSize.get();
                 }
 
+                // restore the data extents index so the tile source doesn't have to
+                // build it. It is only accepted if the source's extents are unchanged.
+                if ( meta->_dataExtentIndex.isSet() && getTileSource() && getTileSource()->getProfile() )
+                {
+                    osg::ref_ptr<DataExtentIndex> index = new DataExtentIndex(getTileSource()->getProfile());
+                    if ( index->fromConfig(meta->_dataExtentIndex.get(), getTileSource()->getDataExtents()) )
+                    {
+                        getTileSource()->setDataExtentIndex(index.get());
+                    }
+                }
+
                 bin->setMetadata(meta.get());
             }
             else
@@ -616,6 +689,10 @@ TerrainLayer::getCacheBin(const Profile* profile)
                 meta->_cacheCreateTime = DateTime().asTimeStamp();
                 meta->_dataExtents     = getTileSource()->getDataExtents();
 
+                osg::ref_ptr<const DataExtentIndex> index = getTileSource()->getDataExtentIndex();
+                if ( index.valid() )
+                    meta->_dataExtentIndex = index->getConfig();
+
                 // store it in the cache bin.
                 std::string data = meta->getConfig().toJSON(false);
                 bin->write(metaKey, new StringObject(data), _readOptions.get());                   
@@ -650,6 +727,23 @@ TerrainLayer::getCacheBin(const Profile* profile)
         // If we loaded a profile from the cache metadata, apply the overrides:
         applyProfileOverrides();
 
+        // Restore the tiles the source failed to produce in earlier sessions.
+        TileBlacklist* blacklist = getTileSource() ? getTileSource()->getBlacklist() : 0L;
+        if ( blacklist && !_blacklistRestored && cacheSettings->cachePolicy()->isCacheReadable() )
+        {
+            ReadResult br = bin->readString(BLACKLIST_KEY, _readOptions.get());
+            if ( br.succeeded() && !cacheSettings->cachePolicy()->isExpired(br.lastModifiedTime()) )
+            {
+                std::istringstream in( br.getString() );
+                if ( blacklist->merge(in) )
+                {
+                    OE_INFO << LC << "Restored " << blacklist->size() << " blacklisted tiles from the cache" << std::endl;
+                }
+            }
+            _blacklistSavedRevision = blacklist->getRevision();
+            _blacklistRestored = true;
+        }
+
         if (meta.valid())
         {
             _cacheBinMetadata[metaKey] = meta.get();
@@ -251,8 +251,8 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
     // check the quick cache.
     HFCacheKey cachekey;
     cachekey._key          = key;
-    cachekey._revision     = frame.getRevision();
     cachekey._samplePolicy = samplePolicy;
+    getElevationLayerRevisions( frame, key, cachekey._layers );
 
     if (progress)
         progress->stats()["hfcache_try_count"] += 1;
@@ -323,6 +323,33 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
     return populated;
 }
 
+void
+TerrainTileModelFactory::getElevationLayerRevisions(const MapFrame&   frame,
+                                                    const TileKey&    key,
+                                                    std::vector<int>& out_layers) const
+{
+    // Same tests ElevationLayerVector::populateHeightField uses to reject a
+    // layer; a rejected layer can't affect the height field.
+    const ElevationLayerVector& layers = frame.elevationLayers();
+    for(ElevationLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        ElevationLayer* layer = i->get();
+        if ( !layer->getEnabled() || !layer->getVisible() )
+            continue;
+
+        if ( layer->getTileSource() )
+        {
+            if ( !layer->isKeyInRange(key) || !layer->getTileSource()->hasDataInExtent(key.getExtent()) )
+                continue;
+        }
+
+        Revision revision;
+        layer->sync( revision );
+        out_layers.push_back( (int)layer->getUID() );
+        out_layers.push_back( revision );
+    }
+}
+
 osg::Texture*
 TerrainTileModelFactory::createImageTexture(osg::Image*       image,
                                             const ImageLayer* layer) const
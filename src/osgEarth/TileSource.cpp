@@ -30,6 +30,8 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
+#include <algorithm>
+#include <cstring>
 
 #define LC "[TileSource] "
 
@@ -40,69 +42,315 @@ using namespace osgEarth;
 
 //------------------------------------------------------------------------
 
-TileBlacklist::TileBlacklist()
+namespace
 {
-    //NOP
+    // quadtree nodes are allocated in chunks of this many:
+    const unsigned CHUNK_SIZE = 4096u;
+
+    // deepest LOD the blacklist records:
+    const unsigned MAX_LOD = 31u;
+
+    const char     BLACKLIST_MAGIC[4] = { 'O', 'E', 'B', 'L' };
+    const unsigned BLACKLIST_VERSION  = 1u;
+
+    // which child of the tile at (lod - shift - 1) contains (x, y) at lod:
+    inline unsigned childQuadrant(unsigned x, unsigned y, unsigned shift)
+    {
+        return ((x >> shift) & 1u) | (((y >> shift) & 1u) << 1);
+    }
+
+    void writeU32(std::ostream& out, unsigned value)
+    {
+        char b[4] = { (char)(value & 0xFF), (char)((value >> 8) & 0xFF), (char)((value >> 16) & 0xFF), (char)((value >> 24) & 0xFF) };
+        out.write(b, 4);
+    }
+
+    bool readU32(std::istream& in, unsigned& value)
+    {
+        unsigned char b[4];
+        if ( !in.read((char*)b, 4) )
+            return false;
+        value = (unsigned)b[0] | ((unsigned)b[1] << 8) | ((unsigned)b[2] << 16) | ((unsigned)b[3] << 24);
+        return true;
+    }
+}
+
+TileBlacklist::TileBlacklist(unsigned maxNodes) :
+_maxNodes( std::max(maxNodes, 1u) ),
+_numNodes( 0u ),
+_size    ( 0u ),
+_revision( 0u ),
+_subtrees( false ),
+_full    ( false )
+{
+    _chunks.resize( (_maxNodes + CHUNK_SIZE - 1u) / CHUNK_SIZE, (Node*)0L );
+}
+
+TileBlacklist::~TileBlacklist()
+{
+    for(unsigned i=0; i<_chunks.size(); ++i)
+        delete [] _chunks[i];
+}
+
+TileBlacklist::Node&
+TileBlacklist::node(unsigned ref) const
+{
+    return _chunks[(ref-1u) / CHUNK_SIZE][(ref-1u) % CHUNK_SIZE];
+}
+
+unsigned
+TileBlacklist::allocNode(unsigned flags)
+{
+    unsigned i = _numNodes;
+    if ( i >= _maxNodes )
+    {
+        if ( !_full )
+        {
+            OE_INFO << LC << "Blacklist is full (" << _maxNodes << " nodes); no more tiles will be recorded" << std::endl;
+            _full = true;
+        }
+        return 0u;
+    }
+
+    Node*& chunk = _chunks[i / CHUNK_SIZE];
+    if ( !chunk )
+        chunk = new Node[CHUNK_SIZE];
+
+    // initialize before anyone can link to it:
+    Node& n = chunk[i % CHUNK_SIZE];
+    for(unsigned c=0; c<4u; ++c)
+        n._children[c].exchange( 0u );
+    n._flags.exchange( 0u );
+
+    ++_numNodes;
+
+    unsigned ref = i + 1u;
+    setFlags( ref, flags );
+    return ref;
+}
+
+unsigned
+TileBlacklist::getOrCreateChild(OpenThreads::Atomic& link)
+{
+    unsigned ref = link;
+    if ( ref == 0u )
+    {
+        ref = allocNode( 0u );
+        if ( ref != 0u )
+            link.exchange( ref );
+    }
+    return ref;
+}
+
+void
+TileBlacklist::setFlags(unsigned ref, unsigned flags)
+{
+    unsigned old = node(ref)._flags.exchange( flags );
+    if ( old == flags )
+        return;
+
+    if ( (flags & BLACKLISTED) && !(old & BLACKLISTED) )
+        ++_size;
+    else if ( !(flags & BLACKLISTED) && (old & BLACKLISTED) )
+        --_size;
+
+    ++_revision;
+}
+
+unsigned
+TileBlacklist::countBlacklisted(unsigned ref) const
+{
+    const Node& n = node(ref);
+    unsigned count = (n._flags & BLACKLISTED) ? 1u : 0u;
+    for(unsigned c=0; c<4u; ++c)
+    {
+        unsigned child = n._children[c];
+        if ( child != 0u )
+            count += countBlacklisted( child );
+    }
+    return count;
+}
+
+void
+TileBlacklist::prune(unsigned ref)
+{
+    // The pruned nodes are not reused (until clear) since a lookup may be inside them.
+    Node& n = node(ref);
+    for(unsigned c=0; c<4u; ++c)
+    {
+        unsigned child = n._children[c];
+        if ( child != 0u )
+        {
+            unsigned count = countBlacklisted( child );
+            n._children[c].exchange( 0u );
+            for(unsigned i=0; i<count; ++i)
+                --_size;
+            ++_revision;
+        }
+    }
 }
 
 void
 TileBlacklist::add(const TileKey& key)
 {
-    Threading::ScopedWriteLock lock(_mutex);
-    _tiles.insert(key);
+    unsigned lod = key.getLOD(), x = key.getTileX(), y = key.getTileY();
+    if ( lod > MAX_LOD || (x >> lod) >= ROOTS_WIDE || (y >> lod) >= ROOTS_WIDE )
+        return;
+
+    Threading::ScopedMutexLock lock(_writeMutex);
+
+    // walk down to the tile, creating nodes as necessary. path[i] is the node at LOD i.
+    unsigned path[MAX_LOD+1u];
+    OpenThreads::Atomic* link = &_roots[(y >> lod)*ROOTS_WIDE + (x >> lod)];
+    for(unsigned level = 0u; ; ++level)
+    {
+        unsigned ref = getOrCreateChild( *link );
+        if ( ref == 0u )
+            return;
+
+        // already covered by a blacklisted subtree?
+        if ( node(ref)._flags & SUBTREE )
+            return;
+
+        path[level] = ref;
+        if ( level == lod )
+            break;
+
+        link = &node(ref)._children[childQuadrant(x, y, lod-level-1u)];
+    }
+
+    if ( !_subtrees )
+    {
+        setFlags( path[lod], node(path[lod])._flags | BLACKLISTED );
+    }
+    else
+    {
+        // flag before pruning so a concurrent lookup never sees a gap.
+        setFlags( path[lod], BLACKLISTED | SUBTREE );
+        prune( path[lod] );
+
+        // four blacklisted siblings collapse into their parent:
+        for(unsigned level = lod; level > 0u; --level)
+        {
+            const Node& parent = node(path[level-1u]);
+            bool covered = true;
+            for(unsigned c=0; c<4u && covered; ++c)
+            {
+                unsigned child = parent._children[c];
+                covered = child != 0u && (node(child)._flags & SUBTREE) != 0u;
+            }
+            if ( !covered )
+                break;
+
+            setFlags( path[level-1u], BLACKLISTED | SUBTREE );
+            prune( path[level-1u] );
+        }
+    }
+
     OE_DEBUG << "Added " << key.str() << " to blacklist" << std::endl;
 }
 
 void
 TileBlacklist::remove(const TileKey& key)
 {
-    Threading::ScopedWriteLock lock(_mutex);
-    _tiles.erase(key);
+    unsigned lod = key.getLOD(), x = key.getTileX(), y = key.getTileY();
+    if ( lod > MAX_LOD || (x >> lod) >= ROOTS_WIDE || (y >> lod) >= ROOTS_WIDE )
+        return;
+
+    Threading::ScopedMutexLock lock(_writeMutex);
+
+    OpenThreads::Atomic* link = &_roots[(y >> lod)*ROOTS_WIDE + (x >> lod)];
+    for(unsigned level = 0u; ; ++level)
+    {
+        unsigned ref = *link;
+        if ( ref == 0u )
+            return;
+
+        if ( level == lod )
+        {
+            setFlags( ref, 0u );
+            break;
+        }
+
+        unsigned q = childQuadrant(x, y, lod-level-1u);
+
+        // A blacklisted subtree above the tile: split it into its four
+        // children (all still blacklisted) and continue down.
+        if ( node(ref)._flags & SUBTREE )
+        {
+            if ( _numNodes + 4u > _maxNodes )
+            {
+                OE_INFO << LC << "Blacklist is full; cannot remove " << key.str() << std::endl;
+                return;
+            }
+
+            for(unsigned c=0; c<4u; ++c)
+                node(ref)._children[c].exchange( allocNode(BLACKLISTED | SUBTREE) );
+
+            setFlags( ref, 0u );
+        }
+
+        link = &node(ref)._children[q];
+    }
+
     OE_DEBUG << "Removed " << key.str() << " from blacklist" << std::endl;
 }
 
 void
 TileBlacklist::clear()
 {
-    Threading::ScopedWriteLock lock(_mutex);
-    _tiles.clear();
+    Threading::ScopedMutexLock lock(_writeMutex);
+
+    for(unsigned i=0; i<ROOTS_WIDE*ROOTS_WIDE; ++i)
+        _roots[i].exchange( 0u );
+
+    _numNodes.exchange( 0u );
+    _size.exchange( 0u );
+    ++_revision;
+    _full = false;
+
     OE_DEBUG << "Cleared blacklist" << std::endl;
 }
 
 bool
 TileBlacklist::contains(const TileKey& key) const
 {
-    Threading::ScopedReadLock lock(_mutex);
-    return _tiles.find(key) != _tiles.end();
+    unsigned lod = key.getLOD(), x = key.getTileX(), y = key.getTileY();
+    if ( lod > MAX_LOD || (x >> lod) >= ROOTS_WIDE || (y >> lod) >= ROOTS_WIDE )
+        return false;
+
+    unsigned ref = _roots[(y >> lod)*ROOTS_WIDE + (x >> lod)];
+    for(unsigned level = 0u; ref != 0u; ++level)
+    {
+        const Node& n = node(ref);
+        unsigned flags = n._flags;
+
+        if ( flags & SUBTREE )
+            return true;
+
+        if ( level == lod )
+            return (flags & BLACKLISTED) != 0u;
+
+        ref = n._children[childQuadrant(x, y, lod-level-1u)];
+    }
+    return false;
 }
 
 unsigned int
 TileBlacklist::size() const
 {
-    Threading::ScopedReadLock lock(_mutex);
-    return _tiles.size();
+    return _size;
 }
 
 TileBlacklist*
 TileBlacklist::read(std::istream &in)
 {
     osg::ref_ptr< TileBlacklist > result = new TileBlacklist();
-
-    while (!in.eof())
+    if ( !result->merge(in) )
     {
-        std::string line;
-        std::getline(in, line);
-        if (!line.empty())
-        {
-            int z, x, y;
-            if (sscanf(line.c_str(), "%d %d %d", &z, &x, &y) == 3)
-            {
-                result->add(TileKey(z, x, y, 0L));
-            }
-
-        }
+        OE_WARN << LC << "Blacklist data is malformed; ignoring it" << std::endl;
+        return 0L;
     }
-
     return result.release();
 }
 
@@ -111,12 +359,102 @@ TileBlacklist::read(const std::string &filename)
 {
     if (osgDB::fileExists(filename) && (osgDB::fileType(filename) == osgDB::REGULAR_FILE))
     {
-        std::ifstream in( filename.c_str() );
+        std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
         return read( in );
     }
     return NULL;
 }
 
+bool
+TileBlacklist::merge(std::istream& in)
+{
+    // older blacklists are text, one "lod x y" per line:
+    if ( in.peek() != BLACKLIST_MAGIC[0] )
+    {
+        while (!in.eof())
+        {
+            std::string line;
+            std::getline(in, line);
+            if (!line.empty())
+            {
+                int z, x, y;
+                if (sscanf(line.c_str(), "%d %d %d", &z, &x, &y) == 3)
+                {
+                    add(TileKey(z, x, y, 0L));
+                }
+            }
+        }
+        return true;
+    }
+
+    char magic[4];
+    unsigned version, numRoots;
+    if ( !in.read(magic, 4) || ::memcmp(magic, BLACKLIST_MAGIC, 4) != 0 ||
+         !readU32(in, version) || version != BLACKLIST_VERSION ||
+         !readU32(in, numRoots) || numRoots > ROOTS_WIDE*ROOTS_WIDE )
+    {
+        return false;
+    }
+
+    Threading::ScopedMutexLock lock(_writeMutex);
+
+    for(unsigned i=0; i<numRoots; ++i)
+    {
+        int rx = in.get(), ry = in.get();
+        if ( rx < 0 || ry < 0 || (unsigned)rx >= ROOTS_WIDE || (unsigned)ry >= ROOTS_WIDE )
+            return false;
+
+        if ( !readNode(&_roots[ry*ROOTS_WIDE + rx], in, 0u) )
+            return false;
+    }
+    return true;
+}
+
+bool
+TileBlacklist::readNode(OpenThreads::Atomic* link, std::istream& in, unsigned depth)
+{
+    int b = in.get();
+    if ( b < 0 || depth > MAX_LOD )
+        return false;
+
+    unsigned flags     = (unsigned)b & 3u;
+    unsigned childMask = (unsigned)b >> 2;
+    if ( childMask > 15u )
+        return false;
+
+    // A null link means we are skipping a subtree that is already covered
+    // (or that there is no room for).
+    unsigned ref = link ? getOrCreateChild(*link) : 0u;
+    if ( ref != 0u )
+    {
+        unsigned existing = node(ref)._flags;
+        if ( existing & SUBTREE )
+        {
+            ref = 0u;
+        }
+        else if ( flags & SUBTREE )
+        {
+            setFlags( ref, BLACKLISTED | SUBTREE );
+            prune( ref );
+            ref = 0u;
+        }
+        else
+        {
+            setFlags( ref, existing | flags );
+        }
+    }
+
+    for(unsigned c=0; c<4u; ++c)
+    {
+        if ( childMask & (1u << c) )
+        {
+            if ( !readNode(ref != 0u ? &node(ref)._children[c] : 0L, in, depth+1u) )
+                return false;
+        }
+    }
+    return true;
+}
+
 void
 TileBlacklist::write(const std::string &filename) const
 { 
@@ -126,20 +464,53 @@ TileBlacklist::write(const std::string &filename) const
         OE_NOTICE << "Couldn't create path " << path << std::endl;
         return;
     }
-    std::ofstream out(filename.c_str());
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
     write(out);
 }
 
 void
 TileBlacklist::write(std::ostream &output) const
 {
-    Threading::ScopedReadLock lock(const_cast<TileBlacklist*>(this)->_mutex);
-    for (BlacklistedTiles::const_iterator itr = _tiles.begin(); itr != _tiles.end(); ++itr)
+    Threading::ScopedMutexLock lock(_writeMutex);
+
+    unsigned numRoots = 0u;
+    for(unsigned i=0; i<ROOTS_WIDE*ROOTS_WIDE; ++i)
+        if ( _roots[i] != 0u )
+            ++numRoots;
+
+    output.write(BLACKLIST_MAGIC, 4);
+    writeU32(output, BLACKLIST_VERSION);
+    writeU32(output, numRoots);
+
+    for(unsigned i=0; i<ROOTS_WIDE*ROOTS_WIDE; ++i)
     {
-        output << itr->getLOD() << " " << itr->getTileX() << " " << itr->getTileY() << std::endl;
+        unsigned ref = _roots[i];
+        if ( ref != 0u )
+        {
+            output.put( (char)(i % ROOTS_WIDE) );
+            output.put( (char)(i / ROOTS_WIDE) );
+            writeNode( ref, output );
+        }
     }
 }
 
+void
+TileBlacklist::writeNode(unsigned ref, std::ostream& out) const
+{
+    const Node& n = node(ref);
+
+    unsigned childMask = 0u;
+    for(unsigned c=0; c<4u; ++c)
+        if ( n._children[c] != 0u )
+            childMask |= (1u << c);
+
+    out.put( (char)((n._flags & 3u) | (childMask << 2)) );
+
+    for(unsigned c=0; c<4u; ++c)
+        if ( childMask & (1u << c) )
+            writeNode( n._children[c], out );
+}
+
 
 //------------------------------------------------------------------------
 
@@ -150,6 +521,7 @@ _tileSize             ( 256 ),
 _noDataValue          ( (float)SHRT_MIN ),
 _minValidValue        ( -32000.0f ),
 _maxValidValue        (  32000.0f ),
+_blacklistSubtrees    ( false ),
 _L2CacheSize          ( 16 ),
 _bilinearReprojection ( true ),
 _coverage             ( false )
@@ -167,6 +539,7 @@ TileSourceOptions::getConfig() const
     conf.updateIfSet( "min_valid_value", _minValidValue );
     conf.updateIfSet( "max_valid_value", _maxValidValue );
     conf.updateIfSet( "blacklist_filename", _blacklistFilename);
+    conf.updateIfSet( "blacklist_subtrees", _blacklistSubtrees);
     conf.updateIfSet( "l2_cache_size", _L2CacheSize );
     conf.updateIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.updateIfSet( "max_data_level", _maxDataLevel );
@@ -195,6 +568,7 @@ TileSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "max_valid_value", _maxValidValue );
     conf.getIfSet( "nodata_max", _maxValidValue ); // backcompat
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
+    conf.getIfSet( "blacklist_subtrees", _blacklistSubtrees);
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "max_data_level", _maxDataLevel );
@@ -266,6 +640,11 @@ _mode   ( 0 )
         //Initialize the blacklist if we couldn't read it.
         _blacklist = new TileBlacklist();
     }
+
+    if (_options.blacklistSubtrees().isSet())
+    {
+        _blacklist->setSubtrees(_options.blacklistSubtrees().get());
+    }
 }
 
 TileSource::~TileSource()
@@ -333,7 +712,9 @@ TileSource::getPixelsPerTile() const
 
 void TileSource::dirtyDataExtents()
 {
+    Threading::ScopedMutexLock lock(_mutex);
     _dataExtentsUnion = GeoExtent::INVALID;
+    _dataExtentIndex = 0L;
 }
 
 const GeoExtent& TileSource::getDataExtentsUnion() const
@@ -356,6 +737,33 @@ const GeoExtent& TileSource::getDataExtentsUnion() const
     return _dataExtentsUnion;
 }
 
+osg::ref_ptr<const DataExtentIndex>
+TileSource::getDataExtentIndex() const
+{
+    // Take the reference under the lock so that a concurrent dirtyDataExtents()
+    // or setDataExtentIndex() cannot free the index out from under the caller.
+    Threading::ScopedMutexLock lock(_mutex);
+    if (!_dataExtentIndex.valid() && _dataExtents.size() > 0 && getProfile())
+    {
+        osg::ref_ptr<DataExtentIndex> index = new DataExtentIndex(getProfile());
+        index->build(_dataExtents);
+        if (index->valid())
+        {
+            OE_DEBUG << LC << "Indexed " << index->getNumExtents() << " data extents in "
+                << index->getNumNodes() << " nodes" << std::endl;
+            _dataExtentIndex = index.get();
+        }
+    }
+    return _dataExtentIndex;
+}
+
+void
+TileSource::setDataExtentIndex(const DataExtentIndex* index)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _dataExtentIndex = index;
+}
+
 osg::Image*
 TileSource::createImage(const TileKey&        key,
                         ImageOperation*       prepOp, 
@@ -512,6 +920,10 @@ TileSource::hasDataInExtent( const GeoExtent& extent ) const
     if ( _dataExtents.size() == 0 )
         return true;
 
+    osg::ref_ptr<const DataExtentIndex> index = getDataExtentIndex();
+    if ( index.valid() )
+        return index->hasDataInExtent( extent );
+
     bool intersects = false;
 
     for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
@@ -540,7 +952,14 @@ TileSource::hasDataAt( const GeoPoint& location, bool exact) const
     {
         return getDataExtentsUnion().contains(location);
     }
-   
+
+    osg::ref_ptr<const DataExtentIndex> index = getDataExtentIndex();
+    GeoPoint local;
+    if (index.valid() && location.transform(getProfile()->getSRS(), local))
+    {
+        return index->hasDataAt(local.x(), local.y());
+    }
+
 
     for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
     {
@@ -571,7 +990,8 @@ TileSource::hasData(const osgEarth::TileKey& key) const
     unsigned int lod = key.getLevelOfDetail();
 
     // Remap the lod to an appropriate lod if it's not in the same SRS        
-    if (!key.getProfile()->isHorizEquivalentTo( getProfile() ) )
+    bool sameProfile = key.getProfile()->isHorizEquivalentTo( getProfile() );
+    if ( !sameProfile )
     {        
         lod = getProfile()->getEquivalentLOD( key.getProfile(), key.getLevelOfDetail() );        
     }
@@ -588,6 +1008,14 @@ TileSource::hasData(const osgEarth::TileKey& key) const
         return true;
     }
 
+    // Keys in our own profile can go straight to the index.
+    if (sameProfile)
+    {
+        osg::ref_ptr<const DataExtentIndex> index = getDataExtentIndex();
+        if (index.valid())
+            return index->hasData(key);
+    }
+
     bool intersectsData = false;
     const osgEarth::GeoExtent& keyExtent = key.getExtent();
     
@@ -692,6 +1120,13 @@ TileSource::hasDataForFallback(const osgEarth::TileKey& key) const
     if (_dataExtents.size() == 0) 
         return true;
 
+    if (key.getProfile()->isHorizEquivalentTo(getProfile()))
+    {
+        osg::ref_ptr<const DataExtentIndex> index = getDataExtentIndex();
+        if (index.valid())
+            return index->hasDataForFallback(key);
+    }
+
     const osgEarth::GeoExtent& keyExtent = key.getExtent();
     bool intersectsData = false;
 
@@ -23,12 +23,17 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
 #include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
 #include <osgDB/Archive>
+#include <OpenThreads/Condition>
 #include <fstream>
 #include <sstream>
+#include <list>
+#include <vector>
 
 #define LC "[URI] "
 
@@ -282,6 +287,46 @@ namespace
         return ReadResult();
     }
 
+    // finds a response header in the cached metadata (header names are case-insensitive)
+    std::string getHeader( const Config& meta, const std::string& name )
+    {
+        for(ConfigSet::const_iterator i = meta.children().begin(); i != meta.children().end(); ++i)
+        {
+            if ( ciEquals(i->key(), name) )
+                return i->value();
+        }
+        return "";
+    }
+
+    // builds a request that revalidates the cached copy (if any) instead of
+    // downloading it again; the server can then answer with a 304. "cached"
+    // may also hold just the validators of a copy kept by the caller (see
+    // RevalidationProgress).
+    HTTPRequest createRequest( const std::string& uri, const ReadResult& cached )
+    {
+        HTTPRequest req(uri);
+        if ( cached.code() == ReadResult::RESULT_OK )
+        {
+            std::string etag = getHeader(cached.metadata(), "ETag");
+            if ( !etag.empty() )
+            {
+                req.setETag( etag );
+            }
+
+            // prefer the server's own Last-Modified value over our record's timestamp
+            std::string lastModified = getHeader(cached.metadata(), "Last-Modified");
+            if ( !lastModified.empty() )
+            {
+                req.addHeader( "If-Modified-Since", lastModified );
+            }
+            else if ( cached.lastModifiedTime() > 0 )
+            {
+                req.setLastModified( cached.lastModifiedTime() );
+            }
+        }
+        return req;
+    }
+
 
     //--------------------------------------------------------------------
     // Read functors (used by the doRead method)
@@ -291,13 +336,9 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_OBJECTS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readObject(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readObject(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached )
         {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+            HTTPRequest req = createRequest(uri, cached);
             return HTTPClient::readObject(req, opt, p);
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return ReadResult(osgDB::readObjectFile(uri, opt)); }
@@ -308,13 +349,9 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_NODES) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readNode(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key ) { return bin->readObject(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached )
         {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+            HTTPRequest req = createRequest(uri, cached);
             return HTTPClient::readNode(req, opt, p);
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return ReadResult(osgDB::readNodeFile(uri, opt)); }
@@ -335,12 +372,8 @@ namespace
             if ( r.getImage() ) r.getImage()->setFileName( key );
             return r;
         }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified ) { 
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached ) { 
+            HTTPRequest req = createRequest(uri, cached);
             ReadResult r = HTTPClient::readImage(req, opt, p);
             if ( r.getImage() ) r.getImage()->setFileName( uri );
             return r;
@@ -357,18 +390,49 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_STRINGS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readString(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readString(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached )
         {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+            HTTPRequest req = createRequest(uri, cached);
             return HTTPClient::readString(req, opt, p);
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return readStringFile(uri, opt); }
     };
 
+    //--------------------------------------------------------------------
+    // Revalidates an expired cache record in the background, so the reader
+    // that found it can use the stale copy right away.
+
+    template<typename READ_FUNCTOR>
+    struct URIRefreshTask : public TaskRequest
+    {
+        URIRefreshTask(const URI& uri, const ReadResult& cached, CacheBin* bin, const osgDB::Options* options) :
+            _uri    ( uri ),
+            _cached ( cached ),
+            _bin    ( bin ),
+            _options( options ) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            READ_FUNCTOR reader;
+            ReadResult r = reader.fromHTTP( _uri.full(), _options.get(), progress, _cached );
+            if ( r.code() == ReadResult::RESULT_NOT_MODIFIED )
+            {
+                OE_DEBUG << LC << _uri.full() << " revalidated" << std::endl;
+                _bin->touch( _uri.cacheKey() );
+            }
+            else if ( r.succeeded() )
+            {
+                OE_DEBUG << LC << _uri.full() << " refreshed" << std::endl;
+                _bin->write( _uri.cacheKey(), r.getObject(), r.metadata(), _options.get() );
+            }
+        }
+
+        URI                                _uri;
+        ReadResult                         _cached;
+        osg::ref_ptr<CacheBin>             _bin;
+        osg::ref_ptr<const osgDB::Options> _options;
+    };
+
     //--------------------------------------------------------------------
     // MASTER read template function. I templatized this so we wouldn't
     // have 4 95%-identical code paths to maintain...
@@ -479,6 +543,22 @@ namespace
                         }
                     }
 
+                    // Serve an expired record as-is and revalidate it in the background
+                    // if the policy allows it.
+                    if ( expired && !cb && cp->staleWhileRevalidate() == true &&
+                         cp->isCacheWriteable() && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
+                    {
+                        osg::ref_ptr<osgDB::Options> remoteOptions =
+                            Registry::instance()->cloneOrCreateOptions( localOptions );
+                        remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
+
+                        CacheRefreshService::instance()->schedule(
+                            bin->getID() + "/" + uri.cacheKey(),
+                            new URIRefreshTask<READ_FUNCTOR>(uri, result, bin.get(), remoteOptions.get()) );
+
+                        expired = false;
+                    }
+
                     // If it's not cached, or it is cached but is expired then try to hit the server.                    
                     if ( result.empty() || expired )
                     {                        
@@ -487,8 +567,8 @@ namespace
                             Registry::instance()->cloneOrCreateOptions( localOptions );
                         remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
 
-                        // Store the existing object from the cache if there is one.
-                        osg::ref_ptr< osg::Object > object = result.getObject();
+                        // Store the existing record from the cache if there is one.
+                        ReadResult cached = result;
 
                         // try to use the callback if it's set. Callback ignores the caching policy.
                         if ( cb )
@@ -500,6 +580,10 @@ namespace
                                 // "not implemented" is the only excuse for falling back
                                 gotResultFromCallback = true;
                             }
+                            else
+                            {
+                                result = cached;
+                            }
                         }
 
                         if ( !gotResultFromCallback )
@@ -507,7 +591,21 @@ namespace
                             // still no data, go to the source:
                             if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
                             {                                
-                                ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
+                                // the caller may hold its own copy of the data (e.g. a layer's tile cache).
+                                RevalidationProgress* revalidation = RevalidationProgress::from(progress);
+                                ReadResult validators = cached;
+                                if ( revalidation && !cached.succeeded() )
+                                {
+                                    validators = ReadResult( ReadResult::RESULT_OK, 0L, revalidation->getValidators(uri.full()) );
+                                }
+
+                                ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, validators );
+
+                                if ( revalidation )
+                                {
+                                    revalidation->recordRead( uri.full(), remoteResult );
+                                }
+
                                 if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
                                 {                                    
                                     OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
@@ -591,6 +689,520 @@ URI::readString(const osgDB::Options* dbOptions,
     return doRead<ReadString>( *this, dbOptions, progress );
 }
 
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Worker threads for URI::readImageAsync. They read local files, check
+    // the cache and decode responses; they never wait on the network. The
+    // pool is stopped by URI::shutdownAsync(), never during static destruction.
+    class AsyncReadPool
+    {
+    public:
+        AsyncReadPool(unsigned numThreads) : _done(false)
+        {
+            for(unsigned i=0; i<numThreads; ++i)
+            {
+                _threads.push_back( new Worker(this) );
+                _threads.back()->start();
+            }
+        }
+
+        ~AsyncReadPool()
+        {
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                _done = true;
+                _cond.broadcast();
+            }
+
+            for(unsigned i=0; i<_threads.size(); ++i)
+            {
+                _threads[i]->join();
+                delete _threads[i];
+            }
+
+            // fail the reads that never started so no one waits forever.
+            for(Queue::iterator i = _queue.begin(); i != _queue.end(); ++i)
+            {
+                (*i)->cancel();
+                (**i)( (*i)->getProgressCallback() );
+            }
+        }
+
+        void add(TaskRequest* task)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            _queue.push_back( task );
+            _cond.signal();
+        }
+
+    private:
+        struct Worker : public OpenThreads::Thread
+        {
+            Worker(AsyncReadPool* pool) : _pool(pool) { }
+
+            void run()
+            {
+                osg::ref_ptr<TaskRequest> task;
+                while( _pool->next(task) )
+                {
+                    (*task)( task->getProgressCallback() );
+                    task = 0L;
+                }
+            }
+
+            AsyncReadPool* _pool;
+        };
+
+        // blocks until there is a task to run; returns false at shutdown.
+        bool next(osg::ref_ptr<TaskRequest>& task)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            while( !_done && _queue.empty() )
+                _cond.wait( &_mutex );
+            if ( _done )
+                return false;
+            task = _queue.front().get();
+            _queue.pop_front();
+            return true;
+        }
+
+        typedef std::list< osg::ref_ptr<TaskRequest> > Queue;
+
+        OpenThreads::Mutex     _mutex;
+        OpenThreads::Condition _cond;
+        Queue                  _queue;
+        bool                   _done;
+        std::vector<Worker*>   _threads;
+    };
+
+    struct AsyncReadPoolHolder
+    {
+        AsyncReadPoolHolder() : _pool(0L) { }
+        AsyncReadPool*   _pool;
+        Threading::Mutex _mutex;
+    };
+    static AsyncReadPoolHolder s_asyncReads;
+
+    // Queues a task on the pool, starting the pool if necessary. Returns
+    // false if "start" is false and the pool is not running (i.e. it was
+    // shut down while a response was on its way).
+    bool queueAsyncRead(TaskRequest* task, bool start)
+    {
+        Threading::ScopedMutexLock lock( s_asyncReads._mutex );
+        if ( !s_asyncReads._pool )
+        {
+            if ( !start )
+                return false;
+
+            // the work is local I/O and decoding, so one thread per core
+            s_asyncReads._pool = new AsyncReadPool( osg::maximum(OpenThreads::GetNumberOfProcessors(), 2) );
+        }
+        s_asyncReads._pool->add( task );
+        return true;
+    }
+}
+
+const ReadResult&
+URIFuture::get()
+{
+    while( !_ready.isSet() )
+        _ready.wait();
+    return _result;
+}
+
+/**
+ * One readImageAsync() call. It runs on the pool twice for a remote URI:
+ * once to check the caches and start the request on the asynchronous HTTP
+ * engine, and again to decode the response when it arrives. Everything
+ * else (local files, read callbacks, cache hits) finishes in the first run.
+ */
+struct URI::AsyncRead : public TaskRequest
+{
+    // reports a cancel() on the future, or on the caller's own progress callback
+    struct Progress : public ProgressCallback
+    {
+        Progress(URIFuture* future, ProgressCallback* user) : _future(future), _user(user) { }
+
+        bool isCanceled()
+        {
+            return
+                ProgressCallback::isCanceled() ||
+                _future->isCancelRequested()   ||
+                (_user.valid() && _user->isCanceled());
+        }
+
+        URIFuture*                     _future;  // owned by the read
+        osg::ref_ptr<ProgressCallback> _user;
+    };
+
+    // hands the response back to the pool for decoding; runs on the HTTP I/O thread.
+    struct Response : public HTTPResponseCallback
+    {
+        Response(AsyncRead* read) : _read(read) { }
+
+        void onResponse(const HTTPRequest& request, const HTTPResponse& response)
+        {
+            _read->_response = response;
+            _read->_received = true;
+            if ( !queueAsyncRead(_read.get(), false) )
+            {
+                _read->finish( ReadResult(ReadResult::RESULT_CANCELED) );
+            }
+            _read = 0L;
+        }
+
+        osg::ref_ptr<AsyncRead> _read;
+    };
+
+    AsyncRead(const URI& uri, URIFuture* future, const osgDB::Options* options, ProgressCallback* progress, URIResultCallback* callback) :
+        _uri     ( uri ),
+        _options ( options ),
+        _callback( callback ),
+        _future  ( future ),
+        _user    ( progress ),
+        _memCache( 0L ),
+        _request ( std::string() ),
+        _received( false )
+    {
+        setProgressCallback( new Progress(_future.get(), progress) );
+    }
+
+    void operator()(ProgressCallback* progress)
+    {
+        if ( progress->isCanceled() )
+            finish( ReadResult(ReadResult::RESULT_CANCELED) );
+        else if ( _received )
+            decode( progress );
+        else
+            start( progress );
+    }
+
+    // Checks the memory and disk caches, and either finishes or sends the request.
+    void start(ProgressCallback* progress)
+    {
+        // same options readImage() would use:
+        osg::ref_ptr<const osgDB::Options> localOptions = _options.valid() ? _options.get() : Registry::instance()->getDefaultOptions();
+        if ( _uri.optionString().isSet() )
+        {
+            osgDB::Options* newLocalOptions = Registry::cloneOrCreateOptions(localOptions.get());
+            newLocalOptions->setOptionString(
+                _uri.optionString().get() + " " + localOptions->getOptionString());
+            localOptions = newLocalOptions;
+        }
+
+        URIAliasMap* aliasMap = URIAliasMap::from( localOptions.get() );
+        _resolved = aliasMap ? aliasMap->resolve(_uri.full(), _uri.context()) : _uri;
+
+        // local files and read callbacks take the blocking path; so does a
+        // cache-only policy, and a stale record served while it revalidates.
+        if ( _resolved.empty() || !_resolved.isRemote() || Registry::instance()->getURIReadCallback() )
+        {
+            finish( _uri.readImage(_options.get(), progress), false );
+            return;
+        }
+
+        _memCache = URIResultCache::from( localOptions.get() );
+        if ( _memCache )
+        {
+            URIResultCache::Record rec;
+            if ( _memCache->get(_resolved, rec) )
+            {
+                finish( rec.value() );
+                return;
+            }
+        }
+
+        CacheSettings* cacheSettings = CacheSettings::get(localOptions.get());
+        if ( cacheSettings )
+        {
+            _policy = cacheSettings->cachePolicy();
+            if ( _policy->isCacheEnabled() )
+                _bin = cacheSettings->getCacheBin();
+        }
+
+        ReadImage reader;
+        if ( _bin.valid() && _policy->isCacheReadable() )
+        {
+            _cached = reader.fromCache( _bin.get(), _resolved.cacheKey() );
+            if ( _cached.succeeded() )
+            {
+                _cached.setIsFromCache( true );
+                if ( !_policy->isExpired(_cached.lastModifiedTime()) )
+                {
+                    finishRemote( _cached );
+                    return;
+                }
+
+                if ( _policy->staleWhileRevalidate() == true && _policy->isCacheWriteable() )
+                {
+                    finish( _uri.readImage(_options.get(), progress), false );
+                    return;
+                }
+            }
+        }
+
+        if ( _policy.isSet() && _policy->usage() == CachePolicy::USAGE_CACHE_ONLY )
+        {
+            finishRemote( _cached );
+            return;
+        }
+
+        // Need to do this to support nested PLODs and Proxynodes.
+        osg::ref_ptr<osgDB::Options> remoteOptions = Registry::instance()->cloneOrCreateOptions( localOptions.get() );
+        remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(_resolved.full()) );
+        _remoteOptions = remoteOptions.get();
+
+        // the caller may hold its own copy of the data (e.g. a layer's tile cache).
+        ReadResult validators = _cached;
+        RevalidationProgress* revalidation = RevalidationProgress::from(_user.get());
+        if ( revalidation && !_cached.succeeded() )
+        {
+            validators = ReadResult( ReadResult::RESULT_OK, 0L, revalidation->getValidators(_resolved.full()) );
+        }
+
+        // the engine calls back when the response is in; this thread moves on.
+        _request = createRequest( _resolved.full(), validators );
+        HTTPClient::getAsync( _request, _remoteOptions.get(), progress, new Response(this) );
+    }
+
+    // Decodes the response, updates the cache and finishes.
+    void decode(ProgressCallback* progress)
+    {
+        ReadResult result = HTTPClient::decodeImage( _request, _response, _remoteOptions.get(), progress );
+        if ( result.getImage() )
+            result.getImage()->setFileName( _resolved.full() );
+
+        RevalidationProgress* revalidation = RevalidationProgress::from(_user.get());
+        if ( revalidation )
+        {
+            revalidation->recordRead( _resolved.full(), result );
+        }
+
+        if ( result.code() == ReadResult::RESULT_NOT_MODIFIED )
+        {
+            OE_DEBUG << LC << _resolved.full() << " not modified, using cached result" << std::endl;
+            if ( _bin.valid() )
+                _bin->touch( _resolved.cacheKey() );
+
+            // a RevalidationProgress caller keeps its own copy; it gets "not modified".
+            if ( _cached.succeeded() )
+                result = _cached;
+        }
+        else if ( result.succeeded() && _bin.valid() && _policy->isCacheWriteable() )
+        {
+            OE_DEBUG << LC << "Writing " << _resolved.cacheKey() << " to cache" << std::endl;
+            _bin->write( _resolved.cacheKey(), result.getObject(), result.metadata(), _remoteOptions.get() );
+        }
+
+        finishRemote( result );
+    }
+
+    // names and memory-caches a result that came from the cache or the network.
+    void finishRemote(ReadResult result)
+    {
+        if ( result.getObject() )
+        {
+            result.getObject()->setName( _resolved.base() );
+            if ( _memCache )
+                _memCache->insert( _resolved, result );
+        }
+        finish( result );
+    }
+
+    // "postProcess" is false for results from readImage(), which already did it.
+    void finish(ReadResult result, bool postProcess =true)
+    {
+        if ( postProcess )
+        {
+            URIPostReadCallback* post = URIPostReadCallback::from(_options.get());
+            if ( post )
+                (*post)(result);
+        }
+
+        if ( _callback.valid() )
+            _callback->onResult( _uri, result );
+
+        URI::resolveAsync( _future.get(), result );
+    }
+
+    URI                                _uri;
+    osg::ref_ptr<const osgDB::Options> _options;
+    osg::ref_ptr<URIResultCallback>    _callback;
+    osg::ref_ptr<URIFuture>            _future;
+    osg::ref_ptr<ProgressCallback>     _user;
+
+    // state carried from start() to decode():
+    URI                                _resolved;
+    URIResultCache*                    _memCache;  // owned by the options
+    optional<CachePolicy>              _policy;
+    osg::ref_ptr<CacheBin>             _bin;
+    ReadResult                         _cached;
+    osg::ref_ptr<const osgDB::Options> _remoteOptions;
+    HTTPRequest                        _request;
+    HTTPResponse                       _response;
+    bool                               _received;
+};
+
+osg::ref_ptr<URIFuture>
+URI::readImageAsync(const osgDB::Options* dbOptions,
+                    ProgressCallback*     progress,
+                    URIResultCallback*    callback) const
+{
+    osg::ref_ptr<URIFuture> future = new URIFuture();
+    osg::ref_ptr<AsyncRead> read = new AsyncRead( *this, future.get(), dbOptions, progress, callback );
+    queueAsyncRead( read.get(), true );
+    return future;
+}
+
+void
+URI::resolveAsync(URIFuture* future, const ReadResult& result)
+{
+    future->_result = result;
+    future->_ready.set();
+}
+
+void
+URI::shutdownAsync()
+{
+    AsyncReadPool* pool = 0L;
+    {
+        Threading::ScopedMutexLock lock( s_asyncReads._mutex );
+        pool = s_asyncReads._pool;
+        s_asyncReads._pool = 0L;
+    }
+
+    // joins the workers, failing any reads that have not started. Reads
+    // waiting on the network finish as canceled when their responses arrive.
+    delete pool;
+}
+
+//------------------------------------------------------------------------
+
+RevalidationProgress::RevalidationProgress(ProgressCallback* progress, const Config& cacheMetadata) :
+    _progress      ( progress ),
+    _sent          ( cacheMetadata.child("validators") ),
+    _received      ( "validators" ),
+    _numReads      ( 0u ),
+    _numNotModified( 0u )
+{
+    if ( progress )
+        _collectStats = progress->collectStats();
+}
+
+RevalidationProgress*
+RevalidationProgress::from(ProgressCallback* progress)
+{
+    return dynamic_cast<RevalidationProgress*>( progress );
+}
+
+bool
+RevalidationProgress::isCanceled()
+{
+    return ProgressCallback::isCanceled() || (_progress.valid() && _progress->isCanceled());
+}
+
+Config
+RevalidationProgress::getValidators(const std::string& uri) const
+{
+    Config headers;
+    ConfigSet reads = _sent.children("read");
+    for(ConfigSet::const_iterator i = reads.begin(); i != reads.end(); ++i)
+    {
+        if ( i->value("uri") == uri )
+        {
+            if ( i->hasValue("etag") )
+                headers.add( "ETag", i->value("etag") );
+            if ( i->hasValue("last_modified") )
+                headers.add( "Last-Modified", i->value("last_modified") );
+            break;
+        }
+    }
+    return headers;
+}
+
+void
+RevalidationProgress::recordRead(const std::string& uri, const ReadResult& result)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    ++_numReads;
+
+    if ( result.code() == ReadResult::RESULT_NOT_MODIFIED )
+    {
+        ++_numNotModified;
+
+        // the caller keeps its copy, so this is not a failure (e.g. no blacklisting).
+        setNeedsRetry( true );
+
+        // and the copy's validators still apply.
+        ConfigSet reads = _sent.children("read");
+        for(ConfigSet::const_iterator i = reads.begin(); i != reads.end(); ++i)
+        {
+            if ( i->value("uri") == uri )
+            {
+                _received.add( *i );
+                break;
+            }
+        }
+    }
+    else if ( result.succeeded() )
+    {
+        std::string etag         = getHeader( result.metadata(), "ETag" );
+        std::string lastModified = getHeader( result.metadata(), "Last-Modified" );
+        if ( !etag.empty() || !lastModified.empty() )
+        {
+            Config read( "read" );
+            read.set( "uri", uri );
+            if ( !etag.empty() )
+                read.set( "etag", etag );
+            if ( !lastModified.empty() )
+                read.set( "last_modified", lastModified );
+            _received.add( read );
+        }
+    }
+}
+
+bool
+RevalidationProgress::notModified() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _numReads > 0u && _numNotModified == _numReads;
+}
+
+Config
+RevalidationProgress::getCacheMetadata() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    // no remote reads (e.g. the source had the data in memory): the validators still apply.
+    const Config& validators = _numReads > 0u ? _received : _sent;
+
+    Config meta;
+    if ( !validators.children().empty() )
+        meta.add( validators );
+    return meta;
+}
+
+void
+RevalidationProgress::finish()
+{
+    if ( !_progress.valid() )
+        return;
+
+    if ( needsRetry() && !notModified() )
+        _progress->setNeedsRetry( true );
+
+    if ( !message().empty() )
+        _progress->message() = message();
+
+    if ( _progress->collectStats() )
+    {
+        for(Stats::const_iterator i = stats().begin(); i != stats().end(); ++i)
+            _progress->stats(i->first) += i->second;
+    }
+}
+
 
 //------------------------------------------------------------------------
 
@@ -24,6 +24,7 @@
 
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
+#include <vector>
 
 using namespace osgEarth;
 
@@ -154,17 +155,37 @@ VerticalDatum::transform(const VerticalDatum* from,
         ystep = (ne.y()-sw.y()) / double(rows-1);
     }
 
-    for( unsigned c=0; c<cols; ++c)
+    // sample each geoid once for the whole grid instead of once per post:
+    const Geoid* fromGeoid = from ? from->getGeoid() : 0L;
+    const Geoid* toGeoid   = to   ? to->getGeoid()   : 0L;
+
+    std::vector<float> fromOffsets, toOffsets;
+    if ( fromGeoid )
+    {
+        fromOffsets.resize( cols*rows );
+        fromGeoid->getHeights( sw.y(), sw.x(), ystep, xstep, cols, rows, &fromOffsets[0] );
+    }
+    if ( toGeoid )
+    {
+        toOffsets.resize( cols*rows );
+        toGeoid->getHeights( sw.y(), sw.x(), ystep, xstep, cols, rows, &toOffsets[0] );
+    }
+
+    Units fromUnits = from ? from->getUnits() : Units::METERS;
+    Units toUnits   = to   ? to->getUnits()   : Units::METERS;
+    double scale = fromUnits.convertTo(toUnits, 1.0);
+
+    osg::HeightField::HeightList& heights = hf->getHeightList();
+    for( unsigned i=0; i<heights.size(); ++i )
     {
-        double lon = sw.x() + xstep*double(c);
-        for( unsigned r=0; r<rows; ++r)
+        float& h = heights[i];
+        if (h != NO_DATA_VALUE)
         {
-            double lat = sw.y() + ystep*double(r);
-            float& h = hf->getHeight(c, r);
-            if (h != NO_DATA_VALUE)
-            {
-                VerticalDatum::transform( from, to, lat, lon, h );
-            }
+            double z = h;
+            if ( fromGeoid ) z += fromOffsets[i];
+            z *= scale;
+            if ( toGeoid ) z -= toOffsets[i];
+            h = float(z);
         }
     }
 
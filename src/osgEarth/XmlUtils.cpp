@@ -286,7 +286,10 @@ XmlElement::getConfig(const std::string& referrer) const
 		{
 			XmlNode* n = c->get();
 			if ( n->isElement() )
-				conf.add( static_cast<const XmlElement*>(n)->getConfig(referrer) );
+			{
+				Config child = static_cast<const XmlElement*>(n)->getConfig(referrer);
+				conf.addChild(std::string()).swap( child );
+			}
 		}
 
 		conf.value() = getText();
@@ -416,6 +419,118 @@ namespace
         //Now, replace the <!DOCTYPE> element with whitespace
         xmlStr.erase(startIndex, endIndex - startIndex + 1);
     }
+
+    // Reads a whole stream and parses it with TinyXML.
+    bool parse(std::istream& in, const URIContext& uriContext, TiXmlDocument& xmlDoc)
+    {
+        //Read the entire document into a string
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string xmlStr;
+        xmlStr = buffer.str();
+
+        removeDocType( xmlStr );
+        //OE_NOTICE << xmlStr;
+
+        xmlDoc.Parse(xmlStr.c_str());    
+
+        if ( xmlDoc.Error() )
+        {
+            std::stringstream buf;
+            buf << xmlDoc.ErrorDesc() << " (row " << xmlDoc.ErrorRow() << ", col " << xmlDoc.ErrorCol() << ")";
+            std::string str;
+            str = buf.str();
+            OE_WARN << "Error in XML document: " << str << std::endl;
+            if ( !uriContext.referrer().empty() )
+                OE_WARN << uriContext.referrer() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void buildConfig(const TiXmlElement* element, const std::string& referrer, Config& conf);
+
+    // Replaces an xi:include element with the root element of the document it
+    // references. On failure the element becomes an empty Config, as it does
+    // in XmlElement::getConfig.
+    void buildInclude(const TiXmlElement* element, const std::string& referrer, Config& conf)
+    {
+        std::string href;
+        for(const TiXmlAttribute* attr = element->FirstAttribute(); attr; attr = attr->Next())
+        {
+            if ( osgEarth::ciEquals(attr->Name(), "href") )
+                href = attr->Value();
+        }
+
+        if (href.empty())
+        {
+            OE_WARN << "Missing href with xi:include" << std::endl;
+            return;
+        }
+
+        URIContext uriContext(referrer);
+        URI uri(href, uriContext);
+        std::string fullURI = uri.full();
+        OE_INFO << "Loading href from " << fullURI << std::endl;
+
+        ReadResult r = uri.readString();
+        TiXmlDocument xmlDoc;
+        if ( r.succeeded() )
+        {
+            std::stringstream buf( r.getString() );
+            if ( parse(buf, URIContext(fullURI), xmlDoc) && xmlDoc.RootElement() )
+            {
+                Config included;
+                included.setReferrer( fullURI );
+                buildConfig( xmlDoc.RootElement(), fullURI, included );
+                included.setExternalRef( href );
+                conf.swap( included );
+                return;
+            }
+        }
+
+        OE_WARN << "Failed to load xi:include from " << fullURI << std::endl;
+    }
+
+    // Builds a Config directly from the TinyXML tree, populating each child
+    // in place. Produces the same result as XmlElement::getConfig without
+    // building an XmlElement tree or copying subtrees.
+    void buildConfig(const TiXmlElement* element, const std::string& referrer, Config& conf)
+    {
+        conf.key() = osgEarth::toLower(element->Value());
+
+        // collect in a map first, so the attribute order (and the handling of
+        // duplicates) matches XmlElement.
+        XmlAttributes attrs;
+        for(const TiXmlAttribute* attr = element->FirstAttribute(); attr; attr = attr->Next())
+        {
+            attrs[osgEarth::toLower(attr->Name())] = attr->Value();
+        }
+
+        for(XmlAttributes::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+        {
+            conf.addChild( a->first ).value() = a->second;
+        }
+
+        std::string text;
+        for(const TiXmlNode* node = element->FirstChild(); node; node = node->NextSibling())
+        {
+            const TiXmlElement* child = node->ToElement();
+            if ( child )
+            {
+                if ( osgEarth::ciEquals(child->Value(), "xi:include") )
+                    buildInclude( child, referrer, conf.addChild(std::string()) );
+                else
+                    buildConfig( child, referrer, conf.addChild(std::string()) );
+            }
+            else if ( node->ToText() )
+            {
+                text += node->Value();
+            }
+        }
+
+        conf.value() = trim( text );
+    }
 }
 
 
@@ -449,31 +564,9 @@ XmlDocument*
 XmlDocument::load( std::istream& in, const URIContext& uriContext )
 {
     TiXmlDocument xmlDoc;
-
-    //Read the entire document into a string
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    std::string xmlStr;
-    xmlStr = buffer.str();
-
-    removeDocType( xmlStr );
-    //OE_NOTICE << xmlStr;
-
     XmlDocument* doc = NULL;
-    xmlDoc.Parse(xmlStr.c_str());    
 
-    if ( xmlDoc.Error() )
-    {
-        std::stringstream buf;
-        buf << xmlDoc.ErrorDesc() << " (row " << xmlDoc.ErrorRow() << ", col " << xmlDoc.ErrorCol() << ")";
-        std::string str;
-        str = buf.str();
-        OE_WARN << "Error in XML document: " << str << std::endl;
-        if ( !uriContext.referrer().empty() )
-            OE_WARN << uriContext.referrer() << std::endl;
-    }
-
-    if ( !xmlDoc.Error() && xmlDoc.RootElement() )
+    if ( parse(in, uriContext, xmlDoc) && xmlDoc.RootElement() )
     {
         doc = new XmlDocument();
         processNode( doc,  xmlDoc.RootElement() );
@@ -482,6 +575,22 @@ XmlDocument::load( std::istream& in, const URIContext& uriContext )
     return doc;    
 }
 
+bool
+XmlDocument::loadConfig( std::istream& in, const URIContext& uriContext, Config& output )
+{
+    TiXmlDocument xmlDoc;
+    if ( !parse(in, uriContext, xmlDoc) || !xmlDoc.RootElement() )
+        return false;
+
+    // same shape as XmlDocument::getConfig(): a "Document" holding the root element.
+    Config doc( "Document" );
+    doc.setReferrer( URI("", uriContext).full() );
+    buildConfig( xmlDoc.RootElement(), doc.referrer(), doc.addChild(std::string()) );
+
+    output.swap( doc );
+    return true;
+}
+
 Config
 XmlDocument::getConfig() const
 {
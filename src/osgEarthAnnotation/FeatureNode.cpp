@@ -301,12 +301,12 @@ FeatureNode::onTileAdded(const TileKey&          key,
 {
     if ( !tile || _featurePolytope.contains( tile->getBound() ) )
     {
-        clamp( context.getTerrain(), tile );
+        clamp( context.getTerrain(), tile, key.getExtent() );
     }
 }
 
 void
-FeatureNode::clamp(const Terrain* terrain, osg::Node* patch)
+FeatureNode::clamp(const Terrain* terrain, osg::Node* patch, const GeoExtent& patchExtent)
 {
     if ( terrain && patch )
     {
@@ -317,6 +317,7 @@ FeatureNode::clamp(const Terrain* terrain, osg::Node* patch)
         clamper.setTerrainPatch( patch );
         clamper.setTerrainSRS( terrain->getSRS() );
         clamper.setPreserveZ( relative );
+        clamper.setTerrainPatchExtent( patchExtent );
 
         this->accept( clamper );
         this->dirtyBound();
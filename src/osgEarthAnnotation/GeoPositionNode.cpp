@@ -184,7 +184,8 @@ GeoPositionNode::setOcclusionCulling( bool value )
 
         if ( _occlusionCullingRequested )
         {
-            _occlusionCuller = new OcclusionCullingCallback( _geoxform );
+            MapNode* mapNode = getMapNode();
+            _occlusionCuller = new OcclusionCullingCallback( _geoxform, mapNode ? mapNode->getMap() : 0L );
             _occlusionCuller->setMaxAltitude( getOcclusionCullingMaxAltitude() );
             addCullCallback( _occlusionCuller.get()  );
         }
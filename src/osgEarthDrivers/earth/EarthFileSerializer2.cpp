@@ -314,26 +314,41 @@ namespace
 
 namespace
 {
-    void addImageLayer(const Config& conf, Map* map)
+    ImageLayer* createImageLayer(const Config& conf)
     {
         ImageLayerOptions options( conf );
         options.name() = conf.value("name");
-        map->addImageLayer( new ImageLayer(options) );
+        return new ImageLayer(options);
     }
 
-    void addElevationLayer(const Config& conf, Map* map)
+    ElevationLayer* createElevationLayer(const Config& conf)
     {
         ElevationLayerOptions options( conf );
         options.name() = conf.value( "name" );
-        map->addElevationLayer( new ElevationLayer(options) );
+        return new ElevationLayer(options);
     }
 
-    void addModelLayer(const Config& conf, Map* map)
+    ModelLayer* createModelLayer(const Config& conf)
     {
         ModelLayerOptions options( conf );
         options.name() = conf.value( "name" );
         options.driver() = ModelSourceOptions( conf );
-        map->addModelLayer( new ModelLayer(options) );
+        return new ModelLayer(options);
+    }
+
+    bool isImageLayer(const Config& conf)
+    {
+        return conf.key() == "image";
+    }
+
+    bool isElevationLayer(const Config& conf)
+    {
+        return conf.key() == "elevation" || conf.key() == "heightfield";
+    }
+
+    bool isModelLayer(const Config& conf)
+    {
+        return conf.key() == "model";
     }
 
     void addMaskLayer(const Config& conf, Map* map)
@@ -417,6 +432,23 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
     MapNode* mapNode = new MapNode( map, mapNodeOptions );
 
     // Read the layers in LAST (otherwise they will not benefit from the cache/profile configuration)
+    // Open them all at once first, since that is the slow part; they are still added
+    // to the map one at a time below, in the order in which they appear.
+    std::vector< osg::ref_ptr<Layer> > layers;
+    for(ConfigSet::const_iterator i = conf.children().begin(); i != conf.children().end(); ++i)
+    {
+        if ( isImageLayer(*i) )
+            layers.push_back( createImageLayer(*i) );
+        else if ( isElevationLayer(*i) )
+            layers.push_back( createElevationLayer(*i) );
+        else if ( isModelLayer(*i) )
+            layers.push_back( createModelLayer(*i) );
+    }
+
+    map->openLayers( layers );
+
+    std::vector< osg::ref_ptr<Layer> >::const_iterator nextLayer = layers.begin();
+
     for(ConfigSet::const_iterator i = conf.children().begin(); i != conf.children().end(); ++i)
     {
         if (i->key() == "options" || i->key() == "name" || i->key() == "type" || i->key() == "version")
@@ -424,19 +456,19 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
             // nop - handled earlier
         }
 
-        else if ( i->key() == "image" )
+        else if ( isImageLayer(*i) )
         {
-            addImageLayer( *i, map );
+            map->addImageLayer( static_cast<ImageLayer*>((nextLayer++)->get()) );
         }
 
-        else if ( i->key() == "elevation" || i->key() == "heightfield" )
+        else if ( isElevationLayer(*i) )
         {
-            addElevationLayer( *i, map );
+            map->addElevationLayer( static_cast<ElevationLayer*>((nextLayer++)->get()) );
         }
 
-        else if ( i->key() == "model" )
+        else if ( isModelLayer(*i) )
         {
-            addModelLayer( *i, map );
+            map->addModelLayer( static_cast<ModelLayer*>((nextLayer++)->get()) );
         }
 
         else if ( i->key() == "mask" )
@@ -228,18 +228,18 @@ class ReaderWriterEarth : public osgDB::ReaderWriter
             // from an "anonymous" stream here)
             URIContext uriContext( readOptions ); 
 
-            osg::ref_ptr<XmlDocument> doc = XmlDocument::load( in, uriContext );
-            if ( !doc.valid() )
+            Config docConf;
+            if ( !XmlDocument::loadConfig( in, uriContext, docConf ) )
                 return ReadResult::ERROR_IN_READING_FILE;
 
-            Config docConf = doc->getConfig();
-
             // support both "map" and "earth" tag names at the top level
+            // (swap it out; the earth file can be large)
             Config conf;
-            if ( docConf.hasChild( "map" ) )
-                conf = docConf.child( "map" );
-            else if ( docConf.hasChild( "earth" ) )
-                conf = docConf.child( "earth" );
+            Config* top = docConf.mutable_child( "map" );
+            if ( !top )
+                top = docConf.mutable_child( "earth" );
+            if ( top )
+                conf.swap( *top );
 
             osg::ref_ptr<osg::Node> node;
 
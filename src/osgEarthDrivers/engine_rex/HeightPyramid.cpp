@@ -0,0 +1,420 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2008-2014 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "HeightPyramid"
+#include <algorithm>
+#include <cfloat>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace osgEarth;
+
+#define LC "[HeightPyramid] "
+
+// number of grid cells along each side of a leaf node
+#define CELLS_PER_LEAF 4u
+
+namespace
+{
+    // clips the segment s + t*d (t in [t0,t1]) to a box; returns false if it misses.
+    bool clip(const osg::BoundingBox& bb, const osg::Vec3d& s, const osg::Vec3d& d, double& t0, double& t1)
+    {
+        for(int i=0; i<3; ++i)
+        {
+            // pad for the float precision of the box
+            double lo = (double)bb._min[i] - 1e-3;
+            double hi = (double)bb._max[i] + 1e-3;
+
+            if ( osg::equivalent(d[i], 0.0) )
+            {
+                if ( s[i] < lo || s[i] > hi )
+                    return false;
+            }
+            else
+            {
+                double inv = 1.0/d[i];
+                double a = (lo - s[i]) * inv;
+                double b = (hi - s[i]) * inv;
+                if ( a > b ) std::swap(a, b);
+                if ( a > t0 ) t0 = a;
+                if ( b < t1 ) t1 = b;
+                if ( t0 > t1 )
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // clips the segment s + t*d (t in [t0,t1]) to the slab lo <= n.p <= hi; returns false if it misses.
+    bool clipSlab(const osg::Vec3f& n, double lo, double hi, const osg::Vec3d& s, const osg::Vec3d& d, double& t0, double& t1)
+    {
+        osg::Vec3d nd(n);
+        double ns  = nd * s;
+        double dir = nd * d;
+        double a = lo - 1e-3;
+        double b = hi + 1e-3;
+
+        if ( osg::equivalent(dir, 0.0) )
+            return ns >= a && ns <= b;
+
+        double ta = (a - ns) / dir;
+        double tb = (b - ns) / dir;
+        if ( ta > tb ) std::swap(ta, tb);
+        if ( ta > t0 ) t0 = ta;
+        if ( tb < t1 ) t1 = tb;
+        return t0 <= t1;
+    }
+
+    // two-sided segment/triangle test; t is a ratio along d.
+    bool intersectTriangle(const osg::Vec3d& s, const osg::Vec3d& d,
+                           const osg::Vec3d& v0, const osg::Vec3d& v1, const osg::Vec3d& v2,
+                           double& t, double& u, double& v)
+    {
+        osg::Vec3d e1 = v1 - v0;
+        osg::Vec3d e2 = v2 - v0;
+        osg::Vec3d p  = d ^ e2;
+        double det = e1 * p;
+        if ( osg::equivalent(det, 0.0, 1e-12) )
+            return false;
+
+        double inv = 1.0/det;
+        osg::Vec3d q0 = s - v0;
+        u = (q0 * p) * inv;
+        if ( u < 0.0 || u > 1.0 )
+            return false;
+
+        osg::Vec3d q = q0 ^ e1;
+        v = (d * q) * inv;
+        if ( v < 0.0 || u + v > 1.0 )
+            return false;
+
+        t = (e2 * q) * inv;
+        return t >= 0.0 && t <= 1.0;
+    }
+}
+
+//........................................................................
+
+HeightPyramid::HeightPyramid(const osg::Geometry* geometry, const float* heights, unsigned tileSize) :
+osgEarth::QuadTree(),
+_geometry( geometry ),
+_heights ( heights ),
+_tileSize( tileSize )
+{
+    //nop
+}
+
+void
+HeightPyramid::dirty()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _data = 0L;
+}
+
+void
+HeightPyramid::getData(osg::ref_ptr<const Levels>& out) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    if ( !_data.valid() )
+        _data = build();
+    out = _data.get();
+}
+
+bool
+HeightPyramid::getHeightRange(float& minHeight, float& maxHeight) const
+{
+    osg::ref_ptr<const Levels> data;
+    getData( data );
+    if ( !data.valid() || data->_levels.empty() )
+        return false;
+
+    const Node& root = data->_levels.back()._nodes[0];
+    minHeight = root._minHeight;
+    maxHeight = root._maxHeight;
+    return true;
+}
+
+const HeightPyramid::Levels*
+HeightPyramid::build() const
+{
+    if ( !_geometry || !_heights || _tileSize < 2 )
+        return 0L;
+
+    const osg::Vec3Array* verts   = static_cast<const osg::Vec3Array*>(_geometry->getVertexArray());
+    const osg::Vec3Array* normals = static_cast<const osg::Vec3Array*>(_geometry->getNormalArray());
+    const unsigned tileSize = _tileSize;
+
+    if ( !verts || !normals || verts->size() < tileSize*tileSize || normals->size() < tileSize*tileSize )
+        return 0L;
+
+    const float* heights = _heights;
+    const unsigned cells = tileSize-1;
+
+    Levels* data = new Levels();
+    data->_tileSize = tileSize;
+
+    // snapshot the displaced vertices; intersections only read this copy.
+    data->_points.resize( tileSize*tileSize );
+    for(unsigned i=0; i<tileSize*tileSize; ++i)
+        data->_points[i] = (*verts)[i] + (*normals)[i] * heights[i];
+
+    // each level halves the resolution of the one below, down to a single node.
+    unsigned cellsPerNode = CELLS_PER_LEAF;
+    for(;;)
+    {
+        data->_levels.push_back( Level() );
+        Level& level = data->_levels.back();
+        level._cellsPerNode = cellsPerNode;
+        level._width  = (cells + cellsPerNode - 1) / cellsPerNode;
+        level._height = level._width;
+        level._nodes.resize( level._width * level._height );
+
+        for(unsigned y=0; y<level._height; ++y)
+        {
+            unsigned t0 = y*cellsPerNode, t1 = osg::minimum(t0+cellsPerNode, cells);
+            for(unsigned x=0; x<level._width; ++x)
+            {
+                unsigned s0 = x*cellsPerNode, s1 = osg::minimum(s0+cellsPerNode, cells);
+                Node& node = level._nodes[y*level._width + x];
+                node._minHeight =  FLT_MAX;
+                node._maxHeight = -FLT_MAX;
+
+                osg::Vec3f up;
+                for(unsigned t=t0; t<=t1; ++t)
+                {
+                    for(unsigned s=s0; s<=s1; ++s)
+                    {
+                        unsigned i = t*tileSize + s;
+                        float h = heights[i];
+                        node._box.expandBy( data->_points[i] );
+                        node._minHeight = osg::minimum(node._minHeight, h);
+                        node._maxHeight = osg::maximum(node._maxHeight, h);
+                        up += (*normals)[i];
+                    }
+                }
+
+                if ( up.normalize() == 0.0f )
+                    up.set(0.0f, 0.0f, 1.0f);
+                node._up    = up;
+                node._minUp =  DBL_MAX;
+                node._maxUp = -DBL_MAX;
+
+                // in double, since tile coordinates can be large.
+                osg::Vec3d upd(up);
+                for(unsigned t=t0; t<=t1; ++t)
+                {
+                    for(unsigned s=s0; s<=s1; ++s)
+                    {
+                        double u = upd * osg::Vec3d(data->_points[t*tileSize + s]);
+                        node._minUp = osg::minimum(node._minUp, u);
+                        node._maxUp = osg::maximum(node._maxUp, u);
+                    }
+                }
+            }
+        }
+
+        if ( level._width == 1 && level._height == 1 )
+            break;
+
+        cellsPerNode *= 2u;
+    }
+
+    return data;
+}
+
+namespace
+{
+    // the part of the segment inside a node's box and height range; false if it misses.
+    template<typename NODE>
+    bool enter(const NODE& node, const osg::Vec3d& s, const osg::Vec3d& d, double& t0, double& t1)
+    {
+        return
+            clip( node._box, s, d, t0, t1 ) &&
+            clipSlab( node._up, node._minUp, node._maxUp, s, d, t0, t1 );
+    }
+}
+
+bool
+HeightPyramid::intersect(const osg::Vec3d& start, const osg::Vec3d& end, LineSegmentIntersections& intersections) const
+{
+    osg::ref_ptr<const Levels> data;
+    getData( data );
+    if ( !data.valid() )
+        return false;
+
+    unsigned numBefore = intersections.size();
+
+    double t0 = 0.0, t1 = 1.0, maxRatio = 1.0;
+    unsigned root = data->_levels.size()-1;
+    if ( enter(data->_levels[root]._nodes[0], start, end-start, t0, t1) )
+    {
+        intersect( *data.get(), root, 0, 0, start, end-start, false, maxRatio, intersections );
+    }
+
+    return intersections.size() > numBefore;
+}
+
+bool
+HeightPyramid::intersectNearest(const osg::Vec3d& start, const osg::Vec3d& end, LineSegmentIntersection& nearest) const
+{
+    osg::ref_ptr<const Levels> data;
+    getData( data );
+    if ( !data.valid() )
+        return false;
+
+    LineSegmentIntersections hits;
+
+    double t0 = 0.0, t1 = 1.0, maxRatio = 1.0;
+    unsigned root = data->_levels.size()-1;
+    if ( enter(data->_levels[root]._nodes[0], start, end-start, t0, t1) )
+    {
+        intersect( *data.get(), root, 0, 0, start, end-start, true, maxRatio, hits );
+    }
+
+    if ( hits.empty() )
+        return false;
+
+    nearest = hits.back();
+    return true;
+}
+
+void
+HeightPyramid::intersect(const Levels&             data,
+                         unsigned                  level,
+                         unsigned                  x,
+                         unsigned                  y,
+                         const osg::Vec3d&         s,
+                         const osg::Vec3d&         d,
+                         bool                      nearestOnly,
+                         double&                   maxRatio,
+                         LineSegmentIntersections& out) const
+{
+    if ( level == 0 )
+    {
+        intersectCells( data, x, y, s, d, nearestOnly, maxRatio, out );
+        return;
+    }
+
+    // visit the children that the segment enters, nearest first, so that a
+    // nearest-only search can stop as soon as no child can beat its best hit.
+    const Level& below = data._levels[level-1];
+    unsigned cxs[4], cys[4];
+    double   entry[4];
+    unsigned count = 0;
+
+    for(unsigned cy=2*y; cy<osg::minimum(2*y+2, below._height); ++cy)
+    {
+        for(unsigned cx=2*x; cx<osg::minimum(2*x+2, below._width); ++cx)
+        {
+            double t0 = 0.0, t1 = maxRatio;
+            if ( enter(below._nodes[cy*below._width + cx], s, d, t0, t1) )
+            {
+                unsigned i = count++;
+                for( ; i > 0 && entry[i-1] > t0; --i )
+                {
+                    entry[i] = entry[i-1];
+                    cxs[i]   = cxs[i-1];
+                    cys[i]   = cys[i-1];
+                }
+                entry[i] = t0;
+                cxs[i]   = cx;
+                cys[i]   = cy;
+            }
+        }
+    }
+
+    for(unsigned i=0; i<count; ++i)
+    {
+        if ( nearestOnly && entry[i] > maxRatio )
+            break;
+
+        intersect( data, level-1, cxs[i], cys[i], s, d, nearestOnly, maxRatio, out );
+    }
+}
+
+void
+HeightPyramid::intersectCells(const Levels&             data,
+                              unsigned                  x,
+                              unsigned                  y,
+                              const osg::Vec3d&         s,
+                              const osg::Vec3d&         d,
+                              bool                      nearestOnly,
+                              double&                   maxRatio,
+                              LineSegmentIntersections& out) const
+{
+    const std::vector<osg::Vec3f>& points = data._points;
+    const unsigned tileSize = data._tileSize;
+    const unsigned cells    = tileSize-1;
+    const unsigned leaf     = data._levels[0]._cellsPerNode;
+
+    unsigned s0 = x*leaf, s1 = osg::minimum(s0 + leaf, cells);
+    unsigned t0 = y*leaf, t1 = osg::minimum(t0 + leaf, cells);
+
+    // same triangulation and primitive numbering as TileDrawable::accept(PrimitiveFunctor&)
+    for(unsigned t=t0; t<t1; ++t)
+    {
+        for(unsigned c=s0; c<s1; ++c)
+        {
+            unsigned i00 = t*tileSize + c;
+            unsigned i10 = i00 + 1;
+            unsigned i01 = i00 + tileSize;
+            unsigned i11 = i01 + 1;
+
+            osg::Vec3d v00 = points[i00];
+            osg::Vec3d v10 = points[i10];
+            osg::Vec3d v01 = points[i01];
+            osg::Vec3d v11 = points[i11];
+
+            unsigned prim = 2*(t*cells + c);
+
+            const osg::Vec3d* tri[2][3] = { { &v00, &v01, &v10 }, { &v10, &v01, &v11 } };
+            const unsigned    idx[2][3] = { { i00,  i01,  i10  }, { i10,  i01,  i11  } };
+
+            for(unsigned k=0; k<2; ++k)
+            {
+                double r, u, v;
+                if ( intersectTriangle(s, d, *tri[k][0], *tri[k][1], *tri[k][2], r, u, v) &&
+                     (!nearestOnly || r < maxRatio) )
+                {
+                    LineSegmentIntersection hit;
+                    hit.ratio             = r;
+                    hit.intersectionPoint = s + d*r;
+
+                    osg::Vec3d normal = (*tri[k][1] - *tri[k][0]) ^ (*tri[k][2] - *tri[k][0]);
+                    normal.normalize();
+                    hit.intersectionNormal = normal;
+
+                    hit.p0 = idx[k][0];
+                    hit.p1 = idx[k][1];
+                    hit.p2 = idx[k][2];
+                    hit.r0 = (float)(1.0 - u - v);
+                    hit.r1 = (float)u;
+                    hit.r2 = (float)v;
+                    hit.primitiveIndex = prim + k;
+
+                    if ( nearestOnly )
+                    {
+                        // keep just the best hit
+                        maxRatio = r;
+                        out.clear();
+                    }
+                    out.push_back( hit );
+                }
+            }
+        }
+    }
+}
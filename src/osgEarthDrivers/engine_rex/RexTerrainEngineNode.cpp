@@ -44,6 +44,7 @@
 #endif
 
 #include <cstdlib> // for getenv
+#include <climits>
 
 #define LC "[RexTerrainEngineNode] "
 
@@ -141,7 +142,7 @@ _terrain( terrain )
 void
 RexTerrainEngineNode::ElevationChangedCallback::onVisibleChanged( TerrainLayer* layer )
 {
-    _terrain->refresh(true); // true => force a dirty
+    _terrain->refreshLayerExtent( layer );
 }
 
 //------------------------------------------------------------------------
@@ -351,6 +352,28 @@ RexTerrainEngineNode::refresh(bool forceDirty)
     }
 }
 
+void
+RexTerrainEngineNode::refreshLayerExtent(TerrainLayer* layer)
+{
+    if ( _batchUpdateInProgress || !layer || !_update_mapf->getProfile() )
+    {
+        refresh();
+        return;
+    }
+
+    // A layer can only change the tiles that intersect its data, so reload
+    // just those. Tiles elsewhere keep their geometry, and their cached
+    // height fields stay valid (see TerrainTileModelFactory::HFCacheKey).
+    GeoExtent extent;
+    if ( layer->getTileSource() )
+        extent = layer->getTileSource()->getDataExtentsUnion();
+
+    if ( !extent.isValid() )
+        extent = _update_mapf->getProfile()->getExtent();
+
+    invalidateRegion( extent, 0u, INT_MAX );
+}
+
 void
 RexTerrainEngineNode::onMapInfoEstablished( const MapInfo& mapInfo )
 {
@@ -866,7 +889,7 @@ RexTerrainEngineNode::addElevationLayer( ElevationLayer* layer )
 
     layer->addCallback( _elevationCallback.get() );
 
-    refresh();
+    refreshLayerExtent( layer );
 }
 
 void
@@ -877,19 +900,23 @@ RexTerrainEngineNode::removeElevationLayer( ElevationLayer* layerRemoved )
 
     layerRemoved->removeCallback( _elevationCallback.get() );
 
-    refresh();
+    refreshLayerExtent( layerRemoved );
 }
 
 void
 RexTerrainEngineNode::moveElevationLayer( unsigned int oldIndex, unsigned int newIndex )
 {
-    refresh();
+    // reordering only matters where the moved layer has data.
+    if ( newIndex < _update_mapf->elevationLayers().size() )
+        refreshLayerExtent( _update_mapf->getElevationLayerAt(newIndex) );
+    else
+        refresh();
 }
 
 void
 RexTerrainEngineNode::toggleElevationLayer( ElevationLayer* layer )
 {
-    refresh();
+    refreshLayerExtent( layer );
 }
 
 // Generates the main shader code for rendering the terrain.
@@ -194,7 +194,42 @@ SurfaceNode::setElevationRaster(const osg::Image*   raster,
         _drawable->setElevationRaster( raster, scaleBias );
     }
 
-    // next compute the bounding box in local space:
+    updateBounds();
+}
+
+bool
+SurfaceNode::setElevationRanges(const ElevationRange& tile,
+                                const ElevationRange  children[4])
+{
+    if ( !_drawable.valid() )
+        return false;
+
+    bool changed = tile != _tileRange;
+    for(unsigned c=0; c<4; ++c)
+        changed = changed || children[c] != _childRanges[c];
+
+    if ( !changed )
+        return false;
+
+    _tileRange = tile;
+    for(unsigned c=0; c<4; ++c)
+        _childRanges[c] = children[c];
+
+    // The surface may be drawing inherited elevation data, so the range
+    // can only ever add to the bound computed from that data.
+    if ( _tileRange._valid )
+        _drawable->setInitialBound( _drawable->computeRangeBound(_tileRange._min, _tileRange._max) );
+    else
+        _drawable->setInitialBound( osg::BoundingBox() );
+
+    updateBounds();
+    return true;
+}
+
+void
+SurfaceNode::updateBounds()
+{
+    // compute the bounding box in local space:
 #if OSG_VERSION_GREATER_OR_EQUAL(3,3,2)
     const osg::BoundingBox& box = _drawable->getBoundingBox();
 #else
@@ -260,6 +295,17 @@ SurfaceNode::setElevationRaster(const osg::Image*   raster,
     _childrenCorners[3][6] =  maxZMedians[2];
     _childrenCorners[3][7] =  box.corner(7);
 
+    // Where the range of a child is known, bound it with that instead.
+    for(int c=0; c<4; ++c)
+    {
+        if ( _childRanges[c]._valid )
+        {
+            osg::BoundingBox childBox = _drawable->computeRangeBound(_childRanges[c]._min, _childRanges[c]._max, c);
+            for(int j=0; j<8; ++j)
+                _childrenCorners[c][j] = childBox.corner(j);
+        }
+    }
+
     // Transform the child corners to world space
     
     const osg::Matrix& local2world = getMatrix();
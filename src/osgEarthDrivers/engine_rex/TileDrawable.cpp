@@ -80,6 +80,9 @@ _skirtSize   ( skirtSize )
     int tileSize2 = tileSize*tileSize;
     _heightCache = new float[ tileSize2 ];
     for(int i=0; i<tileSize2; ++i) _heightCache[i] = 0.0f;    
+
+    _heightPyramid = new HeightPyramid(_geom.get(), _heightCache, tileSize);
+    setShape( _heightPyramid.get() );
 }
 
 TileDrawable::~TileDrawable()
@@ -351,6 +354,8 @@ TileDrawable::setElevationRaster(const osg::Image*   image,
         }
     }
 
+    _heightPyramid->dirty();
+
     dirtyBound();
 }
 
@@ -366,7 +371,35 @@ TileDrawable::getElevationMatrix() const
     return _elevationScaleBias;
 }
 
+osg::BoundingBox
+TileDrawable::computeRangeBound(float minHeight, float maxHeight, int quadrant) const
+{
+    const osg::Vec3Array& verts   = *static_cast<osg::Vec3Array*>(_geom->getVertexArray());
+    const osg::Vec3Array& normals = *static_cast<osg::Vec3Array*>(_geom->getNormalArray());
+
+    int s0 = 0, t0 = 0, s1 = _tileSize-1, t1 = _tileSize-1;
+    if ( quadrant >= 0 )
+    {
+        int half = (_tileSize-1)/2;
+        if ( quadrant & 1 ) s0 = half; else s1 = half;
+        if ( quadrant & 2 ) t0 = half; else t1 = half;
+    }
+
+    osg::BoundingBox box;
+    for(int t=t0; t<=t1; ++t)
+    {
+        for(int s=s0; s<=s1; ++s)
+        {
+            int i = t*_tileSize + s;
+            box.expandBy( verts[i] + normals[i] * minHeight );
+            box.expandBy( verts[i] + normals[i] * maxHeight );
+        }
+    }
+    return box;
+}
+
 // Functor supplies triangles to things like IntersectionVisitor, ComputeBoundsVisitor, etc.
+// (The DPLineSegmentIntersector uses the HeightPyramid instead.)
 void
 TileDrawable::accept(osg::PrimitiveFunctor& f) const
 {
@@ -26,7 +26,9 @@
 #include "ElevationTextureUtils"
 
 #include <osgEarth/CullingUtils>
+#include <osgEarth/ElevationLayer>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/MapFrame>
 #include <osgEarth/TraversalData>
 #include <osgEarth/Shadowing>
 #include <osgEarth/Utils>
@@ -36,6 +38,8 @@
 #include <osg/ComputeBoundsVisitor>
 #include <osg/ValueObject>
 
+#include <cfloat>
+
 using namespace osgEarth::Drivers::RexTerrainEngine;
 using namespace osgEarth;
 
@@ -60,6 +64,53 @@ namespace
         osg::Matrixf(0.5f,0,0,0, 0,0.5f,0,0, 0,0,1.0f,0, 0.0f,0.0f,0,1.0f),
         osg::Matrixf(0.5f,0,0,0, 0,0.5f,0,0, 0,0,1.0f,0, 0.5f,0.0f,0,1.0f)
     };
+
+    // Combined elevation range of the map's elevation layers over a key, from
+    // the layers' min/max pyramids. Like the heightfield compositor, it skips
+    // layers with no data for the key and adds offset layers on top. Fails if
+    // a contributing layer has not recorded a range at or above the key.
+    bool getElevationRange(const MapFrame& frame, const TileKey& key, ElevationRange& out)
+    {
+        float hmin = FLT_MAX, hmax = -FLT_MAX;
+        float offsetMin = 0.0f, offsetMax = 0.0f;
+
+        const ElevationLayerVector& layers = frame.elevationLayers();
+        for(ElevationLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+        {
+            ElevationLayer* layer = i->get();
+            if ( !layer->getEnabled() || !layer->getVisible() )
+                continue;
+
+            TileKey bestKey;
+            if ( layer->getTileSource() &&
+                (!layer->isKeyInRange(key) || !layer->getTileSource()->getBestAvailableTileKey(key, bestKey)) )
+                continue;
+
+            float layerMin, layerMax;
+            const ElevationRanges* ranges = layer->getElevationRanges();
+            if ( !ranges || !ranges->get(key, layerMin, layerMax) )
+                return false;
+
+            if ( layer->isOffset() )
+            {
+                offsetMin += layerMin;
+                offsetMax += layerMax;
+            }
+            else
+            {
+                hmin = std::min(hmin, layerMin);
+                hmax = std::max(hmax, layerMax);
+            }
+        }
+
+        if ( hmin > hmax )
+            return false;
+
+        out._valid = true;
+        out._min   = hmin + offsetMin;
+        out._max   = hmax + offsetMax;
+        return true;
+    }
 }
 
 TileNode::TileNode() : 
@@ -604,6 +655,7 @@ TileNode::inheritState(EngineContext* context)
     // default inheritance of the elevation data for bounding purposes:
     osg::ref_ptr<const osg::Image> elevRaster;
     osg::Matrixf                   elevMatrix;
+    bool                           hasOwnElevation = false;
     if ( parent )
     {
         elevRaster = parent->getElevationRaster();
@@ -664,6 +716,7 @@ TileNode::inheritState(EngineContext* context)
                 osg::Texture* t = static_cast<osg::Texture*>(sa);
                 elevRaster = t->getImage(0);
                 elevMatrix = osg::Matrixf::identity();
+                hasOwnElevation = true;
             }
         }
     }
@@ -678,6 +731,13 @@ TileNode::inheritState(EngineContext* context)
         }
     }
 
+    // Bound the tile (until its own elevation data arrives) and its potential
+    // children with the known elevation ranges.
+    if ( setElevationRanges(context, hasOwnElevation) )
+    {
+        changesMade = true;
+    }
+
     // finally, update the uniforms for terrain morphing
     updateTileUniforms( context->getSelectionInfo() );
 
@@ -693,6 +753,36 @@ TileNode::inheritState(EngineContext* context)
     return changesMade;
 }
 
+bool
+TileNode::setElevationRanges(EngineContext* context, bool hasOwnElevation)
+{
+    if ( !_surface.valid() )
+        return false;
+
+    const MapFrame& frame = context->getMapFrame();
+
+    ElevationRange tileRange;
+    if ( !hasOwnElevation )
+    {
+        getElevationRange( frame, _key, tileRange );
+    }
+
+    // SurfaceNode orders the children SW, SE, NW, NE; TileKey quadrants
+    // go NW, NE, SW, SE.
+    ElevationRange childRanges[4];
+    for(unsigned c=0; c<4; ++c)
+    {
+        getElevationRange( frame, _key.createChildKey(c ^ 2u), childRanges[c] );
+    }
+
+    bool changed = _surface->setElevationRanges( tileRange, childRanges );
+
+    if ( _patch.valid() )
+        _patch->setElevationRanges( tileRange, childRanges );
+
+    return changed;
+}
+
 void
 TileNode::mergeStateSet(osg::StateSet* stateSet, MPTexture* mptex, const RenderBindings& bindings)
 {
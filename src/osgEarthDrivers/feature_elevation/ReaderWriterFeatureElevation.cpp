@@ -37,10 +37,12 @@
 #include <osgDB/ImageOptions>
 
 #include <sstream>
+#include <algorithm>
 #include <stdlib.h>
 #include <memory.h>
 
 #include "FeatureElevationOptions"
+#include "PolygonRasterizer"
 
 #define LC "[Featuer Elevation driver] "
 
@@ -169,78 +171,127 @@ public:
                 hf->allocate(tileSize, tileSize);
                 for (unsigned int i = 0; i < hf->getHeightList().size(); ++i) hf->getHeightList()[i] = NO_DATA_VALUE;
 
-				// Iterate over the output heightfield and sample the data that was read into it.
+				// Pixel spacing of the output heightfield.
 				double dx = (xmax - xmin) / (tileSize-1);
 				double dy = (ymax - ymin) / (tileSize-1);
 
-				for (int c = 0; c < tileSize; ++c)
+                // Each sample takes the value of the first feature covering it, so
+                // put the highest priority first. The sort is stable so that ties
+                // keep the order of the feature source.
+                if ( _options.priority().isSet() )
+                {
+                    std::vector<PrioritizedFeature> sorted;
+                    sorted.reserve( featureList.size() );
+                    for (FeatureList::iterator f = featureList.begin(); f != featureList.end(); ++f)
+                        sorted.push_back( PrioritizedFeature((*f)->getDouble(_options.priority().value()), f->get()) );
+                    std::stable_sort( sorted.begin(), sorted.end() );
+
+                    FeatureList ordered;
+                    for (unsigned i = 0; i < sorted.size(); ++i)
+                        ordered.push_back( sorted[i]._feature );
+                    featureList.swap( ordered );
+                }
+
+                // Transform each polygon into the heightfield's pixel space once and
+                // scanline-fill the samples it covers, rather than transforming and
+                // testing every sample against every feature.
+                PolygonRasterizer rasterizer(tileSize, tileSize);
+                std::vector<PolygonRasterizer::Span> spans;
+                std::vector<osg::Vec3d> ring;
+
+				for (FeatureList::iterator f = featureList.begin(); f != featureList.end(); ++f)
 				{
-					double geoX = xmin + (dx * (double)c);
-					for (int r = 0; r < tileSize; ++r)
-					{
-						double geoY = ymin + (dy * (double)r);
-
-						float h = NO_DATA_VALUE;
-
-						for (FeatureList::iterator f = featureList.begin(); f != featureList.end(); ++f)
-						{
-							osgEarth::Symbology::Polygon* boundary = dynamic_cast<osgEarth::Symbology::Polygon*>((*f)->getGeometry());
-
-							if (!boundary)
-							{
-								OE_WARN << LC << "NOT A POLYGON" << std::endl;
-							}
-							else
-							{
-								GeoPoint geo(keySRS, geoX, geoY, 0.0, ALTMODE_ABSOLUTE);
-
-                                if ( transformRequired )
-                                    geo = geo.transform(featureSRS);
-
-								if ( boundary->contains2D(geo.x(), geo.y()) )
-								{
-                                    h = (*f)->getDouble(_options.attr().value());
-
-                                    if ( keySRS->isGeographic() )
-                                    {                              
-                                        // for a round earth, must adjust the final elevation accounting for the
-                                        // curvature of the earth; so we have to adjust it in the feature boundary's
-                                        // local tangent plane.
-                                        Bounds bounds = boundary->getBounds();
-                                        GeoPoint anchor( featureSRS, bounds.center().x(), bounds.center().y(), h, ALTMODE_ABSOLUTE );
-                                        if ( transformRequired )
-                                            anchor = anchor.transform(keySRS);
-
-                                        // For transforming between ECEF and local tangent plane:
-                                        osg::Matrix localToWorld, worldToLocal;
-                                        anchor.createLocalToWorld(localToWorld);
-                                        worldToLocal.invert( localToWorld );
-
-                                        // Get the ECEF location of the anchor point:
-                                        osg::Vec3d ecef;
-                                        geo.toWorld( ecef );
-
-                                        // Move it into Local Tangent Plane coordinates:
-                                        osg::Vec3d local = ecef * worldToLocal;
-
-                                        // Reset the Z to zero, since the LTP is centered on the "h" elevation:
-                                        local.z() = 0.0;
-
-                                        // Back into ECEF:
-                                        ecef = local * localToWorld;
-
-                                        // And back into lat/long/alt:
-                                        geo.fromWorld( geo.getSRS(), ecef);
-
-                                        h = geo.z();
-                                    }
-									break;
-								}
-							}
-						}
-
-						hf->setHeight(c, r, h + _offset);
-					}
+                    float h = (*f)->getDouble(_options.attr().value());
+
+                    GeometryIterator parts( (*f)->getGeometry(), false );
+                    while ( parts.hasMore() )
+                    {
+					    osgEarth::Symbology::Polygon* boundary = dynamic_cast<osgEarth::Symbology::Polygon*>(parts.next());
+					    if (!boundary)
+					    {
+						    OE_WARN << LC << "NOT A POLYGON" << std::endl;
+                            continue;
+					    }
+
+                        // the outer ring first, then the holes:
+                        bool ok = toPixels(boundary, featureSRS, keySRS, transformRequired, xmin, ymin, dx, dy, ring);
+                        if ( ok )
+                            rasterizer.addRing( &ring[0], ring.size() );
+
+                        const osgEarth::Symbology::RingCollection& holes = boundary->getHoles();
+                        for (unsigned i = 0; ok && i < holes.size(); ++i)
+                        {
+                            if ( holes[i]->size() < 3 )
+                                continue;
+                            ok = toPixels(holes[i].get(), featureSRS, keySRS, transformRequired, xmin, ymin, dx, dy, ring);
+                            if ( ok )
+                                rasterizer.addRing( &ring[0], ring.size() );
+                        }
+
+                        spans.clear();
+                        if ( !ok )
+                        {
+                            rasterizer.discard();
+                            continue;
+                        }
+                        if ( rasterizer.fill(spans) == 0 )
+                        {
+                            continue;
+                        }
+
+                        if ( keySRS->isGeographic() )
+                        {
+                            // for a round earth, must adjust the final elevation accounting for the
+                            // curvature of the earth; so we have to adjust it in the feature boundary's
+                            // local tangent plane.
+                            Bounds bounds = boundary->getBounds();
+                            GeoPoint anchor( featureSRS, bounds.center().x(), bounds.center().y(), h, ALTMODE_ABSOLUTE );
+                            if ( transformRequired )
+                                anchor = anchor.transform(keySRS);
+
+                            // For transforming between ECEF and local tangent plane:
+                            osg::Matrix localToWorld, worldToLocal;
+                            anchor.createLocalToWorld(localToWorld);
+                            worldToLocal.invert( localToWorld );
+
+                            for (unsigned i = 0; i < spans.size(); ++i)
+                            {
+                                const PolygonRasterizer::Span& span = spans[i];
+                                double geoY = ymin + (dy * (double)span._row);
+                                for (unsigned c = span._colStart; c < span._colEnd; ++c)
+                                {
+                                    GeoPoint geo(keySRS, xmin + (dx * (double)c), geoY, 0.0, ALTMODE_ABSOLUTE);
+
+                                    // Get the ECEF location of the sample:
+                                    osg::Vec3d ecef;
+                                    geo.toWorld( ecef );
+
+                                    // Move it into Local Tangent Plane coordinates:
+                                    osg::Vec3d local = ecef * worldToLocal;
+
+                                    // Reset the Z to zero, since the LTP is centered on the "h" elevation:
+                                    local.z() = 0.0;
+
+                                    // Back into ECEF:
+                                    ecef = local * localToWorld;
+
+                                    // And back into lat/long/alt:
+                                    geo.fromWorld( keySRS, ecef );
+
+                                    hf->setHeight(c, span._row, geo.z() + _offset);
+                                }
+                            }
+                        }
+                        else
+                        {
+                            for (unsigned i = 0; i < spans.size(); ++i)
+                            {
+                                const PolygonRasterizer::Span& span = spans[i];
+                                for (unsigned c = span._colStart; c < span._colEnd; ++c)
+                                    hf->setHeight(c, span._row, h + _offset);
+                            }
+                        }
+                    }
 				}
                 return hf.release();
 			}	
@@ -255,6 +306,42 @@ public:
     }
 
 
+private:
+
+    struct PrioritizedFeature
+    {
+        PrioritizedFeature(double priority, Feature* feature) : _priority(priority), _feature(feature) { }
+        bool operator < (const PrioritizedFeature& rhs) const { return _priority > rhs._priority; }
+        double   _priority;
+        Feature* _feature;
+    };
+
+    // Copies a ring into the pixel space of a heightfield whose sample (0,0) is
+    // at (xmin, ymin) in the key SRS and whose samples are (dx, dy) apart.
+    // Returns false if the ring is degenerate or fails to transform.
+    bool toPixels(const osgEarth::Symbology::Ring*  ring,
+                  const SpatialReference*           featureSRS,
+                  const SpatialReference*           keySRS,
+                  bool                              transformRequired,
+                  double xmin, double ymin, double dx, double dy,
+                  std::vector<osg::Vec3d>&          output) const
+    {
+        output.assign( ring->begin(), ring->end() );
+        if ( output.size() < 3 )
+            return false;
+
+        if ( transformRequired && !featureSRS->transform(output, keySRS) )
+            return false;
+
+        for (unsigned i = 0; i < output.size(); ++i)
+        {
+            output[i].x() = (output[i].x() - xmin) / dx;
+            output[i].y() = (output[i].y() - ymin) / dy;
+        }
+        return true;
+    }
+
+
 private:
 
     GeoExtent _extents;
@@ -85,7 +85,9 @@ _chunkSize        ( 500 ),
 _nextHandleToQueue( 0L ),
 _resultSetEndReached(false),
 _profile          ( profile ),
-_filters          ( filters )
+_filters          ( filters ),
+_nextFid          ( 0u ),
+_readByFid        ( false )
 {
     {
         OGR_SCOPED_LOCK;
@@ -182,6 +184,31 @@ _filters          ( filters )
     readChunk();
 }
 
+FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH              dsHandle,
+                                   OGRLayerH                   layerHandle,
+                                   const FeatureSource*        source,
+                                   const FeatureProfile*       profile,
+                                   const Symbology::Query&     query,
+                                   const FeatureFilterList&    filters,
+                                   std::vector<FeatureID>&     fids) :
+_source           ( source ),
+_dsHandle         ( dsHandle ),
+_layerHandle      ( layerHandle ),
+_resultSetHandle  ( layerHandle ),
+_spatialFilter    ( 0L ),
+_query            ( query ),
+_chunkSize        ( 500 ),
+_nextHandleToQueue( 0L ),
+_resultSetEndReached(false),
+_profile          ( profile ),
+_filters          ( filters ),
+_nextFid          ( 0u ),
+_readByFid        ( true )
+{
+    _fids.swap( fids );
+    readChunk();
+}
+
 FeatureCursorOGR::~FeatureCursorOGR()
 {
     OGR_SCOPED_LOCK;
@@ -238,7 +265,18 @@ FeatureCursorOGR::readChunk()
         FeatureList filterList;
         while( filterList.size() < _chunkSize && !_resultSetEndReached )
         {
-            OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
+            OGRFeatureH handle = 0L;
+            if ( _readByFid )
+            {
+                // skip IDs that no longer resolve (e.g. deleted features).
+                while( !handle && _nextFid < _fids.size() )
+                    handle = OGR_L_GetFeature( _resultSetHandle, _fids[_nextFid++] );
+            }
+            else
+            {
+                handle = OGR_L_GetNextFeature( _resultSetHandle );
+            }
+
             if ( handle )
             {
                 osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get() );
@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
+#include <osgEarth/PackedHilbertRTree>
 #include <osgEarthFeatures/FeatureSource>
 #include <osgEarthFeatures/Filter>
 #include <osgEarthFeatures/BufferFilter>
@@ -29,9 +30,12 @@
 #include "FeatureCursorOGR"
 #include <osgEarthFeatures/OgrUtils>
 #include <osg/Notify>
+#include <osg/Timer>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <list>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <ogr_api.h>
 #include <cpl_error.h>
 
@@ -305,6 +309,12 @@ public:
             {
                 result->geoInterp() = _options.geoInterp().get();
             }
+
+            // an in-memory index can't track edits, so only use it read-only.
+            if ( _layerHandle && !_writable && _options.inMemoryIndex() == true )
+            {
+                buildIndex();
+            }
         }
 
         return result;
@@ -323,6 +333,14 @@ public:
         }
         else
         {
+            // with an in-memory index, a spatial query becomes a list of feature IDs.
+            Symbology::Query localQuery( query );
+            bool useIndex =
+                _index.valid() &&
+                !query.expression().isSet() &&
+                !query.orderby().isSet() &&
+                getLocalBounds( localQuery );
+
             OGRDataSourceH dsHandle = 0L;
             OGRLayerH layerHandle = 0L;
 
@@ -339,7 +357,22 @@ public:
                 }
             }
 
-            if ( dsHandle && layerHandle )
+            if ( dsHandle && layerHandle && useIndex )
+            {
+                const Bounds& b = localQuery.bounds().get();
+                std::vector<FeatureID> fids;
+                _index->query( b.xMin(), b.yMin(), b.xMax(), b.yMax(), fids );
+
+                return new FeatureCursorOGR(
+                    dsHandle,
+                    layerHandle,
+                    this,
+                    getFeatureProfile(),
+                    localQuery,
+                    getFilters(),
+                    fids );
+            }
+            else if ( dsHandle && layerHandle )
             {
                 // cursor is responsible for the OGR handles.
                 return new FeatureCursorOGR( 
@@ -382,6 +415,33 @@ public:
         return _featureCount;
     }
 
+    // modification time and size of the file(s) behind the source, if it
+    // is a local file. Shapefiles keep their attributes in a separate .dbf.
+    virtual std::string getSourceSignature() const
+    {
+        if ( !_options.url().isSet() || _options.url()->isRemote() )
+            return std::string();
+
+        std::string path = _options.url()->full();
+        std::string::size_type zip = osgEarth::toLower(path).find(".zip/");
+        if ( zip != std::string::npos )
+            path = path.substr(0, zip+4);
+
+        std::string signature = fileSignature( path );
+        if ( !signature.empty() && osgDB::getLowerCaseFileExtension(path) == "shp" )
+            signature += "|" + fileSignature( osgDB::getNameLessExtension(path) + ".dbf" );
+
+        return signature;
+    }
+
+    static std::string fileSignature(const std::string& path)
+    {
+        struct stat buf;
+        if ( ::stat(path.c_str(), &buf) != 0 )
+            return std::string();
+        return Stringify() << (long long)buf.st_mtime << ":" << (long long)buf.st_size;
+    }
+
     bool supportsGetFeature() const
     {
         return true;
@@ -521,6 +581,133 @@ protected:
         }
     }
 
+    // sets the query bounds (in feature profile coordinates) from its tile key
+    // if necessary; returns false if the query has no spatial extent.
+    bool getLocalBounds( Symbology::Query& query ) const
+    {
+        if ( !query.bounds().isSet() && query.tileKey().isSet() && getFeatureProfile() )
+        {
+            GeoExtent localEx = query.tileKey()->getExtent().transform( getFeatureProfile()->getSRS() );
+            if ( localEx.isValid() )
+                query.bounds() = localEx.bounds();
+        }
+        return query.bounds().isSet();
+    }
+
+    // builds (or loads from the cache) the in-memory spatial index.
+    void buildIndex()
+    {
+        {
+            OGR_SCOPED_LOCK;
+
+            if ( OGR_L_TestCapability(_layerHandle, OLCFastSpatialFilter) != 0 )
+            {
+                OE_INFO << LC << "Layer " << getName() << " has a spatial index; in-memory index not needed" << std::endl;
+                return;
+            }
+
+            if ( OGR_L_TestCapability(_layerHandle, OLCRandomRead) == 0 )
+            {
+                OE_INFO << LC << "Layer " << getName() << " does not support reading by ID; in-memory index disabled" << std::endl;
+                return;
+            }
+        }
+
+        osg::ref_ptr<CacheBin> cacheBin;
+        optional<CachePolicy> policy;
+        if ( CacheSettings* cacheSettings = CacheSettings::get(getReadOptions()) )
+        {
+            cacheBin = cacheSettings->getCacheBin();
+            policy = cacheSettings->cachePolicy();
+        }
+
+        std::string cacheKey = Stringify() << "ogr_index_" << hashToString(_source + "|" + _options.layer().value());
+
+        // a cached index is only valid for the exact data it was built from.
+        std::string signature = getSourceSignature();
+
+        osg::ref_ptr<PackedHilbertRTree> index = new PackedHilbertRTree();
+
+        if ( cacheBin.valid() && policy->isCacheReadable() )
+        {
+            ReadResult rr = cacheBin->readString( cacheKey, getReadOptions() );
+            if (rr.succeeded() &&
+                !policy->isExpired(rr.lastModifiedTime()) &&
+                rr.metadata().value<int>("feature_count", -1) == _featureCount &&
+                rr.metadata().value("signature") == signature &&
+                index->read(rr.getString()) )
+            {
+                OE_INFO << LC << "Loaded in-memory index for " << getName() << " from the cache" << std::endl;
+                _index = index.get();
+                return;
+            }
+        }
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        std::vector<PackedHilbertRTree::Item> items;
+        if ( _featureCount > 0 )
+            items.reserve( _featureCount );
+
+        // scan the feature envelopes. This is the only full pass over the layer.
+        {
+            OGR_SCOPED_LOCK;
+
+            // don't bother parsing the attributes.
+            OGRFeatureDefnH layerDef = OGR_L_GetLayerDefn( _layerHandle );
+            std::vector<const char*> ignored;
+            for(int i = 0; i < OGR_FD_GetFieldCount(layerDef); ++i)
+                ignored.push_back( OGR_Fld_GetNameRef(OGR_FD_GetFieldDefn(layerDef, i)) );
+            ignored.push_back( "OGR_STYLE" );
+            ignored.push_back( 0L );
+            OGR_L_SetIgnoredFields( _layerHandle, &ignored[0] );
+
+            OGR_L_ResetReading( _layerHandle );
+            OGRFeatureH handle;
+            while( (handle = OGR_L_GetNextFeature(_layerHandle)) != 0L )
+            {
+                OGRGeometryH geom = OGR_F_GetGeometryRef( handle );
+                if ( geom && !OGR_G_IsEmpty(geom) )
+                {
+                    OGREnvelope env;
+                    OGR_G_GetEnvelope( geom, &env );
+
+                    PackedHilbertRTree::Item item;
+                    item._id   = OGR_F_GetFID( handle );
+                    item._xmin = env.MinX;
+                    item._ymin = env.MinY;
+                    item._xmax = env.MaxX;
+                    item._ymax = env.MaxY;
+                    items.push_back( item );
+                }
+                OGR_F_Destroy( handle );
+            }
+
+            OGR_L_SetIgnoredFields( _layerHandle, 0L );
+            OGR_L_ResetReading( _layerHandle );
+        }
+
+        unsigned numItems = items.size();
+        index->build( items );
+        _index = index.get();
+
+        OE_INFO << LC << "Built in-memory index for " << getName() << " (" << numItems << " features) in "
+            << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << "s" << std::endl;
+
+        if ( cacheBin.valid() && policy->isCacheWriteable() )
+        {
+            osg::ref_ptr<StringObject> record = new StringObject();
+            std::string buffer;
+            index->write( buffer );
+            record->setString( buffer );
+
+            Config meta;
+            meta.set( "feature_count", _featureCount );
+            meta.set( "signature", signature );
+            cacheBin->write( cacheKey, record.get(), meta, getReadOptions() );
+        }
+    }
+
 
 
 
@@ -537,6 +724,7 @@ private:
     bool _writable;
     FeatureSchema _schema;
     Geometry::Type _geometryType;
+    osg::ref_ptr<PackedHilbertRTree> _index;
 };
 
 
@@ -631,7 +631,9 @@ public:
       _srcDS(NULL),
       _warpedDS(NULL),
       _options(options),
-      _maxDataLevel(30)
+      _maxDataLevel(30),
+      _deferred(false),
+      _openFailed(false)
     {
     }
 
@@ -688,6 +690,26 @@ public:
         //    }
         //}
 
+        // remember the override profile (if any) before we set one of our own.
+        _overrideProfile = getProfile();
+
+        // with a known source extent, report the profile now and open the file on first read.
+        if ( initializeFromSourceExtent() )
+        {
+            return STATUS_OK;
+        }
+
+        return openDataset();
+    }
+
+
+    /**
+     * Opens the dataset and sets up the geotransform. Unless the profile came
+     * from the source extent, also works out the profile and data extents.
+     * Call with the GDAL lock held.
+     */
+    Status openDataset()
+    {
         // Is a valid external GDAL dataset specified ?
         bool useExternalDataset = false;
         osg::ref_ptr<GDALOptions::ExternalDataset> pExternalDataset = _options.externalDataset();
@@ -893,16 +915,16 @@ public:
         }
 
 
-        if ( !srcProj.empty() && getProfile() != 0L )
+        if ( !srcProj.empty() && _overrideProfile.valid() )
         {
             OE_WARN << LC << "Overriding profile of a source that already defines its own SRS ("
                 << this->getName() << ")" << std::endl;
         }
 
         osg::ref_ptr<const SpatialReference> src_srs;
-        if ( getProfile() )
+        if ( _overrideProfile.valid() )
         {
-            src_srs = getProfile()->getSRS();
+            src_srs = _overrideProfile->getSRS();
         }
         else if ( !srcProj.empty() )
         {
@@ -942,7 +964,7 @@ public:
         if (isRotated) OE_DEBUG << LC << source << " is rotated " << std::endl;
         bool requiresReprojection = hasGCP || isRotated;
 
-        const Profile* profile = NULL;
+        osg::ref_ptr<const Profile> profile;
 
         // The warp profile, if provided, takes precedence.
         if ( warpProfile )
@@ -955,9 +977,9 @@ public:
         }
 
         // If we have an override profile, just take it.
-        if ( getProfile() )
+        if ( _overrideProfile.valid() )
         {
-            profile = getProfile();
+            profile = _overrideProfile.get();
             if ( profile )
             {
                 OE_DEBUG << LC << INDENT << "Using override Profile: " << profile->toString() <<  std::endl;
@@ -1019,16 +1041,16 @@ public:
         }
 
         //Get the _geotransform
-        if ( getProfile() )
+        if ( _overrideProfile.valid() )
         {
             OE_DEBUG << LC << INDENT << "Get geotransform from Override Profile" <<  std::endl;
-            _geotransform[0] =  getProfile()->getExtent().xMin(); //Top left x
-            _geotransform[1] =  getProfile()->getExtent().width() / (double)_warpedDS->GetRasterXSize();//pixel width
+            _geotransform[0] =  _overrideProfile->getExtent().xMin(); //Top left x
+            _geotransform[1] =  _overrideProfile->getExtent().width() / (double)_warpedDS->GetRasterXSize();//pixel width
             _geotransform[2] =  0;
 
-            _geotransform[3] =  getProfile()->getExtent().yMax(); //Top left y
+            _geotransform[3] =  _overrideProfile->getExtent().yMax(); //Top left y
             _geotransform[4] =  0;
-            _geotransform[5] = -getProfile()->getExtent().height() / (double)_warpedDS->GetRasterYSize();//pixel height
+            _geotransform[5] = -_overrideProfile->getExtent().height() / (double)_warpedDS->GetRasterYSize();//pixel height
 
         }
         else
@@ -1078,6 +1100,12 @@ public:
 
         OE_DEBUG << LC << INDENT << "Geo extents: " << minX << ", " << minY << " -> " << maxX << ", " << maxY << std::endl;
 
+        // the profile and data extents are already set from the source extent.
+        if ( _deferred )
+        {
+            return STATUS_OK;
+        }
+
         if ( !profile )
         {
             profile = Profile::create(
@@ -1103,6 +1131,105 @@ public:
 
         OE_INFO << LC << INDENT << "Resolution= " << resolutionX << "x" << resolutionY << " max=" << maxResolution << std::endl;
 
+        computeMaxDataLevel( profile.get(), maxResolution );
+
+        osg::ref_ptr< SpatialReference > srs = SpatialReference::create( warpedSRSWKT );
+        // record the data extent in profile space:
+        _extents = GeoExtent( srs, minX, minY, maxX, maxY);
+        GeoExtent profile_extent = _extents.transform( profile->getSRS() );
+
+        getDataExtents().push_back( DataExtent(profile_extent, 0, _maxDataLevel) );
+
+        //Set the profile
+        setProfile( profile.get() );
+        OE_DEBUG << LC << INDENT << "Set Profile to " << (profile.valid() ? profile->toString() : "NULL") <<  std::endl;
+
+        return STATUS_OK;
+    }
+
+
+    /**
+     * Sets up the profile, data extents and max data level from the source
+     * extent in the options, without opening the file. Returns false if the
+     * options do not describe the dataset well enough to do that.
+     */
+    bool initializeFromSourceExtent()
+    {
+        if ( !_options.sourceExtent().isSet() ||
+             !_options.sourceExtent()->srsString().isSet() ||
+             !_options.sourceExtent()->bounds().isSet() ||
+             _options.sourceWidth().getOrUse(0u) == 0u ||
+             _options.sourceHeight().getOrUse(0u) == 0u ||
+             _options.externalDataset().valid() ||
+             !_options.url().isSet() ||
+             _options.subDataSet().isSet() ||
+             _options.warpProfile().isSet() ||
+             _overrideProfile.valid() ||
+             osgDB::fileType(_options.url()->full()) != osgDB::REGULAR_FILE )
+        {
+            return false;
+        }
+
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::create( _options.sourceExtent()->srsString().get() );
+        if ( !srs.valid() )
+        {
+            return false;
+        }
+
+        // same profile that openDataset() would work out for a north-up file:
+        const Bounds& b = _options.sourceExtent()->bounds().get();
+        osg::ref_ptr<const Profile> profile = srs->isGeographic() ?
+            Profile::create(srs.get(), -180.0, -90.0, 180.0, 90.0, 2u, 1u) :
+            Profile::create(srs.get(), b.xMin(), b.yMin(), b.xMax(), b.yMax());
+
+        if ( !profile.valid() )
+        {
+            return false;
+        }
+
+        double resolutionX = b.width()  / (double)_options.sourceWidth().get();
+        double resolutionY = b.height() / (double)_options.sourceHeight().get();
+        computeMaxDataLevel( profile.get(), osg::minimum(resolutionX, resolutionY) );
+
+        _extents = GeoExtent( srs.get(), b.xMin(), b.yMin(), b.xMax(), b.yMax() );
+        getDataExtents().push_back( DataExtent(_extents.transform(profile->getSRS()), 0, _maxDataLevel) );
+        setProfile( profile.get() );
+
+        _deferred = true;
+        OE_INFO << LC << INDENT << _options.url()->full() << " will be opened on first read" << std::endl;
+        return true;
+    }
+
+
+    /**
+     * Opens a dataset whose profile came from the source extent, if it is not
+     * open yet. Call with the GDAL lock held.
+     */
+    bool openIfDeferred()
+    {
+        if ( _warpedDS )
+            return true;
+
+        if ( !_openFailed )
+        {
+            Status status = openDataset();
+            if ( status.isError() )
+            {
+                OE_WARN << LC << "Failed to open " << _options.url()->full() << ": " << status.message() << std::endl;
+                _openFailed = true;
+            }
+        }
+
+        return _warpedDS != 0L;
+    }
+
+
+    /**
+     * Sets the max data level to the first level whose tiles are at least as
+     * fine as the data, unless the options override it.
+     */
+    void computeMaxDataLevel(const Profile* profile, double maxResolution)
+    {
         if (_options.maxDataLevelOverride().isSet())
         {
             _maxDataLevel = _options.maxDataLevelOverride().value();
@@ -1127,19 +1254,6 @@ public:
 
             OE_INFO << LC << INDENT << _options.url().value().full() << " max Data Level: " << _maxDataLevel << std::endl;
         }
-
-        osg::ref_ptr< SpatialReference > srs = SpatialReference::create( warpedSRSWKT );
-        // record the data extent in profile space:
-        _extents = GeoExtent( srs, minX, minY, maxX, maxY);
-        GeoExtent profile_extent = _extents.transform( profile->getSRS() );
-
-        getDataExtents().push_back( DataExtent(profile_extent, 0, _maxDataLevel) );
-
-        //Set the profile
-        setProfile( profile );
-        OE_DEBUG << LC << INDENT << "Set Profile to " << (profile ? profile->toString() : "NULL") <<  std::endl;
-
-        return STATUS_OK;
     }
 
 
@@ -1278,6 +1392,9 @@ public:
 
         GDAL_SCOPED_LOCK;
 
+        if ( !openIfDeferred() )
+            return NULL;
+
         int tileSize = _options.tileSize().value();
 
         osg::ref_ptr<osg::Image> image;
@@ -1892,6 +2009,9 @@ public:
 
         GDAL_SCOPED_LOCK;
 
+        if ( !openIfDeferred() )
+            return NULL;
+
         int tileSize = _options.tileSize().value();
 
         //Allocate the heightfield
@@ -2018,6 +2138,9 @@ public:
 
         GDAL_SCOPED_LOCK;
 
+        if ( !openIfDeferred() )
+            return NULL;
+
         int tileSize = _options.tileSize().value();
 
         //Allocate the heightfield
@@ -2289,6 +2412,10 @@ private:
 
     const GDALOptions _options;
 
+    osg::ref_ptr<const Profile> _overrideProfile;
+    bool                        _deferred;   // profile came from the source extent; open on first read
+    bool                        _openFailed;
+
     osg::ref_ptr< CacheBin > _cacheBin;
     osg::ref_ptr< osgDB::Options > _dbOptions;
 
@@ -67,6 +67,9 @@ public:
             _index = TileIndex::load( _options.url()->full() );        
             if (_index.valid() )
             {
+                // bounds the number of GDAL datasets held open at once:
+                _tileSourceCache.setMaxSize( osg::maximum(_options.maxOpenFiles().get(), 1u) );
+
                 setProfile( osgEarth::Registry::instance()->getGlobalGeodeticProfile() );
                 return STATUS_OK;
             }
@@ -108,21 +111,23 @@ public:
 
                     start = osg::Timer::instance()->tick();
                     source = osgEarth::TileSourceFactory::create( opt );                               
-                    TileSource::Status compStatus = source->open();
-                    if (compStatus.isOK())
-                    {
-                        _tileSourceCache.insert( files[i], source.get() );                                                
-                    }
-                    else
+                    TileSource::Status compStatus = source.valid() ? source->open() : TileSource::Status::Error("No driver");
+                    if (!compStatus.isOK())
                     {
                         OE_WARN << "Failed to open " << files[i] << std::endl;
+                        source = 0L;
                     }
+                    // Cache failures too, so a bad file isn't reopened for every tile.
+                    _tileSourceCache.insert( files[i], source.get() );                                                
                     end = osg::Timer::instance()->tick();
                     //OE_NOTICE << "init took " << osg::Timer::instance()->delta_m( start, end) << "ms" << std::endl;
                 }               
             }
 
-            
+            if (!source.valid())
+            {
+                continue;
+            }
             
             start = osg::Timer::instance()->tick();
             osg::ref_ptr< osg::Image > image = source->createImage( key);
@@ -19,10 +19,12 @@
 
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Geoid>
+#include <osgEarth/GeoidGrid>
 #include <osgEarth/Units>
 #include <osgDB/ReaderWriter>
 #include <osgDB/Registry>
 #include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
 #include "EGM96Grid.h"
 
 using namespace osgEarth;
@@ -38,45 +40,59 @@ namespace
             "EGM96",                                  // readable name
             "egm96" )                                 // initialization string
         {
-            // build a heightfield from the data.
-
-            unsigned cols = 1441, rows = 721;
-            float colStep = 0.25f, rowStep = 0.25f;
+            _geoid = new Geoid();
+            _geoid->setUnits( Units::METERS );
+            _geoid->setName( "EGM96" );
 
-            osg::HeightField* hf = new osg::HeightField();
-            hf->allocate( cols, rows );
-            osg::Vec3 origin(-180.f, -90.f, 0.f);
-            hf->setOrigin( origin );
-            hf->setXInterval( colStep );
-            hf->setYInterval( rowStep );
+            // prefer a memory-mapped grid (see osgearth_geoidgrid) if one is installed.
+            osg::ref_ptr<GeoidGrid> grid;
+            std::string gridFile = osgDB::findDataFile( "egm96.geoid" );
+            if ( !gridFile.empty() )
+                grid = GeoidGrid::open( gridFile );
 
-            for( unsigned c=0; c<cols-1; ++c )
+            if ( grid.valid() )
             {
-                float inputLon = 0.0f + float(c) * colStep;
+                _geoid->setGrid( grid.get() );
+            }
+            else
+            {
+                // build a heightfield from the data.
 
-                if ( inputLon >= 180.0 ) inputLon -= 360.0;
-                
-                unsigned outc = unsigned( (inputLon-origin.x())/colStep );
+                unsigned cols = 1441, rows = 721;
+                float colStep = 0.25f, rowStep = 0.25f;
+
+                osg::HeightField* hf = new osg::HeightField();
+                hf->allocate( cols, rows );
+                osg::Vec3 origin(-180.f, -90.f, 0.f);
+                hf->setOrigin( origin );
+                hf->setXInterval( colStep );
+                hf->setYInterval( rowStep );
 
-                for( unsigned r=0; r<rows; ++r )
+                for( unsigned c=0; c<cols-1; ++c )
                 {
-                    float inputLat = 90.0f - float(r) * rowStep;
+                    float inputLon = 0.0f + float(c) * colStep;
 
-                    unsigned outr = unsigned( (inputLat-origin.y())/rowStep );
+                    if ( inputLon >= 180.0 ) inputLon -= 360.0;
+                
+                    unsigned outc = unsigned( (inputLon-origin.x())/colStep );
+
+                    for( unsigned r=0; r<rows; ++r )
+                    {
+                        float inputLat = 90.0f - float(r) * rowStep;
 
-                    Linear h( (double)s_egm96grid[r*cols+c], Units::CENTIMETERS );
-                    hf->setHeight( outc, outr, float(h.as(Units::METERS)) );
+                        unsigned outr = unsigned( (inputLat-origin.y())/rowStep );
+
+                        Linear h( (double)s_egm96grid[r*cols+c], Units::CENTIMETERS );
+                        hf->setHeight( outc, outr, float(h.as(Units::METERS)) );
+                    }
                 }
-            }
 
-            // copy the first column to the last column
-            for(unsigned r=0; r<rows; ++r)
-                hf->setHeight(cols-1, r, hf->getHeight(0, r));
+                // copy the first column to the last column
+                for(unsigned r=0; r<rows; ++r)
+                    hf->setHeight(cols-1, r, hf->getHeight(0, r));
 
-            _geoid = new Geoid();
-            _geoid->setHeightField( hf );
-            _geoid->setUnits( Units::METERS );
-            _geoid->setName( "EGM96" );
+                _geoid->setHeightField( hf );
+            }
         }
     };
 }
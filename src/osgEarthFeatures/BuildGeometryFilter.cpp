@@ -921,10 +921,21 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
 
     ring->rewind(osgEarth::Symbology::Geometry::ORIENTATION_CCW);
 
+    Polygon* poly = dynamic_cast<Polygon*>(ring);
+
+    // count first, so that splicing in the holes (each plus two bridge
+    // points) never grows the outer loop.
+    unsigned numPoints = ring->size();
+    if ( poly )
+    {
+        for( RingCollection::const_iterator h = poly->getHoles().begin(); h != poly->getHoles().end(); ++h )
+            numPoints += h->get()->size() + 2;
+    }
+
     osg::ref_ptr<osg::Vec3Array> allPoints = new osg::Vec3Array();
+    allPoints->reserve( numPoints );
     transformAndLocalize( ring->asVector(), featureSRS, allPoints.get(), mapSRS, world2local, makeECEF );
 
-    Polygon* poly = dynamic_cast<Polygon*>(ring);
     if ( poly )
     {
         RingCollection ordered(poly->getHoles().begin(), poly->getHoles().end());
@@ -222,15 +222,20 @@ ExtrudeGeometryFilter::buildStructure(const Geometry*         input,
     osg::Vec3d maxLoc(0,0,0);
     double     maxLoc_len = 0;
 
-    // Initial pass over the geometry does two things:
+    // Initial pass over the geometry does three things:
     // 1: Calculate the minimum Z across all parts.
     // 2: Establish a "target length" for extrusion
+    // 3: Count the parts that will become walls, to size the structure
     double absHeight = fabs(height);
+    unsigned numWalls = 0u;
 
     ConstGeometryIterator zfinder( input );
     while( zfinder.hasMore() )
     {
         const Geometry* geom = zfinder.next();
+        if ( geom->size() >= 2 )
+            ++numWalls;
+
         for( Geometry::const_iterator m = geom->begin(); m != geom->end(); ++m )
         {
             osg::Vec3d m_point = *m;
@@ -308,6 +313,8 @@ ExtrudeGeometryFilter::buildStructure(const Geometry*         input,
     double texWidthM  = wallSkin ? *wallSkin->imageWidth() : 0.0;
     double texHeightM = wallSkin ? *wallSkin->imageHeight() : 1.0;
 
+    structure.elevations.reserve( numWalls );
+
     ConstGeometryIterator iter( input );
     while( iter.hasMore() )
     {
@@ -328,10 +335,13 @@ ExtrudeGeometryFilter::buildStructure(const Geometry*         input,
         elevation.texHeightAdjustedM = div > 0.0 ? maxHeight / div : maxHeight;
 
         // Step 1 - Create the real corners and transform them into our target SRS.
+        // (numCorners tracks the list's size, which is not constant-time to get.)
         Corners corners;
+        unsigned numCorners = 0u;
         for(Geometry::const_iterator m = part->begin(); m != part->end(); ++m)
         {
             Corners::iterator corner = corners.insert(corners.end(), Corner());
+            ++numCorners;
             
             // mark as "from source", as opposed to being inserted by the algorithm.
             corner->isFromSource = true;
@@ -417,6 +427,7 @@ ExtrudeGeometryFilter::buildStructure(const Geometry*         input,
                 {
                     // insert a new fake corner.
 					Corners::iterator new_corner;
+                    ++numCorners;
 
                     if ( isLastEdge )
                     {
@@ -473,6 +484,7 @@ ExtrudeGeometryFilter::buildStructure(const Geometry*         input,
 
         // Step 4 - Create faces connecting each pair of Posts.
         Faces& faces = elevation.faces;
+        faces.reserve( numCorners );
         for(Corners::const_iterator c = corners.begin(); c != corners.end(); ++c)
         {
             Corners::const_iterator this_corner = c;
@@ -684,10 +696,15 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
                                          const osg::Vec4&     roofColor,
                                          const SkinResource*  roofSkin)
 {    
+    // the roof uses at most one vert per structure point; size the arrays up front.
+    unsigned maxRoofVerts = structure.getNumPoints();
+
     osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->reserve( maxRoofVerts );
     roof->setVertexArray( verts );
 
     osg::Vec4Array* color = new osg::Vec4Array();
+    color->reserve( maxRoofVerts );
     roof->setColorArray( color );
     roof->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
 
@@ -695,6 +712,7 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
     if ( roofSkin )
     {
         tex = new osg::Vec3Array();
+        tex->reserve( maxRoofVerts );
         roof->setTexCoordArray(0, tex);
     }
 
@@ -705,6 +723,7 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
         // so we will put them in one of the texture arrays and copy them to an attrib array 
         // after tessellation. #osghack
         anchors = new osg::Vec4Array();
+        anchors->reserve( maxRoofVerts );
         roof->setTexCoordArray(1, anchors);
     }
 
@@ -801,7 +820,11 @@ ExtrudeGeometryFilter::buildOutlineGeometry(const Structure&  structure,
     // minimum angle between adjacent faces for which to draw a post.
     const float cosMinAngle = cos(osg::DegreesToRadians(minCreaseAngleDeg));
 
+    // at most 3 verts (roof, base and next roof) and 4 indices per face.
+    unsigned maxOutlineVerts = 3 * structure.getNumPoints();
+
     osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->reserve( maxOutlineVerts );
     outline->setVertexArray( verts );
 
     osg::Vec4Array* color = new osg::Vec4Array();
@@ -810,12 +833,14 @@ ExtrudeGeometryFilter::buildOutlineGeometry(const Structure&  structure,
     color->push_back( outlineColor );
 
     osg::DrawElements* de = new osg::DrawElementsUInt(GL_LINES);
+    de->reserveElements( 4 * structure.getNumPoints() );
     outline->addPrimitiveSet(de);
         
     osg::Vec4Array* anchors = 0L;
     if ( _gpuClamping )
     {
         anchors = new osg::Vec4Array();
+        anchors->reserve( maxOutlineVerts );
         outline->setVertexAttribArray    ( Clamping::AnchorAttrLocation, anchors );
         outline->setVertexAttribBinding  ( Clamping::AnchorAttrLocation, osg::Geometry::BIND_PER_VERTEX );
         outline->setVertexAttribNormalize( Clamping::AnchorAttrLocation, false );
@@ -42,6 +42,17 @@ _clone   ( false )
     _iter = _features.begin();
 }
 
+FeatureListCursor::FeatureListCursor(FeatureList& features, bool adopt) :
+_clone   ( false )
+{
+    if ( adopt )
+        _features.swap( features );
+    else
+        _features = features;
+
+    _iter = _features.begin();
+}
+
 bool
 FeatureListCursor::hasMore() const
 {
@@ -56,6 +67,21 @@ FeatureListCursor::nextFeature()
     return _clone ? osg::clone(r, osg::CopyOp::DEEP_COPY_ALL) : r;
 }
 
+void
+FeatureListCursor::fill( FeatureList& output )
+{
+    if ( _clone )
+    {
+        FeatureCursor::fill( output );
+    }
+    else
+    {
+        // the caller now owns the remaining features; no need to copy them.
+        output.splice( output.end(), _features, _iter, _features.end() );
+        _iter = _features.end();
+    }
+}
+
 //---------------------------------------------------------------------------
 
 GeometryFeatureCursor::GeometryFeatureCursor(Geometry* geom) :
@@ -44,7 +44,7 @@ FeatureListSource::createFeatureCursor( const Symbology::Query& query )
         Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
         cursorFeatures.push_back( feature );
     }    
-    return new FeatureListCursor( cursorFeatures );
+    return new FeatureListCursor( cursorFeatures, true );
 }
 
 const FeatureProfile*
@@ -32,6 +32,7 @@
 #include <osgEarth/FadeEffect>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/TaskService>
 #include <osgEarth/ThreadingUtils>
 
 #include <osg/CullFace>
@@ -41,6 +42,7 @@
 #include <osgDB/ReaderWriter>
 #include <osgDB/WriteFile>
 #include <osgUtil/Optimizer>
+#include <OpenThreads/Thread>
 
 #include <algorithm>
 #include <iterator>
@@ -1122,7 +1124,8 @@ FeatureModelGraph::build(const Style&          defaultStyle,
         const FeatureProfile* featureProfile = source->getFeatureProfile();
 
         // each feature has its own style, so use that and ignore the style catalog.
-        osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor( baseQuery );
+        osg::ref_ptr<FeatureCursor> cursor = source->createCachedFeatureCursor( baseQuery, readOptions );
+        ++_sourceReads;
 
         while( cursor.valid() && cursor->hasMore() )
         {
@@ -1131,7 +1134,7 @@ FeatureModelGraph::build(const Style&          defaultStyle,
             {
                 FeatureList list;
                 list.push_back( feature );
-                osg::ref_ptr<FeatureCursor> cursor = new FeatureListCursor(list);
+                osg::ref_ptr<FeatureCursor> cursor = new FeatureListCursor(list, true);
 
                 FilterContext context( _session.get(), featureProfile, workingExtent, index );
 
@@ -1172,14 +1175,45 @@ FeatureModelGraph::build(const Style&          defaultStyle,
         // a create a node for each style group.
         if ( styles->selectors().size() > 0 )
         {
+            // in single-pass mode, read the features once for all the selectors that
+            // don't need the feature source to run a query of their own.
+            std::vector<const StyleSelector*> singlePass;
+            std::vector<osg::ref_ptr<osg::Group> > singlePassGroups;
+
+            if ( _options.singlePassSelectors() == true )
+            {
+                for( StyleSelectorList::const_iterator i = styles->selectors().begin(); i != styles->selectors().end(); ++i )
+                {
+                    if ( isSinglePassSelector(*i) )
+                        singlePass.push_back( &(*i) );
+                }
+
+                if ( singlePass.size() > 1 )
+                    sortIntoStyleGroupsSinglePass( singlePass, defaultStyle, baseQuery, index, singlePassGroups, readOptions );
+                else
+                    singlePass.clear();
+            }
+
             for( StyleSelectorList::const_iterator i = styles->selectors().begin(); i != styles->selectors().end(); ++i )
             {
                 // pull the selected style...
                 const StyleSelector& sel = *i;
 
+                // already done in the single pass? add its style groups in selector order.
+                std::vector<const StyleSelector*>::iterator sp = std::find(singlePass.begin(), singlePass.end(), &sel);
+                if ( sp != singlePass.end() )
+                {
+                    osg::Group* holder = singlePassGroups[sp - singlePass.begin()].get();
+                    for(unsigned c=0; c<holder->getNumChildren(); ++c)
+                    {
+                        if ( !group->containsNode(holder->getChild(c)) )
+                            group->addChild( holder->getChild(c) );
+                    }
+                }
+
                 // if the selector uses an expression to select the style name, then we must perform the
                 // query and then SORT the features into style groups.
-                if ( sel.styleExpression().isSet() )
+                else if ( sel.styleExpression().isSet() )
                 {
                     // merge the selector's query into the existing query
                     Query combinedQuery = baseQuery.combineWith( *sel.query() );
@@ -1298,8 +1332,8 @@ FeatureModelGraph::buildStyleGroups(const StyleSelector*  selector,
  * Querys the feature source;
  * Visits each feature and uses the Style Expression to resolve its style class;
  * Sorts the features into bins based on style class;
- * Compiles each bin into a separate style group;
- * Adds the resulting style groups to the provided parent.
+ * Compiles the bins into separate style groups in parallel;
+ * Adds the resulting style groups to the provided parent, in bin order.
  */
 void
 FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
@@ -1315,7 +1349,8 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
     const GeoExtent& extent = featureProfile->getExtent();
     
     // query the feature source:
-    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createFeatureCursor( query );
+    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createCachedFeatureCursor( query, readOptions );
+    ++_sourceReads;
     if ( !cursor.valid() )
         return;
 
@@ -1339,44 +1374,259 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
         }
     }
 
-    // next create a style group per bin.
+    // next create a compile job per bin. Bins whose style does not resolve are
+    // skipped (along with their features).
+    CompileStyleGroup::Jobs jobs;
+    Threading::MultiEvent semaphore;
+
     for( std::map<std::string,FeatureList>::iterator i = styleBins.begin(); i != styleBins.end(); ++i )
     {
-        const std::string& styleString = i->first;
-        FeatureList&       workingSet  = i->second;
+        Style combinedStyle = resolveStyleString( i->first, styleExpr );
+        if ( combinedStyle.empty() )
+            continue;
+
+        ParallelTask<CompileStyleGroup>* job = new ParallelTask<CompileStyleGroup>( &semaphore );
+        job->_graph       = this;
+        job->_style       = combinedStyle;
+        job->_context     = context;
+        job->_readOptions = readOptions;
+        job->_features.swap( i->second );
+        jobs.push_back( job );
+    }
+
+    // compile the bins in parallel, then add the style groups in bin (style name)
+    // order so the tile comes out the same no matter which job finished first.
+    CompileStyleGroup::run( jobs, semaphore );
+
+    for(unsigned j=0; j<jobs.size(); ++j)
+    {
+        if ( jobs[j]->_styleGroup.valid() )
+            parent->addChild( jobs[j]->_styleGroup.get() );
+    }
+}
+
+
+Style
+FeatureModelGraph::resolveStyleString(const std::string&      styleString,
+                                      const StringExpression& styleExpr)
+{
+    Style style;
+
+    // if the style string begins with an open bracket, it's an inline style definition.
+    if ( styleString.length() > 0 && styleString.at(0) == '{' )
+    {
+        Config conf( "style", styleString );
+        conf.setReferrer( styleExpr.uriContext().referrer() );
+        conf.set( "type", "text/css" );
+        style = Style(conf);
+    }
+
+    // otherwise, look up the style in the stylesheet. Do NOT fall back on a default
+    // style in this case: for style expressions, the user must be explicity about 
+    // default styling; this is because there is no other way to exclude unwanted
+    // features.
+    else
+    {
+        const Style* selectedStyle = _session->styles()->getStyle(styleString, false);
+        if ( selectedStyle )
+            style = *selectedStyle;
+    }
+
+    return style;
+}
 
-        // resolve the style:
-        Style combinedStyle;
 
-        // if the style string begins with an open bracket, it's an inline style definition.
-        if ( styleString.length() > 0 && styleString.at(0) == '{' )
+/**
+ * Whether a selector can take part in a single-pass sort: its query must not
+ * add anything to the base query, since we cannot evaluate a driver-specific
+ * expression on features that are already in memory.
+ */
+bool
+FeatureModelGraph::isSinglePassSelector(const StyleSelector& selector) const
+{
+    if ( selector.query().isSet() )
+    {
+        const Query& q = selector.query().get();
+        if ( q.expression().isSet() || q.orderby().isSet() || q.bounds().isSet() || q.tileKey().isSet() )
+            return false;
+    }
+
+    // same restriction as the multi-pass path (see build()).
+    return selector.styleExpression().isSet() || !_useTiledSource;
+}
+
+
+namespace
+{
+    // pool shared by all graphs for compiling style groups in parallel.
+    TaskService* getCompileService()
+    {
+        static Threading::Mutex s_mutex;
+        static osg::ref_ptr<TaskService> s_service;
+
+        Threading::ScopedMutexLock lock( s_mutex );
+        if ( !s_service.valid() )
+            s_service = new TaskService( "FeatureModelGraph compile", OpenThreads::GetNumberOfProcessors() );
+        return s_service.get();
+    }
+}
+
+
+/**
+ * Compiles one style group; runs in parallel with the others from the same tile.
+ */
+struct FeatureModelGraph::CompileStyleGroup
+{
+    typedef std::vector< osg::ref_ptr< ParallelTask<CompileStyleGroup> > > Jobs;
+
+    void execute()
+    {
+        _styleGroup = _graph->createStyleGroup( _style, _features, _context, _readOptions.get() );
+    }
+
+    /**
+     * Runs a set of jobs that were all created with "semaphore" and waits for
+     * them: this thread takes the first job and the pool takes the rest. The
+     * results stay in job order, so the caller can merge them deterministically.
+     */
+    static void run(Jobs& jobs, Threading::MultiEvent& semaphore)
+    {
+        if ( jobs.size() > 1 )
         {
-            Config conf( "style", styleString );
-            conf.setReferrer( styleExpr.uriContext().referrer() );
-            conf.set( "type", "text/css" );
-            combinedStyle = Style(conf);
+            semaphore.reset( jobs.size()-1 );
+            TaskService* service = getCompileService();
+            for(unsigned j=1; j<jobs.size(); ++j)
+                service->add( jobs[j].get() );
         }
 
-        // otherwise, look up the style in the stylesheet. Do NOT fall back on a default
-        // style in this case: for style expressions, the user must be explicity about 
-        // default styling; this is because there is no other way to exclude unwanted
-        // features.
-        else
+        if ( !jobs.empty() )
+            jobs[0]->execute();
+
+        if ( jobs.size() > 1 )
+            semaphore.wait();
+    }
+
+    FeatureModelGraph*                 _graph;
+    Style                              _style;
+    FeatureList                        _features;
+    FilterContext                      _context;
+    osg::ref_ptr<const osgDB::Options> _readOptions;
+    osg::ref_ptr<osg::Group>           _styleGroup;
+};
+
+
+/**
+ * Reads the features once;
+ * Visits each feature and sorts it into a bin for every selector (evaluating
+ * the selector's style expression if it has one);
+ * Compiles the bins into style groups in parallel;
+ * Returns the style groups of selectors[i] as the children of output[i].
+ */
+void
+FeatureModelGraph::sortIntoStyleGroupsSinglePass(const std::vector<const StyleSelector*>& selectors,
+                                                 const Style&                             defaultStyle,
+                                                 const Query&                             baseQuery,
+                                                 FeatureIndexBuilder*                     index,
+                                                 std::vector<osg::ref_ptr<osg::Group> >&  output,
+                                                 const osgDB::Options*                    readOptions)
+{
+    output.clear();
+    for(unsigned i=0; i<selectors.size(); ++i)
+        output.push_back( new osg::Group() );
+
+    // the profile of the features
+    const FeatureProfile* featureProfile = _session->getFeatureSource()->getFeatureProfile();
+
+    // get the extent of the full set of feature data:
+    const GeoExtent& extent = featureProfile->getExtent();
+
+    // query the feature source once, instead of once per selector:
+    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createCachedFeatureCursor( baseQuery, readOptions );
+    ++_sourceReads;
+    for(unsigned i=1; i<selectors.size(); ++i)
+        ++_sourceReadsSaved;
+
+    OE_DEBUG << LC << "source reads = " << (unsigned)_sourceReads << ", saved by single-pass = " << (unsigned)_sourceReadsSaved << "\n";
+
+    if ( !cursor.valid() )
+        return;
+
+    // establish the working bounds and a context:
+    Bounds bounds = baseQuery.bounds().isSet() ? *baseQuery.bounds() : extent.bounds();
+    FilterContext context( _session.get(), featureProfile, GeoExtent(featureProfile->getSRS(), bounds), index );
+
+    std::vector<StringExpression> styleExprs;
+    for(unsigned i=0; i<selectors.size(); ++i)
+        styleExprs.push_back( selectors[i]->styleExpression().getOrUse(StringExpression()) );
+
+    // visit each feature and sort it into a bin for each selector. Selectors
+    // without a style expression use a single bin (with an empty name).
+    std::vector< std::map<std::string, FeatureList> > styleBins( selectors.size() );
+    while( cursor->hasMore() )
+    {
+        osg::ref_ptr<Feature> feature = cursor->nextFeature();
+        if ( !feature.valid() )
+            continue;
+
+        bool used = false;
+        for(unsigned i=0; i<selectors.size(); ++i)
         {
-            const Style* selectedStyle = _session->styles()->getStyle(styleString, false);
-            if ( selectedStyle )
-                combinedStyle = *selectedStyle;
+            std::string styleString;
+            if ( selectors[i]->styleExpression().isSet() )
+            {
+                styleString = feature->eval( styleExprs[i], &context );
+                if ( styleString.empty() || styleString == "null" )
+                    continue;
+            }
+
+            // compiling modifies the features, so every bin after the first gets a copy.
+            styleBins[i][styleString].push_back( used ? new Feature(*feature.get()) : feature.get() );
+            used = true;
         }
+    }
+
+    // set up a compile job for each bin that resolves to a style.
+    CompileStyleGroup::Jobs jobs;
+    std::vector<unsigned> jobSelectors;
+    Threading::MultiEvent semaphore;
 
-        // if there is a valid style, create the node and add it. (Otherwise we will skip
-        // the feature.)
-        if ( !combinedStyle.empty() )
+    for(unsigned i=0; i<selectors.size(); ++i)
+    {
+        for( std::map<std::string,FeatureList>::iterator b = styleBins[i].begin(); b != styleBins[i].end(); ++b )
         {
-            osg::Group* styleGroup = createStyleGroup(combinedStyle, workingSet, context, readOptions);
-            if ( styleGroup )
-                parent->addChild( styleGroup );
+            Style style;
+            if ( selectors[i]->styleExpression().isSet() )
+            {
+                style = resolveStyleString( b->first, *selectors[i]->styleExpression() );
+            }
+            else
+            {
+                // combine the selection style with the incoming base style:
+                Style selectedStyle = *_session->styles()->getStyle( selectors[i]->getSelectedStyleName() );
+                style = defaultStyle.combineWith( selectedStyle );
+            }
+
+            if ( style.empty() )
+                continue;
+
+            ParallelTask<CompileStyleGroup>* job = new ParallelTask<CompileStyleGroup>( &semaphore );
+            job->_graph       = this;
+            job->_style       = style;
+            job->_context     = context;
+            job->_readOptions = readOptions;
+            job->_features.swap( b->second );
+            jobs.push_back( job );
+            jobSelectors.push_back( i );
         }
     }
+
+    CompileStyleGroup::run( jobs, semaphore );
+
+    for(unsigned j=0; j<jobs.size(); ++j)
+    {
+        if ( jobs[j]->_styleGroup.valid() )
+            output[jobSelectors[j]]->addChild( jobs[j]->_styleGroup.get() );
+    }
 }
 
 
@@ -1424,7 +1674,8 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
     if ( workingSet.size() > 0 )
     {
         osg::ref_ptr<osg::Node> node;
-        osg::ref_ptr<FeatureCursor> newCursor = new FeatureListCursor(workingSet);
+        // hand the features to the compiler instead of copying the list.
+        osg::ref_ptr<FeatureCursor> newCursor = new FeatureListCursor(workingSet, true);
 
         if ( createOrUpdateNode( newCursor.get(), style, context, readOptions, node ) )
         {
@@ -1456,7 +1707,8 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
     const GeoExtent& extent = featureProfile->getExtent();
     
     // query the feature source:
-    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createFeatureCursor( query );
+    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createCachedFeatureCursor( query, readOptions );
+    ++_sourceReads;
 
     if ( cursor.valid() && cursor->hasMore() )
     {
@@ -20,6 +20,7 @@
 #include <osgEarthFeatures/ResampleFilter>
 #include <osgEarthFeatures/BufferFilter>
 #include <osgEarthFeatures/ConvertTypeFilter>
+#include <osgEarthFeatures/FeatureTileCache>
 #include <osgEarth/Registry>
 #include <osg/Notify>
 #include <osgDB/ReadFile>
@@ -32,7 +33,8 @@ using namespace osgEarth::Symbology;
 using namespace OpenThreads;
 
 FeatureSourceOptions::FeatureSourceOptions(const ConfigOptions& options) :
-DriverConfigOptions( options )
+DriverConfigOptions( options ),
+_cacheFeatures     ( false )
 {
     fromConfig( _conf );
 }
@@ -54,6 +56,7 @@ FeatureSourceOptions::fromConfig(const Config& conf)
     conf.getIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.getIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
     conf.getIfSet   ( "fid_attribute", _fidAttribute );
+    conf.getIfSet   ( "cache_features", _cacheFeatures );
 
     // For backwards-compatibility (before adding the "filters" block)
     // TODO: Remove at some point in the distant future.
@@ -81,6 +84,7 @@ FeatureSourceOptions::getConfig() const
     conf.updateIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.updateIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
     conf.updateIfSet   ( "fid_attribute", _fidAttribute );
+    conf.updateIfSet   ( "cache_features", _cacheFeatures );
 
     if ( !_filterOptions.empty() )
     {
@@ -148,6 +152,52 @@ FeatureSource::getFeatureProfile() const
     return _featureProfile.get();
 }
 
+FeatureCursor*
+FeatureSource::createCachedFeatureCursor(const Symbology::Query& query,
+                                         const osgDB::Options*   readOptions)
+{
+    CacheSettings* cacheSettings = CacheSettings::get(readOptions);
+
+    if ( _options.cacheFeatures() == false ||
+         !cacheSettings ||
+         !cacheSettings->getCacheBin() ||
+         !getFeatureProfile() )
+    {
+        return createFeatureCursor( query );
+    }
+
+    Revision revision;
+    sync( revision );
+
+    FeatureTileCache cache( cacheSettings->getCacheBin(), cacheSettings->cachePolicy().get() );
+    std::string key = FeatureTileCache::makeKey( query, getSourceSignature(), revision );
+
+    FeatureList features;
+    if ( cache.read(key, getFeatureProfile()->getSRS(), features, readOptions) )
+    {
+        // the blacklist may have changed since the record was written.
+        for(FeatureList::iterator i = features.begin(); i != features.end(); )
+        {
+            if ( isBlacklisted(i->get()->getFID()) )
+                i = features.erase( i );
+            else
+                ++i;
+        }
+
+        OE_DEBUG << LC << "Read " << features.size() << " features from cache (key = " << key << ")\n";
+        return new FeatureListCursor( features, true );
+    }
+
+    osg::ref_ptr<FeatureCursor> cursor = createFeatureCursor( query );
+    if ( !cursor.valid() )
+        return 0L;
+
+    cursor->fill( features );
+    cache.write( key, features, readOptions );
+
+    return new FeatureListCursor( features, true );
+}
+
 const FeatureFilterList&
 FeatureSource::getFilters() const
 {
@@ -111,7 +111,11 @@ FeatureSourceIndexNode::tagDrawable(osg::Drawable* drawable, Feature* feature)
 {
     if ( !feature || !_index.valid() ) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagDrawable( drawable, feature );
-    if ( r ) _fids[ feature->getFID() ] = r;
+    if ( r )
+    {
+        Threading::ScopedMutexLock lock(_fidsMutex);
+        _fids[ feature->getFID() ] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -120,7 +124,11 @@ FeatureSourceIndexNode::tagAllDrawables(osg::Node* node, Feature* feature)
 {
     if ( !feature || !_index.valid() ) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagAllDrawables( node, feature );
-    if ( r ) _fids[ feature->getFID() ] = r;
+    if ( r )
+    {
+        Threading::ScopedMutexLock lock(_fidsMutex);
+        _fids[ feature->getFID() ] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -129,7 +137,11 @@ FeatureSourceIndexNode::tagNode(osg::Node* node, Feature* feature)
 {
     if ( !feature || !_index.valid() ) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagNode( node, feature );
-    if ( r ) _fids[ feature->getFID() ] = r;
+    if ( r )
+    {
+        Threading::ScopedMutexLock lock(_fidsMutex);
+        _fids[ feature->getFID() ] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -186,7 +198,6 @@ namespace
     struct ReIndex : public osg::NodeVisitor
     {
         FeatureSourceIndexNode*        _indexNode;
-        FeatureSourceIndexNode::FIDMap _newFIDMap;
         std::map<ObjectID,ObjectID>&   _oldToNew;
 
         ReIndex(FeatureSourceIndexNode* indexNode, std::map<ObjectID,ObjectID>& oldToNew) :
@@ -198,16 +209,16 @@ namespace
 
         void apply(osg::Node& node)
         {
-            _indexNode->reIndexNode(&node, _oldToNew, _newFIDMap);
+            _indexNode->reIndexNode(&node, _oldToNew);
             traverse(node);
         }
 
         void apply(osg::Geode& geode)
         {
-            _indexNode->reIndexNode(&geode, _oldToNew, _newFIDMap);
+            _indexNode->reIndexNode(&geode, _oldToNew);
             for (unsigned i = 0; i < geode.getNumDrawables(); ++i)
             {
-                _indexNode->reIndexDrawable(geode.getDrawable(i), _oldToNew, _newFIDMap);
+                _indexNode->reIndexDrawable(geode.getDrawable(i), _oldToNew);
             }
             traverse(geode);
         }
@@ -232,24 +243,29 @@ FeatureSourceIndexNode::reIndex(std::map<ObjectID,ObjectID>& oidmappings)
 {
     ReIndex visitor(this, oidmappings);
     this->accept(visitor);
-    _fids = visitor._newFIDMap;
+
+    // one pass over this node's features once all its object IDs are replaced
+    FIDMap newFIDMap;
+    if ( _index.valid() )
+        _index->remap(oidmappings, _fids, newFIDMap);
+    _fids.swap(newFIDMap);
     //OE_INFO << LC << "Reindexed " << _fids.size() << " mappings\n";
 }
 
 void
-FeatureSourceIndexNode::reIndexDrawable(osg::Drawable* drawable, std::map<ObjectID,ObjectID>& oldNew, FIDMap& newFIDMap)
+FeatureSourceIndexNode::reIndexDrawable(osg::Drawable* drawable, std::map<ObjectID,ObjectID>& oldNew)
 {
     if ( !drawable || !_index.valid() ) return;
 
-    _index->update(drawable, oldNew, _fids, newFIDMap);
+    _index->update(drawable, oldNew);
 }
 
 void
-FeatureSourceIndexNode::reIndexNode(osg::Node* node, std::map<ObjectID,ObjectID>& oldNew, FIDMap& newFIDMap)
+FeatureSourceIndexNode::reIndexNode(osg::Node* node, std::map<ObjectID,ObjectID>& oldNew)
 {
     if (!node || !_index.valid()) return;
 
-    _index->update(node, oldNew, _fids, newFIDMap);
+    _index->update(node, oldNew);
 }
 
 FeatureSourceIndexNode* FeatureSourceIndexNode::get(osg::Node* graph)
@@ -508,61 +524,39 @@ FeatureSourceIndex::getObjectID(FeatureID fid) const
 }
 
 // When Feature index data is deserialized, the old serialized ObjectIDs are 
-// no longer valid. This method will re-install the mappings in the master index
-// and write new local mappings with new ObjectIDs.
+// no longer valid. These methods re-install the objects in the master index
+// and record the old-to-new ObjectID mappings; remap() then rewrites the
+// local FID mappings.
 void
-FeatureSourceIndex::update(osg::Drawable* drawable, std::map<ObjectID,ObjectID>& oldToNew, const FIDMap& oldFIDMap, FIDMap& newFIDMap)
+FeatureSourceIndex::update(osg::Drawable* drawable, std::map<ObjectID,ObjectID>& oldToNew)
 {
-    unsigned count = 0;
-    if (_masterIndex->updateObjectIDs(drawable, oldToNew, this))
-    {
-        for (std::map<ObjectID, ObjectID>::const_iterator i = oldToNew.begin(); i != oldToNew.end(); ++i)
-        {
-            const ObjectID& oldoid = i->first;
-            const ObjectID& newoid = i->second;
+    _masterIndex->updateObjectIDs(drawable, oldToNew, this);
+}
 
-            for (FIDMap::const_iterator j = oldFIDMap.begin(); j != oldFIDMap.end(); ++j)
-            {
-                const RefIDPair* rip = j->second.get();
-                if (rip && rip->_oid == oldoid)
-                {
-                    RefIDPair* newrip = new RefIDPair(rip->_fid, newoid);
-                    _oids[newoid] = rip->_fid;
-                    _fids[rip->_fid] = newrip;
-                    newFIDMap[rip->_fid] = newrip;
-                    ++count;
-                }
-            }
-        }
-    }
+void
+FeatureSourceIndex::update(osg::Node* node, std::map<ObjectID,ObjectID>& oldToNew)
+{
+    _masterIndex->updateObjectID(node, oldToNew, this);
 }
 
-// When Feature index data is deserialized, the old serialized ObjectIDs are 
-// no longer valid. This method will re-install the mappings in the master index
-// and write new local mappings with new ObjectIDs.
 void
-FeatureSourceIndex::update(osg::Node* node, std::map<ObjectID,ObjectID>& oldToNew, const FIDMap& oldFIDMap, FIDMap& newFIDMap)
+FeatureSourceIndex::remap(const std::map<ObjectID,ObjectID>& oldToNew, const FIDMap& oldFIDMap, FIDMap& newFIDMap)
 {
-    unsigned count = 0;
-    if (_masterIndex->updateObjectID(node, oldToNew, this))
+    Threading::ScopedMutexLock lock(_mutex);
+
+    for (FIDMap::const_iterator j = oldFIDMap.begin(); j != oldFIDMap.end(); ++j)
     {
-        for (std::map<ObjectID, ObjectID>::const_iterator i = oldToNew.begin(); i != oldToNew.end(); ++i)
-        {
-            const ObjectID& oldoid = i->first;
-            const ObjectID& newoid = i->second;
+        const RefIDPair* rip = j->second.get();
+        if ( !rip )
+            continue;
 
-            for (FIDMap::const_iterator j = oldFIDMap.begin(); j != oldFIDMap.end(); ++j)
-            {
-                const RefIDPair* rip = j->second.get();
-                if (rip && rip->_oid == oldoid)
-                {
-                    RefIDPair* newrip = new RefIDPair(rip->_fid, newoid);
-                    _oids[newoid] = rip->_fid;
-                    _fids[rip->_fid] = newrip;
-                    newFIDMap[rip->_fid] = newrip;
-                    ++count;
-                }
-            }
+        std::map<ObjectID, ObjectID>::const_iterator i = oldToNew.find(rip->_oid);
+        if ( i != oldToNew.end() )
+        {
+            RefIDPair* newrip = new RefIDPair(rip->_fid, i->second);
+            _oids[i->second] = rip->_fid;
+            _fids[rip->_fid] = newrip;
+            newFIDMap[rip->_fid] = newrip;
         }
     }
 }
@@ -0,0 +1,584 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureTileCache>
+#include <osgEarth/StringUtils>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#define LC "[FeatureTileCache] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+// Record layout (all offsets relative to the start of the record):
+//
+//   "OEFT" version:u8 littleEndian:u8
+//   numSchema:varint { name:string type:u8 }*
+//   numFeatures:varint
+//   numCoords:varint
+//   <padding to 8 bytes>
+//   coords: numCoords * (x,y,z) doubles
+//   { fid:varint geometry numAttrs:varint { schema:varint set:u8 value }* flags:u8 [style:string] [interp:u8] }*
+//
+// A geometry is type:u8 followed by its structure; its points are taken in
+// order from the coordinate buffer:
+//   multi:   numParts:varint part*
+//   polygon: numPoints:varint numHoles:varint { numPoints:varint }*
+//   other:   numPoints:varint
+//
+// Strings are length:varint + bytes, ints are zigzag varints, doubles are raw.
+
+#define RECORD_VERSION 1
+
+namespace
+{
+    const char RECORD_MAGIC[4] = { 'O', 'E', 'F', 'T' };
+
+    enum
+    {
+        FLAG_STYLE  = 1 << 0,
+        FLAG_INTERP = 1 << 1
+    };
+
+    bool isLittleEndian()
+    {
+        const unsigned short one = 1;
+        return *reinterpret_cast<const unsigned char*>(&one) == 1;
+    }
+
+    // encoding ...........................................................
+
+    struct Writer
+    {
+        std::string& _buf;
+        Writer(std::string& buf) : _buf(buf) { }
+
+        void u8(unsigned value)
+        {
+            _buf.push_back( (char)(value & 0xff) );
+        }
+
+        void varint(unsigned long long value)
+        {
+            while( value >= 0x80 )
+            {
+                _buf.push_back( (char)((value & 0x7f) | 0x80) );
+                value >>= 7;
+            }
+            _buf.push_back( (char)value );
+        }
+
+        void zigzag(long long value)
+        {
+            varint( (unsigned long long)((value << 1) ^ (value >> 63)) );
+        }
+
+        void real(double value)
+        {
+            _buf.append( reinterpret_cast<const char*>(&value), sizeof(double) );
+        }
+
+        void string(const std::string& value)
+        {
+            varint( value.size() );
+            _buf.append( value );
+        }
+    };
+
+    typedef std::pair<std::string, AttributeType> SchemaEntry;
+
+    struct Encoder
+    {
+        std::vector<SchemaEntry>           _schema;
+        std::map<SchemaEntry, unsigned>    _schemaIndex;
+        std::vector<double>                _coords;
+        std::string                        _body;
+        Writer                             _out;
+
+        Encoder() : _out(_body) { }
+
+        unsigned intern(const std::string& name, AttributeType type)
+        {
+            SchemaEntry entry(name, type);
+            std::map<SchemaEntry, unsigned>::const_iterator i = _schemaIndex.find(entry);
+            if ( i != _schemaIndex.end() )
+                return i->second;
+
+            unsigned index = _schema.size();
+            _schema.push_back( entry );
+            _schemaIndex[entry] = index;
+            return index;
+        }
+
+        void points(const Geometry* geom)
+        {
+            _out.varint( geom->size() );
+            for(Geometry::const_iterator p = geom->begin(); p != geom->end(); ++p)
+            {
+                _coords.push_back( p->x() );
+                _coords.push_back( p->y() );
+                _coords.push_back( p->z() );
+            }
+        }
+
+        void geometry(const Geometry* geom)
+        {
+            if ( !geom )
+            {
+                _out.u8( Geometry::TYPE_UNKNOWN );
+                return;
+            }
+
+            _out.u8( geom->getType() );
+
+            if ( geom->getType() == Geometry::TYPE_MULTI )
+            {
+                const GeometryCollection& parts = static_cast<const MultiGeometry*>(geom)->getComponents();
+                _out.varint( parts.size() );
+                for(GeometryCollection::const_iterator i = parts.begin(); i != parts.end(); ++i)
+                    geometry( i->get() );
+            }
+            else if ( geom->getType() == Geometry::TYPE_POLYGON )
+            {
+                const Polygon* poly = static_cast<const Polygon*>(geom);
+                points( poly );
+                _out.varint( poly->getHoles().size() );
+                for(RingCollection::const_iterator i = poly->getHoles().begin(); i != poly->getHoles().end(); ++i)
+                    points( i->get() );
+            }
+            else
+            {
+                points( geom );
+            }
+        }
+
+        void feature(const Feature* f)
+        {
+            _out.varint( f->getFID() );
+
+            geometry( f->getGeometry() );
+
+            const AttributeTable& attrs = f->getAttrs();
+            _out.varint( attrs.size() );
+            for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+            {
+                const AttributeValue& value = a->second;
+                _out.varint( intern(a->first, value.first) );
+                _out.u8( value.second.set ? 1 : 0 );
+                if ( !value.second.set )
+                    continue;
+
+                switch( value.first )
+                {
+                case ATTRTYPE_INT:    _out.zigzag( value.second.intValue ); break;
+                case ATTRTYPE_DOUBLE: _out.real( value.second.doubleValue ); break;
+                case ATTRTYPE_BOOL:   _out.u8( value.second.boolValue ? 1 : 0 ); break;
+                default:              _out.string( value.second.stringValue ); break;
+                }
+            }
+
+            unsigned flags = 0;
+            if ( f->style().isSet() )     flags |= FLAG_STYLE;
+            if ( f->geoInterp().isSet() ) flags |= FLAG_INTERP;
+            _out.u8( flags );
+
+            if ( flags & FLAG_STYLE )
+                _out.string( f->style()->getConfig().toJSON(false) );
+
+            if ( flags & FLAG_INTERP )
+                _out.u8( f->geoInterp().get() );
+        }
+    };
+
+    // decoding ...........................................................
+
+    struct Reader
+    {
+        const char* _ptr;
+        const char* _end;
+        bool        _ok;
+
+        Reader(const char* ptr, const char* end) : _ptr(ptr), _end(end), _ok(true) { }
+
+        bool has(unsigned long long bytes)
+        {
+            if ( _ok && (unsigned long long)(_end - _ptr) >= bytes )
+                return true;
+            _ok = false;
+            return false;
+        }
+
+        unsigned u8()
+        {
+            return has(1) ? (unsigned char)*_ptr++ : 0u;
+        }
+
+        unsigned long long varint()
+        {
+            unsigned long long value = 0;
+            for(unsigned shift = 0; shift < 64 && has(1); shift += 7)
+            {
+                unsigned char b = (unsigned char)*_ptr++;
+                value |= (unsigned long long)(b & 0x7f) << shift;
+                if ( (b & 0x80) == 0 )
+                    return value;
+            }
+            _ok = false;
+            return 0;
+        }
+
+        long long zigzag()
+        {
+            unsigned long long value = varint();
+            return (long long)(value >> 1) ^ -(long long)(value & 1);
+        }
+
+        double real()
+        {
+            double value = 0.0;
+            if ( has(sizeof(double)) )
+            {
+                ::memcpy( &value, _ptr, sizeof(double) );
+                _ptr += sizeof(double);
+            }
+            return value;
+        }
+
+        std::string string()
+        {
+            unsigned long long len = varint();
+            if ( !has(len) )
+                return std::string();
+            std::string value(_ptr, (size_t)len);
+            _ptr += len;
+            return value;
+        }
+    };
+
+    struct Decoder
+    {
+        Reader                   _in;
+        std::vector<SchemaEntry> _schema;
+        const char*              _coords;
+        unsigned long long       _numCoords;
+        unsigned long long       _nextCoord;
+
+        Decoder(const char* ptr, const char* end) : _in(ptr, end), _coords(0L), _numCoords(0), _nextCoord(0) { }
+
+        bool points(Geometry* geom)
+        {
+            unsigned long long count = _in.varint();
+            if ( !_in._ok || count > _numCoords - _nextCoord )
+            {
+                _in._ok = false;
+                return false;
+            }
+
+            geom->resize( (size_t)count );
+            if ( count > 0 )
+            {
+                // osg::Vec3d is three packed doubles, same as the buffer.
+                ::memcpy( &(*geom)[0], _coords + _nextCoord*sizeof(osg::Vec3d), (size_t)count*sizeof(osg::Vec3d) );
+            }
+            _nextCoord += count;
+            return true;
+        }
+
+        // Returns NULL for an empty geometry. Any other failure, including
+        // one in a nested part, also clears _in._ok so the record fails.
+        Geometry* geometry(unsigned depth)
+        {
+            unsigned type = _in.u8();
+            if ( !_in._ok || type == Geometry::TYPE_UNKNOWN )
+                return 0L;
+
+            osg::ref_ptr<Geometry> geom;
+
+            if ( type == Geometry::TYPE_MULTI )
+            {
+                if ( depth > 16 )
+                {
+                    _in._ok = false;
+                    return 0L;
+                }
+
+                MultiGeometry* multi = new MultiGeometry();
+                geom = multi;
+                unsigned long long numParts = _in.varint();
+                for(unsigned long long i = 0; i < numParts && _in._ok; ++i)
+                {
+                    Geometry* part = geometry(depth+1);
+                    if ( part )
+                        multi->add( part );
+                }
+            }
+            else if ( type == Geometry::TYPE_POLYGON )
+            {
+                Polygon* poly = new Polygon();
+                geom = poly;
+                if ( !points(poly) )
+                    return 0L;
+
+                unsigned long long numHoles = _in.varint();
+                for(unsigned long long i = 0; i < numHoles && _in._ok; ++i)
+                {
+                    osg::ref_ptr<Ring> hole = new Ring();
+                    if ( !points(hole.get()) )
+                        return 0L;
+                    poly->getHoles().push_back( hole.get() );
+                }
+            }
+            else if ( type == Geometry::TYPE_POINTSET || type == Geometry::TYPE_LINESTRING || type == Geometry::TYPE_RING )
+            {
+                geom =
+                    type == Geometry::TYPE_POINTSET   ? (Geometry*)new PointSet() :
+                    type == Geometry::TYPE_LINESTRING ? (Geometry*)new LineString() :
+                                                        (Geometry*)new Ring();
+                if ( !points(geom.get()) )
+                    return 0L;
+            }
+            else
+            {
+                _in._ok = false;
+                return 0L;
+            }
+
+            return _in._ok ? geom.release() : 0L;
+        }
+
+        Feature* feature(const SpatialReference* srs)
+        {
+            FeatureID fid = (FeatureID)_in.varint();
+
+            osg::ref_ptr<Feature> f = new Feature( geometry(0), srs, Style(), fid );
+            if ( !_in._ok )
+                return 0L;
+
+            unsigned long long numAttrs = _in.varint();
+            for(unsigned long long i = 0; i < numAttrs && _in._ok; ++i)
+            {
+                unsigned long long index = _in.varint();
+                if ( index >= _schema.size() )
+                {
+                    _in._ok = false;
+                    break;
+                }
+
+                const SchemaEntry& entry = _schema[(size_t)index];
+                if ( _in.u8() == 0 )
+                {
+                    f->setNull( entry.first, entry.second );
+                    continue;
+                }
+
+                AttributeValue value;
+                value.first = entry.second;
+                value.second.set = true;
+                switch( entry.second )
+                {
+                case ATTRTYPE_INT:    value.second.intValue    = (int)_in.zigzag(); break;
+                case ATTRTYPE_DOUBLE: value.second.doubleValue = _in.real(); break;
+                case ATTRTYPE_BOOL:   value.second.boolValue   = _in.u8() != 0; break;
+                default:              value.second.stringValue = _in.string(); break;
+                }
+                f->set( entry.first, value );
+            }
+
+            unsigned flags = _in.u8();
+
+            if ( flags & FLAG_STYLE )
+            {
+                Config conf;
+                if ( conf.fromJSON(_in.string()) )
+                    f->style() = Style(conf);
+            }
+
+            if ( flags & FLAG_INTERP )
+                f->geoInterp() = (GeoInterpolation)_in.u8();
+
+            return _in._ok ? f.release() : 0L;
+        }
+    };
+}
+
+//------------------------------------------------------------------------
+
+FeatureTileCache::FeatureTileCache(CacheBin* bin, const CachePolicy& policy) :
+_bin   ( bin ),
+_policy( policy )
+{
+    //nop
+}
+
+std::string
+FeatureTileCache::makeKey(const Query&        query,
+                          const std::string&  sourceSignature,
+                          int                 sourceRevision)
+{
+    // Query::getConfig() does not include the tile key.
+    std::string q = query.getConfig().toJSON(false);
+    if ( query.tileKey().isSet() )
+        q += query.tileKey()->str();
+
+    return Stringify()
+        << "features/" << hashToString(q)
+        << "_" << hashToString(sourceSignature)
+        << "_" << sourceRevision;
+}
+
+bool
+FeatureTileCache::read(const std::string&      key,
+                       const SpatialReference* srs,
+                       FeatureList&            output,
+                       const osgDB::Options*   readOptions) const
+{
+    if ( !_bin.valid() || !_policy.isCacheReadable() )
+        return false;
+
+    ReadResult rr = _bin->readString(key, readOptions);
+    if ( !rr.succeeded() )
+        return false;
+
+    if ( _policy.isExpired(rr.lastModifiedTime()) )
+    {
+        OE_DEBUG << LC << "Record " << key << " is cached but expired\n";
+        return false;
+    }
+
+    const std::string& data = rr.getString();
+    if ( !decode(data.data(), data.size(), srs, output) )
+    {
+        OE_WARN << LC << "Record " << key << " in cache bin [" << _bin->getID() << "] is invalid\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool
+FeatureTileCache::write(const std::string&    key,
+                        const FeatureList&    features,
+                        const osgDB::Options* writeOptions) const
+{
+    if ( !_bin.valid() || !_policy.isCacheWriteable() )
+        return false;
+
+    osg::ref_ptr<StringObject> record = new StringObject();
+    std::string buffer;
+    encode( features, buffer );
+    record->setString( buffer );
+
+    return _bin->write(key, record.get(), Config(), writeOptions);
+}
+
+void
+FeatureTileCache::encode(const FeatureList& features, std::string& buffer)
+{
+    Encoder encoder;
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        if ( i->valid() )
+            encoder.feature( i->get() );
+    }
+
+    unsigned start = buffer.size();
+    Writer out(buffer);
+
+    buffer.append( RECORD_MAGIC, sizeof(RECORD_MAGIC) );
+    out.u8( RECORD_VERSION );
+    out.u8( isLittleEndian() ? 1 : 0 );
+
+    out.varint( encoder._schema.size() );
+    for(std::vector<SchemaEntry>::const_iterator i = encoder._schema.begin(); i != encoder._schema.end(); ++i)
+    {
+        out.string( i->first );
+        out.u8( i->second );
+    }
+
+    unsigned numFeatures = 0;
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+        if ( i->valid() ) ++numFeatures;
+    out.varint( numFeatures );
+
+    out.varint( encoder._coords.size()/3 );
+
+    // align the coordinate buffer so a mapped record can be read in place.
+    while( (buffer.size() - start) % sizeof(double) != 0 )
+        out.u8( 0 );
+
+    if ( !encoder._coords.empty() )
+        buffer.append( reinterpret_cast<const char*>(&encoder._coords[0]), encoder._coords.size()*sizeof(double) );
+
+    buffer.append( encoder._body );
+}
+
+bool
+FeatureTileCache::decode(const char*             data,
+                         unsigned                size,
+                         const SpatialReference* srs,
+                         FeatureList&            output)
+{
+    Decoder decoder( data, data + size );
+    Reader& in = decoder._in;
+
+    if ( !in.has(sizeof(RECORD_MAGIC)) || ::memcmp(data, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0 )
+        return false;
+    in._ptr += sizeof(RECORD_MAGIC);
+
+    if ( in.u8() != RECORD_VERSION )
+        return false;
+
+    // records are written in native byte order.
+    if ( in.u8() != (isLittleEndian() ? 1u : 0u) )
+        return false;
+
+    unsigned long long numSchema = in.varint();
+    for(unsigned long long i = 0; i < numSchema && in._ok; ++i)
+    {
+        std::string name = in.string();
+        AttributeType type = (AttributeType)in.u8();
+        decoder._schema.push_back( SchemaEntry(name, type) );
+    }
+
+    unsigned long long numFeatures = in.varint();
+    decoder._numCoords = in.varint();
+
+    while( in._ok && (in._ptr - data) % sizeof(double) != 0 )
+        in.u8();
+
+    if ( !in._ok || decoder._numCoords > size / sizeof(osg::Vec3d) || !in.has(decoder._numCoords * sizeof(osg::Vec3d)) )
+        return false;
+
+    decoder._coords = in._ptr;
+    in._ptr += decoder._numCoords * sizeof(osg::Vec3d);
+
+    FeatureList features;
+    for(unsigned long long i = 0; i < numFeatures; ++i)
+    {
+        Feature* f = decoder.feature(srs);
+        if ( !f )
+            return false;
+        features.push_back( f );
+    }
+
+    output.splice( output.end(), features );
+    return true;
+}
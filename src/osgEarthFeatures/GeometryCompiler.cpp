@@ -33,11 +33,13 @@
 #include <osgEarth/Capabilities>
 #include <osgEarth/ShaderGenerator>
 #include <osgEarth/ShaderUtils>
+#include <osgEarth/ThreadingUtils>
 #include <osgEarth/Utils>
 #include <osg/MatrixTransform>
 #include <osg/Timer>
 #include <osgDB/WriteFile>
 #include <osgUtil/Optimizer>
+#include <set>
 
 
 #define LC "[GeometryCompiler] "
@@ -71,7 +73,8 @@ _geoInterp             ( GEOINTERP_GREAT_CIRCLE ),
 _optimizeStateSharing  ( true ),
 _optimize              ( false ),
 _validate              ( false ),
-_maxPolyTilingAngle    ( 45.0f )
+_maxPolyTilingAngle    ( 45.0f ),
+_collectStats          ( false )
 {
    //nop
 }
@@ -91,7 +94,8 @@ _geoInterp             ( s_defaults.geoInterp().value() ),
 _optimizeStateSharing  ( s_defaults.optimizeStateSharing().value() ),
 _optimize              ( s_defaults.optimize().value() ),
 _validate              ( s_defaults.validate().value() ),
-_maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() )
+_maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() ),
+_collectStats          ( s_defaults.collectStats().value() )
 {
     fromConfig(_conf);
 }
@@ -112,6 +116,7 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.getIfSet   ( "optimize", _optimize );
     conf.getIfSet   ( "validate", _validate );
     conf.getIfSet   ( "max_polygon_tiling_angle", _maxPolyTilingAngle );
+    conf.getIfSet   ( "collect_stats", _collectStats );
 
     conf.getIfSet( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.getIfSet( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -135,6 +140,7 @@ GeometryCompilerOptions::getConfig() const
     conf.addIfSet   ( "optimize", _optimize );
     conf.addIfSet   ( "validate", _validate );
     conf.addIfSet   ( "max_polygon_tiling_angle", _maxPolyTilingAngle );
+    conf.addIfSet   ( "collect_stats", _collectStats );
 
     conf.addIfSet( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.addIfSet( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -151,6 +157,111 @@ GeometryCompilerOptions::mergeConfig( const Config& conf )
 
 //-----------------------------------------------------------------------
 
+namespace
+{
+    // Pass over the input, for the stats.
+    void countInput(const FeatureList& features, GeometryCompiler::Stats& stats)
+    {
+        for(FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
+        {
+            ++stats._features;
+
+            const Geometry* geom = f->get()->getGeometry();
+            if ( geom )
+            {
+                ConstGeometryIterator parts( geom, true );
+                while( parts.hasMore() )
+                {
+                    ++stats._parts;
+                    stats._points += parts.next()->size();
+                }
+            }
+        }
+    }
+
+    // Counts what the filters left in the output graph. This counts objects,
+    // not the heap allocations made (and freed) while building them.
+    struct CountOutputVisitor : public osg::NodeVisitor
+    {
+        CountOutputVisitor(GeometryCompiler::Stats& stats) :
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _stats          (stats) { }
+
+        void apply(osg::Node& node)
+        {
+            ++_stats._objects;
+            count( node.getStateSet() );
+            traverse( node );
+        }
+
+        void apply(osg::Geode& geode)
+        {
+            ++_stats._objects;
+            count( geode.getStateSet() );
+
+            for(unsigned i=0; i<geode.getNumDrawables(); ++i)
+            {
+                osg::Drawable* drawable = geode.getDrawable(i);
+                ++_stats._drawables;
+                ++_stats._objects;
+                count( drawable->getStateSet() );
+
+                osg::Geometry* geom = drawable->asGeometry();
+                if ( geom )
+                {
+                    if ( geom->getVertexArray() )
+                        _stats._vertices += geom->getVertexArray()->getNumElements();
+
+                    count( geom->getVertexArray() );
+                    count( geom->getNormalArray() );
+                    count( geom->getColorArray() );
+                    count( geom->getSecondaryColorArray() );
+                    count( geom->getFogCoordArray() );
+                    for(unsigned t=0; t<geom->getNumTexCoordArrays(); ++t)
+                        count( geom->getTexCoordArray(t) );
+                    for(unsigned a=0; a<geom->getNumVertexAttribArrays(); ++a)
+                        count( geom->getVertexAttribArray(a) );
+
+                    _stats._objects += geom->getNumPrimitiveSets();
+                }
+            }
+
+            traverse( geode );
+        }
+
+        // state sets and arrays may be shared, so only count each once.
+        void count(const osg::Object* object)
+        {
+            if ( object && _seen.insert(object).second )
+                ++_stats._objects;
+        }
+
+        GeometryCompiler::Stats&     _stats;
+        std::set<const osg::Object*> _seen;
+    };
+
+    // Running totals of the compile stats. Each compile gathers its own
+    // Stats and merges them here once, when it finishes, so the lock is
+    // taken once per compile for a few additions.
+    Threading::Mutex        s_totalsMutex;
+    GeometryCompiler::Stats s_totals;
+
+    GeometryCompiler::AllocationCounter s_allocationCounter = 0L;
+}
+
+void
+GeometryCompiler::setAllocationCounter(AllocationCounter counter)
+{
+    s_allocationCounter = counter;
+}
+
+GeometryCompiler::Stats
+GeometryCompiler::getTotalStats()
+{
+    Threading::ScopedMutexLock lock( s_totalsMutex );
+    return s_totals;
+}
+
 GeometryCompiler::GeometryCompiler()
 {
     //nop
@@ -221,11 +332,22 @@ GeometryCompiler::compile(FeatureList&          workingSet,
                           const Style&          style,
                           const FilterContext&  context)
 {
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
+    _stats = Stats();
+
 #ifdef PROFILING
-    osg::Timer_t p_start = osg::Timer::instance()->tick();
-    unsigned p_features = workingSet.size();
+    bool collectStats = true;
+#else
+    bool collectStats = (_options.collectStats() == true);
 #endif
 
+    // the allocations made by the stats passes themselves are not counted.
+    AllocationCounter allocationCounter = collectStats ? s_allocationCounter : 0L;
+    if ( collectStats )
+        countInput( workingSet, _stats );
+    unsigned long long allocationsBefore = allocationCounter ? allocationCounter() : 0ull;
+
     // for debugging/validation.
     std::vector<std::string> history;
     bool trackHistory = (_options.validate() == true);
@@ -596,18 +718,30 @@ GeometryCompiler::compile(FeatureList&          workingSet,
     //test: dump the tile to disk
     //osgDB::writeNodeFile( *(resultGroup.get()), "out.osg" );
 
+    if ( allocationCounter )
+        _stats._allocations = (unsigned)(allocationCounter() - allocationsBefore);
+
+    if ( collectStats )
+    {
+        CountOutputVisitor countOutput( _stats );
+        resultGroup->accept( countOutput );
+    }
+    _stats._seconds = osg::Timer::instance()->delta_s(startTime, osg::Timer::instance()->tick());
+
+    {
+        Threading::ScopedMutexLock lock( s_totalsMutex );
+        s_totals += _stats;
+    }
+
 #ifdef PROFILING
-    static double totalTime = 0.0;
-    static Threading::Mutex totalTimeMutex;
-    osg::Timer_t p_end = osg::Timer::instance()->tick();
-    double t = osg::Timer::instance()->delta_s(p_start, p_end);
-    totalTimeMutex.lock();
-    totalTime += t;
-    totalTimeMutex.unlock();
+    Stats totals = getTotalStats();
     OE_INFO << LC
-        << "features = " << p_features
-        << ", time = " << t << " s.  cummulative = " 
-        << totalTime << " s."
+        << "features = " << _stats._features
+        << ", objects = " << _stats._objects
+        << ", allocations = " << _stats._allocations
+        << ", time = " << _stats._seconds << " s.  cummulative = " 
+        << totals._seconds << " s., " << totals._objects << " objects, "
+        << totals._allocations << " allocations."
         << std::endl;
 #endif
 
@@ -18,6 +18,7 @@
  */
 #include <osgEarthFeatures/TransformFilter>
 #include <osg/ClusterCullingCallback>
+#include <algorithm>
 
 #define LC "[TransformFilter] "
 
@@ -121,11 +122,74 @@ TransformFilter::push( FeatureList& input, FilterContext& incx )
 {
     _bbox = osg::BoundingBoxd();
 
-    // first transform all the points into the output SRS, collecting a bounding box as we go:
-    bool ok = true;
-    for( FeatureList::iterator i = input.begin(); i != input.end(); i++ )
-        if ( !push( i->get(), incx ) )
-            ok = false;
+    bool needsSRSXform =
+        _outputSRS.valid() &&
+        ( ! incx.profile()->getSRS()->isEquivalentTo( _outputSRS.get() ) );
+
+    bool needsMatrixXform = !_mat.isIdentity();
+
+    // first transform all the points into the output SRS, collecting a bounding box as we go.
+    // Gather the points of all the features so the SRS transformation runs once, over one
+    // long array, instead of once per geometry part.
+    if ( needsSRSXform || _localize || needsMatrixXform )
+    {
+        std::vector<Geometry*> parts;
+        unsigned numPoints = 0;
+        for( FeatureList::iterator i = input.begin(); i != input.end(); i++ )
+        {
+            if ( i->valid() && i->get()->getGeometry() )
+            {
+                GeometryIterator iter( i->get()->getGeometry() );
+                while( iter.hasMore() )
+                {
+                    Geometry* geom = iter.next();
+                    parts.push_back( geom );
+                    numPoints += geom->size();
+                }
+            }
+        }
+
+        std::vector<osg::Vec3d> points;
+        points.reserve( numPoints );
+        for( unsigned p=0; p<parts.size(); ++p )
+        {
+            Geometry* geom = parts[p];
+            for( unsigned i=0; i < geom->size(); ++i )
+                points.push_back( needsMatrixXform ? (*geom)[i] * _mat : (*geom)[i] );
+        }
+
+        // if the batch fails, retry part by part so one bad point only spoils its own part.
+        bool batchFailed =
+            needsSRSXform &&
+            !incx.profile()->getSRS()->transform( points, _outputSRS.get() );
+
+        unsigned k = 0;
+        for( unsigned p=0; p<parts.size(); ++p )
+        {
+            Geometry* geom = parts[p];
+            if ( batchFailed )
+            {
+                // start over from the untouched geometry, since a failed
+                // transform may have changed some of the points.
+                std::vector<osg::Vec3d> partPoints;
+                partPoints.reserve( geom->size() );
+                for( unsigned i=0; i < geom->size(); ++i )
+                    partPoints.push_back( needsMatrixXform ? (*geom)[i] * _mat : (*geom)[i] );
+
+                incx.profile()->getSRS()->transform( partPoints, _outputSRS.get() );
+                std::copy( partPoints.begin(), partPoints.end(), points.begin()+k );
+            }
+
+            for( unsigned i=0; i < geom->size(); ++i, ++k )
+            {
+                (*geom)[i] = points[k];
+
+                // update the bounding box.
+                if ( _localize )
+                    _bbox.expandBy( points[k] );
+            }
+        }
+    }
 
     FilterContext outcx( incx );
 
@@ -84,7 +84,8 @@ CssUtils::readConfig( const std::string& css, const std::string& referrer, Confi
         const std::string& name = blocks[i++];
         if ( i < blocks.size() )
         {
-            Config elementConf( name );
+            output.push_back( Config(name) );
+            Config& elementConf = output.back();
             elementConf.setReferrer( referrer );
 
             StringVector propSet;
@@ -100,8 +101,6 @@ CssUtils::readConfig( const std::string& css, const std::string& referrer, Confi
                     elementConf.set( prop[0], prop[1] );
                 }
             }
-
-            output.push_back( elementConf );
         }
     }
 }
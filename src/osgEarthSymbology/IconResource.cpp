@@ -20,6 +20,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/ImageCache>
 #include <osgEarth/Capabilities>
 
 #include <osg/AutoTransform>
@@ -144,7 +145,7 @@ IconResource::createNodeFromURI( const URI& uri, const osgDB::Options* dbOptions
 {
     osg::Node* node = 0L;
 
-    ReadResult r = uri.readImage( dbOptions );
+    ReadResult r = ImageCache::readSharedImage( uri, dbOptions );
     if ( r.succeeded() )
     {
         OE_INFO << LC << "Loaded " << uri.base() << "(from " << (r.isFromCache()? "cache" : "source") << ")"
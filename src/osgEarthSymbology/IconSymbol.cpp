@@ -21,6 +21,7 @@
 #include <osgEarthSymbology/Style>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/ImageCache>
 #include <osgEarth/ImageUtils>
 #include <osgDB/Options>
 
@@ -112,7 +113,7 @@ IconSymbol::getImage( unsigned maxSize ) const
         {
             osg::ref_ptr<osgDB::Options> dbOptions = Registry::instance()->cloneOrCreateOptions();
             dbOptions->setObjectCacheHint( osgDB::Options::CACHE_IMAGES );
-            _image = _url->evalURI().getImage( dbOptions.get() );
+            _image = ImageCache::readSharedImage( _url->evalURI(), dbOptions.get() ).getImage();
             if ( _image.valid() && (maxSize < (unsigned int)_image->s() || maxSize < (unsigned int)_image->t()) )
             {
                 unsigned new_s, new_t;
@@ -21,6 +21,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/ImageCache>
 
 #include <osg/BlendFunc>
 #include <osg/Texture2D>
@@ -220,11 +221,11 @@ SkinResource::createImage( const osgDB::Options* dbOptions ) const
     {
         osg::ref_ptr<osgDB::Options> ro = Registry::cloneOrCreateOptions(dbOptions);
         ro->setOptionString(Stringify() << _readOptions.get() << " " << ro->getOptionString());
-        result = _imageURI->readImage(ro.get());
+        result = ImageCache::readSharedImage(_imageURI.get(), ro.get());
     }
     else
     {
-        result = _imageURI->readImage(dbOptions);
+        result = ImageCache::readSharedImage(_imageURI.get(), dbOptions);
     }
     return result.releaseImage();
 }
@@ -21,11 +21,28 @@
 */
 #include <osgEarthUtil/DataScanner>
 #include <osgEarthDrivers/gdal/GDALOptions>
+#include <osgEarth/Registry>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <osg/Timer>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+#include <gdal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
 
 #define LC "[DataScanner] "
 
+#define MANIFEST_HEADER "#osgEarth DataScanner manifest 1"
+
 using namespace osgEarth;
 using namespace osgEarth::Util;
 using namespace osgEarth::Drivers;
@@ -34,7 +51,7 @@ namespace
 {
     void traverse(const std::string&              path,
                   const std::vector<std::string>& extensions,
-                  ImageLayerVector&               out_imageLayers)
+                  std::vector<std::string>&       out_paths)
     {
         if ( osgDB::fileType(path) == osgDB::DIRECTORY )
         {
@@ -45,7 +62,7 @@ namespace
                     continue;
 
                 std::string filepath = osgDB::concatPaths( path, *f );
-                traverse( filepath, extensions, out_imageLayers );
+                traverse( filepath, extensions, out_paths );
             }
         }
 
@@ -55,26 +72,315 @@ namespace
 
             if ( std::find(extensions.begin(), extensions.end(), ext) != extensions.end() )
             {
-                GDALOptions gdal;
-                gdal.url() = path;
-                //gdal.interpolation() = INTERP_NEAREST;
+                out_paths.push_back( path );
+            }
+        }
+    }
+
+    typedef std::map<std::string, DataScanner::Record> Manifest;
+
+    // Manifest format: a header line, then tab-separated lines. "srs" lines
+    // hold the distinct WKT strings; "file" lines refer to them by index
+    // (-1 for none) and end with the path, so paths may contain spaces.
+    bool readManifest(const std::string& filename, Manifest& out)
+    {
+        std::ifstream in( filename.c_str() );
+        if ( !in.is_open() )
+            return false;
+
+        std::string line;
+        if ( !std::getline(in, line) || line != MANIFEST_HEADER )
+        {
+            OE_WARN << LC << "Ignoring " << filename << "; it is not a scanner manifest" << std::endl;
+            return false;
+        }
+
+        std::vector<std::string> srsTable;
+        while( std::getline(in, line) )
+        {
+            if ( line.compare(0, 4, "srs\t") == 0 )
+            {
+                srsTable.push_back( line.substr(4) );
+            }
+            else if ( line.compare(0, 5, "file\t") == 0 )
+            {
+                std::istringstream buf( line.substr(5) );
+                DataScanner::Record record;
+                long long modified;
+                int readable, srs;
+                buf >> modified >> record._size >> readable >> srs
+                    >> record._xmin >> record._ymin >> record._xmax >> record._ymax
+                    >> record._resolutionX >> record._resolutionY
+                    >> record._width >> record._height;
+                buf.get();
+                std::getline( buf, record._path );
 
-                ImageLayerOptions options( path, gdal );
-                options.cachePolicy() = CachePolicy::NO_CACHE;
+                if ( buf.fail() || record._path.empty() || srs >= (int)srsTable.size() )
+                    continue;
 
-                ImageLayer* layer = new ImageLayer(options);
-                out_imageLayers.push_back( layer );
-                OE_INFO << LC << "Found " << path << std::endl;
+                record._modified = (TimeStamp)modified;
+                record._readable = readable != 0;
+                if ( srs >= 0 )
+                    record._srs = srsTable[srs];
+                out[record._path] = record;
             }
         }
+        return true;
     }
+
+    bool writeManifest(const std::string& filename, const std::vector<DataScanner::Record>& records)
+    {
+        std::map<std::string, int> srsTable;
+        std::ostringstream srsLines, fileLines;
+        fileLines << std::setprecision(17);
+
+        for(unsigned i=0; i<records.size(); ++i)
+        {
+            const DataScanner::Record& record = records[i];
+
+            int srs = -1;
+            if ( !record._srs.empty() )
+            {
+                std::map<std::string, int>::const_iterator s = srsTable.find( record._srs );
+                if ( s == srsTable.end() )
+                {
+                    srs = srsTable.size();
+                    srsTable[record._srs] = srs;
+                    srsLines << "srs\t" << record._srs << "\n";
+                }
+                else
+                {
+                    srs = s->second;
+                }
+            }
+
+            fileLines << "file\t"
+                << (long long)record._modified << "\t" << record._size << "\t"
+                << (record._readable ? 1 : 0) << "\t" << srs << "\t"
+                << record._xmin << "\t" << record._ymin << "\t" << record._xmax << "\t" << record._ymax << "\t"
+                << record._resolutionX << "\t" << record._resolutionY << "\t"
+                << record._width << "\t" << record._height << "\t"
+                << record._path << "\n";
+        }
+
+        // write to a temporary file and swap it in, so an interrupted scan
+        // never leaves a truncated manifest behind.
+        std::string tempname = filename + ".tmp";
+        {
+            std::ofstream out( tempname.c_str(), std::ios::out | std::ios::trunc );
+            if ( !out.is_open() )
+            {
+                OE_WARN << LC << "Cannot write manifest " << tempname << std::endl;
+                return false;
+            }
+            out << MANIFEST_HEADER << "\n" << srsLines.str() << fileLines.str();
+            if ( out.fail() )
+            {
+                OE_WARN << LC << "Failed to write manifest " << tempname << std::endl;
+                return false;
+            }
+        }
+
+        ::remove( filename.c_str() );
+        return ::rename( tempname.c_str(), filename.c_str() ) == 0;
+    }
+
+    // Opens a file with GDAL to read its size, geotransform and SRS. GDAL can
+    // open separate datasets concurrently, so this runs without the global lock.
+    void readFile(DataScanner::Record& record)
+    {
+        GDALDatasetH ds = GDALOpen( record._path.c_str(), GA_ReadOnly );
+        record._readable = ds != 0L;
+        if ( !ds )
+            return;
+
+        record._width  = GDALGetRasterXSize( ds );
+        record._height = GDALGetRasterYSize( ds );
+
+        double gt[6];
+        const char* wkt = GDALGetProjectionRef( ds );
+        if ( GDALGetGeoTransform(ds, gt) == CE_None && gt[2] == 0.0 && gt[4] == 0.0 && wkt && *wkt )
+        {
+            double x0 = gt[0], x1 = gt[0] + gt[1]*record._width;
+            double y0 = gt[3], y1 = gt[3] + gt[5]*record._height;
+            record._srs         = wkt;
+            record._xmin        = osg::minimum(x0, x1);
+            record._ymin        = osg::minimum(y0, y1);
+            record._xmax        = osg::maximum(x0, x1);
+            record._ymax        = osg::maximum(y0, y1);
+            record._resolutionX = osg::absolute(gt[1]);
+            record._resolutionY = osg::absolute(gt[5]);
+
+            // the manifest is line-based:
+            std::replace( record._srs.begin(), record._srs.end(), '\n', ' ' );
+            std::replace( record._srs.begin(), record._srs.end(), '\r', ' ' );
+        }
+
+        GDALClose( ds );
+    }
+
+    struct ScanState
+    {
+        const std::vector<std::string>*    _paths;
+        std::vector<DataScanner::Record>*  _records;
+        const Manifest*                    _manifest;
+        OpenThreads::Atomic                _next;
+        OpenThreads::Atomic                _scanned;
+    };
+
+    // pulls files off the shared list until there are none left.
+    struct ScanJob
+    {
+        ScanJob() : _state(0L) { }
+
+        void execute()
+        {
+            unsigned total = _state->_paths->size();
+            for(unsigned i = (++_state->_next) - 1u; i < total; i = (++_state->_next) - 1u)
+            {
+                DataScanner::Record& record = (*_state->_records)[i];
+                record._path = (*_state->_paths)[i];
+
+                struct stat buf;
+                if ( ::stat(record._path.c_str(), &buf) == 0 )
+                {
+                    record._modified = buf.st_mtime;
+                    record._size     = buf.st_size;
+                }
+
+                Manifest::const_iterator m = _state->_manifest->find( record._path );
+                if ( m != _state->_manifest->end() &&
+                     m->second._modified == record._modified &&
+                     m->second._size == record._size )
+                {
+                    record = m->second;
+                }
+                else
+                {
+                    readFile( record );
+                    ++_state->_scanned;
+                }
+            }
+        }
+
+        ScanState* _state;
+    };
 }
 
+//------------------------------------------------------------------------
+
+DataScanner::DataScanner() :
+_numThreads( osg::maximum(OpenThreads::GetNumberOfProcessors(), 1) )
+{
+    //nop
+}
+
+void
+DataScanner::scan(const std::string&              absRootPath,
+                  const std::vector<std::string>& extensions,
+                  std::vector<Record>&            out_records) const
+{
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    // Make sure the registry is loaded since that is where the GDAL registration happens
+    osgEarth::Registry::instance();
+
+    std::vector<std::string> paths;
+    traverse( absRootPath, extensions, paths );
+
+    Manifest manifest;
+    if ( !_manifest.empty() )
+        readManifest( _manifest, manifest );
+
+    // Each file gets its own slot, so the order of the results does not
+    // depend on which thread read what.
+    out_records.resize( paths.size() );
+
+    ScanState state;
+    state._paths    = &paths;
+    state._records  = &out_records;
+    state._manifest = &manifest;
+
+    unsigned numJobs = osg::clampBetween( (unsigned)paths.size(), 1u, osg::maximum(_numThreads, 1u) );
+
+    std::vector< osg::ref_ptr< ParallelTask<ScanJob> > > jobs;
+    for(unsigned j=0; j<numJobs; ++j)
+    {
+        jobs.push_back( new ParallelTask<ScanJob>() );
+        jobs.back()->_state = &state;
+    }
+
+    // the calling thread runs the first job and the pool the rest.
+    Threading::MultiEvent semaphore;
+    osg::ref_ptr<TaskService> service;
+    if ( numJobs > 1 )
+    {
+        semaphore.reset( numJobs-1 );
+        service = new TaskService( "DataScanner", numJobs-1 );
+        for(unsigned j=1; j<numJobs; ++j)
+        {
+            jobs[j]->_mev = &semaphore;
+            service->add( jobs[j].get() );
+        }
+    }
+
+    jobs[0]->execute();
+
+    if ( numJobs > 1 )
+        semaphore.wait();
+
+    _stats._files   = paths.size();
+    _stats._scanned = state._scanned;
+    _stats._reused  = _stats._files - _stats._scanned;
+
+    // save the manifest if anything changed (including removed files).
+    if ( !_manifest.empty() && (_stats._scanned > 0u || manifest.size() != paths.size()) )
+        writeManifest( _manifest, out_records );
+
+    _stats._seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+    OE_INFO << LC << "Scanned " << absRootPath << ": " << _stats._files << " files, "
+        << _stats._scanned << " opened, " << _stats._reused << " unchanged, in "
+        << _stats._seconds << " s" << std::endl;
+}
 
 void
 DataScanner::findImageLayers(const std::string&              absRootPath,
                              const std::vector<std::string>& extensions,
                              ImageLayerVector&               out_imageLayers) const
 {
-    traverse( absRootPath, extensions, out_imageLayers );
+    std::vector<Record> records;
+    scan( absRootPath, extensions, records );
+
+    for(std::vector<Record>::const_iterator r = records.begin(); r != records.end(); ++r)
+    {
+        if ( !r->_readable )
+        {
+            OE_INFO << LC << "Skipped " << r->_path << " (GDAL cannot read it)" << std::endl;
+            continue;
+        }
+
+        GDALOptions gdal;
+        gdal.url() = r->_path;
+        //gdal.interpolation() = INTERP_NEAREST;
+
+        // pass along what the scan already knows, so the driver can set up
+        // the layer without opening the file again.
+        if ( !r->_srs.empty() && r->_width > 0u && r->_height > 0u )
+        {
+            ProfileOptions extent;
+            extent.srsString() = r->_srs;
+            extent.bounds()    = Bounds( r->_xmin, r->_ymin, r->_xmax, r->_ymax );
+            gdal.sourceExtent() = extent;
+            gdal.sourceWidth()  = r->_width;
+            gdal.sourceHeight() = r->_height;
+        }
+
+        ImageLayerOptions options( r->_path, gdal );
+        options.cachePolicy() = CachePolicy::NO_CACHE;
+
+        ImageLayer* layer = new ImageLayer(options);
+        out_imageLayers.push_back( layer );
+        OE_INFO << LC << "Found " << r->_path << std::endl;
+    }
 }
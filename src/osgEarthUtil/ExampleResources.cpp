@@ -390,6 +390,9 @@ MapNodeHelper::parse(MapNode*             mapNode,
 
     std::string imageExtensions;
     args.read("--image-extensions", imageExtensions);
+
+    std::string imageManifest;
+    args.read("--images-manifest", imageManifest);
     
     // animation path:
     std::string animpath;
@@ -571,6 +574,7 @@ MapNodeHelper::parse(MapNode*             mapNode,
         OE_INFO << LC << "Loading images from " << imageFolder << "..." << std::endl;
         ImageLayerVector imageLayers;
         DataScanner scanner;
+        scanner.setManifest( imageManifest );
         scanner.findImageLayers( imageFolder, extensions, imageLayers );
 
         if ( imageLayers.size() > 0 )
@@ -713,6 +717,7 @@ MapNodeHelper::usage() const
         << "  --logdepth2                   : activates logarithmic depth buffer with per-fragment interpolation\n"
         << "  --images [path]               : finds and loads image layers from folder [path]\n"
         << "  --image-extensions [ext,...]  : with --images, extensions to use\n"
+        << "  --images-manifest [file]      : with --images, manifest file used to skip unchanged files\n"
         << "  --out-earth [file]            : write the loaded map to an earth file\n"
         << "  --uniform [name] [min] [max]  : create a uniform controller with min/max values\n"
         << "  --path [file]                 : load and playback an animation path\n";
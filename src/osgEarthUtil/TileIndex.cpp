@@ -27,6 +27,11 @@
 #include <ogr_api.h>
 #include <osgEarthFeatures/OgrUtils>
 #include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -36,7 +41,42 @@ using namespace std;
 
 #define OGR_SCOPED_LOCK GDAL_SCOPED_LOCK
 
-TileIndex::TileIndex()
+#define LC "[TileIndex] "
+
+namespace
+{
+    const char     INDEX_MAGIC[8]  = { 'O', 'E', 'T', 'I', 'D', 'X', '0', '2' };
+    const unsigned INDEX_BYTEORDER = 0x01020304u;
+
+    // Binary index layout: this header, then the sections it points to, each
+    // aligned to 8 bytes. The first three sections are the arrays of a
+    // PackedHilbertRTree, mapped as they are.
+    struct IndexHeader
+    {
+        char               _magic[8];
+        unsigned           _byteOrder;
+        unsigned           _nodeSize;
+        unsigned           _numEntries;
+        unsigned           _numBoxes;
+        unsigned           _numLevels;
+        unsigned           _indexSize;        // sizeof(unsigned long) of the writer
+        unsigned long long _levelEndsOffset;  // unsigned[numLevels]
+        unsigned long long _boxesOffset;      // PackedHilbertRTree::Box[numBoxes]
+        unsigned long long _indicesOffset;    // unsigned long[numBoxes]
+        unsigned long long _locationsOffset;  // unsigned long long[numEntries+1]
+        unsigned long long _stringsOffset;    // char[]
+        unsigned long long _fileSize;
+    };
+
+    unsigned long long align8(unsigned long long offset)
+    {
+        return (offset + 7u) & ~7ull;
+    }
+}
+
+TileIndex::TileIndex() :
+_locations( 0L ),
+_strings  ( 0L )
 {
 }
 
@@ -45,6 +85,112 @@ TileIndex::~TileIndex()
 
 }
 
+bool
+TileIndex::isBinary(const std::string& filename)
+{
+    return osgDB::getLowerCaseFileExtension( filename ) == "tidx";
+}
+
+bool
+TileIndex::write(const std::string& filename, const std::vector<Entry>& entries, unsigned nodeSize)
+{
+    unsigned numEntries = entries.size();
+
+    // the same packed R-tree the OGR driver keeps in memory, keyed by entry number:
+    std::vector<PackedHilbertRTree::Item> items( numEntries );
+    for(unsigned i=0; i<numEntries; ++i)
+    {
+        items[i]._id   = i;
+        items[i]._xmin = entries[i]._xmin;
+        items[i]._ymin = entries[i]._ymin;
+        items[i]._xmax = entries[i]._xmax;
+        items[i]._ymax = entries[i]._ymax;
+    }
+
+    osg::ref_ptr<PackedHilbertRTree> tree = new PackedHilbertRTree();
+    tree->build( items, nodeSize );
+
+    // locations, in entry order:
+    std::string strings;
+    std::vector<unsigned long long> locations;
+    for(unsigned i=0; i<numEntries; ++i)
+    {
+        locations.push_back( strings.size() );
+        strings.append( entries[i]._location );
+    }
+    locations.push_back( strings.size() );
+
+    IndexHeader header;
+    ::memset( &header, 0, sizeof(header) );
+    ::memcpy( header._magic, INDEX_MAGIC, sizeof(INDEX_MAGIC) );
+    header._byteOrder       = INDEX_BYTEORDER;
+    header._nodeSize        = tree->getNodeSize();
+    header._numEntries      = numEntries;
+    header._numBoxes        = tree->getNumBoxes();
+    header._numLevels       = tree->getNumLevels();
+    header._indexSize       = sizeof(unsigned long);
+    header._levelEndsOffset = align8( sizeof(IndexHeader) );
+    header._boxesOffset     = align8( header._levelEndsOffset + header._numLevels*sizeof(unsigned) );
+    header._indicesOffset   = align8( header._boxesOffset + header._numBoxes*sizeof(PackedHilbertRTree::Box) );
+    header._locationsOffset = align8( header._indicesOffset + header._numBoxes*sizeof(unsigned long) );
+    header._stringsOffset   = align8( header._locationsOffset + locations.size()*sizeof(unsigned long long) );
+    header._fileSize        = header._stringsOffset + strings.size();
+
+    // write to a temporary file and swap it in, so that processes mapping the
+    // old index never see a partial one.
+    std::string tempname = filename + ".tmp";
+    std::ofstream out( tempname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !out.is_open() )
+    {
+        OE_WARN << LC << "Cannot open " << tempname << " for writing" << std::endl;
+        return false;
+    }
+
+    const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    unsigned long long pos = 0u;
+
+    out.write( (const char*)&header, sizeof(header) );
+    pos += sizeof(header);
+
+    const char* sections[5] = {
+        (const char*)tree->getLevelEnds(),
+        (const char*)tree->getBoxes(),
+        (const char*)tree->getIndices(),
+        (const char*)&locations[0],
+        strings.data() };
+    unsigned long long offsets[5] = {
+        header._levelEndsOffset, header._boxesOffset, header._indicesOffset,
+        header._locationsOffset, header._stringsOffset };
+    unsigned long long sizes[5] = {
+        header._numLevels*sizeof(unsigned), header._numBoxes*sizeof(PackedHilbertRTree::Box), header._numBoxes*sizeof(unsigned long),
+        locations.size()*sizeof(unsigned long long), strings.size() };
+
+    for(unsigned i=0; i<5; ++i)
+    {
+        out.write( zeros, offsets[i] - pos );
+        if ( sizes[i] > 0u )
+            out.write( sections[i], sizes[i] );
+        pos = offsets[i] + sizes[i];
+    }
+
+    out.close();
+    if ( out.fail() )
+    {
+        OE_WARN << LC << "Failed to write " << tempname << std::endl;
+        ::remove( tempname.c_str() );
+        return false;
+    }
+
+    ::remove( filename.c_str() );
+    if ( ::rename( tempname.c_str(), filename.c_str() ) != 0 )
+    {
+        OE_WARN << LC << "Failed to rename " << tempname << " to " << filename << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 TileIndex*
     TileIndex::load(const std::string& filename)
 {        
@@ -53,6 +199,72 @@ TileIndex*
         return 0;
     }
 
+    if ( isBinary(filename) )
+    {
+        osg::ref_ptr<MappedFile> file = MappedFile::open( filename );
+        if ( !file.valid() )
+            return 0;
+
+        IndexHeader header;
+        bool ok = file->size() >= sizeof(header);
+        if ( ok )
+        {
+            ::memcpy( &header, file->data(), sizeof(header) );
+            ok =
+                ::memcmp( header._magic, INDEX_MAGIC, sizeof(INDEX_MAGIC) ) == 0 &&
+                header._byteOrder == INDEX_BYTEORDER &&
+                header._indexSize == sizeof(unsigned long) &&
+                header._fileSize  == file->size() &&
+                header._levelEndsOffset + (unsigned long long)header._numLevels*sizeof(unsigned) <= header._boxesOffset &&
+                header._boxesOffset + (unsigned long long)header._numBoxes*sizeof(PackedHilbertRTree::Box) <= header._indicesOffset &&
+                header._indicesOffset + (unsigned long long)header._numBoxes*sizeof(unsigned long) <= header._locationsOffset &&
+                header._locationsOffset + (unsigned long long)(header._numEntries+1u)*sizeof(unsigned long long) <= header._stringsOffset &&
+                header._stringsOffset <= header._fileSize &&
+                (header._levelEndsOffset | header._boxesOffset | header._indicesOffset | header._locationsOffset) % 8u == 0u;
+        }
+
+        if ( !ok )
+        {
+            OE_WARN << LC << filename << " is not a valid binary tile index" << std::endl;
+            return 0;
+        }
+
+        osg::ref_ptr<TileIndex> index = new TileIndex();
+        index->_file      = file.get();
+        index->_filename  = filename;
+        index->_locations = (const unsigned long long*)(file->data() + header._locationsOffset);
+        index->_strings   = file->data() + header._stringsOffset;
+
+        // the tree checks its own links; check the rest once here so queries need not.
+        index->_tree = new PackedHilbertRTree();
+        ok = index->_tree->setView(
+            header._nodeSize,
+            header._numEntries,
+            header._numLevels,
+            (const unsigned*)                 (file->data() + header._levelEndsOffset),
+            header._numBoxes,
+            (const PackedHilbertRTree::Box*)  (file->data() + header._boxesOffset),
+            (const unsigned long*)            (file->data() + header._indicesOffset) );
+
+        unsigned long long stringsSize = header._fileSize - header._stringsOffset;
+        for(unsigned i=0; ok && i<header._numEntries; ++i)
+            ok = index->_locations[i] <= index->_locations[i+1];
+        ok = ok && index->_locations[header._numEntries] <= stringsSize;
+
+        const unsigned long* leaves = index->_tree->getIndices();
+        for(unsigned i=0; ok && i<header._numEntries; ++i)
+            ok = leaves[i] < header._numEntries;
+
+        if ( !ok )
+        {
+            OE_WARN << LC << filename << " is corrupt" << std::endl;
+            return 0;
+        }
+
+        OE_INFO << LC << "Mapped " << filename << " (" << header._numEntries << " files)" << std::endl;
+        return index.release();
+    }
+
     //Load up an index file
     OGRFeatureOptions featureOpt;
     featureOpt.url() = filename;        
@@ -77,6 +289,12 @@ TileIndex*
 TileIndex*
     TileIndex::create( const std::string& filename, const osgEarth::SpatialReference* srs )
 {
+    if ( isBinary(filename) )
+    {
+        OE_WARN << LC << "Binary indexes are written in one go; use TileIndex::write or TileIndexBuilder" << std::endl;
+        return 0;
+    }
+
     // Make sure the registry is loaded since that is where the OGR/GDAL registration happens
     osgEarth::Registry::instance();
 
@@ -109,6 +327,13 @@ void
     TileIndex::getFiles(const osgEarth::GeoExtent& extent, std::vector< std::string >& files)
 {            
     files.clear();
+
+    if ( _file.valid() )
+    {
+        getBinaryFiles( extent, files );
+        return;
+    }
+
     osgEarth::Symbology::Query query;    
 
     GeoExtent transformed = extent.transform( _features->getFeatureProfile()->getSRS() );
@@ -126,8 +351,51 @@ void
     }    
 }
 
+void
+TileIndex::getBinaryFiles(const osgEarth::GeoExtent& extent, std::vector< std::string >& files) const
+{
+    if ( !_tree.valid() || _tree->getNumItems() == 0u )
+        return;
+
+    std::vector<GeoExtent> queries;
+    GeoExtent geo = extent.transform( SpatialReference::get("wgs84") );
+    GeoExtent west, east;
+    if ( geo.crossesAntimeridian() && geo.splitAcrossAntimeridian(west, east) )
+    {
+        queries.push_back( west );
+        queries.push_back( east );
+    }
+    else
+    {
+        queries.push_back( geo );
+    }
+
+    std::vector<unsigned long> hits;
+    for(unsigned q=0; q<queries.size(); ++q)
+    {
+        const Bounds b = queries[q].bounds();
+        _tree->query( b.xMin(), b.yMin(), b.xMax(), b.yMax(), hits );
+    }
+
+    // entry order is the order the files were added, same as the shapefile.
+    std::sort( hits.begin(), hits.end() );
+    hits.erase( std::unique(hits.begin(), hits.end()), hits.end() );
+
+    for(unsigned i=0; i<hits.size(); ++i)
+    {
+        std::string location( _strings + _locations[hits[i]], _strings + _locations[hits[i]+1] );
+        files.push_back( getFullPath(_filename, location) );
+    }
+}
+
 bool TileIndex::add( const std::string& filename, const GeoExtent& extent )
 {       
+    if ( _file.valid() )
+    {
+        OE_WARN << LC << "Cannot add " << filename << " to read-only binary index " << _filename << std::endl;
+        return false;
+    }
+
     osg::ref_ptr< Polygon > polygon = new Polygon();
     polygon->push_back( osg::Vec3d(extent.bounds().xMin(), extent.bounds().yMin(), 0) );
     polygon->push_back( osg::Vec3d(extent.bounds().xMax(), extent.bounds().yMin(), 0) );
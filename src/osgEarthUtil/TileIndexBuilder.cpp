@@ -24,9 +24,14 @@
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/Progress>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <osgEarthDrivers/gdal/GDALOptions>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+#include <gdal.h>
 
 using namespace osgDB;
 using namespace osgEarth;
@@ -35,6 +40,126 @@ using namespace osgEarth::Drivers;
 using namespace osgEarth::Features;
 using namespace std;
 
+namespace
+{
+    typedef std::vector<TileIndex::Entry> Footprints;
+
+    // Reads a file's footprint straight from its geotransform. GDAL can open
+    // separate datasets concurrently, so this runs without the global lock.
+    bool scanGeoTransform(const std::string& filename, const std::string& location, Footprints& out)
+    {
+        GDALDatasetH ds = GDALOpen( filename.c_str(), GA_ReadOnly );
+        if ( !ds )
+            return false;
+
+        bool ok = false;
+        double gt[6];
+        const char* wkt = GDALGetProjectionRef( ds );
+        if ( GDALGetGeoTransform(ds, gt) == CE_None && gt[2] == 0.0 && gt[4] == 0.0 && wkt && *wkt )
+        {
+            osg::ref_ptr<const SpatialReference> srs = SpatialReference::create( wkt );
+            if ( srs.valid() )
+            {
+                double x0 = gt[0], x1 = gt[0] + gt[1]*GDALGetRasterXSize(ds);
+                double y0 = gt[3], y1 = gt[3] + gt[5]*GDALGetRasterYSize(ds);
+                GeoExtent extent = GeoExtent(
+                    srs.get(),
+                    osg::minimum(x0, x1), osg::minimum(y0, y1),
+                    osg::maximum(x0, x1), osg::maximum(y0, y1) ).transform( SpatialReference::get("wgs84") );
+
+                if ( extent.isValid() )
+                {
+                    TileIndex::Entry entry;
+                    entry._location = location;
+                    entry._xmin = extent.xMin();
+                    entry._ymin = extent.yMin();
+                    entry._xmax = extent.xMax();
+                    entry._ymax = extent.yMax();
+                    out.push_back( entry );
+                    ok = true;
+                }
+            }
+        }
+
+        GDALClose( ds );
+        return ok;
+    }
+
+    // Falls back on the GDAL driver for files the fast path can't place
+    // (rotated or GCP-referenced rasters, which the driver warps).
+    bool scanTileSource(const std::string& filename, const std::string& location, Footprints& out)
+    {
+        GDALOptions opt;
+        opt.url() = filename;
+
+        osg::ref_ptr< ImageLayer > layer = new ImageLayer( ImageLayerOptions("", opt) );
+        osg::ref_ptr< TileSource > source = layer->getTileSource();
+        if ( !source.valid() )
+            return false;
+
+        const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+        for (DataExtentList::iterator itr = source->getDataExtents().begin(); itr != source->getDataExtents().end(); ++itr)
+        {
+            GeoExtent extent = itr->transform( wgs84 );
+            TileIndex::Entry entry;
+            entry._location = location;
+            entry._xmin = extent.xMin();
+            entry._ymin = extent.yMin();
+            entry._xmax = extent.xMax();
+            entry._ymax = extent.yMax();
+            out.push_back( entry );
+        }
+        return !out.empty();
+    }
+
+    struct ScanState
+    {
+        const std::vector<std::string>* _filenames;
+        std::vector<Footprints>*        _footprints;
+        std::string                     _indexDir;
+        ProgressCallback*               _progress;
+        OpenThreads::Atomic             _next;
+        Threading::Mutex                _progressMutex;
+        unsigned                        _done;
+    };
+
+    // pulls files off the shared list until there are none left.
+    struct ScanJob
+    {
+        ScanJob() : _state(0L) { }
+
+        void execute()
+        {
+            unsigned total = _state->_filenames->size();
+            for(unsigned i = (++_state->_next) - 1u; i < total; i = (++_state->_next) - 1u)
+            {
+                const std::string& filename = (*_state->_filenames)[i];
+
+                // We want the filename as it is relative to the index file
+                std::string relative = getPathRelative( _state->_indexDir, filename );
+
+                Footprints& footprints = (*_state->_footprints)[i];
+                bool ok =
+                    scanGeoTransform( filename, relative, footprints ) ||
+                    scanTileSource( filename, relative, footprints );
+
+                if ( _state->_progress )
+                {
+                    std::stringstream buf;
+                    buf << (ok ? "Processed " : "Skipped ") << filename;
+
+                    Threading::ScopedMutexLock lock( _state->_progressMutex );
+                    _state->_progress->reportProgress( (double)(++_state->_done), (double)total, buf.str() );
+                }
+            }
+        }
+
+        ScanState* _state;
+    };
+}
+
+//------------------------------------------------------------------------
+
 TileIndexBuilder::TileIndexBuilder()
 {
 }
@@ -53,57 +178,77 @@ void TileIndexBuilder::build(const std::string& indexFilename, const osgEarth::S
         srs = osgEarth::SpatialReference::create("wgs84");
     }
 
-    osg::ref_ptr< osgEarth::Util::TileIndex > index = osgEarth::Util::TileIndex::create( indexFilename, srs );
+    // Make sure the registry is loaded since that is where the GDAL registration happens
+    osgEarth::Registry::instance();
 
     _indexFilename = indexFilename;
-    std::string indexDir = getFilePath( _indexFilename );    
-    
-    unsigned int total = _expandedFilenames.size();
 
-    for (unsigned int i = 0; i < _expandedFilenames.size(); i++)
-    {   
-        std::string filename = _expandedFilenames[ i ];        
+    // Scan the files in parallel. Each file gets its own slot so the index
+    // comes out in the same order regardless of which thread scanned what.
+    std::vector<Footprints> footprints( _expandedFilenames.size() );
 
-        GDALOptions opt;
-        opt.url() = filename;
-        
-        osg::ref_ptr< ImageLayer > layer = new ImageLayer( ImageLayerOptions("", opt) );        
+    ScanState state;
+    state._filenames  = &_expandedFilenames;
+    state._footprints = &footprints;
+    state._indexDir   = getFilePath( _indexFilename );
+    state._progress   = _progress.get();
+    state._done       = 0u;
 
-        bool ok = false;
-                
-        if ( layer.valid() )        
-        {            
-            osg::ref_ptr< TileSource > source = layer->getTileSource();
-            if (source.valid())
-            {
-                for (DataExtentList::iterator itr = source->getDataExtents().begin(); itr != source->getDataExtents().end(); ++itr)
-                {
-                    // We want the filename as it is relative to the index file                
-                    std::string relative = getPathRelative( indexDir, filename );                
-                    index->add( relative, *itr);    
-                    ok = true;
-                }                
-            }
-        }        
+    unsigned numJobs = osg::clampBetween(
+        (unsigned)_expandedFilenames.size(),
+        1u,
+        (unsigned)osg::maximum(OpenThreads::GetNumberOfProcessors(), 1) );
+
+    std::vector< osg::ref_ptr< ParallelTask<ScanJob> > > jobs;
+    for(unsigned j=0; j<numJobs; ++j)
+    {
+        jobs.push_back( new ParallelTask<ScanJob>() );
+        jobs.back()->_state = &state;
+    }
 
-        if (_progress.valid())
+    // the calling thread runs the first job and the pool the rest.
+    Threading::MultiEvent semaphore;
+    osg::ref_ptr<TaskService> service;
+    if ( numJobs > 1 )
+    {
+        semaphore.reset( numJobs-1 );
+        service = new TaskService( "TileIndexBuilder", numJobs-1 );
+        for(unsigned j=1; j<numJobs; ++j)
         {
-            std::stringstream buf;
-            if (ok)
-            {
-                buf << "Processed ";
-            }
-            else
+            jobs[j]->_mev = &semaphore;
+            service->add( jobs[j].get() );
+        }
+    }
+
+    jobs[0]->execute();
+
+    if ( numJobs > 1 )
+        semaphore.wait();
+
+    if ( TileIndex::isBinary(indexFilename) )
+    {
+        Footprints entries;
+        for(unsigned i=0; i<footprints.size(); ++i)
+            entries.insert( entries.end(), footprints[i].begin(), footprints[i].end() );
+
+        TileIndex::write( indexFilename, entries );
+    }
+    else
+    {
+        osg::ref_ptr< osgEarth::Util::TileIndex > index = osgEarth::Util::TileIndex::create( indexFilename, srs );
+        if ( index.valid() )
+        {
+            const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+            for(unsigned i=0; i<footprints.size(); ++i)
             {
-                buf << "Skipped ";
+                for(unsigned k=0; k<footprints[i].size(); ++k)
+                {
+                    const TileIndex::Entry& e = footprints[i][k];
+                    index->add( e._location, GeoExtent(wgs84, e._xmin, e._ymin, e._xmax, e._ymax) );
+                }
             }
-
-            buf << filename;
-            _progress->reportProgress( (double)i+1, (double)total, buf.str() );
         }
     }
-
-    osg::Timer_t end = osg::Timer::instance()->tick();    
 }
 
 void TileIndexBuilder::expandFilenames()
@@ -0,0 +1,371 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthUtil/Viewshed>
+#include <osgEarth/ElevationQuery>
+#include <osgEarth/TaskService>
+#include <OpenThreads/Thread>
+#include <osg/Timer>
+
+#define LC "[Viewshed] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // values stored in the visibility grid
+    enum CellState
+    {
+        CELL_HIDDEN  = 0,
+        CELL_VISIBLE = 1,
+        CELL_OUTSIDE = 2
+    };
+
+    /**
+     * Samples the elevation of a contiguous range of grid cells.
+     * ElevationQuery is not thread safe, so each job makes its own.
+     */
+    struct SampleJob
+    {
+        SampleJob() : _points(0L), _begin(0), _end(0), _resolution(0.0), _elevations(0L) { }
+
+        void execute()
+        {
+            ElevationQuery query( _map.get() );
+            std::vector<osg::Vec3d> points( _points->begin()+_begin, _points->begin()+_end );
+            std::vector<double> elevations;
+            elevations.reserve( points.size() );
+            query.getElevations( points, _srs.get(), elevations, _resolution );
+            std::copy( elevations.begin(), elevations.end(), _elevations->begin()+_begin );
+        }
+
+        osg::ref_ptr<const Map>              _map;
+        osg::ref_ptr<const SpatialReference> _srs;
+        const std::vector<osg::Vec3d>*       _points;
+        unsigned                             _begin, _end;
+        double                               _resolution;
+        std::vector<double>*                 _elevations;
+    };
+
+    /**
+     * Grid shared by the sweep jobs. Cells are addressed by their offset
+     * (dx, dy) from the observer.
+     *   _heights: terrain height of each cell, corrected for curvature
+     *   _los:     height of the line of sight over each cell, i.e. the height
+     *             a cell must reach to be seen; never below the terrain
+     */
+    struct Grid
+    {
+        int                        _n, _size;
+        double                     _z0;        // observer height
+        double                     _target;    // target height above terrain
+        std::vector<double>        _heights;
+        std::vector<double>        _los;
+        std::vector<unsigned char> _visibility;
+
+        unsigned index(int dx, int dy) const { return (unsigned)((dy+_n)*_size + (dx+_n)); }
+
+        // Projects the line of sight over a cell 'inner' rings from the observer
+        // out to the next ring and classifies the cell there.
+        void set(unsigned i, double innerLOS, int inner)
+        {
+            double los = _z0 + (innerLOS - _z0) * (double)(inner+1) / (double)inner;
+            _visibility[i] = _heights[i] + _target >= los ? CELL_VISIBLE : CELL_HIDDEN;
+            _los[i] = osg::maximum( _heights[i], los );
+        }
+    };
+
+    /**
+     * Sweeps one of the straight rays (the axes and diagonals) that bound
+     * the octants. Along these the line of sight passes exactly through
+     * the cell centers, so no interpolation is needed.
+     */
+    void sweepRay(Grid& g, int ux, int uy)
+    {
+        unsigned first = g.index(ux, uy);
+        g._visibility[first] = CELL_VISIBLE;
+        g._los[first] = g._heights[first];
+
+        for(int k = 2; k <= g._n; ++k)
+        {
+            g.set( g.index(k*ux, k*uy), g._los[g.index((k-1)*ux, (k-1)*uy)], k-1 );
+        }
+    }
+
+    /**
+     * Sweeps the interior of one octant ring by ring (XDraw). In octant
+     * coordinates (a, b), with 0 < b < a, the ray to a cell crosses ring
+     * a-1 between cells (a-1, b-1) and (a-1, b). Both are either in the
+     * same octant, one ring in, or on its bounding rays, so the octants
+     * are independent once the rays are done.
+     */
+    struct OctantJob
+    {
+        void execute()
+        {
+            Grid& g = *_grid;
+            for(int a = 2; a <= g._n; ++a)
+            {
+                for(int b = 1; b < a; ++b)
+                {
+                    double w = (double)b / (double)a;
+                    double inner =
+                        w       * g._los[cell(a-1, b-1)] +
+                        (1.0-w) * g._los[cell(a-1, b)];
+
+                    g.set( cell(a, b), inner, a-1 );
+                }
+            }
+        }
+
+        unsigned cell(int a, int b) const
+        {
+            return _swap ? _grid->index(_sb*b, _sa*a) : _grid->index(_sa*a, _sb*b);
+        }
+
+        Grid* _grid;
+        bool  _swap;     // true if the major axis is y
+        int   _sa, _sb;  // signs of the major and minor axes
+    };
+}
+
+//------------------------------------------------------------------------
+
+Viewshed::Viewshed(const Map* map) :
+_map         ( map ),
+_radius      ( 5000.0 ),
+_resolution  ( 256u ),
+_targetHeight( 0.0 ),
+_refraction  ( 0.13 ),
+_numThreads  ( 0u ),
+_visibleColor( 0.0f, 1.0f, 0.0f, 0.5f ),
+_hiddenColor ( 1.0f, 0.0f, 0.0f, 0.5f ),
+_size        ( 0u )
+{
+    //nop
+}
+
+bool
+Viewshed::compute(const GeoPoint& observer, GeoImage& output, ProgressCallback* progress)
+{
+    _visibility.clear();
+    _size = 0u;
+
+    osg::ref_ptr<const Map> map;
+    if ( !_map.lock(map) || !map->getProfile() )
+        return false;
+
+    ElevationLayerVector elevationLayers;
+    map->getElevationLayers( elevationLayers );
+    if ( elevationLayers.empty() )
+    {
+        OE_WARN << LC << "Map has no elevation layers\n";
+        return false;
+    }
+
+    const SpatialReference* geoSRS = map->getSRS()->getGeographicSRS();
+    GeoPoint center;
+    if ( !observer.transform(geoSRS, center) )
+    {
+        OE_WARN << LC << "Failed to transform the observer into the map's SRS\n";
+        return false;
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    // Lay out the grid in degrees, with square cells of cellSize meters.
+    Grid g;
+    g._n    = (int)osg::maximum( _resolution, 1u );
+    g._size = 2*g._n + 1;
+    g._target = _targetHeight;
+
+    unsigned numCells = (unsigned)(g._size * g._size);
+    double cellSize   = _radius / (double)g._n;
+    double earthRadius= geoSRS->getEllipsoid()->getRadiusEquator();
+    double dLat       = osg::RadiansToDegrees( cellSize / earthRadius );
+    double dLon       = dLat / osg::maximum( cos(osg::DegreesToRadians(center.y())), 1e-6 );
+
+    std::vector<osg::Vec3d> points( numCells );
+    for(int dy = -g._n; dy <= g._n; ++dy)
+    {
+        double lat = osg::clampBetween( center.y() + dy*dLat, -90.0, 90.0 );
+        for(int dx = -g._n; dx <= g._n; ++dx)
+        {
+            double lon = center.x() + dx*dLon;
+            if      ( lon < -180.0 ) lon += 360.0;
+            else if ( lon >  180.0 ) lon -= 360.0;
+            points[g.index(dx, dy)].set( lon, lat, 0.0 );
+        }
+    }
+
+    unsigned numThreads = _numThreads > 0u ? _numThreads :
+        (unsigned)osg::maximum( OpenThreads::GetNumberOfProcessors(), 1 );
+
+    osg::ref_ptr<TaskService> service = new TaskService( "Viewshed", numThreads );
+
+    // Sample the terrain. Several bands per thread even out the load
+    // when some tiles are slower to fetch than others.
+    g._heights.resize( numCells );
+    {
+        double resolution = map->getSRS()->isGeographic() ? dLat : cellSize;
+        unsigned numJobs  = osg::minimum( numThreads * 4u, (unsigned)g._size );
+        unsigned rowsPerJob = ((unsigned)g._size + numJobs - 1) / numJobs;
+
+        Threading::MultiEvent semaphore;
+        std::vector< osg::ref_ptr< ParallelTask<SampleJob> > > jobs;
+        for(unsigned row = 0; row < (unsigned)g._size; row += rowsPerJob)
+        {
+            ParallelTask<SampleJob>* job = new ParallelTask<SampleJob>();
+            job->_map        = map.get();
+            job->_srs        = geoSRS;
+            job->_points     = &points;
+            job->_begin      = row * g._size;
+            job->_end        = osg::minimum( row + rowsPerJob, (unsigned)g._size ) * g._size;
+            job->_resolution = resolution;
+            job->_elevations = &g._heights;
+            jobs.push_back( job );
+        }
+
+        semaphore.reset( jobs.size() );
+        for(unsigned i = 0; i < jobs.size(); ++i)
+        {
+            jobs[i]->_mev = &semaphore;
+            service->add( jobs[i].get() );
+        }
+        semaphore.wait();
+    }
+
+    if ( progress && progress->isCanceled() )
+        return false;
+
+    // Observer height, then drop the terrain by the curvature of the earth
+    // (reduced by refraction) with distance from the observer.
+    unsigned centerIndex = g.index(0, 0);
+    g._z0 = center.altitudeMode() == ALTMODE_RELATIVE ?
+        g._heights[centerIndex] + center.z() :
+        center.z();
+
+    double curvature = (1.0 - _refraction) * cellSize * cellSize / (2.0 * earthRadius);
+    for(int dy = -g._n; dy <= g._n; ++dy)
+        for(int dx = -g._n; dx <= g._n; ++dx)
+            g._heights[g.index(dx, dy)] -= curvature * (double)(dx*dx + dy*dy);
+
+    // Sweep the bounding rays, then the octants between them in parallel.
+    g._los.resize( numCells );
+    g._visibility.resize( numCells );
+    g._los[centerIndex] = g._heights[centerIndex];
+    g._visibility[centerIndex] = CELL_VISIBLE;
+
+    for(int ux = -1; ux <= 1; ++ux)
+        for(int uy = -1; uy <= 1; ++uy)
+            if ( ux != 0 || uy != 0 )
+                sweepRay( g, ux, uy );
+
+    if ( g._n > 1 )
+    {
+        Threading::MultiEvent semaphore;
+        semaphore.reset( 8 );
+        std::vector< osg::ref_ptr< ParallelTask<OctantJob> > > jobs;
+        for(unsigned octant = 0; octant < 8u; ++octant)
+        {
+            ParallelTask<OctantJob>* job = new ParallelTask<OctantJob>( &semaphore );
+            job->_grid = &g;
+            job->_swap = (octant & 4u) != 0;
+            job->_sa   = (octant & 1u) ? -1 : 1;
+            job->_sb   = (octant & 2u) ? -1 : 1;
+            jobs.push_back( job );
+            service->add( job );
+        }
+        semaphore.wait();
+    }
+
+    // Clip to the radius and render the image.
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( g._size, g._size, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+
+    unsigned char colors[2][4];
+    for(unsigned c = 0; c < 4; ++c)
+    {
+        colors[CELL_HIDDEN][c]  = (unsigned char)(osg::clampBetween(_hiddenColor[c],  0.0f, 1.0f) * 255.0f);
+        colors[CELL_VISIBLE][c] = (unsigned char)(osg::clampBetween(_visibleColor[c], 0.0f, 1.0f) * 255.0f);
+    }
+
+    int r2 = g._n * g._n;
+    for(int dy = -g._n; dy <= g._n; ++dy)
+    {
+        unsigned char* pixel = image->data( 0, dy + g._n );
+        for(int dx = -g._n; dx <= g._n; ++dx, pixel += 4)
+        {
+            unsigned char& state = g._visibility[g.index(dx, dy)];
+            if ( dx*dx + dy*dy > r2 )
+            {
+                state = CELL_OUTSIDE;
+                pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+            }
+            else
+            {
+                pixel[0] = colors[state][0];
+                pixel[1] = colors[state][1];
+                pixel[2] = colors[state][2];
+                pixel[3] = colors[state][3];
+            }
+        }
+    }
+
+    _extent = GeoExtent(
+        geoSRS,
+        center.x() - (g._n + 0.5)*dLon, center.y() - (g._n + 0.5)*dLat,
+        center.x() + (g._n + 0.5)*dLon, center.y() + (g._n + 0.5)*dLat );
+    _size = (unsigned)g._size;
+    _visibility.swap( g._visibility );
+
+    output = GeoImage( image.get(), _extent );
+
+    OE_DEBUG << LC << "Computed " << g._size << "x" << g._size << " viewshed in "
+        << (int)(osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())) << "ms\n";
+
+    return true;
+}
+
+bool
+Viewshed::isVisible(const GeoPoint& target) const
+{
+    if ( _size == 0u || !_extent.isValid() )
+        return false;
+
+    GeoPoint p;
+    if ( !target.transform(_extent.getSRS(), p) )
+        return false;
+
+    double x = p.x();
+    if ( x < _extent.xMin() ) x += 360.0;
+    else if ( x > _extent.xMax() ) x -= 360.0;
+
+    double u = (x - _extent.xMin()) / _extent.width();
+    double v = (p.y() - _extent.yMin()) / _extent.height();
+    if ( u < 0.0 || u >= 1.0 || v < 0.0 || v >= 1.0 )
+        return false;
+
+    unsigned col = (unsigned)(u * (double)_size);
+    unsigned row = (unsigned)(v * (double)_size);
+    return _visibility[row*_size + col] == CELL_VISIBLE;
+}